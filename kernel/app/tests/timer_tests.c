@@ -5,6 +5,8 @@
 // https://opensource.org/licenses/MIT
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <rand.h>
 #include <err.h>
 #include <inttypes.h>
 #include <kernel/timer.h>
@@ -74,8 +76,120 @@ static void timer_test_all_cpus(void)
     printf("%u threads created, %u threads joined\n", max, joined);
 }
 
+#define NUM_QUEUE_TIMERS 1000
+
+struct queue_timer {
+    timer_t timer;
+    lk_bigtime_t deadline;
+    lk_bigtime_t fired;
+};
+
+static int queue_timers_fired;
+static int queue_timers_early;
+
+static enum handler_return queue_timer_cb(struct timer* timer, lk_bigtime_t now, void* arg)
+{
+    struct queue_timer* qt = (struct queue_timer*)arg;
+    qt->fired = now;
+    if (now < qt->deadline)
+        queue_timers_early++;
+    queue_timers_fired++;
+    return INT_NO_RESCHEDULE;
+}
+
+// lots of timers at random times, with some canceled out of the middle of
+// the queue, must each fire exactly once and never early
+static void timer_test_queue(void)
+{
+    struct queue_timer* timers = calloc(NUM_QUEUE_TIMERS, sizeof(*timers));
+    if (timers == NULL) {
+        printf("failed to allocate timers\n");
+        return;
+    }
+
+    queue_timers_fired = 0;
+    queue_timers_early = 0;
+
+    thread_set_pinned_cpu(get_current_thread(), 0);
+    thread_yield();
+
+    lk_bigtime_t now = current_time_hires();
+    for (int i = 0; i < NUM_QUEUE_TIMERS; i++) {
+        lk_bigtime_t delay = LK_USEC(rand() % 20000);
+        timers[i].deadline = now + delay;
+        timer_initialize(&timers[i].timer);
+        timer_set_oneshot_etc(&timers[i].timer, delay, (i & 1) ? LK_USEC(500) : 0,
+                              queue_timer_cb, &timers[i]);
+    }
+    int canceled = 0;
+    for (int i = 0; i < NUM_QUEUE_TIMERS; i += 3) {
+        timer_cancel(&timers[i].timer);
+        if (timers[i].fired == 0)
+            canceled++;
+    }
+
+    thread_sleep(LK_MSEC(50));
+
+    for (int i = 0; i < NUM_QUEUE_TIMERS; i++)
+        timer_cancel(&timers[i].timer);
+
+    thread_set_pinned_cpu(get_current_thread(), -1);
+
+    printf("%d timers, %d canceled, %d fired, %d early\n",
+           NUM_QUEUE_TIMERS, canceled, queue_timers_fired, queue_timers_early);
+    if (queue_timers_fired + canceled != NUM_QUEUE_TIMERS || queue_timers_early != 0)
+        printf("FAILED: timer queue test\n");
+
+    free(timers);
+}
+
+// two timers whose slack windows overlap fire from the same interrupt;
+// retry a few times in case some other interrupt happens to land between
+// their scheduled times
+static void timer_test_coalesce(void)
+{
+    struct queue_timer a, b;
+    bool coalesced = false;
+
+    thread_set_pinned_cpu(get_current_thread(), 0);
+    thread_yield();
+
+    for (int tries = 0; tries < 5 && !coalesced; tries++) {
+        a.fired = b.fired = 0;
+        queue_timers_fired = 0;
+        timer_initialize(&a.timer);
+        timer_initialize(&b.timer);
+
+        spin_lock_saved_state_t state;
+        arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
+        a.deadline = b.deadline = current_time_hires();
+        timer_set_oneshot_etc(&a.timer, LK_MSEC(2), LK_MSEC(2), queue_timer_cb, &a);
+        timer_set_oneshot_etc(&b.timer, LK_MSEC(3), LK_MSEC(2), queue_timer_cb, &b);
+        arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+
+        thread_sleep(LK_MSEC(10));
+        timer_cancel(&a.timer);
+        timer_cancel(&b.timer);
+
+        if (queue_timers_fired != 2) {
+            printf("FAILED: timer coalesce test, %d timers fired\n", queue_timers_fired);
+            break;
+        }
+        coalesced = (a.fired == b.fired);
+    }
+
+    thread_set_pinned_cpu(get_current_thread(), -1);
+
+    printf("coalesced timers fired at %" PRIu64 " and %" PRIu64 "\n", a.fired, b.fired);
+    if (!coalesced)
+        printf("FAILED: timer coalesce test\n");
+}
+
 void timer_tests(void)
 {
     // timer fires on all cpus
     timer_test_all_cpus();
+
+    timer_test_queue();
+    timer_test_coalesce();
 }
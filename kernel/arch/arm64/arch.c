@@ -183,8 +183,9 @@ static void arm64_cpu_early_init(void)
     /* enable user space access to cycle counter */
     ARM64_WRITE_SYSREG(pmuserenr_el0, 1UL);
 
-    /* enable user space access to virtual counter (CNTVCT_EL0) */
-    ARM64_WRITE_SYSREG(cntkctl_el1, 1UL << 1);
+    /* enable user space access to the virtual and physical counters
+     * (CNTVCT_EL0, CNTPCT_EL0) so the vDSO can read the time directly */
+    ARM64_WRITE_SYSREG(cntkctl_el1, (1UL << 1) | (1UL << 0));
 
     uint32_t cpu = arch_curr_cpu_num();
     arm64_get_cache_info(&(cache_info[cpu]));
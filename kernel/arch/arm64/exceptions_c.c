@@ -26,6 +26,12 @@
 
 bool arm64_in_int_handler[SMP_MAX_CPUS];
 
+/* the irq being handled on each cpu, for arch_get_irq_context() */
+static struct {
+    struct arm64_iframe_short *frame;
+    bool user;
+} arm64_irq_frame[SMP_MAX_CPUS];
+
 static void dump_iframe(const struct arm64_iframe_long *iframe)
 {
     printf("iframe %p:\n", iframe);
@@ -310,9 +316,12 @@ void arm64_irq(struct arm64_iframe_short *iframe, uint exception_flags)
 
     uint32_t curr_cpu = arch_curr_cpu_num();
     arm64_in_int_handler[curr_cpu] = true;
+    arm64_irq_frame[curr_cpu].frame = iframe;
+    arm64_irq_frame[curr_cpu].user = !!(exception_flags & ARM64_EXCEPTION_FLAG_LOWER_EL);
 
     enum handler_return ret = platform_irq(iframe);
 
+    arm64_irq_frame[curr_cpu].frame = NULL;
     arm64_in_int_handler[curr_cpu] = false;
 
     /* if we came from user space, check to see if we have any signals to handle */
@@ -328,6 +337,20 @@ void arm64_irq(struct arm64_iframe_short *iframe, uint exception_flags)
         thread_preempt(true);
 }
 
+bool arch_get_irq_context(struct arch_irq_context *context)
+{
+    uint32_t curr_cpu = arch_curr_cpu_num();
+    struct arm64_iframe_short *iframe = arm64_irq_frame[curr_cpu].frame;
+    if (!arm64_in_int_handler[curr_cpu] || iframe == NULL)
+        return false;
+
+    /* the short frame does not save x29, so there is no frame pointer */
+    context->pc = iframe->elr;
+    context->fp = 0;
+    context->user = arm64_irq_frame[curr_cpu].user;
+    return true;
+}
+
 /* called from assembly */
 void arm64_invalid_exception(struct arm64_iframe_long *iframe, unsigned int which);
 
@@ -311,6 +311,9 @@ void x86_exception_handler(x86_iframe_t *frame)
     }
 
     arch_set_in_int_handler(true);
+    struct x86_percpu *percpu = x86_get_percpu();
+    x86_iframe_t *prev_irq_frame = percpu->irq_frame;
+    percpu->irq_frame = frame;
 
     // did we come from user or kernel space?
     bool from_user = SELECTOR_PL(frame->cs) != 0;
@@ -415,6 +418,7 @@ void x86_exception_handler(x86_iframe_t *frame)
     }
 
     /* at this point we're able to be rescheduled, so we're 'outside' of the int handler */
+    percpu->irq_frame = prev_irq_frame;
     arch_set_in_int_handler(false);
 
     /* if we came from user space, check to see if we have any signals to handle */
@@ -435,6 +439,18 @@ void x86_exception_handler(x86_iframe_t *frame)
         frame->vector, frame->ip);
 }
 
+bool arch_get_irq_context(struct arch_irq_context *context)
+{
+    x86_iframe_t *frame = x86_get_percpu()->irq_frame;
+    if (!arch_in_int_handler() || frame == NULL)
+        return false;
+
+    context->pc = frame->ip;
+    context->fp = frame->rbp;
+    context->user = SELECTOR_PL(frame->cs) != 0;
+    return true;
+}
+
 __WEAK uint64_t x86_64_syscall(uint64_t arg1, uint64_t arg2, uint64_t arg3, uint64_t arg4,
                                uint64_t arg5, uint64_t arg6, uint64_t arg7, uint64_t arg8,
                                uint64_t syscall_num, uint64_t ip)
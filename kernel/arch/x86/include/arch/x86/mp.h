@@ -71,6 +71,9 @@ struct x86_percpu {
 
     /* Reserved space for interrupt stacks */
     uint8_t interrupt_stacks[NUM_ASSIGNED_IST_ENTRIES][PAGE_SIZE];
+
+    /* frame of the exception or irq being handled, if any */
+    x86_iframe_t *irq_frame;
 };
 
 static_assert(__offsetof(struct x86_percpu, direct) == PERCPU_DIRECT_OFFSET, "");
@@ -248,6 +248,14 @@ uint64_t ticks_per_second(void)
     return u64_mul_u32_fp32_64(1000 * 1000 * 1000, cntpct_per_ns);
 }
 
+platform_user_clock platform_get_user_clock(struct fp_32_64* ns_per_tick)
+{
+    // EL0 access to both counters is enabled by arm64_cpu_early_init.
+    *ns_per_tick = ns_per_cntpct;
+    return reg_procs->read_ct == read_cntvct ?
+        PLATFORM_USER_CLOCK_CNTVCT : PLATFORM_USER_CLOCK_CNTPCT;
+}
+
 static uint32_t abs_int32(int32_t a)
 {
     return (a > 0) ? a : -a;
@@ -63,6 +63,17 @@ static void arch_spinloop_signal(void);
 /* arch optimized version of a page zero routine against a page aligned buffer */
 void arch_zero_page(void *);
 
+/* where the code an interrupt handler interrupted was, for profiling */
+struct arch_irq_context {
+    vaddr_t pc;
+    vaddr_t fp; /* 0 if the arch does not save it on interrupt entry */
+    bool user;
+};
+
+/* fill in |context| for the current interrupt; returns false if not called
+ * from within an interrupt handler */
+bool arch_get_irq_context(struct arch_irq_context *context);
+
 /* give the specific arch a chance to override some routines */
 #include <arch/arch_ops.h>
 
@@ -0,0 +1,30 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <err.h>
+#include <magenta/compiler.h>
+#include <stddef.h>
+
+__BEGIN_CDECLS
+
+/* Kernel thread stacks, mapped in their own region of the kernel address
+ * space with unmapped guard pages either side, so that running off either
+ * end faults. Freed stacks are kept in a small per-cpu cache for reuse. */
+
+/* allocate a stack of |size| bytes, and an unsafe stack of the same size
+ * if |unsafe_stack| is not NULL */
+status_t kstack_alloc(size_t size, void **stack, void **unsafe_stack);
+
+/* free stacks from kstack_alloc; must be called from thread context */
+void kstack_free(void *stack, void *unsafe_stack, size_t size);
+
+/* free the current thread's own stacks on its way out, with interrupts
+ * disabled; they are not reused until this cpu has switched away */
+void kstack_delayed_free(void *stack, void *unsafe_stack, size_t size);
+
+__END_CDECLS
@@ -21,3 +21,6 @@ void sched_unblock_list(struct list_node *list, bool resched);
 
 void sched_yield(void);
 void sched_preempt(void);
+
+void sched_set_priority(thread_t *t, int priority);
+void sched_set_affinity(thread_t *t, uint32_t mask);
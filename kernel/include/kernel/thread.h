@@ -59,6 +59,7 @@ typedef void (*thread_user_callback_t)(enum thread_user_state_change new_state,
 
 #define THREAD_SIGNAL_KILL                    (1<<0)
 #define THREAD_SIGNAL_SUSPEND                 (1<<1)
+#define THREAD_SIGNAL_SAMPLE                  (1<<2)
 
 #define THREAD_MAGIC (0x74687264) // 'thrd'
 
@@ -83,6 +84,7 @@ typedef struct thread {
 #if WITH_SMP
     uint last_cpu; /* last/current cpu the thread is running on */
     int pinned_cpu; /* only run on pinned_cpu if >= 0 */
+    uint32_t cpu_affinity; /* mask of cpus the thread may run on, 0 for any */
 #endif
 
     /* pointer to the kernel address space this thread is associated with */
@@ -101,6 +103,16 @@ typedef struct thread {
      * left the scheduler. */
     lk_bigtime_t runtime_ns;
 
+    /* Total time spent in THREAD_READY state waiting in a run queue, and
+     * when the thread was last put in one. */
+    lk_bigtime_t ready_wait_ns;
+    lk_bigtime_t last_ready_time;
+
+    /* number of times the thread was switched to, and how many of those
+     * ended with it being preempted rather than blocking or yielding */
+    uint64_t context_switches;
+    uint64_t preemptions;
+
     /* if blocked, a pointer to the wait queue */
     struct wait_queue *blocking_wait_queue;
 
@@ -110,6 +122,9 @@ typedef struct thread {
     /* are we allowed to be interrupted on the current thing we're blocked/sleeping on */
     bool interruptable;
 
+    /* how late the timers for this thread's sleeps and wait timeouts may fire */
+    lk_bigtime_t timer_slack;
+
     /* non-NULL if stopped in an exception */
     const struct arch_exception_context *exception_context;
 
@@ -145,11 +160,13 @@ typedef struct thread {
 #define thread_pinned_cpu(t) ((t)->pinned_cpu)
 #define thread_set_last_cpu(t,c) ((t)->last_cpu = (c))
 #define thread_set_pinned_cpu(t, c) ((t)->pinned_cpu = (c))
+#define thread_cpu_affinity(t) ((t)->cpu_affinity)
 #else
 #define thread_last_cpu(t) (0)
 #define thread_pinned_cpu(t) (-1)
 #define thread_set_last_cpu(t,c) do {} while(0)
 #define thread_set_pinned_cpu(t, c) do {} while(0)
+#define thread_cpu_affinity(t) (0u)
 #endif
 
 /* thread priority */
@@ -179,6 +196,8 @@ void thread_construct_first(thread_t *t, const char *name);
 thread_t *thread_create_idle_thread(uint cpu_num);
 void thread_set_name(const char *name);
 void thread_set_priority(int priority);
+void thread_set_priority_etc(thread_t *t, int priority);
+void thread_set_cpu_affinity(thread_t *t, uint32_t mask);
 void thread_set_user_callback(thread_t *t, thread_user_callback_t cb);
 thread_t *thread_create(const char *name, thread_start_routine entry, void *arg, int priority, size_t stack_size);
 thread_t *thread_create_etc(thread_t *t, const char *name, thread_start_routine entry, void *arg, int priority, void *stack, void *unsafe_stack, size_t stack_size, thread_trampoline_routine alt_trampoline);
@@ -220,6 +239,17 @@ static inline status_t thread_sleep(lk_bigtime_t delay) { return thread_sleep_et
 /* return the number of nanoseconds a thread has been running for */
 lk_bigtime_t thread_runtime(const thread_t *t);
 
+/* scheduler accounting for a thread, including any time accrued in its
+ * current state */
+typedef struct thread_sched_stats {
+    lk_bigtime_t runtime_ns;
+    lk_bigtime_t ready_wait_ns;
+    uint64_t context_switches;
+    uint64_t preemptions;
+} thread_sched_stats_t;
+
+void thread_get_sched_stats(const thread_t *t, thread_sched_stats_t *stats);
+
 /* deliver a kill signal to a thread */
 void thread_kill(thread_t *t, bool block);
 
@@ -297,6 +327,9 @@ struct thread_stats {
 
 extern struct thread_stats thread_stats[SMP_MAX_CPUS];
 
+/* copy the stats of a cpu, counting the time it has been idle for if it is idle now */
+void thread_get_cpu_stats(uint cpu, struct thread_stats *stats);
+
 #define THREAD_STATS_INC(name) do { __atomic_fetch_add(&thread_stats[arch_curr_cpu_num()].name, 1u, __ATOMIC_RELAXED); } while(0)
 
 __END_CDECLS;
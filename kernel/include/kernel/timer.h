@@ -24,9 +24,15 @@ typedef enum handler_return (*timer_callback)(struct timer *, lk_bigtime_t now,
 
 typedef struct timer {
     int magic;
-    struct list_node node;
+
+    /* links in a cpu's pairing heap of pending timers (see timer.c) */
+    struct timer *heap_child;
+    struct timer *heap_next;
+    struct timer *heap_prev;    /* previous sibling, or parent if first child */
+    bool queued;
 
     lk_bigtime_t scheduled_time;
+    lk_bigtime_t slack;         /* may fire up to this much after scheduled_time */
     lk_bigtime_t periodic_time;
 
     timer_callback callback;
@@ -39,8 +45,12 @@ typedef struct timer {
 #define TIMER_INITIAL_VALUE(t) \
 { \
     .magic = TIMER_MAGIC, \
-    .node = LIST_INITIAL_CLEARED_VALUE, \
+    .heap_child = NULL, \
+    .heap_next = NULL, \
+    .heap_prev = NULL, \
+    .queued = false, \
     .scheduled_time = 0, \
+    .slack = 0, \
     .periodic_time = 0, \
     .callback = NULL, \
     .arg = NULL, \
@@ -54,9 +64,13 @@ typedef struct timer {
  * - Timers may be canceled or reprogrammed from within their callback
  * - Setting and canceling timers is not thread safe and cannot be done concurrently
  * - timer_cancel() may spin waiting for a pending timer to complete on another cpu
+ * - A timer with slack fires somewhere in [delay, delay + slack], together with
+ *   any other timers already due, so that nearby timers share one interrupt
 */
 void timer_initialize(timer_t *);
 void timer_set_oneshot(timer_t *, lk_bigtime_t delay, timer_callback, void *arg);
+void timer_set_oneshot_etc(timer_t *, lk_bigtime_t delay, lk_bigtime_t slack,
+                           timer_callback, void *arg);
 void timer_set_periodic(timer_t *, lk_bigtime_t period, timer_callback, void *arg);
 void timer_cancel(timer_t *);
 
@@ -16,10 +16,21 @@
 #include <magenta/compiler.h>
 #include <stdint.h>
 
+__BEGIN_CDECLS
+
 status_t mtrace_control(uint32_t kind, uint32_t action, uint32_t options,
                         void* arg, uint32_t size);
 
+status_t mtrace_sample_control(uint32_t action, uint32_t options,
+                               void* arg, uint32_t size);
+
+// Called on the way back to user mode from an interrupt which took a
+// sample of user code, to add the user call chain to it.
+void mtrace_sample_user_callchain(void);
+
 #ifdef __x86_64__
 status_t mtrace_ipt_control(uint32_t action, uint32_t options,
                             void* arg, uint32_t size);
 #endif
+
+__END_CDECLS
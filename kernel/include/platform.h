@@ -39,6 +39,21 @@ lk_bigtime_t current_time_hires(void);
 /* high-precision timer ticks per second */
 uint64_t ticks_per_second(void);
 
+/* counters that user mode may be able to read directly */
+typedef enum {
+    PLATFORM_USER_CLOCK_NONE = 0,
+    PLATFORM_USER_CLOCK_TSC,        // x86 rdtsc
+    PLATFORM_USER_CLOCK_CNTVCT,     // arm64 cntvct_el0
+    PLATFORM_USER_CLOCK_CNTPCT,     // arm64 cntpct_el0
+} platform_user_clock;
+
+struct fp_32_64;
+
+/* if current_time_hires() is exactly u64_mul_u64_fp32_64(counter, scale)
+ * for a counter user mode can read, return the counter and fill in
+ * *ns_per_tick with the scale; otherwise return PLATFORM_USER_CLOCK_NONE */
+platform_user_clock platform_get_user_clock(struct fp_32_64* ns_per_tick);
+
 /* super early platform initialization, before almost everything */
 void platform_early_init(void);
 
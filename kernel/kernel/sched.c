@@ -15,6 +15,7 @@
 #include <err.h>
 #include <kernel/mp.h>
 #include <kernel/thread.h>
+#include <platform.h>
 
 /* legacy implementation that just broadcast ipis for every reschedule */
 #define BROADCAST_RESCHEDULE 0
@@ -53,20 +54,33 @@ static mp_cpu_mask_t rand_cpu(const mp_cpu_mask_t mask)
     }
 }
 
+#if WITH_SMP
+/* the cpus a thread may be scheduled on */
+static mp_cpu_mask_t allowed_cpus(const thread_t *t)
+{
+    if (t->pinned_cpu >= 0)
+        return (1u << t->pinned_cpu);
+    return t->cpu_affinity ? t->cpu_affinity : ~(mp_cpu_mask_t)0;
+}
+#endif
+
 /* find a cpu to wake up */
 static mp_cpu_mask_t find_cpu(thread_t *t)
 {
 #if BROADCAST_RESCHEDULE
     return MP_CPU_ALL_BUT_LOCAL;
 #elif WITH_SMP
+    /* only consider cpus the thread is allowed to run on */
+    mp_cpu_mask_t allowed = allowed_cpus(t);
+
     /* get the last cpu the thread ran on */
-    mp_cpu_mask_t last_ran_cpu_mask = (1u << thread_last_cpu(t));
+    mp_cpu_mask_t last_ran_cpu_mask = (1u << thread_last_cpu(t)) & allowed;
 
     /* the current cpu */
     mp_cpu_mask_t curr_cpu_mask = (1u << arch_curr_cpu_num());
 
     /* get a list of idle cpus */
-    mp_cpu_mask_t idle_cpu_mask = mp_get_idle_mask();
+    mp_cpu_mask_t idle_cpu_mask = mp_get_idle_mask() & allowed;
     if (idle_cpu_mask != 0) {
         if (idle_cpu_mask & curr_cpu_mask) {
             /* the current cpu is idle, so run it here */
@@ -83,10 +97,15 @@ static mp_cpu_mask_t find_cpu(thread_t *t)
     }
 
     /* no idle cpus */
-    if (last_ran_cpu_mask == curr_cpu_mask) {
-        /* the last cpu it ran on is us */
-        /* pick a random cpu that isn't the current one */
-        return rand_cpu(mp_get_online_mask() & ~(curr_cpu_mask));
+    if (last_ran_cpu_mask == 0 || last_ran_cpu_mask == curr_cpu_mask) {
+        /* the last cpu it ran on is us or it may not run there anymore */
+        /* pick a random allowed cpu that isn't the current one */
+        mp_cpu_mask_t other_cpu_mask = mp_get_online_mask() & allowed & ~(curr_cpu_mask);
+        if (other_cpu_mask == 0) {
+            /* the current cpu is the only one it may run on, so it waits for us */
+            return curr_cpu_mask;
+        }
+        return rand_cpu(other_cpu_mask);
     } else {
         /* pick the last cpu it ran on */
         return last_ran_cpu_mask;
@@ -108,6 +127,7 @@ static void insert_in_run_queue_head(thread_t *t)
 
     list_add_head(&run_queue[t->priority], &t->queue_node);
     run_queue_bitmap |= (1<<t->priority);
+    t->last_ready_time = current_time_hires();
 }
 
 static void insert_in_run_queue_tail(thread_t *t)
@@ -120,6 +140,7 @@ static void insert_in_run_queue_tail(thread_t *t)
 
     list_add_tail(&run_queue[t->priority], &t->queue_node);
     run_queue_bitmap |= (1<<t->priority);
+    t->last_ready_time = current_time_hires();
 }
 
 thread_t *sched_get_top_thread(uint cpu)
@@ -134,7 +155,7 @@ thread_t *sched_get_top_thread(uint cpu)
 
         list_for_every_entry(&run_queue[next_queue], newthread, thread_t, queue_node) {
 #if WITH_SMP
-            if (likely(newthread->pinned_cpu < 0) || (uint)newthread->pinned_cpu == cpu)
+            if (allowed_cpus(newthread) & (1u << cpu))
 #endif
             {
                 list_delete(&newthread->queue_node);
@@ -250,10 +271,70 @@ void sched_preempt(void)
             insert_in_run_queue_head(current_thread);
         else
             insert_in_run_queue_tail(current_thread); /* if we're out of quantum, go to the tail of the queue */
+
+#if WITH_SMP
+        /* if it may no longer run here, get a cpu it may run on to pick it up */
+        if (!(allowed_cpus(current_thread) & (1u << arch_curr_cpu_num())))
+            mp_reschedule(find_cpu(current_thread), 0);
+#endif
     }
     sched_block();
 }
 
+void sched_set_priority(thread_t *t, int priority)
+{
+    DEBUG_ASSERT(t->magic == THREAD_MAGIC);
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+
+    if (t->state == THREAD_READY && list_in_list(&t->queue_node)) {
+        /* move it to the run queue for its new priority */
+        list_delete(&t->queue_node);
+        if (list_is_empty(&run_queue[t->priority]))
+            run_queue_bitmap &= ~(1<<t->priority);
+
+        /* it has been waiting since it was first queued, not since now */
+        lk_bigtime_t last_ready_time = t->last_ready_time;
+        t->priority = priority;
+        insert_in_run_queue_tail(t);
+        t->last_ready_time = last_ready_time;
+
+        mp_reschedule(find_cpu(t), 0);
+        return;
+    }
+
+    t->priority = priority;
+
+    if (t == get_current_thread()) {
+        /* let anything that now outranks us run */
+        sched_preempt();
+    } else if (t->state == THREAD_RUNNING) {
+        /* have the cpu running it reconsider */
+        mp_reschedule(1u << thread_last_cpu(t), 0);
+    }
+}
+
+void sched_set_affinity(thread_t *t, uint32_t mask)
+{
+    DEBUG_ASSERT(t->magic == THREAD_MAGIC);
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+
+#if WITH_SMP
+    t->cpu_affinity = mask;
+
+    if (t->state == THREAD_READY && list_in_list(&t->queue_node)) {
+        /* make sure a cpu it may run on notices it */
+        mp_reschedule(find_cpu(t), 0);
+    } else if (t->state == THREAD_RUNNING &&
+               !(allowed_cpus(t) & (1u << thread_last_cpu(t)))) {
+        /* get it off the cpu it is no longer allowed on */
+        if (t == get_current_thread())
+            sched_preempt();
+        else
+            mp_reschedule(1u << thread_last_cpu(t), 0);
+    }
+#endif
+}
+
 void sched_init_early(void)
 {
     /* initialize the run queues */
@@ -26,6 +26,7 @@
 #include <kernel/sched.h>
 #include <kernel/thread.h>
 #include <kernel/timer.h>
+#include <kernel/kstack.h>
 #include <kernel/mp.h>
 #include <kernel/vm.h>
 #include <platform.h>
@@ -37,6 +38,10 @@
 #include <magenta/c_user_thread.h>
 #endif
 
+#if WITH_LIB_MTRACE
+#include <lib/mtrace.h>
+#endif
+
 struct thread_stats thread_stats[SMP_MAX_CPUS];
 
 #define STACK_DEBUG_BYTE (0x99)
@@ -157,14 +162,19 @@ thread_t *thread_create_etc(
     t->retcode = 0;
     wait_queue_init(&t->retcode_wait_queue);
 
-    /* create the stack */
+    /* create the stack, and the unsafe stack to go with it */
     if (!stack) {
 #if THREAD_STACK_BOUNDS_CHECK
         stack_size += THREAD_STACK_PADDING_SIZE;
         flags |= THREAD_FLAG_DEBUG_STACK_BOUNDS_CHECK;
 #endif
-        t->stack = malloc(stack_size);
-        if (!t->stack) {
+#if __has_feature(safe_stack)
+        DEBUG_ASSERT(!unsafe_stack);
+        status_t status = kstack_alloc(stack_size, &t->stack, &t->unsafe_stack);
+#else
+        status_t status = kstack_alloc(stack_size, &t->stack, NULL);
+#endif
+        if (status != NO_ERROR) {
             if (flags & THREAD_FLAG_FREE_STRUCT)
                 free(t);
             return NULL;
@@ -172,30 +182,18 @@ thread_t *thread_create_etc(
         flags |= THREAD_FLAG_FREE_STACK;
 #if THREAD_STACK_BOUNDS_CHECK
         memset(t->stack, STACK_DEBUG_BYTE, THREAD_STACK_PADDING_SIZE);
+# if __has_feature(safe_stack)
+        memset(t->unsafe_stack, STACK_DEBUG_BYTE, THREAD_STACK_PADDING_SIZE);
+# endif
 #endif
     } else {
         t->stack = stack;
-    }
-
 #if __has_feature(safe_stack)
-    if (!unsafe_stack) {
-        DEBUG_ASSERT(!stack);
-        DEBUG_ASSERT(flags & THREAD_FLAG_FREE_STACK);
-        t->unsafe_stack = malloc(stack_size);
-        if (!t->unsafe_stack) {
-            free(t->stack);
-            if (flags & THREAD_FLAG_FREE_STRUCT)
-                free(t);
-            return NULL;
-        }
-# if THREAD_STACK_BOUNDS_CHECK
-        memset(t->unsafe_stack, STACK_DEBUG_BYTE, THREAD_STACK_PADDING_SIZE);
-# endif
-    } else {
-        DEBUG_ASSERT(stack);
+        DEBUG_ASSERT(unsafe_stack);
         t->unsafe_stack = unsafe_stack;
+#endif
     }
-#else
+#if !__has_feature(safe_stack)
     DEBUG_ASSERT(!unsafe_stack);
 #endif
 
@@ -219,6 +217,21 @@ thread_t *thread_create_etc(
     return t;
 }
 
+static inline void *thread_unsafe_stack(thread_t *t)
+{
+#if __has_feature(safe_stack)
+    return t->unsafe_stack;
+#else
+    return NULL;
+#endif
+}
+
+/* return the stacks thread_create_etc allocated, from some other thread */
+static void thread_free_stack(thread_t *t)
+{
+    kstack_free(t->stack, thread_unsafe_stack(t), t->stack_size);
+}
+
 thread_t *thread_create(const char *name, thread_start_routine entry, void *arg, int priority, size_t stack_size)
 {
     return thread_create_etc(NULL, name, entry, arg, priority,
@@ -392,12 +405,8 @@ status_t thread_join(thread_t *t, int *retcode, lk_bigtime_t timeout)
     THREAD_UNLOCK(state);
 
     /* free its stack and the thread structure itself */
-    if (t->flags & THREAD_FLAG_FREE_STACK && t->stack) {
-        free(t->stack);
-#if __has_feature(safe_stack)
-        free(t->unsafe_stack);
-#endif
-    }
+    if (t->flags & THREAD_FLAG_FREE_STACK && t->stack)
+        thread_free_stack(t);
 
     if (t->flags & THREAD_FLAG_FREE_STRUCT)
         free(t);
@@ -443,10 +452,8 @@ __NO_RETURN static void thread_exit_locked(thread_t *current_thread, int retcode
 
         /* free its stack and the thread structure itself */
         if (current_thread->flags & THREAD_FLAG_FREE_STACK && current_thread->stack) {
-            heap_delayed_free(current_thread->stack);
-#if __has_feature(safe_stack)
-            heap_delayed_free(current_thread->unsafe_stack);
-#endif
+            kstack_delayed_free(current_thread->stack, thread_unsafe_stack(current_thread),
+                                current_thread->stack_size);
 
             /* make sure its not going to get a bounds check performed on the half-freed stack */
             current_thread->flags &= ~THREAD_FLAG_DEBUG_STACK_BOUNDS_CHECK;
@@ -486,12 +493,8 @@ void thread_forget(thread_t *t)
 
     DEBUG_ASSERT(!list_in_list(&t->queue_node));
 
-    if (t->flags & THREAD_FLAG_FREE_STACK && t->stack) {
-        free(t->stack);
-#if __has_feature(safe_stack)
-        free(t->unsafe_stack);
-#endif
-    }
+    if (t->flags & THREAD_FLAG_FREE_STACK && t->stack)
+        thread_free_stack(t);
 
     if (t->flags & THREAD_FLAG_FREE_STRUCT)
         free(t);
@@ -624,6 +627,19 @@ void thread_process_pending_signals(void)
     if (likely(current_thread->signals == 0))
         return;
 
+#if WITH_LIB_MTRACE
+    /* the profiler wants the user call chain of the sample it just took */
+    if (current_thread->signals & THREAD_SIGNAL_SAMPLE) {
+        THREAD_LOCK(state);
+        current_thread->signals &= ~THREAD_SIGNAL_SAMPLE;
+        THREAD_UNLOCK(state);
+
+        mtrace_sample_user_callchain();
+        if (likely(current_thread->signals == 0))
+            return;
+    }
+#endif
+
     /* grab the thread lock so we can safely look at the signal mask */
     THREAD_LOCK(state);
 
@@ -687,6 +703,10 @@ void thread_resched(void)
     lk_bigtime_t now = current_time_hires();
     oldthread->runtime_ns += now - oldthread->last_started_running;
     newthread->last_started_running = now;
+    if (!thread_is_idle(newthread)) {
+        newthread->ready_wait_ns += now - newthread->last_ready_time;
+        newthread->context_switches++;
+    }
 
     /* set up quantum for the new thread if it was consumed */
     if (newthread->remaining_time_slice == 0) {
@@ -846,7 +866,12 @@ void thread_preempt(bool interrupt)
 
     THREAD_LOCK(state);
 
+    /* we are switched back to if some other thread got to run meanwhile,
+     * otherwise we just carry on, which is not worth counting */
+    uint64_t context_switches = current_thread->context_switches;
     sched_preempt();
+    if (!thread_is_idle(current_thread) && current_thread->context_switches != context_switches)
+        current_thread->preemptions++;
 
     THREAD_UNLOCK(state);
 }
@@ -937,7 +962,8 @@ status_t thread_sleep_etc(lk_bigtime_t delay, bool interruptable)
 
     if (delay != INFINITE_TIME) {
         /* set a one shot timer to wake us up and reschedule */
-        timer_set_oneshot(&timer, delay, thread_sleep_handler, (void *)current_thread);
+        timer_set_oneshot_etc(&timer, delay, current_thread->timer_slack,
+                              thread_sleep_handler, (void *)current_thread);
     }
     current_thread->state = THREAD_SLEEPING;
     current_thread->blocked_status = NO_ERROR;
@@ -979,6 +1005,45 @@ lk_bigtime_t thread_runtime(const thread_t *t)
     return runtime;
 }
 
+/**
+ * @brief Return the scheduler accounting for a thread.
+ *
+ * Like thread_runtime(), this includes the time the thread has been running
+ * or waiting to run since it last changed state.
+ */
+void thread_get_sched_stats(const thread_t *t, thread_sched_stats_t *stats)
+{
+    THREAD_LOCK(state);
+
+    lk_bigtime_t now = current_time_hires();
+    stats->runtime_ns = t->runtime_ns;
+    stats->ready_wait_ns = t->ready_wait_ns;
+    if (t->state == THREAD_RUNNING) {
+        stats->runtime_ns += now - t->last_started_running;
+    } else if (t->state == THREAD_READY) {
+        stats->ready_wait_ns += now - t->last_ready_time;
+    }
+    stats->context_switches = t->context_switches;
+    stats->preemptions = t->preemptions;
+
+    THREAD_UNLOCK(state);
+}
+
+/**
+ * @brief Return a snapshot of the statistics of a cpu.
+ *
+ * The counters are not sampled atomically with respect to each other.
+ */
+void thread_get_cpu_stats(uint cpu, struct thread_stats *stats)
+{
+    DEBUG_ASSERT(cpu < SMP_MAX_CPUS);
+
+    *stats = thread_stats[cpu];
+    if (mp_is_cpu_idle(cpu)) {
+        stats->idle_time += current_time_hires() - stats->last_idle_timestamp;
+    }
+}
+
 /**
  * @brief Construct a thread t around the current running state
  *
@@ -1078,6 +1143,44 @@ void thread_set_priority(int priority)
     THREAD_UNLOCK(state);
 }
 
+/**
+ * @brief Change priority of any thread
+ *
+ * Like thread_set_priority(), but for threads that may be ready or running
+ * on another cpu as well.
+ */
+void thread_set_priority_etc(thread_t *t, int priority)
+{
+    DEBUG_ASSERT(t->magic == THREAD_MAGIC);
+
+    if (priority <= IDLE_PRIORITY)
+        priority = IDLE_PRIORITY + 1;
+    if (priority > HIGHEST_PRIORITY)
+        priority = HIGHEST_PRIORITY;
+
+    THREAD_LOCK(state);
+    sched_set_priority(t, priority);
+    THREAD_UNLOCK(state);
+}
+
+/**
+ * @brief Restrict the cpus a thread may run on
+ *
+ * @param  t     Thread to change
+ * @param  mask  Mask of cpus the thread may be scheduled on, or 0 for any.
+ *
+ * A thread pinned with thread_set_pinned_cpu() stays on its pinned cpu.
+ * If the thread is running on a cpu outside the mask it is moved off it.
+ */
+void thread_set_cpu_affinity(thread_t *t, uint32_t mask)
+{
+    DEBUG_ASSERT(t->magic == THREAD_MAGIC);
+
+    THREAD_LOCK(state);
+    sched_set_affinity(t, mask);
+    THREAD_UNLOCK(state);
+}
+
 /**
  * @brief  Become an idle thread
  *
@@ -1218,8 +1321,8 @@ void dump_thread(thread_t *t, bool full_dump)
     if (full_dump) {
         dprintf(INFO, "dump_thread: t %p (%s:%s)\n", t, oname, t->name);
 #if WITH_SMP
-        dprintf(INFO, "\tstate %s, last_cpu %u, pinned_cpu %d, priority %d, remaining time slice %" PRIu64 "\n",
-                thread_state_to_str(t->state), t->last_cpu, t->pinned_cpu, t->priority, t->remaining_time_slice);
+        dprintf(INFO, "\tstate %s, last_cpu %u, pinned_cpu %d, cpu_affinity %#x, priority %d, remaining time slice %" PRIu64 "\n",
+                thread_state_to_str(t->state), t->last_cpu, t->pinned_cpu, t->cpu_affinity, t->priority, t->remaining_time_slice);
 #else
         dprintf(INFO, "\tstate %s, priority %d, remaining time slice %" PRIu64 "\n",
                 thread_state_to_str(t->state), t->priority, t->remaining_time_slice);
@@ -1366,7 +1469,8 @@ status_t wait_queue_block(wait_queue_t *wait, lk_bigtime_t timeout)
     /* if the timeout is nonzero or noninfinite, set a callback to yank us out of the queue */
     if (timeout != INFINITE_TIME) {
         timer_initialize(&timer);
-        timer_set_oneshot(&timer, timeout, wait_queue_timeout_handler, (void *)current_thread);
+        timer_set_oneshot_etc(&timer, timeout, current_thread->timer_slack,
+                              wait_queue_timeout_handler, (void *)current_thread);
     }
 
     sched_block();
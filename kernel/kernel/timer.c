@@ -35,8 +35,18 @@
 
 spin_lock_t timer_lock;
 
+/* Each cpu's pending timers form an intrusive pairing heap ordered by
+ * latest deadline (scheduled_time + slack).  Insertion is O(1), and
+ * removing the earliest or an arbitrary timer is O(log n) amortized,
+ * without allocating anything with interrupts disabled.
+ *
+ * The hardware timer is programmed for the latest deadline at the top
+ * of the heap, and each tick then fires every timer at the top whose
+ * scheduled_time has passed.  So timers whose windows overlap are
+ * handled by a single interrupt.
+ */
 struct timer_state {
-    struct list_node timer_queue;
+    timer_t *queue;
 } __CPU_ALIGN;
 
 static struct timer_state timers[SMP_MAX_CPUS];
@@ -51,35 +61,154 @@ void timer_initialize(timer_t *timer)
     *timer = (timer_t)TIMER_INITIAL_VALUE(*timer);
 }
 
+static inline lk_bigtime_t timer_latest(const timer_t *timer)
+{
+    return timer->scheduled_time + timer->slack;
+}
+
+/* combine two heaps, returning the new root */
+static timer_t *heap_meld(timer_t *a, timer_t *b)
+{
+    if (a == NULL)
+        return b;
+    if (b == NULL)
+        return a;
+    if (TIME_LT(timer_latest(b), timer_latest(a))) {
+        timer_t *tmp = a;
+        a = b;
+        b = tmp;
+    }
+
+    /* b becomes the first child of a */
+    b->heap_prev = a;
+    b->heap_next = a->heap_child;
+    if (a->heap_child)
+        a->heap_child->heap_prev = b;
+    a->heap_child = b;
+    return a;
+}
+
+/* combine a list of sibling heaps into one: meld them in pairs from the
+ * left, then meld the pairs together from the right */
+static timer_t *heap_merge_pairs(timer_t *first)
+{
+    timer_t *pairs = NULL;
+    while (first) {
+        timer_t *a = first;
+        timer_t *b = a->heap_next;
+        first = b ? b->heap_next : NULL;
+
+        a->heap_prev = a->heap_next = NULL;
+        if (b)
+            b->heap_prev = b->heap_next = NULL;
+
+        /* push the pair onto a stack threaded through heap_next */
+        timer_t *pair = heap_meld(a, b);
+        pair->heap_next = pairs;
+        pairs = pair;
+    }
+
+    timer_t *root = NULL;
+    while (pairs) {
+        timer_t *pair = pairs;
+        pairs = pair->heap_next;
+        pair->heap_next = NULL;
+        root = heap_meld(root, pair);
+    }
+    return root;
+}
+
+static inline timer_t *timer_queue_head(uint cpu)
+{
+    return timers[cpu].queue;
+}
+
 static void insert_timer_in_queue(uint cpu, timer_t *timer)
 {
-    timer_t *entry;
+    DEBUG_ASSERT(arch_ints_disabled());
+    DEBUG_ASSERT(!timer->queued);
+
+    LTRACEF("timer %p, cpu %u, scheduled %" PRIu64 ", slack %" PRIu64 ", periodic %" PRIu64 "\n",
+            timer, cpu, timer->scheduled_time, timer->slack, timer->periodic_time);
 
+    timer->heap_child = timer->heap_next = timer->heap_prev = NULL;
+    timer->queued = true;
+    timers[cpu].queue = heap_meld(timers[cpu].queue, timer);
+}
+
+/* remove a timer from whichever cpu's queue it is in */
+static void remove_timer_from_queue(timer_t *timer)
+{
     DEBUG_ASSERT(arch_ints_disabled());
+    DEBUG_ASSERT(timer->queued);
+
+    timer_t *prev = timer->heap_prev;
+    timer_t *next = timer->heap_next;
+    timer_t *subheap = heap_merge_pairs(timer->heap_child);
 
-    LTRACEF("timer %p, cpu %u, scheduled %" PRIu64 ", periodic %" PRIu64 "\n", timer, cpu, timer->scheduled_time, timer->periodic_time);
+    timer->heap_child = timer->heap_next = timer->heap_prev = NULL;
+    timer->queued = false;
 
-    list_for_every_entry(&timers[cpu].timer_queue, entry, timer_t, node) {
-        if (TIME_GT(entry->scheduled_time, timer->scheduled_time)) {
-            list_add_before(&entry->node, &timer->node);
-            return;
+    if (prev == NULL) {
+        /* it's the root of some cpu's heap */
+        for (uint i = 0; i < SMP_MAX_CPUS; i++) {
+            if (timers[i].queue == timer) {
+                timers[i].queue = subheap;
+                return;
+            }
         }
+        panic("queued timer %p not found in any queue\n", timer);
+    }
+
+    /* its merged children can't be earlier than its parent, so they
+     * simply take its place among its siblings */
+    timer_t *replacement = next;
+    if (subheap) {
+        subheap->heap_next = next;
+        replacement = subheap;
     }
+    if (replacement)
+        replacement->heap_prev = prev;
+    if (subheap && next)
+        next->heap_prev = subheap;
+
+    if (prev->heap_child == timer)
+        prev->heap_child = replacement;
+    else
+        prev->heap_next = replacement;
+}
+
+/* program the hardware timer for the head of this cpu's queue */
+static void update_platform_timer(uint cpu, lk_bigtime_t now)
+{
+#if PLATFORM_HAS_DYNAMIC_TIMER
+    timer_t *head = timer_queue_head(cpu);
+    if (head == NULL) {
+        LTRACEF("clearing old hw timer, nothing in the queue\n");
+        platform_stop_timer();
+        return;
+    }
+
+    lk_bigtime_t deadline = timer_latest(head);
+    lk_bigtime_t delay = TIME_LT(now, deadline) ? deadline - now : 0;
 
-    /* walked off the end of the list */
-    list_add_tail(&timers[cpu].timer_queue, &timer->node);
+    LTRACEF("setting new timer for %" PRIu64 " nsecs for event %p\n", delay, head);
+    platform_set_oneshot_timer(timer_tick, NULL, delay);
+#endif
 }
 
-static void timer_set(timer_t *timer, lk_bigtime_t delay, lk_bigtime_t period, timer_callback callback, void *arg)
+static void timer_set(timer_t *timer, lk_bigtime_t delay, lk_bigtime_t slack, lk_bigtime_t period,
+                      timer_callback callback, void *arg)
 {
     lk_bigtime_t now;
 
-    LTRACEF("timer %p, delay %" PRIu64 ", period %" PRIu64 ", callback %p, arg %p\n", timer, delay, period, callback, arg);
+    LTRACEF("timer %p, delay %" PRIu64 ", slack %" PRIu64 ", period %" PRIu64 ", callback %p, arg %p\n",
+            timer, delay, slack, period, callback, arg);
 
     DEBUG_ASSERT(timer->magic == TIMER_MAGIC);
 
-    if (list_in_list(&timer->node)) {
-        panic("timer %p already in list\n", timer);
+    if (timer->queued) {
+        panic("timer %p already queued\n", timer);
     }
 
     /* Bump the delay, since we're probably straddling a nanosecond */
@@ -102,6 +231,7 @@ static void timer_set(timer_t *timer, lk_bigtime_t delay, lk_bigtime_t period, t
 
     /* set up the structure */
     timer->scheduled_time = now + delay;
+    timer->slack = slack;
     timer->periodic_time = period;
     timer->callback = callback;
     timer->arg = arg;
@@ -112,13 +242,10 @@ static void timer_set(timer_t *timer, lk_bigtime_t delay, lk_bigtime_t period, t
 
     insert_timer_in_queue(cpu, timer);
 
-#if PLATFORM_HAS_DYNAMIC_TIMER
-    if (list_peek_head_type(&timers[cpu].timer_queue, timer_t, node) == timer) {
+    if (timer_queue_head(cpu) == timer) {
         /* we just modified the head of the timer queue */
-        LTRACEF("setting new timer for %" PRIu64 " nsecs\n", delay);
-        platform_set_oneshot_timer(timer_tick, NULL, delay);
+        update_platform_timer(cpu, now);
     }
-#endif
 
 out:
     spin_unlock_irqrestore(&timer_lock, state);
@@ -139,10 +266,23 @@ out:
  *   enum handler_return callback(struct timer *, lk_bigtime_t now, void *arg) { ... }
  */
 void timer_set_oneshot(timer_t *timer, lk_bigtime_t delay, timer_callback callback, void *arg)
+{
+    timer_set_oneshot_etc(timer, delay, 0, callback, arg);
+}
+
+/**
+ * @brief  Set up a timer that executes once, with some leeway
+ *
+ * As timer_set_oneshot(), but the callback may be delayed by up to slack
+ * ns past the given delay so that it can share an interrupt with other
+ * timers.
+ */
+void timer_set_oneshot_etc(timer_t *timer, lk_bigtime_t delay, lk_bigtime_t slack,
+                           timer_callback callback, void *arg)
 {
     if (delay == 0)
         delay = 1;
-    timer_set(timer, delay, 0, callback, arg);
+    timer_set(timer, delay, slack, 0, callback, arg);
 }
 
 /**
@@ -163,7 +303,7 @@ void timer_set_periodic(timer_t *timer, lk_bigtime_t period, timer_callback call
 {
     if (period == 0)
         period = 1;
-    timer_set(timer, period, period, callback, arg);
+    timer_set(timer, period, 0, period, callback, arg);
 }
 
 /**
@@ -198,34 +338,15 @@ void timer_cancel(timer_t *timer)
     }
 
     /* if the timer is in a queue, remove it and adjust hardware timers if needed */
-    if (list_in_list(&timer->node)) {
-#if PLATFORM_HAS_DYNAMIC_TIMER
-        timer_t *oldhead = list_peek_head_type(&timers[cpu].timer_queue, timer_t, node);
-#endif
+    if (timer->queued) {
+        timer_t *oldhead = timer_queue_head(cpu);
 
-        /* remove it from the queue */
-        list_delete(&timer->node);
+        remove_timer_from_queue(timer);
 
-#if PLATFORM_HAS_DYNAMIC_TIMER
         /* see if we've just modified the head of this cpu's timer queue */
         /* if we modified another cpu's queue, we'll just let it fire and sort itself out */
-        timer_t *newhead = list_peek_head_type(&timers[cpu].timer_queue, timer_t, node);
-        if (newhead == NULL) {
-            LTRACEF("clearing old hw timer, nothing in the queue\n");
-            platform_stop_timer();
-        } else if (newhead != oldhead) {
-            lk_bigtime_t delay;
-            lk_bigtime_t now = current_time_hires();
-
-            if (TIME_LT(newhead->scheduled_time, now))
-                delay = 0;
-            else
-                delay = newhead->scheduled_time - now;
-
-            LTRACEF("setting new timer to %u\n", (uint) delay);
-            platform_set_oneshot_timer(timer_tick, NULL, delay);
-        }
-#endif
+        if (timer_queue_head(cpu) != oldhead)
+            update_platform_timer(cpu, current_time_hires());
     }
 
     spin_unlock_irqrestore(&timer_lock, state);
@@ -259,10 +380,12 @@ static enum handler_return timer_tick(void *arg, lk_bigtime_t now)
 
     for (;;) {
         /* see if there's an event to process */
-        timer = list_peek_head_type(&timers[cpu].timer_queue, timer_t, node);
+        timer = timer_queue_head(cpu);
         if (likely(timer == 0))
             break;
         LTRACEF("next item on timer queue %p at %" PRIu64 " now %" PRIu64 " (%p, arg %p)\n", timer, timer->scheduled_time, now, timer->callback, timer->arg);
+        /* fire anything whose window has opened, coalescing it with
+         * whatever the interrupt was programmed for */
         if (likely(TIME_LT(now, timer->scheduled_time)))
             break;
 
@@ -271,7 +394,7 @@ static enum handler_return timer_tick(void *arg, lk_bigtime_t now)
         DEBUG_ASSERT_MSG(timer && timer->magic == TIMER_MAGIC,
                 "ASSERT: timer failed magic check: timer %p, magic 0x%x\n",
                 timer, (uint)timer->magic);
-        list_delete(&timer->node);
+        remove_timer_from_queue(timer);
 
         /* mark the timer busy */
         timer->active_cpu = cpu;
@@ -307,7 +430,7 @@ static enum handler_return timer_tick(void *arg, lk_bigtime_t now)
             /* if it is a periodic timer and it hasn't been requeued
              * by the callback put it back in the list
              */
-            if (timer->periodic_time > 0 && !list_in_list(&timer->node)) {
+            if (timer->periodic_time > 0 && !timer->queued) {
                 LTRACEF("periodic timer, period %" PRIu64 "\n", timer->periodic_time);
                 timer->scheduled_time = now + timer->periodic_time;
                 insert_timer_in_queue(cpu, timer);
@@ -317,15 +440,12 @@ static enum handler_return timer_tick(void *arg, lk_bigtime_t now)
 
 #if PLATFORM_HAS_DYNAMIC_TIMER
     /* reset the timer to the next event */
-    timer = list_peek_head_type(&timers[cpu].timer_queue, timer_t, node);
+    timer = timer_queue_head(cpu);
     if (timer) {
         /* has to be the case or it would have fired already */
         DEBUG_ASSERT(TIME_GT(timer->scheduled_time, now));
 
-        lk_bigtime_t delay = timer->scheduled_time - now;
-
-        LTRACEF("setting new timer for %u nsecs for event %p\n", (uint)delay, timer);
-        platform_set_oneshot_timer(timer_tick, NULL, delay);
+        update_platform_timer(cpu, now);
     }
 
     /* we're done manipulating the timer queue */
@@ -367,29 +487,17 @@ void timer_transition_off_cpu(uint old_cpu)
     spin_lock_irqsave(&timer_lock, state);
     uint cpu = arch_curr_cpu_num();
 
-    timer_t *old_head = list_peek_head_type(&timers[old_cpu].timer_queue, timer_t, node);
+    timer_t *old_head = timer_queue_head(cpu);
 
-    timer_t *entry = NULL, *tmp_entry = NULL;
     /* Move all timers from old_cpu to this cpu */
-    list_for_every_entry_safe(&timers[old_cpu].timer_queue, entry, tmp_entry, timer_t, node) {
-        list_delete(&entry->node);
-        insert_timer_in_queue(cpu, entry);
-    }
+    timers[cpu].queue = heap_meld(timers[cpu].queue, timers[old_cpu].queue);
+    timers[old_cpu].queue = NULL;
 
-#if PLATFORM_HAS_DYNAMIC_TIMER
-    timer_t *new_head = list_peek_head_type(&timers[cpu].timer_queue, timer_t, node);
+    timer_t *new_head = timer_queue_head(cpu);
     if (new_head != NULL && new_head != old_head) {
-        lk_bigtime_t now = current_time_hires();
-        lk_bigtime_t delay = 0;
-        if (TIME_LT(now, new_head->scheduled_time)) {
-            delay = new_head->scheduled_time - now;
-        }
-
         /* we just modified the head of the timer queue */
-        LTRACEF("setting new timer for %" PRIu64 " nsecs\n", delay);
-        platform_set_oneshot_timer(timer_tick, NULL, delay);
+        update_platform_timer(cpu, current_time_hires());
     }
-#endif
 
     spin_unlock_irqrestore(&timer_lock, state);
 }
@@ -404,15 +512,9 @@ void timer_thaw_percpu(void)
 
     uint cpu = arch_curr_cpu_num();
 
-    timer_t *t = list_peek_head_type(&timers[cpu].timer_queue, timer_t, node);
-    if (t) {
-        lk_bigtime_t now = current_time_hires();
-        lk_bigtime_t delay = 0;
-        if (TIME_LT(now, t->scheduled_time)) {
-            delay = t->scheduled_time - now;
-        }
-        LTRACEF("rescheduling timer for %" PRIu64 " nsecs\n", delay);
-        platform_set_oneshot_timer(timer_tick, NULL, delay);
+    if (timer_queue_head(cpu)) {
+        LTRACEF("rescheduling timer\n");
+        update_platform_timer(cpu, current_time_hires());
     }
 
     spin_unlock(&timer_lock);
@@ -423,7 +525,7 @@ void timer_init(void)
 {
     timer_lock = SPIN_LOCK_INITIAL_VALUE;
     for (uint i = 0; i < SMP_MAX_CPUS; i++) {
-        list_initialize(&timers[i].timer_queue);
+        timers[i].queue = NULL;
     }
 #if !PLATFORM_HAS_DYNAMIC_TIMER
     /* register for a periodic timer tick */
@@ -0,0 +1,213 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <kernel/kstack.h>
+
+#include <arch/ops.h>
+#include <assert.h>
+#include <err.h>
+#include <inttypes.h>
+#include <kernel/spinlock.h>
+#include <kernel/vm.h>
+#include <kernel/vm/vm_address_region.h>
+#include <kernel/vm/vm_aspace.h>
+#include <kernel/vm/vm_object.h>
+#include <mxtl/auto_call.h>
+#include <trace.h>
+
+#define LOCAL_TRACE 0
+
+namespace {
+
+// Number of free stacks kept on each cpu.
+constexpr size_t kCacheMax = 8;
+
+// Written at the base of a free stack while it sits on a list. The base is
+// the far end from where a stack is in use, so this is safe to do to a
+// dying thread's own stack.
+struct kstack_node {
+    kstack_node* next;
+    void* unsafe_stack;
+    size_t size;
+};
+
+// Only touched on its own cpu with interrupts disabled. Anything on these
+// lists may have been freed by a thread which was still running on it, so
+// must not be reused or unmapped until the cpu has switched away, which is
+// guaranteed by only ever taking from the lists of the cpu we are running
+// on, from thread context.
+struct kstack_cache {
+    // most recently freed first
+    kstack_node* stacks;
+    size_t count;
+    // stacks pushed out of the cache, to be unmapped
+    kstack_node* reap;
+};
+
+kstack_cache caches[SMP_MAX_CPUS];
+
+// Takes a cached stack matching |size| and |want_unsafe| off this cpu's
+// cache, and hands back its list of stacks to unmap in |*reap|.
+kstack_node* cache_take(size_t size, bool want_unsafe, kstack_node** reap) {
+    spin_lock_saved_state_t state;
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
+
+    kstack_cache* cache = &caches[arch_curr_cpu_num()];
+    *reap = cache->reap;
+    cache->reap = nullptr;
+
+    kstack_node** prev = &cache->stacks;
+    kstack_node* node;
+    for (node = cache->stacks; node != nullptr; prev = &node->next, node = node->next) {
+        if (node->size == size && (node->unsafe_stack != nullptr) == want_unsafe) {
+            *prev = node->next;
+            cache->count--;
+            break;
+        }
+    }
+
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+    return node;
+}
+
+// Puts a stack on this cpu's cache. If the cache is full, the stack used
+// least recently goes on the reap list, so sizes nobody asks for age out.
+// Called with interrupts disabled.
+void cache_put(void* stack, void* unsafe_stack, size_t size) {
+    DEBUG_ASSERT(arch_ints_disabled());
+
+    kstack_cache* cache = &caches[arch_curr_cpu_num()];
+    if (cache->count == kCacheMax) {
+        kstack_node** prev = &cache->stacks;
+        while ((*prev)->next != nullptr)
+            prev = &(*prev)->next;
+        kstack_node* oldest = *prev;
+        *prev = nullptr;
+        oldest->next = cache->reap;
+        cache->reap = oldest;
+        cache->count--;
+    }
+
+    kstack_node* node = static_cast<kstack_node*>(stack);
+    node->unsafe_stack = unsafe_stack;
+    node->size = size;
+    node->next = cache->stacks;
+    cache->stacks = node;
+    cache->count++;
+}
+
+void unmap_stack(void* stack) {
+    LTRACEF("stack %p\n", stack);
+
+    // the stacks share one region, which this destroys
+    __UNUSED status_t status = vmm_free_region(vmm_get_kernel_aspace(),
+                                               reinterpret_cast<vaddr_t>(stack));
+    DEBUG_ASSERT(status == NO_ERROR);
+}
+
+void unmap_list(kstack_node* list) {
+    while (list != nullptr) {
+        kstack_node* next = list->next;
+        unmap_stack(list);
+        list = next;
+    }
+}
+
+status_t map_stack(const mxtl::RefPtr<VmAddressRegion>& vmar, size_t offset, size_t size,
+                   mxtl::RefPtr<VmObject> vmo, uint64_t vmo_offset, const char* name,
+                   void** out) {
+    mxtl::RefPtr<VmMapping> mapping;
+    status_t status = vmar->CreateVmMapping(offset, size, 0, VMAR_FLAG_SPECIFIC,
+                                            mxtl::move(vmo), vmo_offset,
+                                            ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_WRITE,
+                                            name, &mapping);
+    if (status != NO_ERROR)
+        return status;
+
+    // stacks are used with interrupts disabled, so cannot be demand paged
+    status = mapping->MapRange(0, size, true);
+    if (status != NO_ERROR)
+        return status;
+
+    *out = reinterpret_cast<void*>(mapping->base());
+    return NO_ERROR;
+}
+
+// Maps new stacks, laid out in a region of their own as
+// [guard][stack][guard] or [guard][stack][guard][unsafe stack][guard].
+status_t map_stacks(size_t size, void** stack, void** unsafe_stack) {
+    const size_t mapped_size = ROUNDUP(size, PAGE_SIZE);
+    const size_t num_stacks = unsafe_stack ? 2 : 1;
+    const size_t vmar_size = num_stacks * (mapped_size + PAGE_SIZE) + PAGE_SIZE;
+
+    auto vmo = VmObjectPaged::Create(0, num_stacks * mapped_size);
+    if (!vmo)
+        return ERR_NO_MEMORY;
+
+    mxtl::RefPtr<VmAddressRegion> vmar;
+    status_t status = VmAspace::kernel_aspace()->RootVmar()->CreateSubVmar(
+        0, vmar_size, 0,
+        VMAR_FLAG_CAN_MAP_SPECIFIC | VMAR_FLAG_CAN_MAP_READ | VMAR_FLAG_CAN_MAP_WRITE,
+        "kstack_vmar", &vmar);
+    if (status != NO_ERROR)
+        return status;
+
+    // destroy the vmar if we early abort, along with anything mapped in it
+    auto vmar_cleanup = mxtl::MakeAutoCall([&vmar]() {
+            vmar->Destroy();
+        });
+
+    status = map_stack(vmar, PAGE_SIZE, mapped_size, vmo, 0, "kstack", stack);
+    if (status != NO_ERROR)
+        return status;
+    if (unsafe_stack) {
+        status = map_stack(vmar, 2 * PAGE_SIZE + mapped_size, mapped_size, vmo, mapped_size,
+                           "unsafe_kstack", unsafe_stack);
+        if (status != NO_ERROR)
+            return status;
+    }
+
+    LTRACEF("stack %p unsafe stack %p\n", *stack, unsafe_stack ? *unsafe_stack : nullptr);
+
+    vmar_cleanup.cancel();
+    return NO_ERROR;
+}
+
+} // namespace
+
+status_t kstack_alloc(size_t size, void** stack, void** unsafe_stack) {
+    DEBUG_ASSERT(!arch_in_int_handler());
+
+    kstack_node* reap;
+    kstack_node* node = cache_take(size, unsafe_stack != nullptr, &reap);
+    unmap_list(reap);
+
+    if (node != nullptr) {
+        if (unsafe_stack)
+            *unsafe_stack = node->unsafe_stack;
+        *stack = node;
+        return NO_ERROR;
+    }
+    return map_stacks(size, stack, unsafe_stack);
+}
+
+void kstack_free(void* stack, void* unsafe_stack, size_t size) {
+    DEBUG_ASSERT(!arch_in_int_handler());
+
+    spin_lock_saved_state_t state;
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
+    cache_put(stack, unsafe_stack, size);
+    kstack_cache* cache = &caches[arch_curr_cpu_num()];
+    kstack_node* reap = cache->reap;
+    cache->reap = nullptr;
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
+
+    unmap_list(reap);
+}
+
+void kstack_delayed_free(void* stack, void* unsafe_stack, size_t size) {
+    cache_put(stack, unsafe_stack, size);
+}
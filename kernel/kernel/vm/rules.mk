@@ -16,6 +16,7 @@ MODULE_DEPS += \
 
 MODULE_SRCS += \
     $(LOCAL_DIR)/bootalloc.cpp \
+    $(LOCAL_DIR)/kstack.cpp \
     $(LOCAL_DIR)/page.cpp \
     $(LOCAL_DIR)/pmm.cpp \
     $(LOCAL_DIR)/pmm_arena.cpp \
@@ -7,6 +7,7 @@
 #include <app/tests.h>
 #include <assert.h>
 #include <err.h>
+#include <kernel/kstack.h>
 #include <kernel/vm.h>
 #include <kernel/vm/vm_aspace.h>
 #include <kernel/vm/vm_object.h>
@@ -620,6 +621,41 @@ static bool vmo_read_write_smoke_test(void* context) {
     END_TEST;
 }
 
+// Allocates a kernel stack and checks that it is mapped, with unmapped
+// pages either side of it.
+static bool kstack_guard_pages_test(void* context) {
+    BEGIN_TEST;
+    // an odd size, so that this is a fresh stack rather than a cached one
+    static const size_t stack_size = PAGE_SIZE * 3 + 16;
+    static const size_t mapped_size = ROUNDUP(stack_size, PAGE_SIZE);
+    arch_aspace_t* aspace = &VmAspace::kernel_aspace()->arch_aspace();
+
+    void* stack;
+    void* unsafe_stack;
+    auto err = kstack_alloc(stack_size, &stack, &unsafe_stack);
+    EXPECT_EQ(NO_ERROR, err, "allocating stacks");
+    if (err != NO_ERROR)
+        return false;
+
+    vaddr_t stacks[] = {(vaddr_t)stack, (vaddr_t)unsafe_stack};
+    for (vaddr_t base : stacks) {
+        paddr_t pa;
+        uint flags;
+        EXPECT_EQ(NO_ERROR, arch_mmu_query(aspace, base, &pa, &flags), "stack bottom");
+        EXPECT_EQ(NO_ERROR, arch_mmu_query(aspace, base + mapped_size - PAGE_SIZE, &pa, &flags),
+                  "stack top");
+        EXPECT_EQ(ERR_NOT_FOUND, arch_mmu_query(aspace, base - PAGE_SIZE, &pa, &flags),
+                  "guard page below stack");
+        EXPECT_EQ(ERR_NOT_FOUND, arch_mmu_query(aspace, base + mapped_size, &pa, &flags),
+                  "guard page above stack");
+    }
+    if (!fill_and_test(stack, stack_size))
+        all_ok = false;
+
+    kstack_free(stack, unsafe_stack, stack_size);
+    END_TEST;
+}
+
 // Use the function name as the test name
 #define VM_UNITTEST(fname) UNITTEST(#fname, fname)
 
@@ -646,5 +682,6 @@ VM_UNITTEST(vmo_dropped_ref_test)
 VM_UNITTEST(vmo_remap_test)
 VM_UNITTEST(vmo_double_remap_test)
 VM_UNITTEST(vmo_read_write_smoke_test)
+VM_UNITTEST(kstack_guard_pages_test)
 VM_UNITTEST(dump_all_aspaces)  // Run last
 UNITTEST_END_TESTCASE(vm_tests, "vmtests", "Virtual memory tests", nullptr, nullptr);
@@ -31,6 +31,9 @@ public:
 
 class JobDispatcher final : public Dispatcher {
 public:
+    // Mask with a bit for every cpu the kernel can support.
+    static constexpr uint64_t kAllCpus = (1ull << SMP_MAX_CPUS) - 1;
+
     // Traits to belong to the parent's weak job list.
     struct ListTraitsWeak {
         static mxtl::DoublyLinkedListNodeState<JobDispatcher*>& node_state(
@@ -68,10 +71,24 @@ public:
     uint32_t process_count() const TA_REQ(lock_) { return process_count_;}
     uint32_t job_count() const TA_REQ(lock_) { return job_count_; }
     bool AddChildProcess(ProcessDispatcher* process);
-    void RemoveChildProcess(ProcessDispatcher* process);
+    // |stats| are the summed stats of the process's threads, if it ran any.
+    void RemoveChildProcess(ProcessDispatcher* process, const mx_info_thread_stats_t* stats);
     bool EnumerateChildren(JobEnumerator* je);
+    // Sums the stats of every thread which ran in this job or its children.
+    status_t GetThreadStats(mx_info_thread_stats_t* stats);
     void Kill();
 
+    // The cpus threads started in this job's processes may run on.
+    // Inherited from the parent job when the job is created. Narrowing it
+    // narrows child jobs and existing threads too.
+    uint64_t cpu_affinity();
+    status_t set_cpu_affinity(uint64_t mask);
+
+    // The highest priority threads in this job's processes may have.
+    // Lowering it lowers child jobs and existing threads too.
+    int max_priority();
+    status_t set_max_priority(int priority);
+
     mxtl::RefPtr<ProcessDispatcher> LookupProcessById(mx_koid_t koid);
     mxtl::RefPtr<JobDispatcher> LookupJobById(mx_koid_t koid);
 
@@ -83,11 +100,17 @@ private:
 
     JobDispatcher(uint32_t flags, mxtl::RefPtr<JobDispatcher> parent);
     bool AddChildJob(JobDispatcher* job);
-    void RemoveChildJob(JobDispatcher* job);
+    void RemoveChildJob(JobDispatcher* job, const mx_info_thread_stats_t& stats);
 
     void UpdateSignalsIncrementLocked() TA_REQ(lock_);
     void UpdateSignalsDecrementLocked() TA_REQ(lock_);
 
+    // Bring child jobs and the threads of child processes within this
+    // job's cpu affinity and maximum priority.
+    void ApplyLimits();
+    // Narrow this job to its parent's limits, then apply them below.
+    void InheritLimits(uint64_t cpu_mask, int max_priority);
+
     mxtl::Canary<mxtl::magic("JOBD")> canary_;
 
     const mxtl::RefPtr<JobDispatcher> parent_;
@@ -107,6 +130,11 @@ private:
     State state_ TA_GUARDED(lock_);
     uint32_t process_count_ TA_GUARDED(lock_);
     uint32_t job_count_ TA_GUARDED(lock_);
+    uint64_t cpu_affinity_ TA_GUARDED(lock_);
+    int max_priority_ TA_GUARDED(lock_);
+    // summed stats of the processes and jobs which have left |procs_|
+    // and |jobs_|
+    mx_info_thread_stats_t exited_thread_stats_ TA_GUARDED(lock_) = {};
     StateTracker state_tracker_;
 
     using WeakJobList =
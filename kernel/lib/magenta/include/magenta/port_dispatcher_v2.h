@@ -15,6 +15,7 @@
 #include <magenta/types.h>
 #include <magenta/wait_event.h>
 
+#include <mxtl/atomic.h>
 #include <mxtl/canary.h>
 #include <mxtl/intrusive_double_list.h>
 #include <mxtl/unique_ptr.h>
@@ -80,8 +81,15 @@ class PortDispatcherV2;
 class PortObserver;
 
 struct PortPacket final : public mxtl::DoublyLinkedListable<PortPacket*> {
+    // Bits of |state|.
+    static constexpr uint32_t kQueued = 1u;
+    static constexpr uint32_t kReap = 2u;
+
     mx_port_packet_t packet;
     PortObserver* observer;
+    // Link in the list of packets to destroy, see PortDispatcherV2::TakeLocked().
+    PortPacket* free_next;
+    mxtl::atomic<uint32_t> state;
 
     PortPacket();
     PortPacket(const PortPacket&) = delete;
@@ -137,6 +145,10 @@ public:
     mx_status_t Queue(PortPacket* port_packet, mx_signals_t observed, uint64_t count);
     mx_status_t QueueUser(const mx_port_packet_t& packet);
     mx_status_t DeQueue(mx_time_t timeout, mx_port_packet_t* packet);
+    // Waits for at least one packet and dequeues up to |*count| of them into
+    // |packets|, which can be null to discard them. |*count| is set to the
+    // number dequeued.
+    mx_status_t DeQueue(mx_time_t timeout, mx_port_packet_t* packets, uint32_t* count);
 
     // Decides who is going to destroy the observer. If it returns |true| it
     // is the duty of the caller. If it is false it is the duty of the port.
@@ -148,11 +160,17 @@ public:
 
 private:
     PortDispatcherV2(uint32_t options);
-    PortObserver* CopyLocked(PortPacket* port_packet, mx_port_packet_t* packet) TA_REQ(lock_);
+    uint32_t TakeLocked(mx_port_packet_t* packets, uint32_t max,
+                        PortPacket** to_free) TA_REQ(lock_);
 
+    // Producers check |zero_handles_| and queue under |lock_|, which
+    // on_zero_handles() also holds to set it, so nothing is queued after
+    // its final drain. Consumers take a batch of packets per acquisition,
+    // and |sema_| is only posted when a thread is waiting.
     mxtl::Canary<mxtl::magic("POR2")> canary_;
     Mutex lock_;
     Semaphore sema_;
     bool zero_handles_ TA_GUARDED(lock_);
+    mxtl::atomic<uint32_t> waiters_;
     mxtl::DoublyLinkedList<PortPacket*> packets_ TA_GUARDED(lock_);
 };
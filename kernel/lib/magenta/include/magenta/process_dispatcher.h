@@ -167,6 +167,7 @@ public:
     // Syscall helpers
     status_t GetInfo(mx_info_process_t* info);
     status_t GetStats(mx_info_task_stats_t* stats);
+    status_t GetThreadStats(mx_info_thread_stats_t* stats);
     // NOTE: Code outside of the syscall layer should not typically know about
     // user_ptrs; do not use this pattern as an example.
     status_t GetAspaceMaps(user_ptr<mx_info_maps_t> maps, size_t max,
@@ -176,6 +177,9 @@ public:
 
     status_t GetThreads(mxtl::Array<mx_koid_t>* threads);
 
+    // Bring every thread within the job's cpu mask and maximum priority.
+    void ApplyJobLimits(uint64_t cpu_mask, int max_priority);
+
     // exception handling support
     status_t SetExceptionPort(mxtl::RefPtr<ExceptionPort> eport);
     // Returns true if a port had been set.
@@ -243,6 +247,9 @@ private:
     // list of threads in this process
     mxtl::DoublyLinkedList<UserThread*> thread_list_ TA_GUARDED(state_lock_);
 
+    // summed stats of the threads which have left |thread_list_|
+    mx_info_thread_stats_t exited_thread_stats_ TA_GUARDED(state_lock_) = {};
+
     // our address space
     mxtl::RefPtr<VmAspace> aspace_;
 
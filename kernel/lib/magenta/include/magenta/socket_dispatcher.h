@@ -47,33 +47,50 @@ public:
     void OnPeerZeroHandles();
 
 private:
+    // A ring buffer backed by a VMO.  The VMO is created on the first write
+    // and its pages are committed as data is written; when the buffer drains
+    // all but the first page are handed back.
     class CBuf {
     public:
-        ~CBuf();
-        bool Init(uint32_t len);
-        size_t Write(const void* src, size_t len, bool from_user);
+        void Init(uint32_t len_pow2) { len_pow2_ = len_pow2; }
+        mx_status_t Write(const void* src, size_t len, bool from_user,
+                          size_t* written);
+        // Writes a length header and |len| bytes, or nothing at all.
+        mx_status_t WriteDatagram(const void* src, size_t len, bool from_user);
+        // A null |dest| discards up to |len| bytes.
         size_t Read(void* dest, size_t len, bool from_user);
+        // Like Read() into kernel memory, but leaves the data in the buffer.
+        size_t Peek(void* dest, size_t len) const;
         size_t CouldRead() const;
         size_t free() const;
         bool empty() const;
 
     private:
+        size_t CopyOut(size_t* tail, void* dest, size_t len, bool from_user) const;
+        void Drained();
+
         size_t head_ = 0u;
         size_t tail_ = 0u;
         uint32_t len_pow2_ = 0u;
-        char* buf_ = nullptr;
+        // End of the part of the VMO written since the buffer last drained.
+        size_t high_water_ = 0u;
         mxtl::RefPtr<VmObject> vmo_;
     };
 
+    // Each datagram in |cbuf_| is preceded by its length.
+    using DatagramHeader = uint32_t;
+
     SocketDispatcher(uint32_t flags);
     mx_status_t Init(mxtl::RefPtr<SocketDispatcher> other);
     mx_status_t WriteSelf(const void* src, size_t len, bool from_user,
                           size_t* nwritten);
     status_t UserSignalSelf(uint32_t clear_mask, uint32_t set_mask);
     status_t HalfCloseOther();
+    bool is_full() const TA_REQ(lock_);
 
     mxtl::Canary<mxtl::magic("SOCK")> canary_;
 
+    const uint32_t flags_;
     mx_koid_t peer_koid_;
     StateTracker state_tracker_;
 
@@ -84,4 +101,6 @@ private:
     mxtl::unique_ptr<PortClient> iopc_ TA_GUARDED(lock_);
     // half_closed_[0] is this end and [1] is the other end.
     bool half_closed_[2] TA_GUARDED(lock_);
+    // Room, header included, needed by the last datagram that did not fit.
+    size_t write_wait_ TA_GUARDED(lock_);
 };
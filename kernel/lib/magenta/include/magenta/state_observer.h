@@ -28,7 +28,11 @@ public:
         } entry[2];
     };
 
-    explicit StateObserver() : remove_(false) { }
+    // |notify_mask| is the set of signals whose changes are passed on to
+    // OnStateChange(); the StateTracker does not call it for changes which
+    // only touch other signals.
+    explicit StateObserver(mx_signals_t notify_mask = ~0u)
+        : remove_(false), notify_mask_(notify_mask) { }
 
     // Called when this object is added to a StateTracker, to give it the initial state.
     // Note that |cinfo| might be null. Returns true if a thread was awoken.
@@ -59,14 +63,25 @@ public:
     // OnInitialize() OnStateChange() or OnCancel().
     bool remove() const { return remove_; }
 
+    mx_signals_t notify_mask() const { return notify_mask_; }
+
 protected:
     ~StateObserver() {}
     // Warning: |remove_| should only be mutated during the OnXXX callbacks.
     bool remove_ = false;
 
+    // Only to be called while not added to a StateTracker.
+    void set_notify_mask(mx_signals_t notify_mask) { notify_mask_ = notify_mask; }
+
 private:
     mxtl::Canary<mxtl::magic("SOBS")> canary_;
 
+    mx_signals_t notify_mask_;
+
+    // Which of the StateTracker's lists this is on.
+    friend class StateTracker;
+    uint32_t tracker_list_ = 0u;
+
     friend struct StateObserverListTraits;
     mxtl::DoublyLinkedListNodeState<StateObserver*> state_observer_list_node_state_;
 };
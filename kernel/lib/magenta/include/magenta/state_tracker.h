@@ -65,11 +65,41 @@ public:
     mx_status_t GetCookie(CookieJar* cookiejar, mx_koid_t scope, uint64_t* cookie);
 
 private:
+    // Observers are grouped by notify mask, so that a change of state only
+    // walks the groups watching one of the signals which changed. Objects
+    // rarely have more than a few distinct masks watched at once; observers
+    // whose mask has no group to itself go on |observers_|, which is
+    // filtered one observer at a time.
+    static constexpr uint32_t kNumGroups = 3u;
+
+    struct ObserverGroup {
+        mx_signals_t mask = 0u;
+        ObserverList observers;
+    };
+
+    void AddObserverLocked(StateObserver* observer) TA_REQ(lock_);
+    ObserverList* ListForLocked(StateObserver* observer) TA_REQ(lock_);
+
+    // Calls |func| on the observers interested in a change of |signals| and
+    // takes out the ones which ask to be removed. Returns true if a thread
+    // was awoken.
+    template <typename Func>
+    bool NotifyLocked(mx_signals_t signals, Func func, ObserverList* obs_to_remove) TA_REQ(lock_);
+
+    // Like NotifyLocked() but calls |func| on every observer.
+    template <typename Func>
+    bool ForEachLocked(Func func, ObserverList* obs_to_remove) TA_REQ(lock_);
+
+    template <typename Func>
+    void CancelWithFunc(Func func);
+
     mxtl::Canary<mxtl::magic("STRK")> canary_;
 
     mx_signals_t signals_;
     Mutex lock_;
 
-    // Active observers are elements in |observers_|.
+    // Active observers are elements in the lists of |groups_| or in
+    // |observers_|, according to their |tracker_list_|.
+    ObserverGroup groups_[kNumGroups] TA_GUARDED(lock_);
     ObserverList observers_ TA_GUARDED(lock_);
 };
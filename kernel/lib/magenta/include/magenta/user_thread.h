@@ -18,6 +18,7 @@
 #include <magenta/excp_port.h>
 #include <magenta/futex_node.h>
 #include <magenta/state_tracker.h>
+#include <magenta/syscalls/object.h>
 
 #include <mxtl/canary.h>
 #include <mxtl/intrusive_double_list.h>
@@ -102,6 +103,16 @@ public:
     status_t set_name(const char* name, size_t len);
     void get_name(char out_name[MX_MAX_NAME_LEN]);
     uint64_t runtime_ns() const { return thread_runtime(&thread_); }
+    void GetThreadStats(mx_info_thread_stats_t* stats) const;
+    mx_time_t timer_slack() const { return thread_.timer_slack; }
+    void set_timer_slack(mx_time_t slack) { thread_.timer_slack = slack; }
+    int priority() const { return thread_.priority; }
+    status_t set_priority(int priority);
+    uint64_t cpu_affinity() const;
+    status_t set_cpu_affinity(uint64_t mask);
+    // Narrow the thread to |cpu_mask| and lower it to |max_priority| if
+    // it is above it. Called with the process's state lock held.
+    void ApplyJobLimits(uint64_t cpu_mask, int max_priority);
 
     status_t SetExceptionPort(ThreadDispatcher* td, mxtl::RefPtr<ExceptionPort> eport);
     // Returns true if a port had been set.
@@ -226,15 +237,6 @@ private:
     // Used to protect thread name read/writes
     SpinLock name_lock_;
 
-    // hold a reference to the mapping and vmar used to wrap the mapping of this
-    // thread's kernel stack
-    mxtl::RefPtr<VmMapping> kstack_mapping_;
-    mxtl::RefPtr<VmAddressRegion> kstack_vmar_;
-#if __has_feature(safe_stack)
-    mxtl::RefPtr<VmMapping> unsafe_kstack_mapping_;
-    mxtl::RefPtr<VmAddressRegion> unsafe_kstack_vmar_;
-#endif
-
     // Per-thread structure used while waiting in a ChannelDispatcher::Call.
     // Needed to support the requirements of being able to interrupt a Call
     // in order to suspend a thread.
@@ -249,3 +251,6 @@ private:
 };
 
 const char* StateToString(UserThread::State state);
+
+// Accumulate |stats| into |total|, for the process and job level sums.
+void AddThreadStats(mx_info_thread_stats_t* total, const mx_info_thread_stats_t& stats);
@@ -10,8 +10,12 @@
 #include <new.h>
 
 #include <kernel/auto_lock.h>
+#include <kernel/mp.h>
 
 #include <magenta/process_dispatcher.h>
+#include <magenta/syscalls/object.h>
+
+#include <mxtl/algorithm.h>
 
 constexpr mx_rights_t kDefaultJobRights =
     MX_RIGHT_TRANSFER | MX_RIGHT_DUPLICATE | MX_RIGHT_READ | MX_RIGHT_WRITE |
@@ -47,12 +51,20 @@ JobDispatcher::JobDispatcher(uint32_t /*flags*/,
     : parent_(mxtl::move(parent)),
       state_(State::READY),
       process_count_(0u), job_count_(0u),
+      cpu_affinity_(kAllCpus),
+      max_priority_(MX_PRIORITY_HIGHEST),
       state_tracker_(MX_JOB_NO_PROCESSES|MX_JOB_NO_JOBS) {
 }
 
 JobDispatcher::~JobDispatcher() {
-    if (parent_)
-        parent_->RemoveChildJob(this);
+    if (parent_) {
+        mx_info_thread_stats_t stats;
+        {
+            AutoLock lock(&lock_);
+            stats = exited_thread_stats_;
+        }
+        parent_->RemoveChildJob(this, stats);
+    }
 }
 
 void JobDispatcher::on_zero_handles() {
@@ -84,10 +96,20 @@ bool JobDispatcher::AddChildJob(JobDispatcher* job) {
     jobs_.push_back(job);
     ++job_count_;
     UpdateSignalsIncrementLocked();
+
+    // Set the new job's limits under our lock so that it cannot miss a
+    // change to ours. Raising the priority limit above the default takes
+    // a handle to the parent job.
+    {
+        AutoLock job_lock(&job->lock_);
+        job->cpu_affinity_ = cpu_affinity_;
+        job->max_priority_ = mxtl::min(max_priority_, MX_PRIORITY_DEFAULT);
+    }
     return true;
 }
 
-void JobDispatcher::RemoveChildProcess(ProcessDispatcher* process) {
+void JobDispatcher::RemoveChildProcess(ProcessDispatcher* process,
+                                       const mx_info_thread_stats_t* stats) {
     canary_.Assert();
 
     AutoLock lock(&lock_);
@@ -95,17 +117,20 @@ void JobDispatcher::RemoveChildProcess(ProcessDispatcher* process) {
     if (!ProcessDispatcher::JobListTraitsWeak::node_state(*process).InContainer())
         return;
     procs_.erase(*process);
+    if (stats)
+        AddThreadStats(&exited_thread_stats_, *stats);
     --process_count_;
     UpdateSignalsDecrementLocked();
 }
 
-void JobDispatcher::RemoveChildJob(JobDispatcher* job) {
+void JobDispatcher::RemoveChildJob(JobDispatcher* job, const mx_info_thread_stats_t& stats) {
     canary_.Assert();
 
     AutoLock lock(&lock_);
     if (!JobDispatcher::ListTraitsWeak::node_state(*job).InContainer())
         return;
     jobs_.erase(*job);
+    AddThreadStats(&exited_thread_stats_, stats);
     --job_count_;
     UpdateSignalsDecrementLocked();
 }
@@ -150,6 +175,114 @@ void JobDispatcher::UpdateSignalsIncrementLocked() {
     state_tracker_.UpdateState(clear, 0u);
 }
 
+uint64_t JobDispatcher::cpu_affinity() {
+    canary_.Assert();
+
+    AutoLock lock(&lock_);
+    return cpu_affinity_;
+}
+
+status_t JobDispatcher::set_cpu_affinity(uint64_t mask) {
+    canary_.Assert();
+
+    if ((mask & ~kAllCpus) || (mask & mp_get_online_mask()) == 0)
+        return ERR_INVALID_ARGS;
+
+    // A job cannot give its threads cpus its parent does not have.
+    uint64_t allowed = parent_ ? parent_->cpu_affinity() : kAllCpus;
+    if (mask & ~allowed)
+        return ERR_ACCESS_DENIED;
+
+    {
+        AutoLock lock(&lock_);
+        cpu_affinity_ = mask;
+    }
+    ApplyLimits();
+    return NO_ERROR;
+}
+
+int JobDispatcher::max_priority() {
+    canary_.Assert();
+
+    AutoLock lock(&lock_);
+    return max_priority_;
+}
+
+status_t JobDispatcher::set_max_priority(int priority) {
+    canary_.Assert();
+
+    if (priority < MX_PRIORITY_LOWEST || priority > MX_PRIORITY_HIGHEST)
+        return ERR_OUT_OF_RANGE;
+
+    // A job cannot give its threads more than its parent may have.
+    int allowed = parent_ ? parent_->max_priority() : MX_PRIORITY_HIGHEST;
+    if (priority > allowed)
+        return ERR_ACCESS_DENIED;
+
+    {
+        AutoLock lock(&lock_);
+        max_priority_ = priority;
+    }
+    ApplyLimits();
+    return NO_ERROR;
+}
+
+void JobDispatcher::InheritLimits(uint64_t cpu_mask, int max_priority) {
+    canary_.Assert();
+
+    {
+        AutoLock lock(&lock_);
+        uint64_t mask = cpu_affinity_ & cpu_mask;
+        // Fall back to all of the parent's cpus rather than leave the job
+        // with none it may run on.
+        cpu_affinity_ = (mask & mp_get_online_mask()) ? mask : cpu_mask;
+        max_priority_ = mxtl::min(max_priority_, max_priority);
+    }
+    ApplyLimits();
+}
+
+void JobDispatcher::ApplyLimits() {
+    canary_.Assert();
+
+    mxtl::Array<mxtl::RefPtr<ProcessDispatcher>> procs;
+    mxtl::Array<mxtl::RefPtr<JobDispatcher>> jobs;
+    uint64_t cpu_mask;
+    int max_priority;
+
+    {
+        AutoLock lock(&lock_);
+        AllocChecker ac;
+        procs.reset(new (&ac) mxtl::RefPtr<ProcessDispatcher>[process_count_], process_count_);
+        if (!ac.check())
+            return;
+        jobs.reset(new (&ac) mxtl::RefPtr<JobDispatcher>[job_count_], job_count_);
+        if (!ac.check())
+            return;
+
+        // As in GetThreadStats(), the children are visited outside the
+        // lock. Threads and jobs added meanwhile pick up the new limits
+        // when they join.
+        size_t i = 0;
+        for (auto& p : procs_) {
+            procs[i++] = mxtl::RefPtr<ProcessDispatcher>(&p);
+        }
+        i = 0;
+        for (auto& j : jobs_) {
+            jobs[i++] = mxtl::RefPtr<JobDispatcher>(&j);
+        }
+        cpu_mask = cpu_affinity_;
+        max_priority = max_priority_;
+    }
+
+    for (size_t i = 0; i < procs.size(); i++) {
+        procs[i]->ApplyJobLimits(cpu_mask, max_priority);
+    }
+    for (size_t i = 0; i < jobs.size(); i++) {
+        // TODO(cpu): This recursive call can overflow the stack.
+        jobs[i]->InheritLimits(cpu_mask, max_priority);
+    }
+}
+
 void JobDispatcher::Kill() {
     canary_.Assert();
 
@@ -221,6 +354,52 @@ bool JobDispatcher::EnumerateChildren(JobEnumerator* je) {
     return completed;
 }
 
+status_t JobDispatcher::GetThreadStats(mx_info_thread_stats_t* stats) {
+    canary_.Assert();
+
+    mxtl::Array<mxtl::RefPtr<ProcessDispatcher>> procs;
+    mxtl::Array<mxtl::RefPtr<JobDispatcher>> jobs;
+
+    {
+        AutoLock lock(&lock_);
+        AllocChecker ac;
+        procs.reset(new (&ac) mxtl::RefPtr<ProcessDispatcher>[process_count_], process_count_);
+        if (!ac.check())
+            return ERR_NO_MEMORY;
+        jobs.reset(new (&ac) mxtl::RefPtr<JobDispatcher>[job_count_], job_count_);
+        if (!ac.check())
+            return ERR_NO_MEMORY;
+
+        // Convert our weak pointers into refcounted. The children are asked
+        // for their stats outside the lock, since a process which is dying
+        // calls RemoveChildProcess() with its own state lock held. Any child
+        // which dies meanwhile reports its full stats itself.
+        size_t i = 0;
+        for (auto& p : procs_) {
+            procs[i++] = mxtl::RefPtr<ProcessDispatcher>(&p);
+        }
+        i = 0;
+        for (auto& j : jobs_) {
+            jobs[i++] = mxtl::RefPtr<JobDispatcher>(&j);
+        }
+        *stats = exited_thread_stats_;
+    }
+
+    mx_info_thread_stats_t child_stats;
+    for (size_t i = 0; i < procs.size(); i++) {
+        procs[i]->GetThreadStats(&child_stats);
+        AddThreadStats(stats, child_stats);
+    }
+    for (size_t i = 0; i < jobs.size(); i++) {
+        // TODO(cpu): This recursive call can overflow the stack.
+        status_t status = jobs[i]->GetThreadStats(&child_stats);
+        if (status != NO_ERROR)
+            return status;
+        AddThreadStats(stats, child_stats);
+    }
+    return NO_ERROR;
+}
+
 mxtl::RefPtr<ProcessDispatcher> JobDispatcher::LookupProcessById(mx_koid_t koid) {
     canary_.Assert();
 
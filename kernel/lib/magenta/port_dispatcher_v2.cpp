@@ -20,13 +20,14 @@
 constexpr mx_rights_t kDefaultIOPortRightsV2 =
     MX_RIGHT_DUPLICATE | MX_RIGHT_TRANSFER | MX_RIGHT_READ | MX_RIGHT_WRITE;
 
-PortPacket::PortPacket() : packet{}, observer(nullptr) {
+PortPacket::PortPacket() : packet{}, observer(nullptr), free_next(nullptr), state(0u) {
     // Note that packet is initialized to zeros.
 }
 
 PortObserver::PortObserver(uint32_t type, Handle* handle, mxtl::RefPtr<PortDispatcherV2> port,
                            uint64_t key, mx_signals_t signals)
-    : type_(type),
+    : StateObserver(signals),
+      type_(type),
       key_(key),
       trigger_(signals),
       handle_(handle),
@@ -106,7 +107,7 @@ mx_status_t PortDispatcherV2::Create(uint32_t options,
 }
 
 PortDispatcherV2::PortDispatcherV2(uint32_t /*options*/)
-    : zero_handles_(false) {
+    : zero_handles_(false), waiters_(0u) {
 }
 
 PortDispatcherV2::~PortDispatcherV2() {
@@ -152,14 +153,24 @@ mx_status_t PortDispatcherV2::Queue(PortPacket* port_packet,
             return ERR_BAD_STATE;
 
         if (observed) {
-            if (port_packet->InContainer())
+            // A signal packet is queued at most once at a time; new signals
+            // while it waits to be dequeued are folded into it.
+            uint32_t expected = 0u;
+            if (!port_packet->state.compare_exchange_strong(
+                    &expected, PortPacket::kQueued,
+                    mxtl::memory_order_acquire, mxtl::memory_order_relaxed)) {
+                port_packet->packet.signal.observed |= observed;
                 return NO_ERROR;
+            }
             port_packet->packet.signal.observed = observed;
             port_packet->packet.signal.count = count;
         }
 
         packets_.push_back(port_packet);
-        wake_count = sema_.Post();
+        // Only post for threads which are waiting, so that the semaphore
+        // does not pile up a count for packets nobody slept for.
+        if (waiters_.load() > 0u)
+            wake_count = sema_.Post();
     }
 
     if (wake_count)
@@ -169,50 +180,86 @@ mx_status_t PortDispatcherV2::Queue(PortPacket* port_packet,
 }
 
 mx_status_t PortDispatcherV2::DeQueue(mx_time_t timeout, mx_port_packet_t* packet) {
-    canary_.Assert();
+    uint32_t count = 1u;
+    return DeQueue(timeout, packet, &count);
+}
 
-    PortPacket* port_packet = nullptr;
-    PortObserver* observer = nullptr;
+mx_status_t PortDispatcherV2::DeQueue(mx_time_t timeout, mx_port_packet_t* packets,
+                                      uint32_t* count) {
+    canary_.Assert();
+    DEBUG_ASSERT(*count > 0u);
 
     while (true) {
+        PortPacket* to_free = nullptr;
+        uint32_t taken;
         {
             AutoLock al(&lock_);
-            if (packets_.is_empty())
-                goto wait;
-
-            port_packet = packets_.pop_front();
-            observer = CopyLocked(port_packet, packet);
+            taken = TakeLocked(packets, *count, &to_free);
+
+            if (taken == 0u) {
+                // Count ourselves as waiting under |lock_|, so a producer
+                // either leaves us a packet or posts.
+                waiters_.fetch_add(1u);
+            } else if (!packets_.is_empty() && waiters_.load() > 0u) {
+                // Producers only post once per packet, so pass on what we
+                // left behind.
+                sema_.Post();
+            }
         }
 
-        if (observer)
-            delete observer;
-        else if (packet && packet->type == MX_PKT_TYPE_USER)
-            delete port_packet;
-        return NO_ERROR;
+        if (taken > 0u) {
+            while (to_free) {
+                PortPacket* port_packet = to_free;
+                to_free = port_packet->free_next;
+                if (port_packet->type() == MX_PKT_TYPE_USER)
+                    delete port_packet;
+                else
+                    delete port_packet->observer;
+            }
+            *count = taken;
+            return NO_ERROR;
+        }
 
-wait:
         status_t st = sema_.Wait(timeout);
+        waiters_.fetch_sub(1u);
         if (st != NO_ERROR)
             return st;
     }
 }
 
-PortObserver* PortDispatcherV2::CopyLocked(PortPacket* port_packet, mx_port_packet_t* packet) {
-    if (packet)
-        *packet = port_packet->packet;
-
-    return (port_packet->type() == MX_PKT_TYPE_USER) ? nullptr : port_packet->observer;
+// Copies out up to |max| packets. The ones which need destroying, user
+// packets and those of observers which were reaped while queued, are put on
+// |to_free| for the caller to destroy once it has dropped the lock.
+uint32_t PortDispatcherV2::TakeLocked(mx_port_packet_t* packets, uint32_t max,
+                                      PortPacket** to_free) {
+    uint32_t taken = 0u;
+    while (taken < max && !packets_.is_empty()) {
+        PortPacket* port_packet = packets_.pop_front();
+        if (packets)
+            packets[taken] = port_packet->packet;
+        taken++;
+
+        // Once kQueued is clear the packet can be queued again, or its
+        // observer destroyed by CanReap()'s caller, so it is not touched
+        // after that unless kReap says the port owns it.
+        if (port_packet->type() == MX_PKT_TYPE_USER ||
+            (port_packet->state.fetch_and(~PortPacket::kQueued, mxtl::memory_order_acq_rel) &
+             PortPacket::kReap)) {
+            port_packet->free_next = *to_free;
+            *to_free = port_packet;
+        }
+    }
+    return taken;
 }
 
 bool PortDispatcherV2::CanReap(PortObserver* observer, PortPacket* port_packet) {
     canary_.Assert();
 
-    AutoLock al(&lock_);
-    if (!port_packet->InContainer())
+    port_packet->observer = observer;
+    if ((port_packet->state.fetch_or(PortPacket::kReap, mxtl::memory_order_acq_rel) &
+         PortPacket::kQueued) == 0u)
         return true;
     // The destruction will happen when the packet is dequeued.
-    DEBUG_ASSERT(port_packet->observer == nullptr);
-    port_packet->observer = observer;
     return false;
 }
 
@@ -129,8 +129,9 @@ ProcessDispatcher::~ProcessDispatcher() {
 
     // Remove ourselves from the parent job's weak ref to us. Note that this might
     // have beeen called when transitioning State::DEAD. The Job can handle double calls.
+    // A process which never got that far never ran a thread, so has no stats.
     if (job_)
-        job_->RemoveChildProcess(this);
+        job_->RemoveChildProcess(this, nullptr);
 
     LTRACE_EXIT_OBJ;
 }
@@ -242,6 +243,11 @@ status_t ProcessDispatcher::AddThread(UserThread* t, bool initial_thread) {
     DEBUG_ASSERT(thread_list_.is_empty() == initial_thread);
     thread_list_.push_back(t);
 
+    // start out within the job's limits; a later change to them reaches
+    // the thread through ApplyJobLimits() now that it is on the list
+    if (job_)
+        t->ApplyJobLimits(job_->cpu_affinity(), job_->max_priority());
+
     DEBUG_ASSERT(t->process() == this);
 
     if (initial_thread)
@@ -264,9 +270,12 @@ void ProcessDispatcher::RemoveThread(UserThread* t) {
     // we're going to check for state and possibly transition below
     AutoLock state_lock(&state_lock_);
 
-    // remove the thread from our list
+    // remove the thread from our list, keeping its stats for the process totals
     DEBUG_ASSERT(t != nullptr);
     thread_list_.erase(*t);
+    mx_info_thread_stats_t stats;
+    t->GetThreadStats(&stats);
+    AddThreadStats(&exited_thread_stats_, stats);
 
     // if this was the last thread, transition directly to DEAD state
     if (thread_list_.is_empty()) {
@@ -367,8 +376,9 @@ void ProcessDispatcher::SetStateLocked(State s) {
 
         // We remove ourselves from the parent Job weak ref (to us) list early, so
         // the semantics of signaling MX_JOB_NO_PROCESSES match that of MX_TASK_TERMINATED.
+        // All our threads are gone, so the job can take over their stats.
         if (job_)
-            job_->RemoveChildProcess(this);
+            job_->RemoveChildProcess(this, &exited_thread_stats_);
 
         // The PROC_CREATE record currently emits a uint32_t.
         uint32_t koid = static_cast<uint32_t>(get_koid());
@@ -506,6 +516,25 @@ status_t ProcessDispatcher::GetStats(mx_info_task_stats_t* stats) {
     return NO_ERROR;
 }
 
+status_t ProcessDispatcher::GetThreadStats(mx_info_thread_stats_t* stats) {
+    DEBUG_ASSERT(stats != nullptr);
+    AutoLock lock(&state_lock_);
+    *stats = exited_thread_stats_;
+    for (auto& thread : thread_list_) {
+        mx_info_thread_stats_t thread_stats;
+        thread.GetThreadStats(&thread_stats);
+        AddThreadStats(stats, thread_stats);
+    }
+    return NO_ERROR;
+}
+
+void ProcessDispatcher::ApplyJobLimits(uint64_t cpu_mask, int max_priority) {
+    AutoLock lock(&state_lock_);
+    for (auto& thread : thread_list_) {
+        thread.ApplyJobLimits(cpu_mask, max_priority);
+    }
+}
+
 status_t ProcessDispatcher::GetAspaceMaps(
     user_ptr<mx_info_maps_t> maps, size_t max,
     size_t* actual, size_t* available) {
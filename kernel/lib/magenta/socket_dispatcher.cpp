@@ -17,7 +17,6 @@
 #include <lib/user_copy/user_ptr.h>
 
 #include <kernel/auto_lock.h>
-#include <kernel/vm/vm_aspace.h>
 #include <kernel/vm/vm_object.h>
 
 #include <magenta/handle.h>
@@ -28,7 +27,10 @@
 constexpr mx_rights_t kDefaultSocketRights =
     MX_RIGHT_TRANSFER | MX_RIGHT_DUPLICATE | MX_RIGHT_READ | MX_RIGHT_WRITE;
 
-constexpr size_t kDeFaultSocketBufferSize = 256 * 1024u;
+constexpr uint32_t kValidCreateFlags = MX_SOCKET_DATAGRAM | MX_SOCKET_CAPACITY_MASK;
+
+// Pages of a drained buffer that are kept committed for the next write.
+constexpr size_t kRetainedBufferSize = PAGE_SIZE;
 
 constexpr mx_signals_t kValidSignalMask =
     MX_SOCKET_READABLE | MX_SOCKET_PEER_CLOSED | MX_USER_SIGNAL_ALL;
@@ -40,31 +42,6 @@ template <typename T> T vmodpow2(T val, uint modp2) { return val & ((1U << modp2
 
 #define INC_POINTER(len_pow2, ptr, inc) vmodpow2(((ptr) + (inc)), len_pow2)
 
-SocketDispatcher::CBuf::~CBuf() {
-    VmAspace::kernel_aspace()->FreeRegion(reinterpret_cast<vaddr_t>(buf_));
-}
-
-bool SocketDispatcher::CBuf::Init(uint32_t len) {
-    vmo_ = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, len);
-    if (!vmo_)
-        return false;
-
-    void* start = nullptr;
-    auto st = VmAspace::kernel_aspace()->MapObject(
-        vmo_, "socket", 0u, len, &start, PAGE_SIZE_SHIFT, 0,
-        0, ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_WRITE);
-
-    if (st < 0)
-        return false;
-
-    buf_ = reinterpret_cast<char*>(start);
-
-    if (!buf_)
-        return false;
-    len_pow2_ = log2_uint_floor(len);
-    return true;
-}
-
 size_t SocketDispatcher::CBuf::free() const {
     uint consumed = modpow2((uint)(head_ - tail_), len_pow2_);
     return valpow2(len_pow2_) - consumed - 1;
@@ -74,7 +51,13 @@ bool SocketDispatcher::CBuf::empty() const {
     return tail_ == head_;
 }
 
-size_t SocketDispatcher::CBuf::Write(const void* src, size_t len, bool from_user) {
+mx_status_t SocketDispatcher::CBuf::Write(const void* src, size_t len, bool from_user,
+                                          size_t* written) {
+    if (!vmo_) {
+        vmo_ = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, valpow2(len_pow2_));
+        if (!vmo_)
+            return ERR_NO_MEMORY;
+    }
 
     size_t write_len;
     size_t pos = 0;
@@ -102,55 +85,115 @@ size_t SocketDispatcher::CBuf::Write(const void* src, size_t len, bool from_user
 
         const char *ptr = (const char*)src;
         ptr += pos;
+        status_t status;
         if (from_user) {
             // TODO: find a safer way to do this
             user_ptr<const void> uptr(ptr);
-            vmo_->WriteUser(uptr, head_, write_len, nullptr);
+            status = vmo_->WriteUser(uptr, head_, write_len, nullptr);
         } else {
-            memcpy(buf_ + head_, ptr, write_len);
+            status = vmo_->Write(ptr, head_, write_len, nullptr);
+        }
+        if (status != NO_ERROR) {
+            // Report what made it in, if anything did.
+            if (pos == 0)
+                return status;
+            break;
         }
 
+        high_water_ = MAX(high_water_, head_ + write_len);
         head_ = INC_POINTER(len_pow2_, head_, write_len);
         pos += write_len;
     }
-    return pos;
+
+    *written = pos;
+    return NO_ERROR;
 }
 
-size_t SocketDispatcher::CBuf::Read(void* dest, size_t len, bool from_user) {
-    size_t ret = 0;
-
-    if (tail_ != head_) {
-        size_t pos = 0;
-        // loop until we've read everything we need
-        // at most this will make two passes to deal with wraparound
-        while (pos < len && tail_ != head_) {
-            size_t read_len;
-            if (head_ > tail_) {
-                // simple case where there is no wraparound
-                read_len = MIN(head_ - tail_, len - pos);
-            } else {
-                // read to the end of buffer in this pass
-                read_len = MIN(valpow2(len_pow2_) - tail_, len - pos);
-            }
+mx_status_t SocketDispatcher::CBuf::WriteDatagram(const void* src, size_t len,
+                                                  bool from_user) {
+    DatagramHeader header = static_cast<DatagramHeader>(len);
+    if (len > valpow2(len_pow2_) - 1 - sizeof(header))
+        return ERR_OUT_OF_RANGE;
+    if (free() < sizeof(header) + len)
+        return ERR_SHOULD_WAIT;
+
+    size_t head = head_;
+    size_t high_water = high_water_;
+    size_t written = 0;
+    mx_status_t status = Write(&header, sizeof(header), false, &written);
+    if (status == NO_ERROR)
+        status = Write(src, len, from_user, &written);
+    if (status == NO_ERROR && written != len)
+        status = ERR_INVALID_ARGS;
+
+    // Don't leave a partial datagram behind, nor pages only it committed.
+    if (status != NO_ERROR) {
+        head_ = head;
+        if (high_water_ > high_water)
+            vmo_->DecommitRange(high_water, high_water_ - high_water, nullptr);
+        high_water_ = high_water;
+    }
+    return status;
+}
 
+size_t SocketDispatcher::CBuf::CopyOut(size_t* tail, void* dest, size_t len,
+                                       bool from_user) const {
+    size_t pos = 0;
+    // loop until we've read everything we need
+    // at most this will make two passes to deal with wraparound
+    while (pos < len && *tail != head_) {
+        size_t read_len;
+        if (head_ > *tail) {
+            // simple case where there is no wraparound
+            read_len = MIN(head_ - *tail, len - pos);
+        } else {
+            // read to the end of buffer in this pass
+            read_len = MIN(valpow2(len_pow2_) - *tail, len - pos);
+        }
+
+        if (dest) {
             char *ptr = (char*)dest;
             ptr += pos;
             if (from_user) {
                 // TODO: find a safer way to do this
                 user_ptr<void> uptr(ptr);
-                vmo_->ReadUser(uptr, tail_, read_len, nullptr);
+                vmo_->ReadUser(uptr, *tail, read_len, nullptr);
             } else {
-                memcpy(ptr, buf_ + tail_, read_len);
+                vmo_->Read(ptr, *tail, read_len, nullptr);
             }
-
-            tail_ = INC_POINTER(len_pow2_, tail_, read_len);
-            pos += read_len;
         }
-        ret = pos;
+
+        *tail = INC_POINTER(len_pow2_, *tail, read_len);
+        pos += read_len;
     }
+    return pos;
+}
+
+size_t SocketDispatcher::CBuf::Read(void* dest, size_t len, bool from_user) {
+    if (tail_ == head_)
+        return 0;
+
+    size_t ret = CopyOut(&tail_, dest, len, from_user);
+    if (tail_ == head_)
+        Drained();
     return ret;
 }
 
+size_t SocketDispatcher::CBuf::Peek(void* dest, size_t len) const {
+    size_t tail = tail_;
+    return CopyOut(&tail, dest, len, false);
+}
+
+void SocketDispatcher::CBuf::Drained() {
+    // Start over at the beginning so that small transfers keep reusing the
+    // first page, and give back the rest.
+    head_ = tail_ = 0u;
+    if (high_water_ > kRetainedBufferSize) {
+        vmo_->DecommitRange(kRetainedBufferSize, high_water_ - kRetainedBufferSize, nullptr);
+        high_water_ = kRetainedBufferSize;
+    }
+}
+
 size_t SocketDispatcher::CBuf::CouldRead() const {
     return modpow2((uint)(head_ - tail_), len_pow2_);
 }
@@ -162,6 +205,14 @@ status_t SocketDispatcher::Create(uint32_t flags,
                                   mx_rights_t* rights) {
     LTRACE_ENTRY;
 
+    if (flags & ~kValidCreateFlags)
+        return ERR_INVALID_ARGS;
+
+    uint32_t capacity = (flags & MX_SOCKET_CAPACITY_MASK) >> MX_SOCKET_CAPACITY_SHIFT;
+    if (capacity != 0 &&
+        (capacity < MX_SOCKET_CAPACITY_MIN || capacity > MX_SOCKET_CAPACITY_MAX))
+        return ERR_OUT_OF_RANGE;
+
     AllocChecker ac;
     auto socket0 = mxtl::AdoptRef(new (&ac) SocketDispatcher(flags));
     if (!ac.check())
@@ -183,10 +234,12 @@ status_t SocketDispatcher::Create(uint32_t flags,
     return NO_ERROR;
 }
 
-SocketDispatcher::SocketDispatcher(uint32_t /*flags*/)
-    : peer_koid_(0u),
+SocketDispatcher::SocketDispatcher(uint32_t flags)
+    : flags_(flags),
+      peer_koid_(0u),
       state_tracker_(MX_SOCKET_WRITABLE),
-      half_closed_{false, false} {
+      half_closed_{false, false},
+      write_wait_(0u) {
 }
 
 SocketDispatcher::~SocketDispatcher() {
@@ -197,7 +250,10 @@ SocketDispatcher::~SocketDispatcher() {
 mx_status_t SocketDispatcher::Init(mxtl::RefPtr<SocketDispatcher> other) TA_NO_THREAD_SAFETY_ANALYSIS {
     other_ = mxtl::move(other);
     peer_koid_ = other_->get_koid();
-    return cbuf_.Init(kDeFaultSocketBufferSize) ? NO_ERROR : ERR_NO_MEMORY;
+
+    uint32_t capacity = (flags_ & MX_SOCKET_CAPACITY_MASK) >> MX_SOCKET_CAPACITY_SHIFT;
+    cbuf_.Init(capacity ? capacity : MX_SOCKET_CAPACITY_DEFAULT);
+    return NO_ERROR;
 }
 
 void SocketDispatcher::on_zero_handles() {
@@ -329,22 +385,47 @@ mx_status_t SocketDispatcher::WriteSelf(const void* src, size_t len,
 
     AutoLock lock(&lock_);
 
-    if (!cbuf_.free())
+    bool datagram = (flags_ & MX_SOCKET_DATAGRAM) != 0;
+
+    // WriteDatagram() checks for room itself; a small datagram may fit
+    // while a larger one that was turned away is still waiting.
+    if (!datagram && is_full())
         return ERR_SHOULD_WAIT;
 
     bool was_empty = cbuf_.empty();
+    bool was_waiting = write_wait_ != 0u;
 
-    auto st = cbuf_.Write(src, len, from_user);
+    size_t st = 0;
+    mx_status_t status;
+    if (datagram) {
+        status = cbuf_.WriteDatagram(src, len, from_user);
+        if (status == ERR_SHOULD_WAIT) {
+            // Keep WRITABLE down until this datagram fits, rather than
+            // until the next byte frees up.
+            write_wait_ = sizeof(DatagramHeader) + len;
+            other_->state_tracker_.UpdateState(MX_SOCKET_WRITABLE, 0u);
+        } else if (status == NO_ERROR) {
+            write_wait_ = 0u;
+            st = len;
+        }
+    } else {
+        status = cbuf_.Write(src, len, from_user, &st);
+    }
+    if (status != NO_ERROR)
+        return status;
 
-    if (st > 0) {
+    // Even an empty datagram is something to read.
+    if (st > 0 || (flags_ & MX_SOCKET_DATAGRAM)) {
         if (was_empty)
             state_tracker_.UpdateState(0u, MX_SOCKET_READABLE);
         if (iopc_)
             iopc_->Signal(MX_SOCKET_READABLE, st, &lock_);
     }
 
-    if (!cbuf_.free())
+    if (is_full())
         other_->state_tracker_.UpdateState(MX_SOCKET_WRITABLE, 0u);
+    else if (was_waiting)
+        other_->state_tracker_.UpdateState(0u, MX_SOCKET_WRITABLE);
 
     *written = st;
     return NO_ERROR;
@@ -356,9 +437,14 @@ mx_status_t SocketDispatcher::Read(void* dest, size_t len,
 
     AutoLock lock(&lock_);
 
-    // Just query for bytes outstanding.
+    bool datagram = (flags_ & MX_SOCKET_DATAGRAM) != 0;
+
+    // Just query for bytes outstanding, or the size of the next datagram.
     if (!dest && len == 0) {
-        *nread = cbuf_.CouldRead();
+        DatagramHeader header = 0;
+        if (datagram)
+            cbuf_.Peek(&header, sizeof(header));
+        *nread = datagram ? header : cbuf_.CouldRead();
         return NO_ERROR;
     }
 
@@ -367,17 +453,37 @@ mx_status_t SocketDispatcher::Read(void* dest, size_t len,
     if (cbuf_.empty())
         return closed ? ERR_REMOTE_CLOSED: ERR_SHOULD_WAIT;
 
-    bool was_full = cbuf_.free() == 0u;
-
-    auto st = cbuf_.Read(dest, len, from_user);
+    bool was_full = is_full();
+
+    size_t st;
+    if (datagram) {
+        // Hand out as much of the next datagram as fits and drop the rest.
+        DatagramHeader header = 0;
+        cbuf_.Read(&header, sizeof(header), false);
+        st = cbuf_.Read(dest, MIN(len, header), from_user);
+        cbuf_.Read(nullptr, header - st, false);
+    } else {
+        st = cbuf_.Read(dest, len, from_user);
+    }
 
     if (cbuf_.empty()) {
         state_tracker_.UpdateState(MX_SOCKET_READABLE, 0u);
     }
 
-    if (!closed && was_full && (st > 0))
+    if (!closed && was_full && !is_full()) {
+        write_wait_ = 0u;
         other_->state_tracker_.UpdateState(0u, MX_SOCKET_WRITABLE);
+    }
 
     *nread = static_cast<size_t>(st);
     return NO_ERROR;
 }
+
+bool SocketDispatcher::is_full() const {
+    // A datagram needs room for its header on top of any data, and a
+    // writer that was turned away needs room for the whole datagram.
+    size_t needed = 1u;
+    if (flags_ & MX_SOCKET_DATAGRAM)
+        needed = MAX(sizeof(DatagramHeader) + 1u, write_wait_);
+    return cbuf_.free() < needed;
+}
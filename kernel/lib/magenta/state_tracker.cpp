@@ -11,34 +11,109 @@
 
 namespace {
 
+// Calls |func| on each observer in |observers| which |want| picks, moving
+// the ones which ask to be removed to |obs_to_remove|.
+template <typename Want, typename Func>
+bool VisitObservers(StateTracker::ObserverList* observers, Want want, Func func,
+                    StateTracker::ObserverList* obs_to_remove) {
+    bool awoke_threads = false;
+    for (auto it = observers->begin(); it != observers->end();) {
+        if (!want(*it)) {
+            ++it;
+            continue;
+        }
+        awoke_threads = func(it.CopyPointer()) || awoke_threads;
+        if (it->remove()) {
+            auto to_remove = it;
+            ++it;
+            obs_to_remove->push_back(observers->erase(to_remove));
+        } else {
+            ++it;
+        }
+    }
+    return awoke_threads;
+}
+
+void FinishRemoval(StateTracker::ObserverList* obs_to_remove, bool awoke_threads) {
+    while (!obs_to_remove->is_empty()) {
+        obs_to_remove->pop_front()->OnRemoved();
+    }
+
+    if (awoke_threads)
+        thread_preempt(false);
+}
+
+}  // namespace
+
+template <typename Func>
+bool StateTracker::NotifyLocked(mx_signals_t signals, Func func, ObserverList* obs_to_remove) {
+    bool awoke_threads = false;
+    for (auto& group : groups_) {
+        if (group.mask & signals) {
+            awoke_threads = VisitObservers(&group.observers,
+                                           [](const StateObserver&) { return true; },
+                                           func, obs_to_remove) || awoke_threads;
+        }
+    }
+    awoke_threads = VisitObservers(&observers_,
+                                   [signals](const StateObserver& obs) {
+                                       return (obs.notify_mask() & signals) != 0u;
+                                   },
+                                   func, obs_to_remove) || awoke_threads;
+    return awoke_threads;
+}
+
+template <typename Func>
+bool StateTracker::ForEachLocked(Func func, ObserverList* obs_to_remove) {
+    auto all = [](const StateObserver&) { return true; };
+    bool awoke_threads = false;
+    for (auto& group : groups_)
+        awoke_threads = VisitObservers(&group.observers, all, func, obs_to_remove) || awoke_threads;
+    awoke_threads = VisitObservers(&observers_, all, func, obs_to_remove) || awoke_threads;
+    return awoke_threads;
+}
+
 template <typename Func>
-void CancelWithFunc(StateTracker::ObserverList* observers, Mutex* observer_lock, Func f) {
+void StateTracker::CancelWithFunc(Func func) {
     bool awoke_threads = false;
 
-    StateTracker::ObserverList obs_to_remove;
+    ObserverList obs_to_remove;
 
     {
-        AutoLock lock(observer_lock);
-        for (auto it = observers->begin(); it != observers->end();) {
-            awoke_threads = f(it.CopyPointer()) || awoke_threads;
-            if (it->remove()) {
-                auto to_remove = it;
-                ++it;
-                obs_to_remove.push_back(observers->erase(to_remove));
-            } else {
-                ++it;
-            }
+        AutoLock lock(&lock_);
+        awoke_threads = ForEachLocked(func, &obs_to_remove);
+    }
+
+    FinishRemoval(&obs_to_remove, awoke_threads);
+}
+
+void StateTracker::AddObserverLocked(StateObserver* observer) {
+    // Join the group for our mask, or start one if there is a free group.
+    const mx_signals_t mask = observer->notify_mask();
+    uint32_t free_group = kNumGroups;
+    for (uint32_t ix = 0; ix < kNumGroups; ++ix) {
+        if (groups_[ix].observers.is_empty()) {
+            if (free_group == kNumGroups)
+                free_group = ix;
+        } else if (groups_[ix].mask == mask) {
+            free_group = ix;
+            break;
         }
     }
 
-    while (!obs_to_remove.is_empty()) {
-        obs_to_remove.pop_front()->OnRemoved();
+    observer->tracker_list_ = free_group;
+    if (free_group == kNumGroups) {
+        observers_.push_front(observer);
+    } else {
+        groups_[free_group].mask = mask;
+        groups_[free_group].observers.push_front(observer);
     }
+}
 
-    if (awoke_threads)
-        thread_preempt(false);
+StateTracker::ObserverList* StateTracker::ListForLocked(StateObserver* observer) {
+    return (observer->tracker_list_ == kNumGroups) ? &observers_
+                                                   : &groups_[observer->tracker_list_].observers;
 }
-}  // namespace
 
 void StateTracker::AddObserver(StateObserver* observer, const StateObserver::CountInfo* cinfo) {
     canary_.Assert();
@@ -50,7 +125,7 @@ void StateTracker::AddObserver(StateObserver* observer, const StateObserver::Cou
 
         awoke_threads = observer->OnInitialize(signals_, cinfo);
         if (!observer->remove())
-            observers_.push_front(observer);
+            AddObserverLocked(observer);
     }
     if (awoke_threads)
         thread_preempt(false);
@@ -61,13 +136,13 @@ void StateTracker::RemoveObserver(StateObserver* observer) {
 
     AutoLock lock(&lock_);
     DEBUG_ASSERT(observer != nullptr);
-    observers_.erase(*observer);
+    ListForLocked(observer)->erase(*observer);
 }
 
 void StateTracker::Cancel(Handle* handle) {
     canary_.Assert();
 
-    CancelWithFunc(&observers_, &lock_, [handle](StateObserver* obs) {
+    CancelWithFunc([handle](StateObserver* obs) {
         return obs->OnCancel(handle);
     });
 }
@@ -75,7 +150,7 @@ void StateTracker::Cancel(Handle* handle) {
 void StateTracker::CancelByKey(Handle* handle, const void* port, uint64_t key) {
     canary_.Assert();
 
-    CancelWithFunc(&observers_, &lock_, [handle, port, key](StateObserver* obs) {
+    CancelWithFunc([handle, port, key](StateObserver* obs) {
         return obs->OnCancelByKey(handle, port, key);
     });
 }
@@ -98,25 +173,15 @@ void StateTracker::UpdateState(mx_signals_t clear_mask,
         if (previous_signals == signals_)
             return;
 
-        for (auto it = observers_.begin(); it != observers_.end();) {
-            awoke_threads = it->OnStateChange(signals_) || awoke_threads;
-            if (it->remove()) {
-                auto to_remove = it;
-                ++it;
-                obs_to_remove.push_back(observers_.erase(to_remove));
-            } else {
-                ++it;
-            }
-        }
-    }
-
-    while (!obs_to_remove.is_empty()) {
-        obs_to_remove.pop_front()->OnRemoved();
+        auto new_signals = signals_;
+        awoke_threads = NotifyLocked(previous_signals ^ new_signals,
+                                     [new_signals](StateObserver* obs) {
+                                         return obs->OnStateChange(new_signals);
+                                     },
+                                     &obs_to_remove);
     }
 
-    if (awoke_threads) {
-        thread_preempt(false);
-    }
+    FinishRemoval(&obs_to_remove, awoke_threads);
 }
 
 void StateTracker::StrobeState(mx_signals_t notify_mask) {
@@ -130,27 +195,15 @@ void StateTracker::StrobeState(mx_signals_t notify_mask) {
         AutoLock lock(&lock_);
 
         // include currently active signals as well
-        notify_mask |= signals_;
-
-        for (auto it = observers_.begin(); it != observers_.end();) {
-            awoke_threads = it->OnStateChange(notify_mask) || awoke_threads;
-            if (it->remove()) {
-                auto to_remove = it;
-                ++it;
-                obs_to_remove.push_back(observers_.erase(to_remove));
-            } else {
-                ++it;
-            }
-        }
-    }
-
-    while (!obs_to_remove.is_empty()) {
-        obs_to_remove.pop_front()->OnRemoved();
+        auto new_signals = notify_mask | signals_;
+        awoke_threads = NotifyLocked(notify_mask,
+                                     [new_signals](StateObserver* obs) {
+                                         return obs->OnStateChange(new_signals);
+                                     },
+                                     &obs_to_remove);
     }
 
-    if (awoke_threads) {
-        thread_preempt(false);
-    }
+    FinishRemoval(&obs_to_remove, awoke_threads);
 }
 
 mx_status_t StateTracker::SetCookie(CookieJar* cookiejar, mx_koid_t scope, uint64_t cookie) {
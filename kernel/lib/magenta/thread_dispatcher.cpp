@@ -77,6 +77,13 @@ status_t ThreadDispatcher::GetInfo(mx_info_thread_t* info) {
     return NO_ERROR;
 }
 
+status_t ThreadDispatcher::GetStats(mx_info_thread_stats_t* stats) {
+    canary_.Assert();
+
+    thread_->GetThreadStats(stats);
+    return NO_ERROR;
+}
+
 status_t ThreadDispatcher::GetExceptionReport(mx_exception_report_t* report) {
     canary_.Assert();
 
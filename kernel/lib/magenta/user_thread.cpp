@@ -19,6 +19,7 @@
 #include <arch/debugger.h>
 
 #include <kernel/auto_lock.h>
+#include <kernel/mp.h>
 #include <kernel/thread.h>
 #include <kernel/vm.h>
 #include <kernel/vm/vm_aspace.h>
@@ -27,6 +28,7 @@
 #include <magenta/c_user_thread.h>
 #include <magenta/exception.h>
 #include <magenta/excp_port.h>
+#include <magenta/job_dispatcher.h>
 #include <magenta/magenta.h>
 #include <magenta/process_dispatcher.h>
 #include <magenta/syscalls/debug.h>
@@ -77,91 +79,9 @@ UserThread::~UserThread() {
         DEBUG_ASSERT_MSG(false, "bad state %s, this %p\n", StateToString(state_), this);
     }
 
-    // free the kernel stack
-    kstack_mapping_.reset();
-    if (kstack_vmar_) {
-        kstack_vmar_->Destroy();
-        kstack_vmar_.reset();
-    }
-#if __has_feature(safe_stack)
-    unsafe_kstack_mapping_.reset();
-    if (unsafe_kstack_vmar_) {
-        unsafe_kstack_vmar_->Destroy();
-        unsafe_kstack_vmar_.reset();
-    }
-#endif
-
     event_destroy(&exception_event_);
 }
 
-namespace {
-
-status_t allocate_stack(const mxtl::RefPtr<VmAddressRegion>& vmar, bool unsafe,
-                        mxtl::RefPtr<VmMapping>* out_kstack_mapping,
-                        mxtl::RefPtr<VmAddressRegion>* out_kstack_vmar) {
-    LTRACEF("allocating %s stack\n", unsafe ? "unsafe" : "safe");
-
-    // Create a VMO for our stack
-    auto stack_vmo = VmObjectPaged::Create(0, DEFAULT_STACK_SIZE);
-    if (!stack_vmo) {
-        TRACEF("error allocating %s stack for thread\n",
-               unsafe ? "unsafe" : "safe");
-        return ERR_NO_MEMORY;
-    }
-
-    // create a vmar with enough padding for a page before and after the stack
-    const size_t padding_size = PAGE_SIZE;
-
-    mxtl::RefPtr<VmAddressRegion> kstack_vmar;
-    auto status = vmar->CreateSubVmar(
-        0, 2 * padding_size + DEFAULT_STACK_SIZE, 0,
-        VMAR_FLAG_CAN_MAP_SPECIFIC |
-        VMAR_FLAG_CAN_MAP_READ |
-        VMAR_FLAG_CAN_MAP_WRITE,
-        unsafe ? "unsafe_kstack_vmar" : "kstack_vmar",
-        &kstack_vmar);
-    if (status != NO_ERROR)
-        return status;
-
-    // destroy the vmar if we early abort
-    // this will also clean up any mappings that may get placed on the vmar
-    auto vmar_cleanup = mxtl::MakeAutoCall([&kstack_vmar]() {
-            kstack_vmar->Destroy();
-        });
-
-    LTRACEF("%s stack vmar at %#" PRIxPTR "\n",
-            unsafe ? "unsafe" : "safe", kstack_vmar->base());
-
-    // create a mapping offset padding_size into the vmar we created
-    mxtl::RefPtr<VmMapping> kstack_mapping;
-    status = kstack_vmar->CreateVmMapping(padding_size, DEFAULT_STACK_SIZE, 0,
-                                          VMAR_FLAG_SPECIFIC,
-                                          mxtl::move(stack_vmo), 0,
-                                          ARCH_MMU_FLAG_PERM_READ |
-                                          ARCH_MMU_FLAG_PERM_WRITE,
-                                          unsafe ? "unsafe_kstack" : "kstack",
-                                          &kstack_mapping);
-    if (status != NO_ERROR)
-        return status;
-
-    LTRACEF("%s stack mapping at %#" PRIxPTR "\n",
-            unsafe ? "unsafe" : "safe", kstack_mapping->base());
-
-    // fault in all the pages so we dont demand fault in the stack
-    status = kstack_mapping->MapRange(0, DEFAULT_STACK_SIZE, true);
-    if (status != NO_ERROR)
-        return status;
-
-    // Cancel the cleanup handler on the vmar since we're about to save a
-    // reference to it.
-    vmar_cleanup.cancel();
-    *out_kstack_mapping = mxtl::move(kstack_mapping);
-    *out_kstack_vmar = mxtl::move(kstack_vmar);
-    return NO_ERROR;
-}
-
-};
-
 // complete initialization of the thread object outside of the constructor
 status_t UserThread::Initialize(const char* name, size_t len) {
     LTRACE_ENTRY_OBJ;
@@ -180,30 +100,10 @@ status_t UserThread::Initialize(const char* name, size_t len) {
     memset(thread_name + len, 0, MX_MAX_NAME_LEN - len);
     memcpy(thread_name, name, len);
 
-    // Map the kernel stack somewhere
-    auto vmar = VmAspace::kernel_aspace()->RootVmar()->as_vm_address_region();
-    DEBUG_ASSERT(!!vmar);
-
-    auto status = allocate_stack(vmar, false, &kstack_mapping_, &kstack_vmar_);
-    if (status != NO_ERROR)
-        return status;
-#if __has_feature(safe_stack)
-    status = allocate_stack(vmar, true,
-                            &unsafe_kstack_mapping_, &unsafe_kstack_vmar_);
-    if (status != NO_ERROR)
-        return status;
-#endif
-
-    // create an underlying LK thread
+    // create an underlying LK thread, with a kernel stack of its own
     thread_t* lkthread = thread_create_etc(
         &thread_, thread_name, StartRoutine, this, LOW_PRIORITY,
-        reinterpret_cast<void *>(kstack_mapping_->base()),
-#if __has_feature(safe_stack)
-        reinterpret_cast<void *>(unsafe_kstack_mapping_->base()),
-#else
-        nullptr,
-#endif
-        DEFAULT_STACK_SIZE, nullptr);
+        nullptr, nullptr, DEFAULT_STACK_SIZE, nullptr);
 
     if (!lkthread) {
         TRACEF("error creating thread\n");
@@ -248,6 +148,70 @@ void UserThread::get_name(char out_name[MX_MAX_NAME_LEN]) {
     memcpy(out_name, thread_.name, MX_MAX_NAME_LEN);
 }
 
+// The scheduler keeps affinity in an mp_cpu_mask_t, where 0 means any cpu.
+static_assert(SMP_MAX_CPUS <= sizeof(mp_cpu_mask_t) * 8, "cpu mask too small");
+
+static mp_cpu_mask_t to_cpu_mask(uint64_t mask) {
+    DEBUG_ASSERT((mask & ~JobDispatcher::kAllCpus) == 0);
+    return static_cast<mp_cpu_mask_t>(mask);
+}
+
+status_t UserThread::set_priority(int priority) {
+    canary_.Assert();
+
+    if (priority > process_->job()->max_priority())
+        return ERR_ACCESS_DENIED;
+
+    thread_set_priority_etc(&thread_, priority);
+    return NO_ERROR;
+}
+
+uint64_t UserThread::cpu_affinity() const {
+    uint32_t mask = thread_cpu_affinity(&thread_);
+    return mask ? mask : JobDispatcher::kAllCpus;
+}
+
+status_t UserThread::set_cpu_affinity(uint64_t mask) {
+    canary_.Assert();
+
+    if ((mask & ~JobDispatcher::kAllCpus) || (mask & mp_get_online_mask()) == 0)
+        return ERR_INVALID_ARGS;
+    if (mask & ~process_->job()->cpu_affinity())
+        return ERR_ACCESS_DENIED;
+
+    thread_set_cpu_affinity(&thread_, to_cpu_mask(mask));
+    return NO_ERROR;
+}
+
+void UserThread::ApplyJobLimits(uint64_t cpu_mask, int max_priority) {
+    canary_.Assert();
+
+    uint64_t mask = cpu_affinity() & cpu_mask;
+    if ((mask & mp_get_online_mask()) == 0)
+        mask = cpu_mask;
+    thread_set_cpu_affinity(&thread_, to_cpu_mask(mask));
+
+    if (priority() > max_priority)
+        thread_set_priority_etc(&thread_, max_priority);
+}
+
+void UserThread::GetThreadStats(mx_info_thread_stats_t* stats) const {
+    thread_sched_stats_t sched;
+    thread_get_sched_stats(&thread_, &sched);
+
+    stats->total_runtime = sched.runtime_ns;
+    stats->total_queue_time = sched.ready_wait_ns;
+    stats->context_switches = sched.context_switches;
+    stats->preemptions = sched.preemptions;
+}
+
+void AddThreadStats(mx_info_thread_stats_t* total, const mx_info_thread_stats_t& stats) {
+    total->total_runtime += stats.total_runtime;
+    total->total_queue_time += stats.total_queue_time;
+    total->context_switches += stats.context_switches;
+    total->preemptions += stats.preemptions;
+}
+
 // start a thread
 status_t UserThread::Start(uintptr_t entry, uintptr_t sp,
                            uintptr_t arg1, uintptr_t arg2,
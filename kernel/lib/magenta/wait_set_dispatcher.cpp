@@ -84,11 +84,16 @@ bool WaitSetDispatcher::Entry::IsTriggeredLocked() const {
 
 mx_signals_t WaitSetDispatcher::Entry::GetSignalsStateLocked() const {
     DEBUG_ASSERT(wait_set_->mutex_.IsHeld());
-    return signals_;
+    // We are only told about changes to |watched_signals_|, so |signals_| is
+    // stale for the rest; take those from the object as it is now.
+    if (!dispatcher_)
+        return signals_;
+    auto tracker = dispatcher_->get_state_tracker();
+    return (signals_ & watched_signals_) | (tracker->GetSignalsState() & ~watched_signals_);
 }
 
 WaitSetDispatcher::Entry::Entry(mx_signals_t watched_signals, uint64_t cookie)
-    : StateObserver(), watched_signals_(watched_signals), cookie_(cookie) {}
+    : StateObserver(watched_signals), watched_signals_(watched_signals), cookie_(cookie) {}
 
 bool WaitSetDispatcher::Entry::OnInitialize(mx_signals_t initial_state,
                                             const StateObserver::CountInfo* cinfo) {
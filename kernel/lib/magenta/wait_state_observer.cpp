@@ -26,6 +26,7 @@ mx_status_t WaitStateObserver::Begin(WaitEvent* event,
     event_ = event;
     handle_ = handle;
     watched_signals_ = watched_signals;
+    set_notify_mask(watched_signals);
     dispatcher_ = handle->dispatcher();
     wakeup_reasons_ = 0u;
 
@@ -43,8 +44,12 @@ mx_signals_t WaitStateObserver::End() {
 
     auto tracker = dispatcher_->get_state_tracker();
     DEBUG_ASSERT(tracker);
-    if (tracker)
+    if (tracker) {
+        // We are only told about changes to |watched_signals_|, so pick up
+        // whatever else is asserted now.
+        wakeup_reasons_ |= tracker->GetSignalsState();
         tracker->RemoveObserver(this);
+    }
     dispatcher_.reset();
 
     // Return the set of reasons that we may have been woken.  Basically, this
@@ -0,0 +1,82 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include "mtrace-sample.h"
+
+#include <kernel/thread.h>
+#include <kernel/vm.h>
+#include <magenta/mtrace.h>
+#include <unittest.h>
+
+namespace {
+
+constexpr size_t kBufferSize = 16 * PAGE_SIZE;
+constexpr lk_bigtime_t kPeriod = 10 * MTRACE_SAMPLE_MIN_PERIOD;
+
+// Samples cpu 0 for a while and checks what ends up in its buffer.
+bool sample_smoke_test(void*) {
+    BEGIN_TEST;
+
+    mxtl::RefPtr<VmObject> outputs[1];
+    outputs[0] = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, kBufferSize);
+    REQUIRE_NONNULL(outputs[0], "");
+
+    REQUIRE_EQ(NO_ERROR, mtrace_sample_start(kPeriod, 4, outputs, 1), "");
+    EXPECT_EQ(ERR_BAD_STATE, mtrace_sample_start(kPeriod, 4, outputs, 1),
+              "only one session at a time");
+    thread_sleep(LK_MSEC(20));
+    EXPECT_EQ(NO_ERROR, mtrace_sample_stop(), "");
+    EXPECT_EQ(ERR_BAD_STATE, mtrace_sample_stop(), "already stopped");
+
+    mx_sample_buffer_header_t header;
+    size_t actual;
+    REQUIRE_EQ(NO_ERROR, outputs[0]->Read(&header, 0, sizeof(header), &actual), "");
+    EXPECT_EQ(static_cast<uint32_t>(MX_SAMPLE_BUFFER_MAGIC), header.magic, "");
+    EXPECT_EQ(0u, header.cpu, "");
+    EXPECT_LT(0u, header.size, "no samples taken");
+    EXPECT_LE(header.size, kBufferSize - sizeof(header), "");
+
+    mx_sample_record_t record;
+    REQUIRE_EQ(NO_ERROR, outputs[0]->Read(&record, sizeof(header), sizeof(record), &actual), "");
+    EXPECT_LE(record.num_frames, 4u, "");
+    EXPECT_NEQ(0u, record.pc, "");
+
+    END_TEST;
+}
+
+// The caller can decommit or shrink its buffer while sampling is running;
+// that must not get in the way of the samples being taken, and a buffer
+// too small to hold them is reported when sampling stops.
+bool sample_output_changed_test(void*) {
+    BEGIN_TEST;
+
+    mxtl::RefPtr<VmObject> outputs[1];
+    outputs[0] = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, kBufferSize);
+    REQUIRE_NONNULL(outputs[0], "");
+    outputs[0]->CommitRange(0, kBufferSize, nullptr);
+
+    REQUIRE_EQ(NO_ERROR, mtrace_sample_start(kPeriod, 4, outputs, 1), "");
+    outputs[0]->DecommitRange(0, kBufferSize, nullptr);
+    EXPECT_EQ(NO_ERROR, outputs[0]->Resize(0), "");
+    thread_sleep(LK_MSEC(20));
+    EXPECT_NEQ(NO_ERROR, mtrace_sample_stop(), "");
+
+    // the sampler is left ready for another session
+    outputs[0] = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, kBufferSize);
+    REQUIRE_NONNULL(outputs[0], "");
+    EXPECT_EQ(NO_ERROR, mtrace_sample_start(kPeriod, 0, outputs, 1), "");
+    EXPECT_EQ(NO_ERROR, mtrace_sample_stop(), "");
+
+    END_TEST;
+}
+
+} // namespace
+
+UNITTEST_START_TESTCASE(mtrace_sample_tests)
+UNITTEST("Sample smoke test", sample_smoke_test)
+UNITTEST("Sample output changed", sample_output_changed_test)
+UNITTEST_END_TESTCASE(mtrace_sample_tests, "mtrace_sample", "Sampling profiler tests",
+                      nullptr, nullptr);
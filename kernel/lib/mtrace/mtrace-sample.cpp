@@ -0,0 +1,368 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+// Statistical sampling profiler.
+//
+// A periodic timer on each sampled cpu records where the interrupted code
+// was into a buffer owned and pinned by the kernel, which is copied into a
+// VMO supplied by the caller once sampling stops. The caller's VMO is never
+// touched from interrupt context, where it could have been decommitted or
+// shrunk underneath us. Kernel call chains are found by
+// following frame pointers on the interrupted thread's stack from the
+// timer interrupt. User call chains cannot be read there (the user stack
+// may not be paged in), so the sample is parked on the cpu and finished
+// off by mtrace_sample_user_callchain() on the way back to user mode.
+
+#include <assert.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include <arch/ops.h>
+#include <arch/user_copy.h>
+#include <kernel/mp.h>
+#include <kernel/mutex.h>
+#include <kernel/thread.h>
+#include <kernel/timer.h>
+#include <kernel/vm.h>
+#include <kernel/vm/vm_address_region.h>
+#include <kernel/vm/vm_aspace.h>
+#include <kernel/vm/vm_object.h>
+#include "lib/mtrace.h"
+#include "mtrace-sample.h"
+#include "trace.h"
+
+#include <magenta/mtrace.h>
+#include <magenta/process_dispatcher.h>
+#include <magenta/vm_object_dispatcher.h>
+
+#define LOCAL_TRACE 0
+
+namespace {
+
+// Buffers are mapped into the kernel for the whole session, so keep them to
+// a sane size.
+constexpr uint64_t kMaxBufferSize = 64 * 1024 * 1024;
+
+// Sampling state of one cpu. Only ever touched on its own cpu with
+// interrupts disabled, except by start and stop while the timer is off.
+struct cpu_sampler {
+    timer_t timer;
+    // Null when this cpu is not being sampled.
+    mx_sample_buffer_header_t* header;
+    uint8_t* records;
+    size_t used;
+    size_t capacity;
+
+    // A user mode sample waiting for its call chain.
+    bool pending;
+    mx_sample_record_t pending_record;
+    vaddr_t pending_fp;
+};
+
+cpu_sampler samplers[SMP_MAX_CPUS];
+
+// Settings of the current session, fixed while it runs.
+lk_bigtime_t sample_period;
+uint32_t sample_max_frames;
+
+Mutex sample_lock;
+bool sample_running TA_GUARDED(sample_lock);
+mp_cpu_mask_t sample_cpus TA_GUARDED(sample_lock);
+mxtl::RefPtr<VmMapping> sample_mappings[SMP_MAX_CPUS] TA_GUARDED(sample_lock);
+// Where each cpu's buffer is copied to when sampling stops.
+mxtl::RefPtr<VmObject> sample_outputs[SMP_MAX_CPUS] TA_GUARDED(sample_lock);
+
+// Appends a record to |s|'s buffer, or counts it as dropped if it is full.
+// Called with interrupts disabled.
+void write_record(cpu_sampler* s, const mx_sample_record_t* record, const uint64_t* frames) {
+    if (s->header == nullptr)
+        return;
+
+    size_t frames_len = record->num_frames * sizeof(uint64_t);
+    size_t len = sizeof(*record) + frames_len;
+    if (len > s->capacity - s->used) {
+        s->header->dropped++;
+        return;
+    }
+    uint8_t* p = s->records + s->used;
+    memcpy(p, record, sizeof(*record));
+    memcpy(p + sizeof(*record), frames, frames_len);
+    s->used += len;
+    s->header->size = s->used;
+}
+
+// Follows the frame pointer chain starting at |fp| within |t|'s kernel stack,
+// storing up to |max| return addresses in |frames|.
+uint32_t walk_kernel_stack(const thread_t* t, vaddr_t fp, uint64_t* frames, uint32_t max) {
+    vaddr_t stack_base = reinterpret_cast<vaddr_t>(t->stack);
+    vaddr_t stack_end = stack_base + t->stack_size;
+    uint32_t n = 0;
+    while (n < max && fp >= stack_base && fp + 2 * sizeof(vaddr_t) <= stack_end &&
+           IS_ALIGNED(fp, sizeof(vaddr_t))) {
+        const vaddr_t* frame = reinterpret_cast<const vaddr_t*>(fp);
+        if (frame[1] == 0)
+            break;
+        frames[n++] = frame[1];
+        // frames only ever get older going up the stack
+        if (frame[0] <= fp)
+            break;
+        fp = frame[0];
+    }
+    return n;
+}
+
+enum handler_return sample_tick(timer_t* timer, lk_bigtime_t now, void* arg) {
+    cpu_sampler* s = static_cast<cpu_sampler*>(arg);
+    arch_irq_context context;
+    if (s->header == nullptr || !arch_get_irq_context(&context))
+        return INT_NO_RESCHEDULE;
+
+    thread_t* t = get_current_thread();
+    mx_sample_record_t record = {};
+    record.time = now;
+    record.pid = t->user_pid;
+    record.tid = t->user_tid;
+    record.pc = context.pc;
+
+    if (context.user) {
+        record.flags = MX_SAMPLE_FLAG_USER;
+        if (sample_max_frames > 0 && context.fp != 0 && !s->pending) {
+            s->pending = true;
+            s->pending_record = record;
+            s->pending_fp = context.fp;
+            THREAD_LOCK(state);
+            t->signals |= THREAD_SIGNAL_SAMPLE;
+            THREAD_UNLOCK(state);
+            return INT_NO_RESCHEDULE;
+        }
+        write_record(s, &record, nullptr);
+        return INT_NO_RESCHEDULE;
+    }
+
+    uint64_t frames[MTRACE_SAMPLE_MAX_FRAMES];
+    record.num_frames = walk_kernel_stack(t, context.fp, frames, sample_max_frames);
+    write_record(s, &record, frames);
+    return INT_NO_RESCHEDULE;
+}
+
+void start_task(void* context) {
+    cpu_sampler* s = &samplers[arch_curr_cpu_num()];
+    if (s->header == nullptr)
+        return;
+    timer_initialize(&s->timer);
+    timer_set_periodic(&s->timer, sample_period, sample_tick, s);
+}
+
+void stop_task(void* context) {
+    cpu_sampler* s = &samplers[arch_curr_cpu_num()];
+    s->header = nullptr;
+    s->pending = false;
+}
+
+// Creates a kernel buffer for |cpu| the size of |output|, maps it into the
+// kernel and writes its header.
+status_t map_buffer(uint cpu, mxtl::RefPtr<VmObject> output) TA_REQ(sample_lock) {
+    uint64_t size = output->size();
+    if (size > kMaxBufferSize || !IS_PAGE_ALIGNED(size) ||
+        size < sizeof(mx_sample_buffer_header_t) + sizeof(mx_sample_record_t))
+        return ERR_INVALID_ARGS;
+
+    mxtl::RefPtr<VmObject> vmo = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, size);
+    if (!vmo)
+        return ERR_NO_MEMORY;
+
+    mxtl::RefPtr<VmMapping> mapping;
+    status_t status = VmAspace::kernel_aspace()->RootVmar()->CreateVmMapping(
+        0, size, 0, 0, mxtl::move(vmo), 0,
+        ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_WRITE, "sample_buffer", &mapping);
+    if (status != NO_ERROR)
+        return status;
+
+    // the buffer is written from interrupt context, so it must be present
+    status = mapping->MapRange(0, size, true);
+    if (status != NO_ERROR) {
+        mapping->Destroy();
+        return status;
+    }
+
+    cpu_sampler* s = &samplers[cpu];
+    s->header = reinterpret_cast<mx_sample_buffer_header_t*>(mapping->base());
+    s->header->magic = MX_SAMPLE_BUFFER_MAGIC;
+    s->header->cpu = cpu;
+    s->header->size = 0;
+    s->header->dropped = 0;
+    s->records = reinterpret_cast<uint8_t*>(s->header + 1);
+    s->used = 0;
+    s->capacity = size - sizeof(*s->header);
+    s->pending = false;
+    sample_mappings[cpu] = mxtl::move(mapping);
+    sample_outputs[cpu] = mxtl::move(output);
+    return NO_ERROR;
+}
+
+void unmap_buffers() TA_REQ(sample_lock) {
+    for (uint cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        samplers[cpu].header = nullptr;
+        if (sample_mappings[cpu]) {
+            sample_mappings[cpu]->Destroy();
+            sample_mappings[cpu].reset();
+        }
+        sample_outputs[cpu].reset();
+    }
+}
+
+// Copies the header and records of each cpu's buffer to its output VMO.
+// Returns the first error, having copied whatever else it could.
+status_t copy_out_buffers() TA_REQ(sample_lock) {
+    status_t result = NO_ERROR;
+    for (uint cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        if (!sample_mappings[cpu])
+            continue;
+        const void* buffer = reinterpret_cast<const void*>(sample_mappings[cpu]->base());
+        size_t len = sizeof(mx_sample_buffer_header_t) + samplers[cpu].used;
+        size_t written;
+        status_t status = sample_outputs[cpu]->Write(buffer, 0, len, &written);
+        if (status == NO_ERROR && written != len)
+            status = ERR_OUT_OF_RANGE;
+        if (status != NO_ERROR && result == NO_ERROR)
+            result = status;
+    }
+    return result;
+}
+
+status_t sample_start(void* arg, uint32_t size) {
+    mx_sample_config_t config;
+    if (size != sizeof(config))
+        return ERR_INVALID_ARGS;
+    if (arch_copy_from_user(&config, arg, size) != NO_ERROR)
+        return ERR_INVALID_ARGS;
+    if (config.period < MTRACE_SAMPLE_MIN_PERIOD ||
+        config.max_frames > MTRACE_SAMPLE_MAX_FRAMES ||
+        config.num_buffers == 0 || config.num_buffers > MTRACE_SAMPLE_MAX_CPUS)
+        return ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+    mxtl::RefPtr<VmObject> outputs[MTRACE_SAMPLE_MAX_CPUS];
+    for (uint cpu = 0; cpu < config.num_buffers; cpu++) {
+        if (config.buffers[cpu] == MX_HANDLE_INVALID)
+            continue;
+        mxtl::RefPtr<VmObjectDispatcher> vmo;
+        status_t status = up->GetDispatcherWithRights(config.buffers[cpu],
+                                                      MX_RIGHT_WRITE, &vmo);
+        if (status != NO_ERROR)
+            return status;
+        outputs[cpu] = vmo->vmo();
+    }
+    return mtrace_sample_start(config.period, config.max_frames, outputs, config.num_buffers);
+}
+
+} // namespace
+
+status_t mtrace_sample_start(lk_bigtime_t period, uint32_t max_frames,
+                             const mxtl::RefPtr<VmObject>* outputs, uint32_t num_outputs) {
+    AutoLock lock(&sample_lock);
+    if (sample_running)
+        return ERR_BAD_STATE;
+
+    mp_cpu_mask_t cpus = 0;
+    for (uint cpu = 0; cpu < num_outputs && cpu < arch_max_num_cpus(); cpu++) {
+        if (!outputs[cpu])
+            continue;
+        status_t status = map_buffer(cpu, outputs[cpu]);
+        if (status != NO_ERROR) {
+            unmap_buffers();
+            return status;
+        }
+        cpus |= 1u << cpu;
+    }
+    if (cpus == 0)
+        return ERR_INVALID_ARGS;
+
+    LTRACEF("cpus %#x period %" PRIu64 " max_frames %u\n", cpus, period, max_frames);
+
+    sample_period = period;
+    sample_max_frames = max_frames;
+    sample_cpus = cpus;
+    sample_running = true;
+    mp_sync_exec(cpus, start_task, nullptr);
+    return NO_ERROR;
+}
+
+status_t mtrace_sample_stop() {
+    AutoLock lock(&sample_lock);
+    if (!sample_running)
+        return ERR_BAD_STATE;
+
+    // Detach the buffers on each cpu first, so no interrupt or return to
+    // user mode can be writing to them once the timers are gone.
+    mp_sync_exec(sample_cpus, stop_task, nullptr);
+    for (uint cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        if (sample_cpus & (1u << cpu))
+            timer_cancel(&samplers[cpu].timer);
+    }
+    status_t status = copy_out_buffers();
+    unmap_buffers();
+    sample_cpus = 0;
+    sample_running = false;
+    return status;
+}
+
+void mtrace_sample_user_callchain(void) {
+    DEBUG_ASSERT(arch_ints_disabled());
+
+    cpu_sampler* s = &samplers[arch_curr_cpu_num()];
+    if (!s->pending)
+        return;
+    s->pending = false;
+    if (s->pending_record.tid != get_current_thread()->user_tid)
+        return;
+    mx_sample_record_t record = s->pending_record;
+    vaddr_t fp = s->pending_fp;
+    uint32_t max_frames = sample_max_frames;
+
+    // Reading user memory may fault, which needs interrupts on. We may move
+    // to another cpu meanwhile, which is fine: the record goes to the buffer
+    // of whichever cpu we end up on.
+    uint64_t frames[MTRACE_SAMPLE_MAX_FRAMES];
+    uint32_t n = 0;
+    arch_enable_ints();
+    while (n < max_frames && IS_ALIGNED(fp, sizeof(uint64_t)) &&
+           is_user_address_range(fp, 2 * sizeof(uint64_t))) {
+        uint64_t frame[2];
+        if (arch_copy_from_user(frame, reinterpret_cast<void*>(fp), sizeof(frame)) != NO_ERROR)
+            break;
+        if (frame[1] == 0)
+            break;
+        frames[n++] = frame[1];
+        if (frame[0] <= fp)
+            break;
+        fp = frame[0];
+    }
+    arch_disable_ints();
+
+    record.num_frames = n;
+    write_record(&samplers[arch_curr_cpu_num()], &record, frames);
+}
+
+status_t mtrace_sample_control(uint32_t action, uint32_t options,
+                               void* arg, uint32_t size) {
+    LTRACEF("action %u, options 0x%x, arg %p, size 0x%x\n",
+            action, options, arg, size);
+
+    if (options != 0)
+        return ERR_INVALID_ARGS;
+
+    switch (action) {
+    case MTRACE_SAMPLE_START:
+        return sample_start(arg, size);
+    case MTRACE_SAMPLE_STOP:
+        if (size != 0)
+            return ERR_INVALID_ARGS;
+        return mtrace_sample_stop();
+    default:
+        return ERR_INVALID_ARGS;
+    }
+}
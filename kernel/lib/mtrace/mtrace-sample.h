@@ -0,0 +1,21 @@
+// Copyright 2017 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <err.h>
+#include <kernel/vm/vm_object.h>
+#include <mxtl/ref_ptr.h>
+#include <stdint.h>
+
+// Starts sampling each cpu which has a non-null entry in |outputs| every
+// |period| nanoseconds, recording up to |max_frames| return addresses per
+// sample. Samples go to kernel buffers the size of the outputs.
+status_t mtrace_sample_start(lk_bigtime_t period, uint32_t max_frames,
+                             const mxtl::RefPtr<VmObject>* outputs, uint32_t num_outputs);
+
+// Stops sampling and copies each cpu's buffer to its output.
+status_t mtrace_sample_stop();
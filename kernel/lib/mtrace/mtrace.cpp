@@ -21,6 +21,8 @@
 status_t mtrace_control(uint32_t kind, uint32_t action, uint32_t options,
                         void* arg, uint32_t size) {
     switch (kind) {
+    case MTRACE_KIND_SAMPLE:
+        return mtrace_sample_control(action, options, arg, size);
 #ifdef __x86_64__
     case MTRACE_KIND_IPT:
         return mtrace_ipt_control(action, options, arg, size);
@@ -10,6 +10,10 @@ MODULE := $(LOCAL_DIR)
 
 MODULE_SRCS += \
 	$(LOCAL_DIR)/mtrace.cpp \
-	$(LOCAL_DIR)/mtrace-ipt.cpp
+	$(LOCAL_DIR)/mtrace-ipt.cpp \
+	$(LOCAL_DIR)/mtrace-sample.cpp \
+	$(LOCAL_DIR)/mtrace-sample-unittest.cpp
+
+MODULE_DEPS += kernel/lib/unittest
 
 include make/module.mk
@@ -20,6 +20,7 @@
 #include <lib/crypto/global_prng.h>
 #include <lib/user_copy.h>
 #include <lib/user_copy/user_ptr.h>
+#include <lib/vdso.h>
 
 #include <magenta/event_dispatcher.h>
 #include <magenta/event_pair_dispatcher.h>
@@ -57,8 +58,12 @@ mx_status_t sys_nanosleep(mx_time_t nanoseconds) {
 
 // This must be accessed atomically from any given thread.
 static mxtl::atomic<int64_t> utc_offset;
+// Serializes updates so the vDSO's copy of utc_offset matches ours.
+static Mutex utc_offset_mutex;
 
-uint64_t sys_time_get(uint32_t clock_id) {
+// mx_time_get is normally handled entirely in the vDSO; it only comes
+// here for clocks the vDSO cannot read itself.
+uint64_t sys_time_get_via_kernel(uint32_t clock_id) {
     switch (clock_id) {
     case MX_CLOCK_MONOTONIC:
         return current_time_hires();
@@ -82,9 +87,12 @@ mx_status_t sys_clock_adjust(mx_handle_t hrsrc, uint32_t clock_id, int64_t offse
     switch (clock_id) {
     case MX_CLOCK_MONOTONIC:
         return ERR_ACCESS_DENIED;
-    case MX_CLOCK_UTC:
+    case MX_CLOCK_UTC: {
+        AutoLock lock(&utc_offset_mutex);
         utc_offset.store(offset);
+        VDso::SetUtcOffset(offset);
         return NO_ERROR;
+    }
     default:
         return ERR_INVALID_ARGS;
     }
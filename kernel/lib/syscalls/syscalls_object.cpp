@@ -8,6 +8,9 @@
 #include <inttypes.h>
 #include <trace.h>
 
+#include <kernel/mp.h>
+#include <kernel/thread.h>
+
 #include <magenta/handle_owner.h>
 #include <magenta/job_dispatcher.h>
 #include <magenta/magenta.h>
@@ -22,6 +25,11 @@
 
 #define LOCAL_TRACE 0
 
+// User priorities map directly onto the kernel's, up to HIGH_PRIORITY.
+static_assert(MX_PRIORITY_DEFAULT == LOW_PRIORITY, "");
+static_assert(MX_PRIORITY_HIGHEST == HIGH_PRIORITY, "");
+static_assert(MX_PRIORITY_LOWEST > IDLE_PRIORITY, "");
+
 //TODO: accumulate batches and do fewer user copies
 class SimpleJobEnumerator : public JobEnumerator {
 public:
@@ -332,6 +340,90 @@ mx_status_t sys_object_get_info(mx_handle_t handle, uint32_t topic,
                 return ERR_BUFFER_TOO_SMALL;
             return NO_ERROR;
         }
+        case MX_INFO_THREAD_STATS: {
+            size_t actual =
+                (buffer_size < sizeof(mx_info_thread_stats_t)) ? 0 : 1;
+            size_t avail = 1;
+
+            // Threads report their own stats; processes and jobs the sum
+            // over every thread which ran in them.
+            mxtl::RefPtr<Dispatcher> dispatcher;
+            auto error = up->GetDispatcherWithRights(handle, MX_RIGHT_READ,
+                                                     &dispatcher);
+            if (error < 0)
+                return error;
+
+            if (actual > 0) {
+                mx_info_thread_stats_t info = {};
+
+                mx_status_t err;
+                if (auto thread = DownCastDispatcher<ThreadDispatcher>(&dispatcher)) {
+                    err = thread->GetStats(&info);
+                } else if (auto process = DownCastDispatcher<ProcessDispatcher>(&dispatcher)) {
+                    err = process->GetThreadStats(&info);
+                } else if (auto job = DownCastDispatcher<JobDispatcher>(&dispatcher)) {
+                    err = job->GetThreadStats(&info);
+                } else {
+                    return ERR_WRONG_TYPE;
+                }
+                if (err != NO_ERROR)
+                    return err;
+
+                if (_buffer.copy_array_to_user(&info, sizeof(info)) != NO_ERROR)
+                    return ERR_INVALID_ARGS;
+            }
+            if (_actual && (_actual.copy_to_user(actual) != NO_ERROR))
+                return ERR_INVALID_ARGS;
+            if (_avail && (_avail.copy_to_user(avail) != NO_ERROR))
+                return ERR_INVALID_ARGS;
+            if (actual == 0)
+                return ERR_BUFFER_TOO_SMALL;
+            return NO_ERROR;
+        }
+        case MX_INFO_CPU_STATS: {
+            mx_status_t status = validate_resource_handle(handle);
+            if (status < 0)
+                return status;
+
+            size_t avail = arch_max_num_cpus();
+            size_t actual = MIN(avail, buffer_size / sizeof(mx_info_cpu_stats_t));
+            auto stats = _buffer.reinterpret<mx_info_cpu_stats_t>();
+
+            for (size_t i = 0; i < actual; i++) {
+                struct thread_stats cpu_stats;
+                thread_get_cpu_stats(static_cast<uint>(i), &cpu_stats);
+
+                mx_info_cpu_stats_t info = {};
+                info.cpu_number = static_cast<uint32_t>(i);
+                info.flags = mp_is_cpu_online(static_cast<uint>(i))
+                                 ? MX_INFO_CPU_STATS_FLAG_ONLINE : 0;
+                info.idle_time = cpu_stats.idle_time;
+                info.reschedules = cpu_stats.reschedules;
+                info.context_switches = cpu_stats.context_switches;
+                info.irq_preempts = cpu_stats.irq_preempts;
+                info.preempts = cpu_stats.preempts;
+                info.yields = cpu_stats.yields;
+                info.ints = cpu_stats.interrupts;
+                info.timer_ints = cpu_stats.timer_ints;
+                info.timers = cpu_stats.timers;
+                info.exceptions = cpu_stats.exceptions;
+                info.syscalls = cpu_stats.syscalls;
+#if WITH_SMP
+                info.reschedule_ipis = cpu_stats.reschedule_ipis;
+                info.generic_ipis = cpu_stats.generic_ipis;
+#endif
+                if (stats.element_offset(i).copy_to_user(info) != NO_ERROR)
+                    return ERR_INVALID_ARGS;
+            }
+
+            if (_actual && (_actual.copy_to_user(actual) != NO_ERROR))
+                return ERR_INVALID_ARGS;
+            if (_avail && (_avail.copy_to_user(avail) != NO_ERROR))
+                return ERR_INVALID_ARGS;
+            if (actual < avail)
+                return ERR_BUFFER_TOO_SMALL;
+            return NO_ERROR;
+        }
         case MX_INFO_PROCESS_MAPS: {
             mxtl::RefPtr<ProcessDispatcher> process;
             mx_status_t status =
@@ -443,6 +535,54 @@ mx_status_t sys_object_get_property(mx_handle_t handle_value, uint32_t property,
                 return ERR_INVALID_ARGS;
             return NO_ERROR;
         }
+        case MX_PROP_TIMER_SLACK: {
+            if (size < sizeof(mx_time_t))
+                return ERR_BUFFER_TOO_SMALL;
+            auto thread = DownCastDispatcher<ThreadDispatcher>(&dispatcher);
+            if (!thread)
+                return ERR_WRONG_TYPE;
+            mx_time_t value = thread->thread()->timer_slack();
+            if (_value.reinterpret<mx_time_t>().copy_to_user(value) != NO_ERROR)
+                return ERR_INVALID_ARGS;
+            return NO_ERROR;
+        }
+        case MX_PROP_THREAD_PRIORITY: {
+            if (size < sizeof(int32_t))
+                return ERR_BUFFER_TOO_SMALL;
+            auto thread = DownCastDispatcher<ThreadDispatcher>(&dispatcher);
+            if (!thread)
+                return ERR_WRONG_TYPE;
+            int32_t value = thread->thread()->priority();
+            if (_value.reinterpret<int32_t>().copy_to_user(value) != NO_ERROR)
+                return ERR_INVALID_ARGS;
+            return NO_ERROR;
+        }
+        case MX_PROP_JOB_MAX_PRIORITY: {
+            if (size < sizeof(int32_t))
+                return ERR_BUFFER_TOO_SMALL;
+            auto job = DownCastDispatcher<JobDispatcher>(&dispatcher);
+            if (!job)
+                return ERR_WRONG_TYPE;
+            int32_t value = job->max_priority();
+            if (_value.reinterpret<int32_t>().copy_to_user(value) != NO_ERROR)
+                return ERR_INVALID_ARGS;
+            return NO_ERROR;
+        }
+        case MX_PROP_CPU_AFFINITY: {
+            if (size < sizeof(uint64_t))
+                return ERR_BUFFER_TOO_SMALL;
+            uint64_t value;
+            if (auto thread = DownCastDispatcher<ThreadDispatcher>(&dispatcher)) {
+                value = thread->thread()->cpu_affinity();
+            } else if (auto job = DownCastDispatcher<JobDispatcher>(&dispatcher)) {
+                value = job->cpu_affinity();
+            } else {
+                return ERR_WRONG_TYPE;
+            }
+            if (_value.reinterpret<uint64_t>().copy_to_user(value) != NO_ERROR)
+                return ERR_INVALID_ARGS;
+            return NO_ERROR;
+        }
         default:
             return ERR_INVALID_ARGS;
     }
@@ -518,6 +658,56 @@ mx_status_t sys_object_set_property(mx_handle_t handle_value, uint32_t property,
                 return ERR_INVALID_ARGS;
             return process->set_debug_addr(value);
         }
+        case MX_PROP_TIMER_SLACK: {
+            if (size < sizeof(mx_time_t))
+                return ERR_BUFFER_TOO_SMALL;
+            auto thread = DownCastDispatcher<ThreadDispatcher>(&dispatcher);
+            if (!thread)
+                return up->BadHandle(handle_value, ERR_WRONG_TYPE);
+            mx_time_t slack = 0;
+            if (_value.reinterpret<const mx_time_t>().copy_from_user(&slack) != NO_ERROR)
+                return ERR_INVALID_ARGS;
+            if (slack > MX_TIMER_SLACK_MAX)
+                return ERR_OUT_OF_RANGE;
+            thread->thread()->set_timer_slack(slack);
+            return NO_ERROR;
+        }
+        case MX_PROP_THREAD_PRIORITY: {
+            if (size < sizeof(int32_t))
+                return ERR_BUFFER_TOO_SMALL;
+            auto thread = DownCastDispatcher<ThreadDispatcher>(&dispatcher);
+            if (!thread)
+                return up->BadHandle(handle_value, ERR_WRONG_TYPE);
+            int32_t priority = 0;
+            if (_value.reinterpret<const int32_t>().copy_from_user(&priority) != NO_ERROR)
+                return ERR_INVALID_ARGS;
+            if (priority < MX_PRIORITY_LOWEST || priority > MX_PRIORITY_HIGHEST)
+                return ERR_OUT_OF_RANGE;
+            return thread->thread()->set_priority(priority);
+        }
+        case MX_PROP_JOB_MAX_PRIORITY: {
+            if (size < sizeof(int32_t))
+                return ERR_BUFFER_TOO_SMALL;
+            auto job = DownCastDispatcher<JobDispatcher>(&dispatcher);
+            if (!job)
+                return up->BadHandle(handle_value, ERR_WRONG_TYPE);
+            int32_t priority = 0;
+            if (_value.reinterpret<const int32_t>().copy_from_user(&priority) != NO_ERROR)
+                return ERR_INVALID_ARGS;
+            return job->set_max_priority(priority);
+        }
+        case MX_PROP_CPU_AFFINITY: {
+            if (size < sizeof(uint64_t))
+                return ERR_BUFFER_TOO_SMALL;
+            uint64_t mask = 0;
+            if (_value.reinterpret<const uint64_t>().copy_from_user(&mask) != NO_ERROR)
+                return ERR_INVALID_ARGS;
+            if (auto thread = DownCastDispatcher<ThreadDispatcher>(&dispatcher))
+                return thread->thread()->set_cpu_affinity(mask);
+            if (auto job = DownCastDispatcher<JobDispatcher>(&dispatcher))
+                return job->set_cpu_affinity(mask);
+            return up->BadHandle(handle_value, ERR_WRONG_TYPE);
+        }
     }
 
     return ERR_INVALID_ARGS;
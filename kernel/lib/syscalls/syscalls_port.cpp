@@ -23,6 +23,9 @@
 
 #define LOCAL_TRACE 0
 
+// Packets dequeued at a time by port_wait_many.
+constexpr uint32_t kPortWaitBatch = 16u;
+
 mx_status_t sys_port_create(uint32_t options, user_ptr<mx_handle_t> _out) {
     LTRACEF("options %u\n", options);
 
@@ -118,6 +121,44 @@ mx_status_t sys_port_wait2(mx_handle_t handle, mx_time_t timeout, user_ptr<void>
     return NO_ERROR;
 }
 
+mx_status_t sys_port_wait_many(mx_handle_t handle, mx_time_t timeout,
+                               user_ptr<mx_port_packet_t> _packets, user_ptr<uint32_t> _count) {
+    LTRACEF("handle %d\n", handle);
+
+    uint32_t count;
+    if (_count.copy_from_user(&count) != NO_ERROR)
+        return ERR_INVALID_ARGS;
+    if (count == 0u || !_packets)
+        return ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    mxtl::RefPtr<PortDispatcherV2> port;
+    mx_status_t status = up->GetDispatcherWithRights(handle, MX_RIGHT_WRITE, &port);
+    if (status != NO_ERROR)
+        return status;
+
+    // Only the first batch waits. The rest are taken while they keep coming,
+    // a batch at a time so they can go through the stack.
+    mx_port_packet_t pp[kPortWaitBatch];
+    uint32_t actual = 0u;
+    while (actual < count) {
+        uint32_t n = MIN(count - actual, kPortWaitBatch);
+        status = port->DeQueue(actual ? 0ull : timeout, pp, &n);
+        if (status != NO_ERROR)
+            break;
+        if (_packets.copy_array_to_user(pp, n, actual) != NO_ERROR)
+            return ERR_INVALID_ARGS;
+        actual += n;
+    }
+    if (actual == 0u)
+        return status;
+
+    if (_count.copy_to_user(actual) != NO_ERROR)
+        return ERR_INVALID_ARGS;
+    return NO_ERROR;
+}
+
 mx_status_t sys_port_wait(mx_handle_t handle, mx_time_t timeout,
                           user_ptr<void> _packet, size_t size) {
     LTRACEF("handle %d\n", handle);
@@ -29,9 +29,6 @@
 mx_status_t sys_socket_create(uint32_t options, user_ptr<mx_handle_t> _out0, user_ptr<mx_handle_t> _out1) {
     LTRACEF("entry out_handles %p, %p\n", _out0.get(), _out1.get());
 
-    if (options != 0u)
-        return ERR_INVALID_ARGS;
-
     mxtl::RefPtr<Dispatcher> socket0, socket1;
     mx_rights_t rights;
     status_t result = SocketDispatcher::Create(options, &socket0, &socket1, &rights);
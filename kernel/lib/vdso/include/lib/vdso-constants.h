@@ -14,6 +14,13 @@
 #include <stddef.h>
 #include <stdint.h>
 
+// Values for vdso_constants.user_clock: the counter, if any, that user
+// mode can read directly and convert to MX_CLOCK_MONOTONIC nanoseconds.
+#define VDSO_USER_CLOCK_NONE    0u  // mx_time_get must ask the kernel
+#define VDSO_USER_CLOCK_TSC     1u  // x86 rdtsc (invariant TSC only)
+#define VDSO_USER_CLOCK_CNTVCT  2u  // arm64 cntvct_el0
+#define VDSO_USER_CLOCK_CNTPCT  3u  // arm64 cntpct_el0
+
 // This struct contains constants that are initialized by the kernel
 // once at boot time.  From the vDSO code's perspective, they are
 // read-only data that can never change.  Hence, no synchronization is
@@ -32,4 +39,23 @@ struct vdso_constants {
 
     // Total amount of physical memory in the system, in bytes.
     uint64_t physmem;
+
+    // Which counter mx_time_get reads (VDSO_USER_CLOCK_*).
+    uint32_t user_clock;
+
+    // Nanoseconds per tick of user_clock, as a 32.64 fixed-point number
+    // with the same layout and rounding as the kernel's struct fp_32_64.
+    uint32_t ns_per_tick_l0;
+    uint32_t ns_per_tick_l32;
+    uint32_t ns_per_tick_l64;
+};
+
+// This struct contains values that the kernel updates while the system
+// runs.  Each member is naturally aligned and is written by the kernel
+// and read by the vDSO with single atomic accesses.
+struct vdso_time_values {
+
+    // Offset added to MX_CLOCK_MONOTONIC to yield MX_CLOCK_UTC.
+    // Set by mx_clock_adjust.
+    int64_t utc_offset;
 };
@@ -12,4 +12,8 @@
 class VDso : public RoDso {
 public:
     VDso();
+
+    // Update the MX_CLOCK_UTC offset that the vDSO's mx_time_get adds
+    // to the monotonic time.
+    static void SetUtcOffset(int64_t offset);
 };
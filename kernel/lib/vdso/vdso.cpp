@@ -11,7 +11,9 @@
 #include <kernel/vm.h>
 #include <kernel/vm/vm_aspace.h>
 #include <kernel/vm/vm_object.h>
+#include <lib/fixed_point.h>
 #include <mxtl/type_support.h>
+#include <new.h>
 #include <platform.h>
 
 #include "vdso-code.h"
@@ -95,6 +97,23 @@ private:
     KernelVmoWindow<VDsoDynSym> window_;
 };
 
+// The window onto the vdso_time_values struct stays mapped for the
+// life of the system, so that the kernel can update it in place.
+KernelVmoWindow<vdso_time_values>* time_values_window;
+
+uint32_t vdso_user_clock(platform_user_clock clock) {
+    switch (clock) {
+    case PLATFORM_USER_CLOCK_TSC:
+        return VDSO_USER_CLOCK_TSC;
+    case PLATFORM_USER_CLOCK_CNTVCT:
+        return VDSO_USER_CLOCK_CNTVCT;
+    case PLATFORM_USER_CLOCK_CNTPCT:
+        return VDSO_USER_CLOCK_CNTPCT;
+    default:
+        return VDSO_USER_CLOCK_NONE;
+    }
+}
+
 #define REDIRECT_SYSCALL(dynsym_window, symbol, target)         \
     do {                                                        \
         dynsym_window.set_symbol(symbol, target);               \
@@ -111,6 +130,13 @@ VDso::VDso() : RoDso("vdso", vdso_image, VDSO_CODE_END, VDSO_CODE_START) {
         "vDSO constants", vmo()->vmo(), VDSO_DATA_CONSTANTS);
     uint64_t per_second = ticks_per_second();
 
+    // If the kernel's monotonic clock is a counter that user mode can
+    // read, mx_time_get does the same scaling itself without a syscall.
+    struct fp_32_64 ns_per_tick = {};
+    uint32_t user_clock = VDSO_USER_CLOCK_NONE;
+    if (!cmdline_get_bool("vdso.kernel_time", false))
+        user_clock = vdso_user_clock(platform_get_user_clock(&ns_per_tick));
+
     // Initialize the constants that should be visible to the vDSO.
     // Rather than assigning each member individually, do this with
     // struct assignment and a compound literal so that the compiler
@@ -120,6 +146,21 @@ VDso::VDso() : RoDso("vdso", vdso_image, VDSO_CODE_END, VDSO_CODE_START) {
         arch_dcache_line_size(),
         per_second,
         pmm_count_total_bytes(),
+        user_clock,
+        ns_per_tick.l0,
+        ns_per_tick.l32,
+        ns_per_tick.l64,
+    };
+
+    static_assert(sizeof(vdso_time_values) == VDSO_DATA_TIME_VALUES_SIZE,
+                  "gen-rodso-code.sh is suspect");
+    DEBUG_ASSERT(time_values_window == nullptr);
+    AllocChecker ac;
+    time_values_window = new (&ac) KernelVmoWindow<vdso_time_values>(
+        "vDSO time values", vmo()->vmo(), VDSO_DATA_TIME_VALUES);
+    ASSERT(ac.check());
+    *time_values_window->data() = (vdso_time_values) {
+        0,
     };
 
     // If ticks_per_second has not been calibrated, it will return 0. In this
@@ -133,3 +174,10 @@ VDso::VDso() : RoDso("vdso", vdso_image, VDSO_CODE_END, VDSO_CODE_START) {
         REDIRECT_SYSCALL(dynsym_window, mx_ticks_get, soft_ticks_get);
     }
 }
+
+void VDso::SetUtcOffset(int64_t offset) {
+    if (time_values_window != nullptr) {
+        __atomic_store_n(&time_values_window->data()->utc_offset, offset,
+                         __ATOMIC_RELAXED);
+    }
+}
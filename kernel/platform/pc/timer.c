@@ -164,6 +164,16 @@ uint64_t ticks_per_second(void)
     return tsc_ticks_per_ms * 1000;
 }
 
+platform_user_clock platform_get_user_clock(struct fp_32_64* ns_per_tick)
+{
+    // The TSC is only used as the wall clock when it is invariant, so
+    // every CPU's rdtsc agrees with current_time_hires().
+    if (wall_clock != CLOCK_TSC)
+        return PLATFORM_USER_CLOCK_NONE;
+    *ns_per_tick = ns_per_tsc;
+    return PLATFORM_USER_CLOCK_TSC;
+}
+
 // The PIT timer will keep track of wall time if we aren't using the TSC
 static enum handler_return pit_timer_tick(void *arg)
 {
@@ -6,7 +6,12 @@
 #include <ddk/driver.h>
 #include <ddk/binding.h>
 
+#include <magenta/listnode.h>
+
 #include <stdio.h>
+#include <stdlib.h>
+
+#include "devhost.h"
 
 typedef struct {
     const mx_device_prop_t* props;
@@ -148,3 +153,415 @@ bool devhost_is_bindable_drv(mx_driver_t* drv, mx_device_t* dev, bool autobind)
     return is_bindable(&ctx);
 }
 
+
+// Binding program index
+//
+// Walking every driver's binding program for every new device makes
+// enumeration O(devices x drivers).  When a driver is added, we instead
+// work out which values of BIND_PROTOCOL its program could possibly
+// match and file it under those protocol ids, so probing a device only
+// visits drivers for its protocol (plus the few drivers whose programs
+// could match any protocol).  For programs that also pin down a vendor
+// id (pci or usb), the set of possible vendors is recorded too and is
+// checked before the program is interpreted.
+//
+// The analysis explores every path through the program, treating the
+// property under test as known and any other property as unknown.
+// Programs too complex to analyze are conservatively treated as
+// matching anything.
+
+#define BIND_MAX_KEYS 16
+#define BIND_MAX_STEPS 4096
+#define BIND_INDEX_BUCKETS 64
+
+typedef struct bind_rec {
+    mx_driver_t* drv;
+    uint32_t seq;
+
+    // if vid_prop is nonzero, the driver can only match devices
+    // whose vid_prop property is one of vids[]
+    uint32_t vid_prop;
+    uint32_t vid_count;
+    uint32_t vids[BIND_MAX_KEYS];
+} bind_rec_t;
+
+typedef struct bind_entry {
+    list_node_t node;
+    uint32_t protocol_id;
+    bind_rec_t* rec;
+} bind_entry_t;
+
+// entries by protocol id, and entries for drivers that may match any protocol
+static list_node_t bind_index[BIND_INDEX_BUCKETS];
+static list_node_t bind_generic = LIST_INITIAL_VALUE(bind_generic);
+static uint32_t bind_next_seq;
+
+// what the analysis assumes about a property
+typedef struct {
+    uint32_t id;
+    bool wildcard;   // not equal to any value the program tests for
+    uint32_t value;
+} bind_assumption_t;
+
+typedef struct {
+    uint32_t ip;
+    uint32_t flags;
+} bind_state_t;
+
+// evaluates an instruction's condition if it can be decided
+// returns false if it depends on an unknown property
+static bool bind_eval_cond(uint32_t inst, uint32_t value, uint32_t flags,
+                           const bind_assumption_t* assume, size_t count, bool* cond) {
+    uint32_t cc = BINDINST_CC(inst);
+    uint32_t pid = BINDINST_PB(inst);
+    uint32_t pval;
+
+    if (cc == COND_AL) {
+        *cond = true;
+        return true;
+    }
+    if (pid == BIND_FLAGS) {
+        pval = flags;
+    } else {
+        const bind_assumption_t* a = NULL;
+        for (size_t n = 0; n < count; n++) {
+            if (assume[n].id == pid) {
+                a = &assume[n];
+                break;
+            }
+        }
+        if (a == NULL) {
+            return false;
+        }
+        if (a->wildcard) {
+            if (cc == COND_EQ) {
+                *cond = false;
+                return true;
+            }
+            if (cc == COND_NE) {
+                *cond = true;
+                return true;
+            }
+            return false;
+        }
+        pval = a->value;
+    }
+
+    switch (cc) {
+    case COND_EQ: *cond = (pval == value); break;
+    case COND_NE: *cond = (pval != value); break;
+    case COND_LT: *cond = (pval < value); break;
+    case COND_GT: *cond = (pval > value); break;
+    case COND_LE: *cond = (pval <= value); break;
+    case COND_GE: *cond = (pval >= value); break;
+    case COND_MASK: *cond = ((pval & value) != 0); break;
+    case COND_BITS: *cond = ((pval & value) == value); break;
+    default:
+        // illegal instructions are treated as unknown,
+        // the interpreter will report them at probe time
+        return false;
+    }
+    return true;
+}
+
+// returns true if some path through the driver's binding program
+// may reach a MATCH under the given assumptions
+static bool bind_may_match(mx_driver_t* drv, const bind_assumption_t* assume, size_t count) {
+    const mx_bind_inst_t* prog = drv->binding;
+    size_t len = drv->binding_size / sizeof(mx_bind_inst_t);
+    bind_state_t stack[64];
+    size_t sp = 0;
+    uint32_t steps = 0;
+
+    stack[sp++] = (bind_state_t){ 0, 0 };
+    while (sp > 0) {
+        bind_state_t st = stack[--sp];
+        while (st.ip < len) {
+            if (++steps > BIND_MAX_STEPS) {
+                return true;
+            }
+            const mx_bind_inst_t* ip = prog + st.ip;
+            uint32_t inst = ip->op;
+            bool cond;
+            bool known = bind_eval_cond(inst, ip->arg, st.flags, assume, count, &cond);
+
+            if (!known) {
+                // explore the path where the condition is false later
+                if (sp == countof(stack)) {
+                    return true;
+                }
+                stack[sp++] = (bind_state_t){ st.ip + 1, st.flags };
+                cond = true;
+            }
+            if (!cond) {
+                st.ip++;
+                continue;
+            }
+
+            switch (BINDINST_OP(inst)) {
+            case OP_ABORT:
+                goto next_path;
+            case OP_MATCH:
+                return true;
+            case OP_GOTO: {
+                uint32_t label = BINDINST_PA(inst);
+                uint32_t n = st.ip;
+                while (++n < len) {
+                    if ((BINDINST_OP(prog[n].op) == OP_LABEL) &&
+                        (BINDINST_PA(prog[n].op) == label)) {
+                        break;
+                    }
+                }
+                st.ip = n + 1;
+                break;
+            }
+            case OP_SET:
+                st.flags |= BINDINST_PA(inst);
+                st.ip++;
+                break;
+            case OP_CLEAR:
+                st.flags &= ~(BINDINST_PA(inst));
+                st.ip++;
+                break;
+            case OP_LABEL:
+                st.ip++;
+                break;
+            default:
+                goto next_path;
+            }
+        }
+next_path:
+        ;
+    }
+    return false;
+}
+
+// collects the distinct values a program compares a property against
+// returns false if there are too many to index
+static bool bind_collect_keys(mx_driver_t* drv, uint32_t pid, uint32_t* keys, uint32_t* count) {
+    const mx_bind_inst_t* ip = drv->binding;
+    const mx_bind_inst_t* end = ip + (drv->binding_size / sizeof(mx_bind_inst_t));
+
+    *count = 0;
+    for (; ip < end; ip++) {
+        if ((BINDINST_CC(ip->op) == COND_AL) || (BINDINST_PB(ip->op) != pid)) {
+            continue;
+        }
+        uint32_t n;
+        for (n = 0; n < *count; n++) {
+            if (keys[n] == ip->arg) {
+                break;
+            }
+        }
+        if (n < *count) {
+            continue;
+        }
+        if (*count == BIND_MAX_KEYS) {
+            return false;
+        }
+        keys[(*count)++] = ip->arg;
+    }
+    return true;
+}
+
+// work out which vendor ids, if any, a driver is restricted to
+// when matching the given protocols
+static void bind_compile_vendor(bind_rec_t* rec, const uint32_t* protos, uint32_t proto_count) {
+    static const uint32_t vid_props[] = { BIND_PCI_VID, BIND_USB_VID };
+
+    for (size_t v = 0; v < countof(vid_props); v++) {
+        uint32_t vids[BIND_MAX_KEYS];
+        uint32_t vid_count;
+        if (!bind_collect_keys(rec->drv, vid_props[v], vids, &vid_count) || (vid_count == 0)) {
+            continue;
+        }
+
+        bind_assumption_t assume[2];
+        assume[0].id = BIND_PROTOCOL;
+        assume[0].wildcard = false;
+        assume[1].id = vid_props[v];
+
+        // any vendor allowed for one of the protocols means no filter
+        assume[1].wildcard = true;
+        bool filter = true;
+        for (uint32_t p = 0; p < proto_count; p++) {
+            assume[0].value = protos[p];
+            if (bind_may_match(rec->drv, assume, 2)) {
+                filter = false;
+                break;
+            }
+        }
+        if (!filter) {
+            continue;
+        }
+
+        assume[1].wildcard = false;
+        rec->vid_count = 0;
+        for (uint32_t n = 0; n < vid_count; n++) {
+            assume[1].value = vids[n];
+            for (uint32_t p = 0; p < proto_count; p++) {
+                assume[0].value = protos[p];
+                if (bind_may_match(rec->drv, assume, 2)) {
+                    rec->vids[rec->vid_count++] = vids[n];
+                    break;
+                }
+            }
+        }
+        rec->vid_prop = vid_props[v];
+        return;
+    }
+}
+
+static list_node_t* bind_bucket(uint32_t protocol_id) {
+    return &bind_index[(protocol_id ^ (protocol_id >> 16)) % BIND_INDEX_BUCKETS];
+}
+
+static bind_entry_t* bind_new_entry(bind_rec_t* rec, uint32_t protocol_id) {
+    bind_entry_t* e;
+    if ((e = malloc(sizeof(bind_entry_t))) == NULL) {
+        return NULL;
+    }
+    e->protocol_id = protocol_id;
+    e->rec = rec;
+    return e;
+}
+
+static mx_status_t bind_add_generic(bind_rec_t* rec) {
+    bind_entry_t* e;
+    if ((e = bind_new_entry(rec, 0)) == NULL) {
+        printf("devhost: out of memory indexing driver '%s'\n", rec->drv->name);
+        free(rec);
+        return ERR_NO_MEMORY;
+    }
+    list_add_tail(&bind_generic, &e->node);
+    return NO_ERROR;
+}
+
+mx_status_t devhost_bind_index_add(mx_driver_t* drv) {
+    static bool initialized = false;
+    if (!initialized) {
+        for (size_t n = 0; n < BIND_INDEX_BUCKETS; n++) {
+            list_initialize(&bind_index[n]);
+        }
+        initialized = true;
+    }
+
+    bind_rec_t* rec;
+    if ((rec = calloc(1, sizeof(bind_rec_t))) == NULL) {
+        printf("devhost: out of memory indexing driver '%s'\n", drv->name);
+        return ERR_NO_MEMORY;
+    }
+    rec->drv = drv;
+    rec->seq = bind_next_seq++;
+
+    uint32_t protos[BIND_MAX_KEYS];
+    uint32_t proto_count;
+    bind_assumption_t assume = { .id = BIND_PROTOCOL, .wildcard = true };
+    if (!bind_collect_keys(drv, BIND_PROTOCOL, protos, &proto_count) ||
+        bind_may_match(drv, &assume, 1)) {
+        return bind_add_generic(rec);
+    }
+
+    // keep only the protocols the program can actually match
+    uint32_t count = 0;
+    assume.wildcard = false;
+    for (uint32_t n = 0; n < proto_count; n++) {
+        assume.value = protos[n];
+        if (bind_may_match(drv, &assume, 1)) {
+            protos[count++] = protos[n];
+        }
+    }
+    bind_compile_vendor(rec, protos, count);
+
+    if (count == 0) {
+        // this driver only binds on request (by name)
+        free(rec);
+        return NO_ERROR;
+    }
+
+    // allocate every entry before publishing any, so that a driver
+    // is never left filed under only some of its protocols
+    bind_entry_t* entries[BIND_MAX_KEYS];
+    for (uint32_t n = 0; n < count; n++) {
+        if ((entries[n] = bind_new_entry(rec, protos[n])) == NULL) {
+            while (n > 0) {
+                free(entries[--n]);
+            }
+            // fall back to probing this driver against everything
+            return bind_add_generic(rec);
+        }
+    }
+    for (uint32_t n = 0; n < count; n++) {
+        list_add_tail(bind_bucket(protos[n]), &entries[n]->node);
+    }
+    return NO_ERROR;
+}
+
+static bool bind_rec_may_match(bind_rec_t* rec, bpctx_t* ctx) {
+    if (rec->vid_prop == 0) {
+        return true;
+    }
+    uint32_t vid = dev_get_prop(ctx, rec->vid_prop);
+    for (uint32_t n = 0; n < rec->vid_count; n++) {
+        if (rec->vids[n] == vid) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bind_entry_t* bind_next_keyed(list_node_t* list, list_node_t* node, uint32_t protocol_id) {
+    while ((node = list_next(list, node)) != NULL) {
+        bind_entry_t* e = containerof(node, bind_entry_t, node);
+        if (e->protocol_id == protocol_id) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static bind_entry_t* bind_next_generic(list_node_t* node) {
+    node = list_next(&bind_generic, node);
+    return node ? containerof(node, bind_entry_t, node) : NULL;
+}
+
+void devhost_bind_index_foreach(mx_device_t* dev, bool (*func)(mx_driver_t* drv, void* cookie),
+                                void* cookie) {
+    bpctx_t ctx;
+    ctx.props = dev->props;
+    ctx.end = dev->props + dev->prop_count;
+    ctx.protocol_id = dev->protocol_id;
+    ctx.autobind = 1;
+
+    uint32_t protocol_id = dev_get_prop(&ctx, BIND_PROTOCOL);
+    list_node_t* keyed = bind_bucket(protocol_id);
+    if (keyed->next == NULL) {
+        // no drivers added yet
+        return;
+    }
+
+    // visit the matching protocol's drivers and the generic drivers
+    // in the order the drivers were added
+    bind_entry_t* k = bind_next_keyed(keyed, keyed, protocol_id);
+    bind_entry_t* g = bind_next_generic(&bind_generic);
+    while ((k != NULL) || (g != NULL)) {
+        bind_entry_t* e;
+        if ((g == NULL) || ((k != NULL) && (k->rec->seq < g->rec->seq))) {
+            e = k;
+        } else {
+            e = g;
+        }
+
+        if (bind_rec_may_match(e->rec, &ctx) && func(e->rec->drv, cookie)) {
+            break;
+        }
+
+        // the callback may drop the devhost lock, but entries are
+        // only ever appended so our position remains valid
+        if (e == k) {
+            k = bind_next_keyed(keyed, &k->node, protocol_id);
+        } else {
+            g = bind_next_generic(&g->node);
+        }
+    }
+}
@@ -202,26 +202,153 @@ static mx_status_t devhost_device_probe(mx_device_t* dev, mx_driver_t* drv, bool
     return NO_ERROR;
 }
 
+typedef struct {
+    mx_device_t* dev;
+    bool autobind;
+} probe_args_t;
+
+static bool devhost_device_probe_one(mx_driver_t* drv, void* cookie) {
+    probe_args_t* args = cookie;
+    if (devhost_device_probe(args->dev, drv, args->autobind) == NO_ERROR) {
+        // if the probe succeeded and we are not a multi-bind
+        // device, we can stop looking for further matches now
+        if (!(args->dev->flags & DEV_FLAG_MULTI_BIND)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Drivers are tried against a device by one thread at a time, as the
+// bind() ops run without the devhost lock held and may be probing the
+// same device from a probe thread, a bind request and a driver being added.
+static cnd_t probe_done_cnd;
+static once_flag probe_once = ONCE_FLAG_INIT;
+
+static void devhost_probe_init(void) {
+    cnd_init(&probe_done_cnd);
+}
+
+static void devhost_device_probe_begin(mx_device_t* dev) {
+    call_once(&probe_once, devhost_probe_init);
+    while (dev->flags & DEV_FLAG_PROBING) {
+        cnd_wait(&probe_done_cnd, &__devhost_api_lock);
+    }
+    dev->flags |= DEV_FLAG_PROBING;
+}
+
+static void devhost_device_probe_end(mx_device_t* dev) {
+    dev->flags &= ~DEV_FLAG_PROBING;
+    cnd_broadcast(&probe_done_cnd);
+}
+
 static void devhost_device_probe_all(mx_device_t* dev, bool autobind) {
     if ((dev->flags & DEV_FLAG_UNBINDABLE) || device_is_bound(dev)) {
         return;
     }
 
-    mx_driver_t* drv = NULL;
-    list_for_every_entry (&driver_list, drv, mx_driver_t, node) {
-        if (devhost_device_probe(dev, drv, autobind) == NO_ERROR) {
-            // if the probe succeeded and we are not a multi-bind
-            // device, we can stop looking for further matches now
-            if (!(dev->flags & DEV_FLAG_MULTI_BIND)) {
+    devhost_device_probe_begin(dev);
+
+    // if the device is still waiting for a probe thread, it is probed now
+    if (dev->flags & DEV_FLAG_QUEUED) {
+        list_delete(&dev->unode);
+        dev->flags &= ~DEV_FLAG_QUEUED;
+    }
+
+    if (!device_is_bound(dev) && !(dev->flags & DEV_FLAG_DEAD)) {
+        // The device goes on the unmatched list before any bind() runs, so
+        // a driver added meanwhile is tried against it too, once we are done.
+        // A successful probe takes it off again.
+        if (!list_in_list(&dev->unode)) {
+            list_add_tail(&unmatched_device_list, &dev->unode);
+        }
+
+        // only drivers whose binding programs can match this
+        // device's protocol (and vendor) are considered
+        probe_args_t args = {
+            .dev = dev,
+            .autobind = autobind,
+        };
+        devhost_bind_index_foreach(dev, devhost_device_probe_one, &args);
+    }
+
+    devhost_device_probe_end(dev);
+}
+
+// Parallel probing
+//
+// Newly added devices are handed to a small pool of probe threads rather
+// than being probed by the thread that added them, so binding of
+// independent subtrees (eg, the children of different bus devices)
+// proceeds concurrently.  Drivers' bind() ops run without the devhost
+// lock held, which is what lets them overlap; binds against any one
+// device are still serialized.  Queued devices sit on the probe list via
+// their unode, marked DEV_FLAG_QUEUED, and may be removed or probed in-line
+// before a probe thread gets to them.  Setting devhost.probe.serial
+// restores in-line probing.
+
+#define PROBE_THREADS_MAX 4
+
+static struct list_node probe_list = LIST_INITIAL_VALUE(probe_list);
+static cnd_t probe_cnd;
+static uint32_t probe_threads;
+static bool probe_serial;
+
+static int devhost_probe_thread(void* arg) {
+    DM_LOCK();
+    for (;;) {
+        mx_device_t* dev = list_remove_head_type(&probe_list, mx_device_t, unode);
+        if (dev == NULL) {
+            cnd_wait(&probe_cnd, &__devhost_api_lock);
+            continue;
+        }
+        dev->flags &= ~DEV_FLAG_QUEUED;
+        if (dev->flags & DEV_FLAG_DEAD) {
+            continue;
+        }
+
+        // same protection against removal that devhost_device_add()
+        // would have provided had we probed in-line
+        dev->flags |= DEV_FLAG_BUSY;
+        dev_ref_acquire(dev);
+        devhost_device_probe_all(dev, true);
+        dev->flags &= (~DEV_FLAG_BUSY);
+        dev_ref_release(dev);
+    }
+    DM_UNLOCK();
+    return 0;
+}
+
+static bool devhost_device_probe_async(mx_device_t* dev) {
+    if (probe_threads == 0) {
+        if (probe_serial || (getenv("devhost.probe.serial") != NULL)) {
+            probe_serial = true;
+            return false;
+        }
+        uint32_t count = mx_system_get_num_cpus();
+        if (count > PROBE_THREADS_MAX) {
+            count = PROBE_THREADS_MAX;
+        }
+        cnd_init(&probe_cnd);
+        for (uint32_t n = 0; n < count; n++) {
+            thrd_t t;
+            if (thrd_create_with_name(&t, devhost_probe_thread, NULL, "devhost-probe") != thrd_success) {
                 break;
             }
+            thrd_detach(t);
+            probe_threads++;
+        }
+        if (probe_threads == 0) {
+            printf("devhost: cannot start probe threads, probing serially\n");
+            probe_serial = true;
+            return false;
         }
     }
 
-    // if no driver is bound, add the device to the unmatched list
-    if (!device_is_bound(dev)) {
-        list_add_tail(&unmatched_device_list, &dev->unode);
-    }
+    dev->flags |= DEV_FLAG_QUEUED;
+    list_add_tail(&probe_list, &dev->unode);
+    cnd_signal(&probe_cnd);
+    return true;
 }
 
 void devhost_device_init(mx_device_t* dev, mx_driver_t* driver,
@@ -389,8 +516,11 @@ mx_status_t devhost_device_add(mx_device_t* dev, mx_device_t* parent) {
         }
     }
 
-    // probe the device
-    devhost_device_probe_all(dev, true);
+    // probe the device, on a probe thread if possible
+    if ((dev->flags & (DEV_FLAG_INSTANCE | DEV_FLAG_UNBINDABLE)) ||
+        !devhost_device_probe_async(dev)) {
+        devhost_device_probe_all(dev, true);
+    }
 
     dev->flags &= (~DEV_FLAG_BUSY);
     return NO_ERROR;
@@ -495,8 +625,12 @@ mx_status_t devhost_device_bind(mx_device_t* dev, const char* drv_name) {
         devhost_device_probe_all(dev, false);
     } else {
         // bind the driver with matching name
+        devhost_device_probe_begin(dev);
         mx_driver_t* drv = NULL;
         list_for_every_entry (&driver_list, drv, mx_driver_t, node) {
+            if (device_is_bound(dev)) {
+                break;
+            }
             if (strcmp(drv->name, drv_name)) {
                 continue;
             }
@@ -504,6 +638,7 @@ mx_status_t devhost_device_bind(mx_device_t* dev, const char* drv_name) {
                 break;
             }
         }
+        devhost_device_probe_end(dev);
     }
     dev->flags &= ~DEV_FLAG_BUSY;
     return NO_ERROR;
@@ -576,15 +711,44 @@ mx_status_t devhost_device_close(mx_device_t* dev, uint32_t flags) {
 mx_status_t devhost_driver_add(mx_driver_t* drv) {
     xprintf("driver add: %p(%s)\n", drv, drv->name);
 
-    // add the driver to the driver list
+    // the unmatched device list changes whenever the lock is dropped, so
+    // probing works from a copy of it, made before the driver is added so
+    // that running out of memory leaves no trace of the driver
+    size_t count = list_length(&unmatched_device_list);
+    mx_device_t** devs = NULL;
+    if ((count > 0) && ((devs = malloc(count * sizeof(mx_device_t*))) == NULL)) {
+        return ERR_NO_MEMORY;
+    }
+
+    // add the driver to the binding index and driver list
+    mx_status_t status;
+    if ((status = devhost_bind_index_add(drv)) < 0) {
+        free(devs);
+        return status;
+    }
     list_add_tail(&driver_list, &drv->node);
 
     // probe unmatched devices with the driver and initialize if the probe is successful
+    if (count == 0) {
+        return NO_ERROR;
+    }
+    size_t n = 0;
     mx_device_t* dev = NULL;
-    mx_device_t* temp = NULL;
-    list_for_every_entry_safe (&unmatched_device_list, dev, temp, mx_device_t, unode) {
-        devhost_device_probe(dev, drv, true);
+    list_for_every_entry (&unmatched_device_list, dev, mx_device_t, unode) {
+        dev_ref_acquire(dev);
+        devs[n++] = dev;
+    }
+    for (n = 0; n < count; n++) {
+        dev = devs[n];
+        // wait out any probe of the device that is in progress
+        devhost_device_probe_begin(dev);
+        if (!device_is_bound(dev) && !(dev->flags & DEV_FLAG_DEAD)) {
+            devhost_device_probe(dev, drv, true);
+        }
+        devhost_device_probe_end(dev);
+        dev_ref_release(dev);
     }
+    free(devs);
     return NO_ERROR;
 }
 
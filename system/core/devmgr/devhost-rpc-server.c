@@ -437,6 +437,11 @@ static mx_status_t _devhost_rio_handler(mxrio_msg_t* msg, mx_handle_t rh,
         }
         return r;
     }
+    case MXRIO_READ_VMO:
+    case MXRIO_WRITE_VMO:
+        // devices are read and written a chunk at a time
+        mx_handle_close(msg->handle[0]);
+        return ERR_MXRIO_NO_VMO_XFER;
     default:
         // close inbound handles so they do not leak
         for (unsigned i = 0; i < MXRIO_HC(msg->op); i++) {
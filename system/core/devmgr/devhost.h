@@ -55,6 +55,15 @@ mx_status_t devhost_device_close(mx_device_t* dev, uint32_t flags);
 
 bool devhost_is_bindable_drv(mx_driver_t* drv, mx_device_t* dev, bool autobind);
 
+// compile a driver's binding program into the binding index
+// on failure the index is left unchanged
+mx_status_t devhost_bind_index_add(mx_driver_t* drv);
+
+// invoke func() on each driver that might bind to dev, in the order
+// they were added, until it returns true
+void devhost_bind_index_foreach(mx_device_t* dev, bool (*func)(mx_driver_t* drv, void* cookie),
+                                void* cookie);
+
 mx_status_t devhost_load_driver(mx_driver_t* drv);
 
 mx_status_t devhost_load_firmware(mx_driver_t* drv, const char* path,
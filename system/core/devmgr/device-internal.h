@@ -13,6 +13,8 @@
 #define DEV_FLAG_INSTANCE       0x00000020  // this device was created-on-open
 #define DEV_FLAG_REBIND         0x00000040  // this device is being rebound
 #define DEV_FLAG_MULTI_BIND     0x00000080  // this device accepts many children
+#define DEV_FLAG_PROBING        0x00000100  // drivers are being tried against this device
+#define DEV_FLAG_QUEUED         0x00000200  // this device is waiting to be probed
 
 #define DEV_MAGIC 'MDEV'
 
@@ -39,14 +39,16 @@ struct bootfile {
 
 struct callback_data {
     mx_handle_t vmo;
+    bootfs_lazy_t* lazy;
     unsigned int file_count;
-    mx_status_t (*add_file)(const char* path, mx_handle_t vmo, mx_off_t off, size_t len);
+    mx_status_t (*add_file)(const char* path, mx_handle_t vmo, mx_off_t off, size_t len,
+                            bootfs_lazy_t* lazy);
 };
 
 static void callback(void* arg, const char* path, size_t off, size_t len) {
     struct callback_data* cd = arg;
     //printf("bootfs: %s @%zd (%zd bytes)\n", path, off, len);
-    cd->add_file(path, cd->vmo, off, len);
+    cd->add_file(path, cd->vmo, off, len, cd->lazy);
     ++cd->file_count;
 }
 
@@ -114,7 +116,8 @@ static void start_system_init(void) {
 }
 
 static bool has_secondary_bootfs = false;
-static ssize_t setup_bootfs_vmo(uint32_t n, uint32_t type, mx_handle_t vmo) {
+static ssize_t setup_bootfs_vmo(uint32_t n, uint32_t type, mx_handle_t vmo,
+                                bootfs_lazy_t* lazy) {
     uint64_t size;
     mx_status_t status = mx_vmo_get_size(vmo, &size);
     if (status != NO_ERROR) {
@@ -126,6 +129,7 @@ static ssize_t setup_bootfs_vmo(uint32_t n, uint32_t type, mx_handle_t vmo) {
     }
     struct callback_data cd = {
         .vmo = vmo,
+        .lazy = lazy,
         .add_file = (type == BOOTDATA_BOOTFS_SYSTEM) ? systemfs_add_file : bootfs_add_file,
     };
     if ((type == BOOTDATA_BOOTFS_SYSTEM) && !has_secondary_bootfs) {
@@ -138,15 +142,79 @@ static ssize_t setup_bootfs_vmo(uint32_t n, uint32_t type, mx_handle_t vmo) {
     return cd.file_count;
 }
 
+// How bootfs images handed to us still compressed are unpacked, chosen
+// with bootfs.decompress=eager|lazy|parallel:
+//  eager    - decompress the whole image on this thread before publishing it
+//  lazy     - decompress the directory now and each file on first access
+//  parallel - decompress the whole image now, one 64kB block per worker
+typedef enum {
+    BOOTFS_DECOMPRESS_EAGER,
+    BOOTFS_DECOMPRESS_LAZY,
+    BOOTFS_DECOMPRESS_PARALLEL,
+} bootfs_decompress_mode_t;
+
+static bootfs_decompress_mode_t bootfs_decompress_mode(void) {
+    const char* mode = getenv("bootfs.decompress");
+    if (mode == NULL || !strcmp(mode, "lazy")) {
+        return BOOTFS_DECOMPRESS_LAZY;
+    } else if (!strcmp(mode, "parallel")) {
+        return BOOTFS_DECOMPRESS_PARALLEL;
+    } else if (!strcmp(mode, "eager")) {
+        return BOOTFS_DECOMPRESS_EAGER;
+    }
+    printf("devmgr: unknown bootfs.decompress mode '%s'\n", mode);
+    return BOOTFS_DECOMPRESS_LAZY;
+}
+
+static void setup_compressed_bootfs(uint32_t n, uint32_t type, mx_handle_t vmo,
+                                    size_t off, size_t len,
+                                    bootfs_decompress_mode_t mode) {
+    const char* errmsg;
+    mx_status_t status;
+    if (mode == BOOTFS_DECOMPRESS_EAGER) {
+        mx_handle_t bootfs_vmo;
+        printf("devmgr: decompressing bootfs #%u\n", n);
+        status = decompress_bootdata(mx_vmar_root_self(), vmo, off, len,
+                                     &bootfs_vmo, &errmsg);
+        if (status < 0) {
+            printf("devmgr: failed to decompress bootdata: %s\n", errmsg);
+        } else {
+            setup_bootfs_vmo(n, type, bootfs_vmo, NULL);
+        }
+        return;
+    }
+
+    bootfs_lazy_t* lazy;
+    status = decompress_bootdata_lazy(mx_vmar_root_self(), vmo, off, len,
+                                      &lazy, &errmsg);
+    if (status < 0) {
+        printf("devmgr: failed to index bootdata: %s\n", errmsg);
+        return;
+    }
+    if (mode == BOOTFS_DECOMPRESS_PARALLEL) {
+        uint32_t cpus = mx_system_get_num_cpus();
+        printf("devmgr: decompressing bootfs #%u on %u cpu%s\n",
+               n, cpus, (cpus == 1) ? "" : "s");
+        if ((status = bootfs_lazy_populate_all(lazy, cpus)) < 0) {
+            printf("devmgr: failed to decompress bootdata (%d)\n", status);
+            return;
+        }
+        setup_bootfs_vmo(n, type, bootfs_lazy_vmo(lazy), NULL);
+    } else {
+        setup_bootfs_vmo(n, type, bootfs_lazy_vmo(lazy), lazy);
+    }
+}
+
 #define HND_BOOTFS(n) MX_HND_INFO(MX_HND_TYPE_BOOTFS_VMO, n)
 #define HND_BOOTDATA(n) MX_HND_INFO(MX_HND_TYPE_BOOTDATA_VMO, n)
 
 static void setup_bootfs(void) {
+    bootfs_decompress_mode_t mode = bootfs_decompress_mode();
     mx_handle_t vmo;
     unsigned idx = 0;
 
     if ((vmo = mx_get_startup_handle(HND_BOOTFS(0)))) {
-        setup_bootfs_vmo(idx++, BOOTDATA_BOOTFS_BOOT, vmo);
+        setup_bootfs_vmo(idx++, BOOTDATA_BOOTFS_BOOT, vmo, NULL);
     } else {
         printf("devmgr: missing primary bootfs?!\n");
     }
@@ -184,20 +252,10 @@ static void setup_bootfs(void) {
                 // this was already unpacked for us by userboot
                 break;
             case BOOTDATA_BOOTFS_BOOT:
-            case BOOTDATA_BOOTFS_SYSTEM: {
-                const char* errmsg;
-                mx_handle_t bootfs_vmo;
-                printf("devmgr: decompressing bootfs #%u\n", idx);
-                status = decompress_bootdata(mx_vmar_root_self(), vmo,
-                                             off, bootdata.length + sizeof(bootdata),
-                                             &bootfs_vmo, &errmsg);
-                if (status < 0) {
-                    printf("devmgr: failed to decompress bootdata\n");
-                } else {
-                    setup_bootfs_vmo(idx++, bootdata.type, bootfs_vmo);
-                }
+            case BOOTDATA_BOOTFS_SYSTEM:
+                setup_compressed_bootfs(idx++, bootdata.type, vmo, off,
+                                        bootdata.length + sizeof(bootdata), mode);
                 break;
-            }
             case BOOTDATA_MDI:
             case BOOTDATA_CMDLINE:
             case BOOTDATA_ACPI_RSDP:
@@ -220,7 +278,7 @@ done:
 }
 
 ssize_t devmgr_add_systemfs_vmo(mx_handle_t vmo) {
-    ssize_t added = setup_bootfs_vmo(100, BOOTDATA_BOOTFS_SYSTEM, vmo);
+    ssize_t added = setup_bootfs_vmo(100, BOOTDATA_BOOTFS_SYSTEM, vmo, NULL);
     if (added > 0) {
         start_system_init();
     }
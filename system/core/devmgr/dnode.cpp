@@ -6,6 +6,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <fs/fnv.h>
 #include <fs/vfs.h>
 #include <magenta/new.h>
 #include <mxtl/ref_ptr.h>
@@ -45,6 +46,7 @@ void Dnode::RemoveFromParent() {
 
     // Detach from parent
     if (parent_) {
+        parent_->names_.erase(*this);
         parent_->children_.erase(*this);
         if (IsDirectory()) {
             // '..' no longer references parent.
@@ -75,13 +77,16 @@ void Dnode::AddChild(mxtl::RefPtr<Dnode> parent, mxtl::RefPtr<Dnode> child) {
     MX_DEBUG_ASSERT(child != parent);
     MX_DEBUG_ASSERT(parent->IsDirectory());
 
+    child->ordinal_ = parent->next_ordinal_++;
+    child->name_hash_ = fnv1a32(child->name_.get(), child->NameLen());
     child->parent_ = parent;
     child->vnode_->link_count_++;
     if (child->IsDirectory()) {
         // Child has '..' pointing back at parent.
         parent->vnode_->link_count_++;
     }
-    parent->children_.push_back(mxtl::move(child));
+    parent->names_.insert(child);
+    parent->children_.insert(mxtl::move(child));
 }
 
 mx_status_t Dnode::Lookup(const char* name, size_t len, mxtl::RefPtr<Dnode>* out) const {
@@ -98,17 +103,17 @@ mx_status_t Dnode::Lookup(const char* name, size_t len, mxtl::RefPtr<Dnode>* out
         return NO_ERROR;
     }
 
-    auto dn = children_.find_if([&name, &len](const Dnode& elem) -> bool {
-        return elem.NameMatch(name, len);
-    });
-    if (dn == children_.end()) {
-        return ERR_NOT_FOUND;
-    }
-
-    if (out != nullptr) {
-        *out = dn.CopyPointer();
+    uint32_t hash = fnv1a32(name, len);
+    for (auto dn = names_.lower_bound(NameKey{hash, 0}); dn.IsValid() && dn->name_hash_ == hash;
+         ++dn) {
+        if (dn->NameMatch(name, len)) {
+            if (out != nullptr) {
+                *out = dn.CopyPointer();
+            }
+            return NO_ERROR;
+        }
     }
-    return NO_ERROR;
+    return ERR_NOT_FOUND;
 }
 
 VnodeMemfs* Dnode::AcquireVnode() const {
@@ -128,9 +133,8 @@ mx_status_t Dnode::CanUnlink() const {
 }
 
 struct dircookie_t {
-    size_t count;    // Identifies the number of entries we've already returned
-    uint32_t seqno;  // Inode seq no
-    uint32_t flags;  // Unused
+    uint64_t ordinal; // Smallest ordinal not yet returned ("." is 0, ".." is 1)
+    uint64_t unused;
 };
 
 static_assert(sizeof(dircookie_t) <= sizeof(vdircookie_t),
@@ -144,23 +148,23 @@ mx_status_t Dnode::ReaddirStart(void* cookie, void* data, size_t len) {
     char* ptr = static_cast<char*>(data);
     mx_status_t r;
 
-    if (c->count == 0) {
+    if (c->ordinal == 0) {
         r = fs::vfs_fill_dirent(reinterpret_cast<vdirent_t*>(ptr + pos), len - pos, ".", 1,
                                 VTYPE_TO_DTYPE(V_TYPE_DIR));
         if (r < 0) {
             return static_cast<mx_status_t>(pos);
         }
         pos += r;
-        c->count++;
+        c->ordinal++;
     }
-    if (c->count == 1) {
+    if (c->ordinal == 1) {
         r = fs::vfs_fill_dirent(reinterpret_cast<vdirent_t*>(ptr + pos), len - pos, "..", 2,
                                 VTYPE_TO_DTYPE(V_TYPE_DIR));
         if (r < 0) {
             return static_cast<mx_status_t>(pos);
         }
         pos += r;
-        c->count++;
+        c->ordinal++;
     }
     return static_cast<mx_status_t>(pos);
 }
@@ -170,16 +174,7 @@ mx_status_t Dnode::Readdir(void* cookie, void* _data, size_t len) const {
     char* data = static_cast<char*>(_data);
     mx_status_t r = 0;
 
-    if (vnode_->seqcount_ != c->seqno && c->count > 0) {
-        // We called readdir with this cookie before, but the directory has
-        // been modified since then.
-        return ERR_IO;
-    } else {
-        // This is the first call to readdir; set the cookie.
-        c->seqno = vnode_->seqcount_;
-    }
-
-    if (c->count <= 1) {
+    if (c->ordinal <= 1) {
         r = Dnode::ReaddirStart(cookie, data, len);
         if (r < 0) {
             return r;
@@ -189,20 +184,19 @@ mx_status_t Dnode::Readdir(void* cookie, void* _data, size_t len) const {
     size_t pos = r;
     char* ptr = static_cast<char*>(data);
 
-    size_t childno = 2;
-    for (const auto& dn : children_) {
-        if (childno++ < c->count) {
-            continue;
-        }
-        uint32_t vtype = dn.IsDirectory() ? V_TYPE_DIR : V_TYPE_FILE;
+    // Children are ordered by the ordinal they were given when added, so
+    // resuming from the cookie neither skips nor repeats entries that were
+    // present for the whole enumeration, even if others came and went.
+    for (auto dn = children_.lower_bound(c->ordinal); dn.IsValid(); ++dn) {
+        uint32_t vtype = dn->IsDirectory() ? V_TYPE_DIR : V_TYPE_FILE;
         r = fs::vfs_fill_dirent(reinterpret_cast<vdirent_t*>(ptr + pos), len - pos,
-                                dn.name_.get(), dn.NameLen(),
+                                dn->name_.get(), dn->NameLen(),
                                 VTYPE_TO_DTYPE(vtype));
         if (r < 0) {
             break;
         }
         pos += r;
-        c->count++;
+        c->ordinal = dn->ordinal_ + 1;
     }
 
     return static_cast<mx_status_t>(pos);
@@ -227,6 +221,7 @@ mxtl::unique_ptr<char[]> Dnode::TakeName() {
 }
 
 void Dnode::PutName(mxtl::unique_ptr<char[]> name, size_t len) {
+    MX_DEBUG_ASSERT(parent_ == nullptr);
     flags_ = static_cast<uint32_t>((flags_ & ~kDnodeNameMax) | len);
     name_ = mxtl::move(name);
 }
@@ -234,7 +229,8 @@ void Dnode::PutName(mxtl::unique_ptr<char[]> name, size_t len) {
 bool Dnode::IsDirectory() const { return vnode_->IsDirectory(); }
 
 Dnode::Dnode(VnodeMemfs* vn, mxtl::unique_ptr<char[]> name, uint32_t flags) :
-    vnode_(vn), parent_(nullptr), flags_(flags), name_(mxtl::move(name)) {
+    vnode_(vn), parent_(nullptr), next_ordinal_(2), ordinal_(0), name_hash_(0),
+    flags_(flags), name_(mxtl::move(name)) {
     vnode_->RefAcquire();
 };
 
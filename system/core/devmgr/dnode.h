@@ -10,6 +10,7 @@
 #include <fs/vfs.h>
 #include <mxio/vfs.h>
 #include <mxtl/intrusive_double_list.h>
+#include <mxtl/intrusive_wavl_tree.h>
 #include <mxtl/ref_counted.h>
 #include <mxtl/ref_ptr.h>
 #include <mxtl/unique_ptr.h>
@@ -29,17 +30,52 @@ class Dnode : public mxtl::RefCounted<Dnode> {
 public:
     DISALLOW_COPY_ASSIGN_AND_MOVE(Dnode);
     using NodeState = mxtl::DoublyLinkedListNodeState<mxtl::RefPtr<Dnode>>;
+    using TreeNodeState = mxtl::WAVLTreeNodeState<mxtl::RefPtr<Dnode>>;
+
+    // Key of a child within its parent's name index. Children whose names
+    // hash to the same value are ordered by ordinal, so keys are unique.
+    struct NameKey {
+        uint32_t hash;
+        uint64_t ordinal;
+    };
 
     // ChildTraits is the state used for a Dnode to appear as the child
-    // of another dnode.
-    struct TypeChildTraits { static NodeState& node_state(Dnode& dn) { return dn.type_child_state_; }};
+    // of another dnode, in creation order. The ordinal doubles as the
+    // readdir cookie, so enumeration can resume in O(log n) and tolerates
+    // entries being added or removed between calls.
+    struct TypeChildTraits {
+        static TreeNodeState& node_state(Dnode& dn) { return dn.type_child_state_; }
+    };
+    struct ChildKeyTraits {
+        static uint64_t GetKey(const Dnode& dn) { return dn.ordinal_; }
+        static bool LessThan(uint64_t key1, uint64_t key2) { return key1 < key2; }
+        static bool EqualTo(uint64_t key1, uint64_t key2) { return key1 == key2; }
+    };
+    // NameTraits is the state used to index children by name, so that
+    // Lookup does not need to walk the whole directory.
+    struct TypeNameTraits {
+        static TreeNodeState& node_state(Dnode& dn) { return dn.type_name_state_; }
+    };
+    struct NameKeyTraits {
+        static NameKey GetKey(const Dnode& dn) { return NameKey{dn.name_hash_, dn.ordinal_}; }
+        static bool LessThan(const NameKey& key1, const NameKey& key2) {
+            return (key1.hash < key2.hash) ||
+                   ((key1.hash == key2.hash) && (key1.ordinal < key2.ordinal));
+        }
+        static bool EqualTo(const NameKey& key1, const NameKey& key2) {
+            return (key1.hash == key2.hash) && (key1.ordinal == key2.ordinal);
+        }
+    };
     // DeviceTraits it the state used by devices to effectively create
     // multiple hard links to a single device vnode. This is used
     // extensively by the device manager to make the "same" device
     // vnode appear in multiple locations within "/dev".
     struct TypeDeviceTraits { static NodeState& node_state(Dnode& dn) { return dn.type_device_state_; }};
 
-    using ChildList = mxtl::DoublyLinkedList<mxtl::RefPtr<Dnode>, Dnode::TypeChildTraits>;
+    using ChildTree = mxtl::WAVLTree<uint64_t, mxtl::RefPtr<Dnode>,
+                                     Dnode::ChildKeyTraits, Dnode::TypeChildTraits>;
+    using NameTree = mxtl::WAVLTree<NameKey, mxtl::RefPtr<Dnode>,
+                                    Dnode::NameKeyTraits, Dnode::TypeNameTraits>;
     using DeviceList = mxtl::DoublyLinkedList<mxtl::RefPtr<Dnode>, Dnode::TypeDeviceTraits>;
 
     // Allocates a dnode, attached to a vnode
@@ -86,6 +122,7 @@ public:
     bool IsSubdirectory(mxtl::RefPtr<Dnode> dn) const;
 
     // Functions to take / steal the allocated dnode name.
+    // The name may only be replaced while the dnode has no parent.
     mxtl::unique_ptr<char[]> TakeName();
     void PutName(mxtl::unique_ptr<char[]> name, size_t len);
 
@@ -93,6 +130,7 @@ public:
 
 private:
     friend struct TypeChildTraits;
+    friend struct TypeNameTraits;
     friend struct TypeDeviceTraits;
 
     Dnode(VnodeMemfs* vn, mxtl::unique_ptr<char[]> name, uint32_t flags);
@@ -100,11 +138,20 @@ private:
     size_t NameLen() const;
     bool NameMatch(const char* name, size_t len) const;
 
-    NodeState type_child_state_;
+    TreeNodeState type_child_state_;
+    TreeNodeState type_name_state_;
     NodeState type_device_state_;
     VnodeMemfs* vnode_;
     mxtl::RefPtr<Dnode> parent_;
-    ChildList children_;
+    ChildTree children_;
+    NameTree names_;
+    // Ordinal handed to the next child; 0 and 1 are reserved for the
+    // "." and ".." entries of the readdir cookie.
+    uint64_t next_ordinal_;
+    // Position within the parent's children_ and names_, valid while
+    // parent_ is set.
+    uint64_t ordinal_;
+    uint32_t name_hash_;
     uint32_t flags_;
     mxtl::unique_ptr<char[]> name_;
 };
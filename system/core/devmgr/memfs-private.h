@@ -6,6 +6,7 @@
 
 #include <threads.h>
 
+#include <bootdata/decompress.h>
 #include <ddk/device.h>
 #include <fs/vfs.h>
 #include <magenta/compiler.h>
@@ -84,6 +85,7 @@ private:
     ssize_t Write(const void* data, size_t len, size_t off) final;
     mx_status_t Truncate(size_t len) final;
     mx_status_t Getattr(vnattr_t* a) final;
+    mx_status_t Mmap(uint32_t flags, mx_handle_t* out, size_t* off, size_t* len) final;
 
     mx_handle_t vmo_;
     mx_off_t length_;
@@ -135,10 +137,12 @@ public:
     // due to our implementation of "memfs_create".
     // We should improve our construction of VnodeVmos, and remove this
     // function.
-    void Init(mx_handle_t vmo, mx_off_t length, mx_off_t offset) {
+    void Init(mx_handle_t vmo, mx_off_t length, mx_off_t offset,
+              bootfs_lazy_t* lazy = nullptr) {
         vmo_ = vmo;
         length_ = length;
         offset_ = offset;
+        lazy_ = lazy;
     }
 
 private:
@@ -148,9 +152,13 @@ private:
     mx_status_t GetHandles(uint32_t flags, mx_handle_t* hnds,
                            uint32_t* type, void* extra, uint32_t* esize) final;
 
+    // Decompress our range of a lazily decompressed bootfs on first access.
+    mx_status_t Populate();
+
     mx_handle_t vmo_;
     mx_off_t length_;
     mx_off_t offset_;
+    bootfs_lazy_t* lazy_;
 };
 
 } // namespace memfs
@@ -179,11 +187,13 @@ mx_status_t devfs_remove(VnodeMemfs* vn);
 
 // boot fs
 VnodeMemfs* bootfs_get_root(void);
-mx_status_t bootfs_add_file(const char* path, mx_handle_t vmo, mx_off_t off, size_t len);
+mx_status_t bootfs_add_file(const char* path, mx_handle_t vmo, mx_off_t off, size_t len,
+                            bootfs_lazy_t* lazy);
 
 // system fs
 VnodeMemfs* systemfs_get_root(void);
-mx_status_t systemfs_add_file(const char* path, mx_handle_t vmo, mx_off_t off, size_t len);
+mx_status_t systemfs_add_file(const char* path, mx_handle_t vmo, mx_off_t off, size_t len,
+                              bootfs_lazy_t* lazy);
 
 // memory fs
 VnodeMemfs* memfs_get_root(void);
@@ -23,10 +23,16 @@ namespace memfs {
 
 mx_status_t VnodeVmo::GetHandles(uint32_t flags, mx_handle_t* hnds,
                                  uint32_t* type, void* extra, uint32_t* esize) {
+    // Clients read the VMO directly, so it must be complete before we hand
+    // it out.
+    mx_status_t status = Populate();
+    if (status < 0)
+        return status;
     mx_off_t* off = static_cast<mx_off_t*>(extra);
     mx_off_t* len = off + 1;
     mx_handle_t vmo;
-    mx_status_t status = mx_handle_duplicate(vmo_, MX_RIGHT_READ | MX_RIGHT_DUPLICATE | MX_RIGHT_TRANSFER, &vmo);
+    status = mx_handle_duplicate(vmo_, MX_RIGHT_READ | MX_RIGHT_EXECUTE | MX_RIGHT_MAP |
+                                 MX_RIGHT_DUPLICATE | MX_RIGHT_TRANSFER, &vmo);
     if (status < 0)
         return status;
     xprintf("vmofile: %x (%x) off=%" PRIu64 " len=%" PRIu64 "\n", vmo, vmo_, offset_, length_);
@@ -41,7 +47,8 @@ mx_status_t VnodeVmo::GetHandles(uint32_t flags, mx_handle_t* hnds,
 
 static mx_status_t vnb_create(VnodeMemfs* parent, VnodeMemfs** out,
                               const char* name, size_t namelen,
-                              mx_handle_t h, mx_off_t off, size_t datalen) {
+                              mx_handle_t h, mx_off_t off, size_t datalen,
+                              bootfs_lazy_t* lazy) {
     if (parent->dnode_ == nullptr) {
         return ERR_NOT_DIR;
     }
@@ -55,7 +62,7 @@ static mx_status_t vnb_create(VnodeMemfs* parent, VnodeMemfs** out,
     VnodeVmo* vnb = static_cast<VnodeVmo*>(vnb_fs);
     xprintf("vnb_create: vn=%p, parent=%p name='%.*s' datalen=%zd\n",
             vnb, parent, (int)namelen, name, datalen);
-    vnb->Init(h, datalen, off);
+    vnb->Init(h, datalen, off, lazy);
 
     *out = vnb;
     return NO_ERROR;
@@ -86,7 +93,7 @@ static mx_status_t vnb_mkdir(VnodeMemfs* parent, VnodeMemfs** out, const char* n
 }
 
 static mx_status_t add_file(VnodeMemfs* vnb, const char* path, mx_handle_t vmo,
-                            mx_off_t off, size_t len) {
+                            mx_off_t off, size_t len, bootfs_lazy_t* lazy) {
     mx_status_t r;
     if ((path[0] == '/') || (path[0] == 0))
         return ERR_INVALID_ARGS;
@@ -96,7 +103,7 @@ static mx_status_t add_file(VnodeMemfs* vnb, const char* path, mx_handle_t vmo,
             if (path[0] == 0) {
                 return ERR_INVALID_ARGS;
             }
-            return vnb_create(vnb, &vnb, path, strlen(path), vmo, off, len);
+            return vnb_create(vnb, &vnb, path, strlen(path), vmo, off, len, lazy);
         } else {
             if (nextpath == path)
                 return ERR_INVALID_ARGS;
@@ -114,10 +121,12 @@ static mx_status_t add_file(VnodeMemfs* vnb, const char* path, mx_handle_t vmo,
 // The following functions exist outside the memfs namespace so they can
 // be exposed to C:
 
-mx_status_t bootfs_add_file(const char* path, mx_handle_t vmo, mx_off_t off, size_t len) {
-    return add_file(bootfs_get_root(), path, vmo, off, len);
+mx_status_t bootfs_add_file(const char* path, mx_handle_t vmo, mx_off_t off, size_t len,
+                            bootfs_lazy_t* lazy) {
+    return add_file(bootfs_get_root(), path, vmo, off, len, lazy);
 }
 
-mx_status_t systemfs_add_file(const char* path, mx_handle_t vmo, mx_off_t off, size_t len) {
-    return add_file(systemfs_get_root(), path, vmo, off, len);
+mx_status_t systemfs_add_file(const char* path, mx_handle_t vmo, mx_off_t off, size_t len,
+                              bootfs_lazy_t* lazy) {
+    return add_file(systemfs_get_root(), path, vmo, off, len, lazy);
 }
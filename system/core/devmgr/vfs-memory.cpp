@@ -50,7 +50,7 @@ VnodeDir::VnodeDir() {
 }
 VnodeDir::~VnodeDir() {}
 
-VnodeVmo::VnodeVmo() : vmo_(MX_HANDLE_INVALID), length_(0), offset_(0) {}
+VnodeVmo::VnodeVmo() : vmo_(MX_HANDLE_INVALID), length_(0), offset_(0), lazy_(nullptr) {}
 VnodeVmo::~VnodeVmo() {}
 
 VnodeDevice::VnodeDevice() {
@@ -108,13 +108,51 @@ ssize_t VnodeFile::Read(void* data, size_t len, size_t off) {
     return actual;
 }
 
+mx_status_t VnodeFile::Mmap(uint32_t flags, mx_handle_t* out, size_t* off, size_t* len) {
+    mx_status_t status;
+    if (vmo_ == MX_HANDLE_INVALID) {
+        // Empty files have no VMO yet. Create one, so the mapping observes
+        // later writes like it would for any other file.
+        if ((status = mx_vmo_create(0, 0, &vmo_)) != NO_ERROR) {
+            return status;
+        }
+    }
+    // The VMO is the file, so stores through a shared mapping are visible
+    // to readers; they do not extend the file, however.
+    mx_rights_t rights = MX_RIGHT_DUPLICATE | MX_RIGHT_TRANSFER | MX_RIGHT_MAP;
+    rights |= (flags & MXIO_MMAP_FLAG_READ) ? MX_RIGHT_READ : 0;
+    rights |= (flags & MXIO_MMAP_FLAG_WRITE) ? MX_RIGHT_WRITE : 0;
+    rights |= (flags & MXIO_MMAP_FLAG_EXEC) ? MX_RIGHT_EXECUTE : 0;
+    if ((status = mx_handle_duplicate(vmo_, rights, out)) != NO_ERROR) {
+        return status;
+    }
+    *off = 0;
+    *len = length_;
+    return NO_ERROR;
+}
+
+mx_status_t VnodeVmo::Populate() {
+    if (lazy_ == nullptr) {
+        return NO_ERROR;
+    }
+    mx_status_t r = bootfs_lazy_populate(lazy_, offset_, length_);
+    if (r == NO_ERROR) {
+        lazy_ = nullptr;
+    }
+    return r;
+}
+
 ssize_t VnodeVmo::Read(void* data, size_t len, size_t off) {
     if (off > length_)
         return 0;
     size_t rlen = length_ - off;
     if (len > rlen)
         len = rlen;
-    mx_status_t r = mx_vmo_read(vmo_, data, offset_ + off, len, &len);
+    mx_status_t r = Populate();
+    if (r < 0) {
+        return r;
+    }
+    r = mx_vmo_read(vmo_, data, offset_ + off, len, &len);
     if (r < 0) {
         return r;
     }
@@ -162,7 +200,11 @@ ssize_t VnodeVmo::Write(const void* data, size_t len, size_t off) {
         // TODO(orr): grow vmo to support extending length
         return ERR_NOT_SUPPORTED;
     }
-    mx_status_t r = mx_vmo_write(vmo_, data, offset_ + off, len, &rlen);
+    mx_status_t r = Populate();
+    if (r < 0) {
+        return r;
+    }
+    r = mx_vmo_write(vmo_, data, offset_ + off, len, &rlen);
     if (r < 0) {
         return r;
     }
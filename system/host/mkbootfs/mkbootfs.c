@@ -384,6 +384,9 @@ static const io_ops io_plain = {
     .write_file = copyfile,
 };
 
+// Blocks must be independent and, apart from the last one, exactly 64kB
+// (so autoFlush must stay off): devmgr decompresses bootfs images lazily,
+// one block at a time, and locates a block's output by its index alone.
 static LZ4F_preferences_t lz4_prefs = {
     .frameInfo = {
         .blockSizeID = LZ4F_max64KB,
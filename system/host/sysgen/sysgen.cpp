@@ -389,6 +389,10 @@ struct Syscall {
         return has_attribute("vdsocall", attributes);
     }
 
+    bool is_internal() const {
+        return has_attribute("internal", attributes);
+    }
+
     bool is_noreturn() const {
         return has_attribute("noreturn", attributes);
     }
@@ -411,6 +415,9 @@ struct Syscall {
         } else if (ret_spec.size() == 1 && !ret_spec[0].name.empty()) {
             print_error("single return arguments cannot be named");
             return false;
+        } else if (is_vdso() && is_internal()) {
+            print_error("vdsocall cannot be internal");
+            return false;
         } else if (is_blocking() &&
                    (ret_spec.size() == 0 || ret_spec[0].type != "mx_status_t")) {
             print_error("blocking must have first return be of type mx_status_t");
@@ -707,7 +714,30 @@ bool generate_legacy_header(std::ofstream& os, const Syscall& sc,
     return os.good();
 }
 
+// Internal syscalls are only called from vDSO code, so they are left
+// out of the public header; the vDSO header declares the raw entry
+// points under their own names instead.
+bool generate_user_header(std::ofstream& os, const Syscall& sc,
+    const string& function_prefix, const std::vector<string>& name_prefixes,
+    const string& no_args_type, bool allow_pointer_wrapping,
+    const std::map<string, string>& attributes) {
+    return sc.is_internal()
+        ? true
+        : generate_legacy_header(os, sc, function_prefix, name_prefixes,
+                                 no_args_type, allow_pointer_wrapping, attributes);
+}
+
+bool generate_vdso_header(std::ofstream& os, const Syscall& sc,
+    const string& function_prefix, const string& name_prefix,
+    const string& internal_name_prefix, const std::map<string, string>& attributes) {
+    return generate_legacy_header(os, sc, function_prefix,
+                                  {sc.is_internal() ? internal_name_prefix : name_prefix},
+                                  "void", false, attributes);
+}
+
 bool generate_rust_bindings(std::ofstream& os, const Syscall& sc) {
+    if (sc.is_internal())
+        return true;
     os << "    pub fn mx_" << sc.name << "(";
 
     // Writes all arguments.
@@ -815,21 +845,27 @@ bool generate_kernel_code(std::ofstream& os, const Syscall& sc,
 }
 
 bool generate_legacy_assembly_x64(
-    std::ofstream& os, const Syscall& sc, const string& syscall_macro, const string& name_prefix) {
+    std::ofstream& os, const Syscall& sc, const string& syscall_macro, const string& name_prefix,
+    const string& internal_name_prefix) {
     if (sc.is_vdso())
         return true;
     // SYSCALL_DEF(nargs64, nargs32, n, ret, name, args...) m_syscall nargs64, mx_##name, n
+    // Internal syscalls get a hidden SYSCALL_mx_##name entry point instead.
     os << syscall_macro << " " << sc.arg_spec.size() << " "
-       << name_prefix << sc.name << " " << sc.index << "\n";
+       << (sc.is_internal() ? internal_name_prefix : name_prefix) << sc.name << " "
+       << sc.index << (sc.is_internal() ? " 1" : "") << "\n";
     return os.good();
 }
 
 bool generate_legacy_assembly_arm64(
-    std::ofstream& os, const Syscall& sc, const string& syscall_macro, const string& name_prefix) {
+    std::ofstream& os, const Syscall& sc, const string& syscall_macro, const string& name_prefix,
+    const string& internal_name_prefix) {
     if (sc.is_vdso())
         return true;
     // SYSCALL_DEF(nargs64, nargs32, n, ret, name, args...) m_syscall mx_##name, n
-    os << syscall_macro << " " << name_prefix << sc.name << " " << sc.index << "\n";
+    // Internal syscalls get a hidden SYSCALL_mx_##name entry point instead.
+    os << syscall_macro << " " << (sc.is_internal() ? internal_name_prefix : name_prefix)
+       << sc.name << " " << sc.index << (sc.is_internal() ? " 1" : "") << "\n";
     return os.good();
 }
 
@@ -868,6 +904,7 @@ const std::map<string, string> kernel_attrs = {
 using gen = std::function<bool(std::ofstream& os, const Syscall& sc)>;
 #define gen1(name, arg1) std::bind(name, std::placeholders::_1, std::placeholders::_2, arg1)
 #define gen2(name, arg1, arg2) std::bind(name, std::placeholders::_1, std::placeholders::_2, arg1, arg2)
+#define gen3(name, arg1, arg2, arg3) std::bind(name, std::placeholders::_1, std::placeholders::_2, arg1, arg2, arg3)
 #define gen4(name, arg1, arg2, arg3, arg4) std::bind(name, std::placeholders::_1, std::placeholders::_2, arg1, arg2, arg3, arg4)
 #define gen5(name, arg1, arg2, arg3, arg4, arg5) std::bind(name, std::placeholders::_1, std::placeholders::_2, arg1, arg2, arg3, arg4, arg5)
 
@@ -887,7 +924,7 @@ const std::map<string, gen> type_to_generator = {
     {
     // The user header, pure C.
         "user-header",
-        gen5(generate_legacy_header,
+        gen5(generate_user_header,
             "extern ",                              // function prefix
             std::vector<string>({"mx_", "_mx_"}),   // function name prefixes
             "void",                                 // no-args special type
@@ -897,11 +934,10 @@ const std::map<string, gen> type_to_generator = {
     // The vDSO-internal header, pure C.  (VDsoHeaderC)
     {
         "vdso-header",
-        gen5(generate_legacy_header,
+        gen4(generate_vdso_header,
             "__attribute__((visibility(\"hidden\"))) extern ",  // function prefix
-            std::vector<string>({"VDSO_mx_"}),                  // function name prefixes
-            "void",                                             // no args special type
-            false,
+            "VDSO_mx_",                                         // function name prefix
+            "SYSCALL_mx_",                                      // internal name prefix
             user_attrs)
     },
     // The kernel header, C++.
@@ -923,16 +959,18 @@ const std::map<string, gen> type_to_generator = {
     //  The assembly file for x86-64.
     {
         "x86-asm",
-        gen2(generate_legacy_assembly_x64,
+        gen3(generate_legacy_assembly_x64,
             "m_syscall",                // syscall macro name
-            "mx_")                      // syscall name prefix
+            "mx_",                      // syscall name prefix
+            "SYSCALL_mx_")              // internal syscall name prefix
     },
     //  The assembly include file for ARM64.
     {
         "arm-asm",
-        gen2(generate_legacy_assembly_arm64,
+        gen3(generate_legacy_assembly_arm64,
             "m_syscall",                // syscall macro name
-            "mx_")                      // syscall name prefix
+            "mx_",                      // syscall name prefix
+            "SYSCALL_mx_")              // internal syscall name prefix
     },
     // A C header defining MX_SYS_* syscall number macros.
     {
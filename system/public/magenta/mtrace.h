@@ -10,6 +10,9 @@
 
 #pragma once
 
+#include <magenta/compiler.h>
+#include <magenta/types.h>
+
 __BEGIN_CDECLS
 
 // mtrace_control() can operate on a range of features, for now just IPT.
@@ -17,6 +20,7 @@ __BEGIN_CDECLS
 // before it's useful; it's here in the interests of hackability in the
 // interim.
 #define MTRACE_KIND_IPT 0
+#define MTRACE_KIND_SAMPLE 1
 
 // Actions for perf_control
 
@@ -45,4 +49,59 @@ __BEGIN_CDECLS
 
 #define MTRACE_IPT_OPTIONS_CPU(options) ((options) & MTRACE_IPT_OPTIONS_CPU_MASK)
 
+// Actions for MTRACE_KIND_SAMPLE: statistical sampling of what each cpu is
+// running, driven by a periodic per-cpu timer.
+
+// Start sampling. ptr = mx_sample_config_t, options = 0.
+#define MTRACE_SAMPLE_START 0
+
+// Stop sampling and copy the samples into the buffers. ptr = NULL,
+// options = 0. The buffers can be read once this returns; if one of them
+// was shrunk while sampling, this fails but the others are still filled.
+#define MTRACE_SAMPLE_STOP 1
+
+#define MTRACE_SAMPLE_MAX_CPUS 32
+#define MTRACE_SAMPLE_MAX_FRAMES 64
+#define MTRACE_SAMPLE_MIN_PERIOD 10000 // 10us
+
+typedef struct mx_sample_config {
+    // Nanoseconds between samples on each cpu.
+    mx_time_t period;
+    // Maximum number of return addresses to record per sample, found by
+    // following frame pointers. 0 records just the pc.
+    uint32_t max_frames;
+    // Number of entries in |buffers|.
+    uint32_t num_buffers;
+    // One VMO per cpu, starting with cpu 0, with MX_RIGHT_WRITE. Samples
+    // are taken on cpus which have one, into kernel buffers of the same
+    // size, and copied into the VMOs when sampling stops.
+    mx_handle_t buffers[MTRACE_SAMPLE_MAX_CPUS];
+} mx_sample_config_t;
+
+// Each buffer starts with a header, followed by |size| bytes of records.
+#define MX_SAMPLE_BUFFER_MAGIC 0x534d504c // 'SMPL'
+
+typedef struct mx_sample_buffer_header {
+    uint32_t magic;
+    uint32_t cpu;
+    // Bytes of records following the header.
+    uint64_t size;
+    // Samples which did not fit in the buffer.
+    uint64_t dropped;
+} mx_sample_buffer_header_t;
+
+// The sample was taken in user mode.
+#define MX_SAMPLE_FLAG_USER (1u << 0)
+
+typedef struct mx_sample_record {
+    mx_time_t time;
+    // Koids of the interrupted thread and its process, or 0 for kernel threads.
+    mx_koid_t pid;
+    mx_koid_t tid;
+    uint64_t pc;
+    uint32_t flags;
+    // Number of return addresses following, innermost first.
+    uint32_t num_frames;
+} mx_sample_record_t;
+
 __END_CDECLS
@@ -27,6 +27,8 @@ typedef enum {
     MX_INFO_THREAD_EXCEPTION_REPORT    = 11, // mx_exception_report_t[1]
     MX_INFO_TASK_STATS                 = 12, // mx_info_task_stats_t[1]
     MX_INFO_PROCESS_MAPS               = 13, // mx_info_maps_t[n]
+    MX_INFO_THREAD_STATS               = 14, // mx_info_thread_stats_t[1]
+    MX_INFO_CPU_STATS                  = 15, // mx_info_cpu_stats_t[n]
     MX_INFO_LAST
 } mx_object_info_topic_t;
 
@@ -172,6 +174,52 @@ typedef struct mx_info_maps {
     } u;
 } mx_info_maps_t;
 
+// Scheduler accounting for a thread. On a process or job this is the sum
+// over every thread which ever ran in it, including those which have exited.
+typedef struct mx_info_thread_stats {
+    // Nanoseconds spent running.
+    mx_time_t total_runtime;
+
+    // Nanoseconds spent ready to run, waiting in a run queue.
+    mx_time_t total_queue_time;
+
+    // Number of times a cpu switched to the thread.
+    uint64_t context_switches;
+
+    // Number of times the thread was preempted, rather than giving up the
+    // cpu by blocking or yielding.
+    uint64_t preemptions;
+} mx_info_thread_stats_t;
+
+// Flags for mx_info_cpu_stats_t.flags.
+#define MX_INFO_CPU_STATS_FLAG_ONLINE       (1u << 0)
+
+// Per-cpu kernel counters, since boot. Requires a resource handle.
+typedef struct mx_info_cpu_stats {
+    uint32_t cpu_number;
+    uint32_t flags;
+
+    mx_time_t idle_time;
+
+    // kernel scheduler counters
+    uint64_t reschedules;
+    uint64_t context_switches;
+    uint64_t irq_preempts;
+    uint64_t preempts;
+    uint64_t yields;
+
+    // cpu level interrupts and exceptions
+    uint64_t ints;              // hardware interrupts, minus timer and ipis
+    uint64_t timer_ints;        // timer interrupts
+    uint64_t timers;            // timer callbacks
+    uint64_t exceptions;        // exceptions such as page fault
+    uint64_t syscalls;
+
+    // inter-processor interrupts
+    uint64_t reschedule_ipis;
+    uint64_t generic_ipis;
+} mx_info_cpu_stats_t;
+
 
 // Object properties.
 
@@ -190,6 +238,34 @@ typedef struct mx_info_maps {
 // Argument is the value of ld.so's _dl_debug_addr, a uintptr_t.
 #define MX_PROP_PROCESS_DEBUG_ADDR          5u
 
+// Argument is an mx_time_t: how many nanoseconds late the thread's
+// sleeps and wait timeouts may complete, so that the kernel can wake
+// it together with other timers.  At most MX_TIMER_SLACK_MAX.
+#define MX_PROP_TIMER_SLACK                 6u
+#define MX_TIMER_SLACK_MAX                  MX_SEC(1)
+
+// Argument is an int32_t scheduling priority for a thread, from
+// MX_PRIORITY_LOWEST to its job's MX_PROP_JOB_MAX_PRIORITY.  Threads start
+// out at MX_PRIORITY_DEFAULT, or the job's maximum if that is lower.
+#define MX_PROP_THREAD_PRIORITY             7u
+#define MX_PRIORITY_LOWEST                  1
+#define MX_PRIORITY_DEFAULT                 8
+#define MX_PRIORITY_HIGHEST                 24
+
+// Argument is a uint64_t mask of the CPUs a thread may run on.  On a job
+// it is the mask threads in the job's processes start out with; a job's
+// mask must be a subset of its parent's, and a thread's a subset of its
+// job's.  A new job starts with its parent's mask.  Narrowing a job's mask
+// also narrows the masks of its child jobs and running threads.
+#define MX_PROP_CPU_AFFINITY                8u
+
+// Argument is an int32_t: the highest MX_PROP_THREAD_PRIORITY threads in a
+// job's processes may have.  It may be raised no higher than the parent
+// job's.  A new job starts at its parent's maximum or MX_PRIORITY_DEFAULT,
+// whichever is lower.  Lowering it also lowers child jobs and threads
+// above the new maximum.
+#define MX_PROP_JOB_MAX_PRIORITY            9u
+
 // Policies for MX_PROP_BAD_HANDLE_POLICY:
 #define MX_POLICY_BAD_HANDLE_IGNORE         0u
 #define MX_POLICY_BAD_HANDLE_LOG            1u
@@ -252,6 +252,21 @@ typedef int64_t mx_rel_off_t;
 // Socket options and limits.
 #define MX_SOCKET_HALF_CLOSE                1u
 
+// Socket create options.  Datagram sockets keep the boundaries between
+// writes; a read returns one datagram, truncated to fit.  The bits do not
+// overlap the write options, so passing one for the other is an error.
+#define MX_SOCKET_STREAM                    0u
+#define MX_SOCKET_DATAGRAM                  (1u << 1)
+// The buffer capacity of each end, as a power of two number of bytes
+// between MX_SOCKET_CAPACITY_MIN and MX_SOCKET_CAPACITY_MAX, or 0 for
+// MX_SOCKET_CAPACITY_DEFAULT.  A buffer holds one byte less than that.
+#define MX_SOCKET_CAPACITY_SHIFT            8
+#define MX_SOCKET_CAPACITY_MASK             (0xffu << MX_SOCKET_CAPACITY_SHIFT)
+#define MX_SOCKET_CAPACITY(log2)            ((uint32_t)(log2) << MX_SOCKET_CAPACITY_SHIFT)
+#define MX_SOCKET_CAPACITY_MIN              12u // 4KB
+#define MX_SOCKET_CAPACITY_MAX              24u // 16MB
+#define MX_SOCKET_CAPACITY_DEFAULT          18u // 256KB
+
 // Flags which can be used to to control cache policy for APIs which map memory.
 typedef enum {
     MX_CACHE_POLICY_CACHED          = 0,
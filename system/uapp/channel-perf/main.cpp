@@ -13,6 +13,7 @@
 #include <magenta/compiler.h>
 #include <magenta/syscalls.h>
 #include <mxtl/unique_ptr.h>
+#include <shm-ring/ring.h>
 
 namespace {
 
@@ -33,6 +34,68 @@ struct TestArgs {
     uint32_t queue;
 };
 
+// Like do_test(), but through a shared-memory ring, which cannot carry handles.
+void do_ring_test(uint32_t duration, const TestArgs& test_args) {
+    __UNUSED mx_status_t status;
+
+    uint64_t duration_ns = duration * 1000000000ull;
+
+    // Room for the pre-queued messages plus the one in flight.
+    mx_handle_t producer[2];
+    mx_handle_t consumer[2];
+    status = shm_ring_create((test_args.queue + 1) * (test_args.size + 16u) * 2u,
+                             producer, consumer);
+    assert(status == NO_ERROR);
+    shm_ring_t w;
+    shm_ring_t r;
+    status = shm_ring_init(&w, producer);
+    assert(status == NO_ERROR);
+    status = shm_ring_init(&r, consumer);
+    assert(status == NO_ERROR);
+
+    mxtl::unique_ptr<uint8_t[]> data;
+    if (test_args.size) {
+        data.reset(new uint8_t[test_args.size]);
+        for (uint32_t i = 0; i < test_args.size; i++)
+            data[i] = static_cast<uint8_t>(i);
+    }
+
+    for (uint32_t i = 0; i < test_args.queue; i++) {
+        status = shm_ring_write(&w, data.get(), test_args.size);
+        assert(status == NO_ERROR);
+    }
+
+    static constexpr uint32_t big_it_size = 10000;
+    uint64_t big_its = 0;
+    uint64_t start_ns = mx_time_get(MX_CLOCK_MONOTONIC);
+    uint64_t end_ns;
+    for (;;) {
+        big_its++;
+        for (uint32_t i = 0; i < big_it_size; i++) {
+            status = shm_ring_write(&w, data.get(), test_args.size);
+            assert(status == NO_ERROR);
+
+            size_t r_size;
+            status = shm_ring_read(&r, data.get(), test_args.size, &r_size);
+            assert(status == NO_ERROR);
+            assert(r_size == test_args.size);
+        }
+
+        end_ns = mx_time_get(MX_CLOCK_MONOTONIC);
+        if ((end_ns - start_ns) >= duration_ns)
+            break;
+    }
+
+    shm_ring_close(&w);
+    shm_ring_close(&r);
+
+    double real_duration = static_cast<double>(end_ns - start_ns) / 1000000000.0;
+    double its_per_second = static_cast<double>(big_its) * big_it_size / real_duration;
+    printf("ring write/read %" PRIu32 " bytes (%" PRIu32 " pre-queued): "
+               "%.0f iterations/second\n",
+           test_args.size, test_args.queue, its_per_second);
+}
+
 void do_test(uint32_t duration, const TestArgs& test_args) {
     __UNUSED mx_status_t status;
 
@@ -121,6 +184,7 @@ int main(int argc, char** argv) {
         "  -h    show help (this)\n"
         "  -o    run single test (default)\n"
         "  -s    run suite (ignores -S/-H/-Q)\n"
+        "  -r    use a shared-memory ring instead of a channel (no handles)\n"
         "  -n N  set test repetition count to N (default: 1)\n"
         "  -d N  set test duration to N seconds (default: 5)\n"
         "  -S N  set message size to N bytes (default: 10)\n"
@@ -128,6 +192,7 @@ int main(int argc, char** argv) {
         "  -Q N  set message pre-queue count to N messages (default: 0)\n";
 
     bool run_suite = false;  // -o/-s
+    bool use_ring = false;   // -r
     uint32_t duration = 5;   // -d
     uint32_t repeats = 1;    // -n
     // Ignored when running a suite:
@@ -138,7 +203,7 @@ int main(int argc, char** argv) {
     };
 
     int opt;
-    while ((opt = getopt(argc, argv, "+hosn:d:S:H:Q:")) != -1) {
+    while ((opt = getopt(argc, argv, "+hosrn:d:S:H:Q:")) != -1) {
         // Our option values are always unsigned numbers.
         uint32_t value = 0;
         if (optarg) {
@@ -160,6 +225,9 @@ int main(int argc, char** argv) {
             case 's':
                 run_suite = true;
                 break;
+            case 'r':
+                use_ring = true;
+                break;
             case 'n':
                 assert(optarg);
                 repeats = value;
@@ -187,6 +255,8 @@ int main(int argc, char** argv) {
     }
     if (optind < argc)
         argument_error(argv[0], "unexpected positional argument");
+    if (use_ring && !run_suite && test_args.handles)
+        argument_error(argv[0], "a ring cannot carry handles");
 
     for (uint32_t i = 0; i < repeats; i++) {
         if (repeats > 1u) {
@@ -214,8 +284,14 @@ int main(int argc, char** argv) {
                 {100, 0, 1},
                 {1000, 0, 1},
             };
-            for (size_t i = 0; i < countof(suite); i++)
-                do_test(duration, suite[i]);
+            for (size_t i = 0; i < countof(suite); i++) {
+                if (!use_ring)
+                    do_test(duration, suite[i]);
+                else if (!suite[i].handles)
+                    do_ring_test(duration, suite[i]);
+            }
+        } else if (use_ring) {
+            do_ring_test(duration, test_args);
         } else {
             do_test(duration, test_args);
         }
@@ -11,6 +11,8 @@ MODULE_TYPE := userapp
 MODULE_SRCS += \
     $(LOCAL_DIR)/main.cpp \
 
+MODULE_STATIC_LIBS := system/ulib/shm-ring
+
 MODULE_LIBS := system/ulib/magenta system/ulib/mxio system/ulib/c system/ulib/mxcpp system/ulib/mxtl
 
 include make/module.mk
@@ -0,0 +1,201 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Throughput of the libgfx fill, copy, blend and conversion paths, in
+// megapixels per second, for each kernel implementation the cpu supports.
+// Surfaces are in memory, so this measures the library, not the display.
+
+#include <gfx/gfx.h>
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <magenta/syscalls.h>
+
+typedef struct bench_args {
+    unsigned width;
+    unsigned height;
+    uint32_t iterations;
+} bench_args_t;
+
+typedef struct bench_surfaces {
+    gfx_surface* argb;   // ARGB_8888 target
+    gfx_surface* xrgb;   // RGB_x888 target
+    gfx_surface* rgb565; // RGB_565 target
+    gfx_surface* src;    // ARGB_8888 source with mixed alpha
+} bench_surfaces_t;
+
+typedef void (*bench_fn_t)(const bench_surfaces_t* s, uint32_t n);
+
+static void bench_fill32(const bench_surfaces_t* s, uint32_t n) {
+    gfx_fillrect(s->xrgb, 0, 0, s->xrgb->width, s->xrgb->height, 0xff000000 | n);
+}
+
+static void bench_fill16(const bench_surfaces_t* s, uint32_t n) {
+    gfx_fillrect(s->rgb565, 0, 0, s->rgb565->width, s->rgb565->height, 0xff000000 | (n << 3));
+}
+
+// console scrolling: move everything up by one 16 pixel text row
+static void bench_scroll32(const bench_surfaces_t* s, uint32_t n) {
+    gfx_copyrect(s->xrgb, 0, 16, s->xrgb->width, s->xrgb->height - 16, 0, 0);
+}
+
+static void bench_copylines32(const bench_surfaces_t* s, uint32_t n) {
+    gfx_copylines(s->argb, s->src, 0, 0, s->src->height);
+}
+
+static void bench_blend32(const bench_surfaces_t* s, uint32_t n) {
+    gfx_blend(s->argb, s->src, 0, 0, s->src->width, s->src->height, 0, 0);
+}
+
+static void bench_convert565(const bench_surfaces_t* s, uint32_t n) {
+    gfx_blend(s->rgb565, s->src, 0, 0, s->src->width, s->src->height, 0, 0);
+}
+
+static const struct {
+    const char* name;
+    bench_fn_t fn;
+} benches[] = {
+    { "fill32", bench_fill32 },
+    { "fill16", bench_fill16 },
+    { "scroll32", bench_scroll32 },
+    { "copylines32", bench_copylines32 },
+    { "blend32", bench_blend32 },
+    { "convert565", bench_convert565 },
+};
+
+static const char* kernels[] = { "generic", "sse2", "avx2", "neon" };
+
+static void run_bench(const bench_args_t* args, const bench_surfaces_t* s,
+                      const char* name, bench_fn_t fn) {
+    // warm up caches and page in the surfaces
+    fn(s, 0);
+
+    uint64_t t0 = mx_time_get(MX_CLOCK_MONOTONIC);
+    for (uint32_t n = 0; n < args->iterations; n++) {
+        fn(s, n);
+    }
+    uint64_t ns = mx_time_get(MX_CLOCK_MONOTONIC) - t0;
+
+    uint64_t pixels = (uint64_t)args->width * args->height * args->iterations;
+    printf("%-8s %-12s %8" PRIu64 " us/frame %8" PRIu64 " Mpix/s\n",
+           gfx_get_kernels(), name, ns / args->iterations / 1000,
+           ns ? (pixels * 1000) / ns : 0);
+}
+
+static gfx_surface* create_surface(const bench_args_t* args, unsigned format) {
+    gfx_surface* s = gfx_create_surface(NULL, args->width, args->height, args->width, format, 0);
+    if (s == NULL) {
+        fprintf(stderr, "gfx-perf: cannot create %ux%u surface\n", args->width, args->height);
+        exit(-1);
+    }
+    return s;
+}
+
+static void usage(const char* argv0) {
+    printf("Usage: %s [options ...]\n"
+           "\n"
+           "Options:\n"
+           "  -h    show help (this)\n"
+           "  -k K  only run kernels K (generic, sse2, avx2, neon)\n"
+           "  -t T  only run test T (fill32, fill16, scroll32, copylines32,\n"
+           "        blend32, convert565)\n"
+           "  -W N  surface width (default: 3840)\n"
+           "  -H N  surface height (default: 2160)\n"
+           "  -n N  frames per test (default: 20)\n",
+           argv0);
+}
+
+int main(int argc, char** argv) {
+    const char* only_kernels = NULL;
+    const char* only_test = NULL;
+    bench_args_t args = {
+        .width = 3840,
+        .height = 2160,
+        .iterations = 20,
+    };
+
+    int opt;
+    while ((opt = getopt(argc, argv, "hk:t:W:H:n:")) != -1) {
+        unsigned long value = 0;
+        if ((opt == 'W') || (opt == 'H') || (opt == 'n')) {
+            char* endptr;
+            errno = 0;
+            value = strtoul(optarg, &endptr, 10);
+            if ((errno != 0) || (*endptr != '\0') || (value == 0) || (value > 65536)) {
+                fprintf(stderr, "%s: invalid numeric value '%s'\n", argv[0], optarg);
+                return -1;
+            }
+        }
+        switch (opt) {
+        case 'h':
+            usage(argv[0]);
+            return 0;
+        case 'k':
+            only_kernels = optarg;
+            break;
+        case 't':
+            only_test = optarg;
+            break;
+        case 'W':
+            args.width = value;
+            break;
+        case 'H':
+            args.height = value;
+            break;
+        case 'n':
+            args.iterations = value;
+            break;
+        default:
+            usage(argv[0]);
+            return -1;
+        }
+    }
+    if (args.height <= 16) {
+        fprintf(stderr, "%s: height must be more than 16\n", argv[0]);
+        return -1;
+    }
+
+    bench_surfaces_t s = {
+        .argb = create_surface(&args, MX_PIXEL_FORMAT_ARGB_8888),
+        .xrgb = create_surface(&args, MX_PIXEL_FORMAT_RGB_x888),
+        .rgb565 = create_surface(&args, MX_PIXEL_FORMAT_RGB_565),
+        .src = create_surface(&args, MX_PIXEL_FORMAT_ARGB_8888),
+    };
+
+    // a mix of transparent, opaque and translucent pixels
+    uint32_t* src = s.src->ptr;
+    for (size_t i = 0; i < (size_t)args.width * args.height; i++) {
+        src[i] = (uint32_t)(i * 2654435761u);
+    }
+
+    printf("gfx-perf: %ux%u, %u frames, default kernels %s\n",
+           args.width, args.height, args.iterations, gfx_get_kernels());
+
+    for (size_t k = 0; k < countof(kernels); k++) {
+        if (only_kernels && strcmp(only_kernels, kernels[k])) {
+            continue;
+        }
+        if (gfx_set_kernels(kernels[k]) != NO_ERROR) {
+            continue;
+        }
+        for (size_t b = 0; b < countof(benches); b++) {
+            if (only_test && strcmp(only_test, benches[b].name)) {
+                continue;
+            }
+            run_bench(&args, &s, benches[b].name, benches[b].fn);
+        }
+    }
+
+    gfx_surface_destroy(s.argb);
+    gfx_surface_destroy(s.xrgb);
+    gfx_surface_destroy(s.rgb565);
+    gfx_surface_destroy(s.src);
+    return 0;
+}
@@ -0,0 +1,211 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Microbenchmark for iotxn_alloc()/iotxn_release() latency.
+
+#include <ddk/iotxn.h>
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <threads.h>
+
+#include <magenta/syscalls.h>
+
+#define MAX_THREADS 16
+#define MAX_INFLIGHT 64
+
+typedef struct test_args {
+    uint64_t size;        // payload size (largest size when mixing)
+    bool mixed;           // cycle through sizes up to size
+    bool pool;            // allocate with IOTXN_ALLOC_POOL
+    uint32_t inflight;    // iotxns held at once by each thread
+    uint32_t iterations;  // alloc/release pairs per thread
+} test_args_t;
+
+typedef struct thread_result {
+    const test_args_t* args;
+    uint64_t alloc_ns;
+    uint64_t release_ns;
+    mx_status_t status;
+} thread_result_t;
+
+static uint64_t size_for(const test_args_t* args, uint32_t n) {
+    if (!args->mixed) {
+        return args->size;
+    }
+    // sixteen sizes evenly spaced up to args->size
+    return ((n % 16) + 1) * args->size / 16;
+}
+
+static int bench_thread(void* arg) {
+    thread_result_t* result = arg;
+    const test_args_t* args = result->args;
+    uint32_t flags = args->pool ? IOTXN_ALLOC_POOL : 0;
+    iotxn_t* txns[MAX_INFLIGHT];
+
+    for (uint32_t i = 0; i < args->iterations; i += args->inflight) {
+        uint64_t t0 = mx_time_get(MX_CLOCK_MONOTONIC);
+        for (uint32_t n = 0; n < args->inflight; n++) {
+            mx_status_t status = iotxn_alloc(&txns[n], flags, size_for(args, i + n));
+            if (status != NO_ERROR) {
+                result->status = status;
+                return -1;
+            }
+        }
+        uint64_t t1 = mx_time_get(MX_CLOCK_MONOTONIC);
+        for (uint32_t n = 0; n < args->inflight; n++) {
+            iotxn_release(txns[n]);
+        }
+        uint64_t t2 = mx_time_get(MX_CLOCK_MONOTONIC);
+
+        result->alloc_ns += t1 - t0;
+        result->release_ns += t2 - t1;
+    }
+    return 0;
+}
+
+static int do_test(const test_args_t* args, uint32_t nthreads) {
+    thread_result_t results[MAX_THREADS] = {};
+    thrd_t threads[MAX_THREADS];
+
+    iotxn_pool_stats_t before;
+    iotxn_pool_stats(&before);
+
+    for (uint32_t t = 0; t < nthreads; t++) {
+        results[t].args = args;
+        if (thrd_create_with_name(&threads[t], bench_thread, &results[t], "iotxn-perf") != thrd_success) {
+            fprintf(stderr, "iotxn-perf: cannot create thread\n");
+            return -1;
+        }
+    }
+
+    uint64_t alloc_ns = 0;
+    uint64_t release_ns = 0;
+    for (uint32_t t = 0; t < nthreads; t++) {
+        thrd_join(threads[t], NULL);
+        if (results[t].status != NO_ERROR) {
+            fprintf(stderr, "iotxn-perf: iotxn_alloc failed: %d\n", results[t].status);
+            return -1;
+        }
+        alloc_ns += results[t].alloc_ns;
+        release_ns += results[t].release_ns;
+    }
+
+    iotxn_pool_stats_t after;
+    iotxn_pool_stats(&after);
+
+    uint64_t ops = (uint64_t)args->iterations * nthreads;
+    uint64_t hits = (after.thread_hits - before.thread_hits) + (after.pool_hits - before.pool_hits);
+    uint64_t misses = after.misses - before.misses;
+    printf("%s %8" PRIu64 " bytes%s, %2u threads, %2u in flight: "
+           "alloc %6" PRIu64 " ns, release %6" PRIu64 " ns, hit rate %3" PRIu64 "%%\n",
+           args->pool ? "pool  " : "nopool", args->size, args->mixed ? " (mixed)" : "        ",
+           nthreads, args->inflight, alloc_ns / ops, release_ns / ops,
+           (hits + misses) ? (hits * 100) / (hits + misses) : 0);
+    return 0;
+}
+
+static void usage(const char* argv0) {
+    printf("Usage: %s [options ...]\n"
+           "\n"
+           "Options:\n"
+           "  -h    show help (this)\n"
+           "  -s    run suite (ignores -S/-T/-F/-m/-p)\n"
+           "  -n N  alloc/release pairs per thread (default: 10000)\n"
+           "  -S N  payload size in bytes (default: 4096)\n"
+           "  -T N  number of threads (default: 1)\n"
+           "  -F N  iotxns in flight per thread (default: 1)\n"
+           "  -m    mix payload sizes up to -S\n"
+           "  -p    allocate without IOTXN_ALLOC_POOL\n",
+           argv0);
+}
+
+int main(int argc, char** argv) {
+    bool run_suite = false;
+    uint32_t nthreads = 1;
+    test_args_t args = {
+        .size = PAGE_SIZE,
+        .mixed = false,
+        .pool = true,
+        .inflight = 1,
+        .iterations = 10000,
+    };
+
+    int opt;
+    while ((opt = getopt(argc, argv, "hsn:S:T:F:mp")) != -1) {
+        unsigned long long value = 0;
+        if (optarg) {
+            char* endptr;
+            errno = 0;
+            value = strtoull(optarg, &endptr, 10);
+            if ((errno != 0) || (*endptr != '\0') || (value == 0) || (value > UINT32_MAX)) {
+                fprintf(stderr, "%s: invalid numeric value '%s'\n", argv[0], optarg);
+                return -1;
+            }
+        }
+        switch (opt) {
+        case 'h':
+            usage(argv[0]);
+            return 0;
+        case 's':
+            run_suite = true;
+            break;
+        case 'n':
+            args.iterations = value;
+            break;
+        case 'S':
+            args.size = value;
+            break;
+        case 'T':
+            nthreads = (value > MAX_THREADS) ? MAX_THREADS : value;
+            break;
+        case 'F':
+            args.inflight = (value > MAX_INFLIGHT) ? MAX_INFLIGHT : value;
+            break;
+        case 'm':
+            args.mixed = true;
+            break;
+        case 'p':
+            args.pool = false;
+            break;
+        default:
+            usage(argv[0]);
+            return -1;
+        }
+    }
+
+    if (!run_suite) {
+        return do_test(&args, nthreads);
+    }
+
+    static const uint64_t sizes[] = { 0, PAGE_SIZE, 16 * PAGE_SIZE, 64 * 1024 + 512 };
+    static const uint32_t threads[] = { 1, 4 };
+    for (uint32_t pool = 0; pool < 2; pool++) {
+        for (uint32_t t = 0; t < countof(threads); t++) {
+            for (uint32_t s = 0; s < countof(sizes); s++) {
+                test_args_t suite_args = args;
+                suite_args.pool = (pool == 1);
+                suite_args.size = sizes[s];
+                suite_args.inflight = 8;
+                if (do_test(&suite_args, threads[t]) < 0) {
+                    return -1;
+                }
+            }
+            test_args_t mixed_args = args;
+            mixed_args.pool = (pool == 1);
+            mixed_args.size = 64 * 1024;
+            mixed_args.mixed = true;
+            mixed_args.inflight = 8;
+            if (do_test(&mixed_args, threads[t]) < 0) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
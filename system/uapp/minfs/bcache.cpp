@@ -19,30 +19,48 @@
 namespace minfs {
 
 mx_status_t Bcache::Readblk(uint32_t bno, void* data) {
+    return Readblks(bno, 1, data);
+}
+
+mx_status_t Bcache::Writeblk(uint32_t bno, const void* data) {
+    return Writeblks(bno, 1, data);
+}
+
+mx_status_t Bcache::Readblks(uint32_t bno, uint32_t count, void* data) {
     off_t off = bno * kMinfsBlockSize;
-    trace(IO, "readblk() bno=%u off=%#llx\n", bno, (unsigned long long)off);
+    ssize_t len = count * kMinfsBlockSize;
+    trace(IO, "readblk() bno=%u count=%u off=%#llx\n", bno, count, (unsigned long long)off);
     if (lseek(fd_, off, SEEK_SET) < 0) {
         error("minfs: cannot seek to block %u\n", bno);
         return ERR_IO;
     }
-    if (read(fd_, data, kMinfsBlockSize) != kMinfsBlockSize) {
-        error("minfs: cannot read block %u\n", bno);
+    if (read(fd_, data, len) != len) {
+        error("minfs: cannot read blocks %u-%u\n", bno, bno + count - 1);
         return ERR_IO;
     }
     return NO_ERROR;
 }
 
-mx_status_t Bcache::Writeblk(uint32_t bno, const void* data) {
+mx_status_t Bcache::Writeblks(uint32_t bno, uint32_t count, const void* data) {
     off_t off = bno * kMinfsBlockSize;
-    trace(IO, "writeblk() bno=%u off=%#llx\n", bno, (unsigned long long)off);
+    ssize_t len = count * kMinfsBlockSize;
+    trace(IO, "writeblk() bno=%u count=%u off=%#llx\n", bno, count, (unsigned long long)off);
     if (lseek(fd_, off, SEEK_SET) < 0) {
         error("minfs: cannot seek to block %u\n", bno);
         return ERR_IO;
     }
-    if (write(fd_, data, kMinfsBlockSize) != kMinfsBlockSize) {
-        error("minfs: cannot write block %u\n", bno);
+    if (write(fd_, data, len) != len) {
+        error("minfs: cannot write blocks %u-%u\n", bno, bno + count - 1);
         return ERR_IO;
     }
+    // Raw writes must not leave a stale copy of the block in the cache.
+    for (uint32_t n = 0; n < count; n++) {
+        auto blk = hash_.find(bno + n);
+        const void* src = static_cast<const char*>(data) + n * kMinfsBlockSize;
+        if (blk.IsValid() && (blk->data() != src)) {
+            memcpy(blk->data(), src, kMinfsBlockSize);
+        }
+    }
     return NO_ERROR;
 }
 
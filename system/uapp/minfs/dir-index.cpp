@@ -0,0 +1,240 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "minfs-private.h"
+
+namespace minfs {
+namespace {
+
+// Acquire the root block of a directory index, checking its header.
+mxtl::RefPtr<BlockNode> dir_index_root_get(Minfs* fs, uint32_t bno) {
+    mxtl::RefPtr<BlockNode> blk;
+    if ((blk = fs->bc_->Get(bno)) == nullptr) {
+        return nullptr;
+    }
+    const minfs_dir_index_t* root = static_cast<const minfs_dir_index_t*>(blk->data());
+    uint32_t count = root->bucket_count;
+    if ((root->magic != kMinfsDirIndexMagic) || (count == 0) ||
+        (count > kMinfsDirIndexMaxBuckets) || (count & (count - 1))) {
+        error("minfs: bad directory index @%u\n", bno);
+        fs->bc_->Put(mxtl::move(blk), 0);
+        return nullptr;
+    }
+    return blk;
+}
+
+// Acquire the bucket block which holds entries for 'hash'.
+mxtl::RefPtr<BlockNode> dir_bucket_get(Minfs* fs, const minfs_dir_index_t* root,
+                                       uint32_t hash) {
+    uint32_t bno = root->bucket[hash & (root->bucket_count - 1)];
+    mxtl::RefPtr<BlockNode> blk;
+    if ((bno == 0) || ((blk = fs->bc_->Get(bno)) == nullptr)) {
+        return nullptr;
+    }
+    if (static_cast<const minfs_dir_bucket_t*>(blk->data())->count > kMinfsDirBucketEntries) {
+        error("minfs: bad directory index bucket @%u\n", bno);
+        fs->bc_->Put(mxtl::move(blk), 0);
+        return nullptr;
+    }
+    return blk;
+}
+
+} // namespace anonymous
+
+mx_status_t VnodeMinfs::DirIndexCandidates(const char* name, size_t len, uint32_t* offs,
+                                           size_t max, size_t* actual) {
+    uint32_t hash = DirentHash(name, len);
+    mxtl::RefPtr<BlockNode> rblk;
+    if ((rblk = dir_index_root_get(fs_, inode_.dir_index)) == nullptr) {
+        return ERR_IO;
+    }
+    mxtl::RefPtr<BlockNode> bblk;
+    bblk = dir_bucket_get(fs_, static_cast<minfs_dir_index_t*>(rblk->data()), hash);
+    fs_->bc_->Put(mxtl::move(rblk), 0);
+    if (bblk == nullptr) {
+        return ERR_IO;
+    }
+
+    const minfs_dir_bucket_t* bucket = static_cast<const minfs_dir_bucket_t*>(bblk->data());
+    mx_status_t status = NO_ERROR;
+    size_t n = 0;
+    for (uint32_t e = 0; e < bucket->count; e++) {
+        if (bucket->entry[e].hash != hash) {
+            continue;
+        } else if (n == max) {
+            status = ERR_BUFFER_TOO_SMALL;
+            break;
+        }
+        offs[n++] = bucket->entry[e].off;
+    }
+    fs_->bc_->Put(mxtl::move(bblk), 0);
+    *actual = n;
+    return status;
+}
+
+// Double the number of buckets, moving each entry whose next hash bit is
+// set into the bucket's new sibling.
+//
+// A split allocates one block per existing bucket, so the last one, from
+// kMinfsDirIndexMaxBuckets / 2 buckets, allocates that many blocks at once.
+// Splits only happen when a bucket fills, so this is at most log2 of
+// kMinfsDirIndexMaxBuckets times over the life of a directory. Everything
+// that can fail happens before the index is touched: on failure the new
+// blocks are released and the index is left as it was.
+mx_status_t VnodeMinfs::DirIndexSplit(minfs_dir_index_t* root) {
+    uint32_t count = root->bucket_count;
+    if (count * 2 > kMinfsDirIndexMaxBuckets) {
+        return ERR_NO_RESOURCES;
+    }
+    mx_status_t status = NO_ERROR;
+    for (uint32_t i = 0; i < count; i++) {
+        mxtl::RefPtr<BlockNode> oblk;
+        if ((oblk = dir_bucket_get(fs_, root, i)) == nullptr) {
+            return ERR_IO;
+        }
+        fs_->bc_->Put(mxtl::move(oblk), 0);
+    }
+    uint32_t bnos[kMinfsDirIndexMaxBuckets / 2];
+    uint32_t allocated;
+    for (allocated = 0; allocated < count; allocated++) {
+        if ((status = fs_->BlockNew(root->bucket[allocated], &bnos[allocated],
+                                    nullptr)) != NO_ERROR) {
+            break;
+        }
+    }
+    if (status != NO_ERROR) {
+        for (uint32_t i = 0; i < allocated; i++) {
+            fs_->BlocksFree(bnos[i], 1);
+        }
+        return status;
+    }
+
+    // neither of these can fail: the buckets were checked and the new
+    // blocks allocated above
+    for (uint32_t i = 0; i < count; i++) {
+        mxtl::RefPtr<BlockNode> oblk = fs_->bc_->Get(root->bucket[i]);
+        mxtl::RefPtr<BlockNode> nblk = fs_->bc_->GetZero(bnos[i]);
+        minfs_dir_bucket_t* old_bucket = static_cast<minfs_dir_bucket_t*>(oblk->data());
+        minfs_dir_bucket_t* new_bucket = static_cast<minfs_dir_bucket_t*>(nblk->data());
+        uint32_t kept = 0;
+        for (uint32_t e = 0; e < old_bucket->count; e++) {
+            if (old_bucket->entry[e].hash & count) {
+                new_bucket->entry[new_bucket->count++] = old_bucket->entry[e];
+            } else {
+                old_bucket->entry[kept++] = old_bucket->entry[e];
+            }
+        }
+        old_bucket->count = kept;
+        fs_->bc_->Put(mxtl::move(oblk), kBlockDirty);
+        fs_->bc_->Put(mxtl::move(nblk), kBlockDirty);
+        root->bucket[count + i] = bnos[i];
+    }
+    root->bucket_count = count * 2;
+    inode_.block_count += count;
+    return NO_ERROR;
+}
+
+mx_status_t VnodeMinfs::DirIndexInsert(const char* name, size_t len, size_t off, bool append) {
+    uint32_t hash = DirentHash(name, len);
+    mxtl::RefPtr<BlockNode> rblk;
+    if ((rblk = dir_index_root_get(fs_, inode_.dir_index)) == nullptr) {
+        return ERR_IO;
+    }
+    minfs_dir_index_t* root = static_cast<minfs_dir_index_t*>(rblk->data());
+    uint32_t rflags = 0;
+    mx_status_t status;
+    while (true) {
+        mxtl::RefPtr<BlockNode> bblk;
+        if ((bblk = dir_bucket_get(fs_, root, hash)) == nullptr) {
+            status = ERR_IO;
+            goto done;
+        }
+        minfs_dir_bucket_t* bucket = static_cast<minfs_dir_bucket_t*>(bblk->data());
+        if (bucket->count < kMinfsDirBucketEntries) {
+            bucket->entry[bucket->count].hash = hash;
+            bucket->entry[bucket->count].off = static_cast<uint32_t>(off);
+            bucket->count++;
+            fs_->bc_->Put(mxtl::move(bblk), kBlockDirty);
+            break;
+        }
+        fs_->bc_->Put(mxtl::move(bblk), 0);
+        rflags = kBlockDirty;
+        if ((status = DirIndexSplit(root)) != NO_ERROR) {
+            goto done;
+        }
+    }
+    if (append && (root->append_off != off)) {
+        root->append_off = static_cast<uint32_t>(off);
+        rflags = kBlockDirty;
+    }
+    status = NO_ERROR;
+done:
+    fs_->bc_->Put(mxtl::move(rblk), rflags);
+    return status;
+}
+
+mx_status_t VnodeMinfs::DirIndexRemove(const char* name, size_t len, size_t off) {
+    uint32_t hash = DirentHash(name, len);
+    mxtl::RefPtr<BlockNode> rblk;
+    if ((rblk = dir_index_root_get(fs_, inode_.dir_index)) == nullptr) {
+        return ERR_IO;
+    }
+    mxtl::RefPtr<BlockNode> bblk;
+    bblk = dir_bucket_get(fs_, static_cast<minfs_dir_index_t*>(rblk->data()), hash);
+    fs_->bc_->Put(mxtl::move(rblk), 0);
+    if (bblk == nullptr) {
+        return ERR_IO;
+    }
+
+    minfs_dir_bucket_t* bucket = static_cast<minfs_dir_bucket_t*>(bblk->data());
+    for (uint32_t e = 0; e < bucket->count; e++) {
+        if ((bucket->entry[e].hash == hash) && (bucket->entry[e].off == off)) {
+            bucket->entry[e] = bucket->entry[--bucket->count];
+            fs_->bc_->Put(mxtl::move(bblk), kBlockDirty);
+            return NO_ERROR;
+        }
+    }
+    fs_->bc_->Put(mxtl::move(bblk), 0);
+    return ERR_NOT_FOUND;
+}
+
+void VnodeMinfs::DirIndexFreed(size_t free_off) {
+    mxtl::RefPtr<BlockNode> rblk;
+    if (!HasDirIndex() || ((rblk = dir_index_root_get(fs_, inode_.dir_index)) == nullptr)) {
+        return;
+    }
+    minfs_dir_index_t* root = static_cast<minfs_dir_index_t*>(rblk->data());
+    uint32_t rflags = 0;
+    if (free_off < root->append_off) {
+        root->append_off = static_cast<uint32_t>(free_off);
+        rflags = kBlockDirty;
+    }
+    fs_->bc_->Put(mxtl::move(rblk), rflags);
+}
+
+size_t VnodeMinfs::DirIndexAppendOffset() {
+    mxtl::RefPtr<BlockNode> rblk;
+    if (!HasDirIndex() || ((rblk = dir_index_root_get(fs_, inode_.dir_index)) == nullptr)) {
+        return 0;
+    }
+    size_t off = static_cast<minfs_dir_index_t*>(rblk->data())->append_off;
+    fs_->bc_->Put(mxtl::move(rblk), 0);
+    return off;
+}
+
+void VnodeMinfs::DirIndexDestroy() {
+    trace(MINFS, "DirIndexDestroy() ino=%u\n", ino_);
+    uint32_t count = 0;
+    if (fs_->DirIndexFree(inode_.dir_index, &count) != NO_ERROR) {
+        error("minfs: ino#%u: could not release directory index\n", ino_);
+    }
+    inode_.dir_index = 0;
+    inode_.block_count -= count;
+    InodeSync(kMxFsSyncDefault);
+}
+
+} // namespace minfs
@@ -0,0 +1,223 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <mxtl/algorithm.h>
+
+#include "minfs-private.h"
+
+namespace minfs {
+namespace {
+
+// Returns the number of extents in use.
+uint32_t extent_count(const minfs_inode_t* inode) {
+    uint32_t n = 0;
+    while ((n < kMinfsExtents) && (inode->extent[n].count != 0)) {
+        n++;
+    }
+    return n;
+}
+
+} // namespace anonymous
+
+mx_status_t VnodeMinfs::ExtentGetBno(uint32_t n, uint32_t* bno, bool alloc) {
+    minfs_extent_t* ext = inode_.extent;
+    uint32_t count = extent_count(&inode_);
+
+    // find the extent holding 'n', or the first one after it
+    uint32_t i;
+    for (i = 0; i < count; i++) {
+        if (n < ext[i].logical) {
+            break;
+        } else if (n < ext[i].logical + ext[i].count) {
+            *bno = ext[i].start + (n - ext[i].logical);
+            return NO_ERROR;
+        }
+    }
+    *bno = 0;
+    if (!alloc) {
+        return NO_ERROR;
+    }
+    if (n >= kMinfsMaxFileBlock) {
+        return ERR_OUT_OF_RANGE;
+    }
+
+    // aim to place 'n' where it would be had the previous extent continued
+    minfs_extent_t* prev = (i > 0) ? &ext[i - 1] : nullptr;
+    uint32_t goal = 0;
+    if (prev != nullptr) {
+        goal = prev->start + prev->count + (n - (prev->logical + prev->count));
+    }
+    uint32_t newbno;
+    mx_status_t status;
+    if ((status = ExtentBlockNew(goal, &newbno)) != NO_ERROR) {
+        return status;
+    }
+
+    if ((prev != nullptr) && (prev->logical + prev->count == n) &&
+        (prev->start + prev->count == newbno)) {
+        // grow the previous extent, absorbing the next one if they now meet
+        prev->count++;
+        if ((i < count) && (ext[i].logical == n + 1) && (ext[i].start == newbno + 1)) {
+            prev->count += ext[i].count;
+            memmove(&ext[i], &ext[i + 1], (count - i - 1) * sizeof(minfs_extent_t));
+            memset(&ext[count - 1], 0, sizeof(minfs_extent_t));
+        }
+    } else if ((i < count) && (ext[i].logical == n + 1) && (ext[i].start == newbno + 1)) {
+        // grow the next extent backwards
+        ext[i].start--;
+        ext[i].logical--;
+        ext[i].count++;
+    } else if (count < kMinfsExtents) {
+        memmove(&ext[i + 1], &ext[i], (count - i) * sizeof(minfs_extent_t));
+        ext[i].start = newbno;
+        ext[i].count = 1;
+        ext[i].logical = n;
+    } else {
+        // out of extents: switch to the block map, and map 'n' there
+        fs_->BlocksFree(newbno, 1);
+        if ((status = ExtentsConvert()) != NO_ERROR) {
+            return status;
+        }
+        return GetBno(n, bno, alloc);
+    }
+    inode_.block_count++;
+    InodeSync(kMxFsSyncDefault);
+    *bno = newbno;
+    return NO_ERROR;
+}
+
+mx_status_t VnodeMinfs::ExtentBlockNew(uint32_t goal, uint32_t* out_bno) {
+    if ((rsv_count_ != 0) && (goal == rsv_start_) &&
+        !fs_->block_map_.Get(goal, goal + 1)) {
+        // the next block of our reservation: nothing to look for
+    } else {
+        ReservationRelease();
+        // reserve more ahead of files which have already grown sequentially
+        uint32_t want = mxtl::min(mxtl::max(inode_.block_count, kMinfsReserveMin),
+                                  kMinfsReserveMax);
+        uint32_t start = goal;
+        uint32_t count = 0;
+        if ((goal == 0) || ((count = fs_->BlockRunAt(goal, want)) == 0)) {
+            mx_status_t status;
+            if ((status = fs_->BlockFindRun(goal, want, &start, &count)) != NO_ERROR) {
+                return status;
+            }
+        }
+        fs_->BlockReserve(start, count);
+        rsv_start_ = start;
+        rsv_count_ = count;
+    }
+
+    mx_status_t status;
+    if ((status = fs_->BlockAllocate(rsv_start_, nullptr)) != NO_ERROR) {
+        ReservationRelease();
+        return status;
+    }
+    *out_bno = rsv_start_++;
+    rsv_count_--;
+    return NO_ERROR;
+}
+
+void VnodeMinfs::ReservationRelease() {
+    if (rsv_count_ != 0) {
+        fs_->BlockUnreserve(rsv_start_, rsv_count_);
+        rsv_count_ = 0;
+    }
+}
+
+mx_status_t VnodeMinfs::ExtentsShrink(uint32_t start) {
+    minfs_extent_t* ext = inode_.extent;
+    uint32_t count = extent_count(&inode_);
+    bool doSync = false;
+
+    while (count > 0) {
+        minfs_extent_t* e = &ext[count - 1];
+        if (e->logical + e->count <= start) {
+            break;
+        }
+        // release the part of the extent at or past 'start'
+        uint32_t keep = (start > e->logical) ? start - e->logical : 0;
+        mx_status_t status;
+        if ((status = fs_->BlocksFree(e->start + keep, e->count - keep)) != NO_ERROR) {
+            return status;
+        }
+        inode_.block_count -= e->count - keep;
+        doSync = true;
+        if (keep != 0) {
+            e->count = keep;
+            break;
+        }
+        memset(e, 0, sizeof(*e));
+        count--;
+    }
+
+    if (doSync) {
+        InodeSync(kMxFsSyncDefault);
+    }
+    return NO_ERROR;
+}
+
+// Builds a block map holding the same blocks as the extents. The inode is
+// only rewritten once all the indirect blocks needed have been allocated,
+// so on failure the file is left as it was.
+mx_status_t VnodeMinfs::ExtentsConvert() {
+    trace(MINFS, "ExtentsConvert() ino=%u\n", ino_);
+    const uint32_t direct_per_indirect = kMinfsBlockSize / sizeof(uint32_t);
+    uint32_t count = extent_count(&inode_);
+    uint32_t dnum[kMinfsDirect] = {};
+    uint32_t inum[kMinfsIndirect] = {};
+    uint32_t icount = 0;
+
+    mxtl::RefPtr<BlockNode> iblk;
+    uint32_t cur = kMinfsIndirect;
+    mx_status_t status = NO_ERROR;
+    for (uint32_t e = 0; e < count; e++) {
+        const minfs_extent_t* ext = &inode_.extent[e];
+        for (uint32_t k = 0; k < ext->count; k++) {
+            uint32_t n = ext->logical + k;
+            if (n < kMinfsDirect) {
+                dnum[n] = ext->start + k;
+                continue;
+            }
+            uint32_t i = (n - kMinfsDirect) / direct_per_indirect;
+            uint32_t j = (n - kMinfsDirect) % direct_per_indirect;
+            if (i != cur) {
+                if (iblk != nullptr) {
+                    fs_->bc_->Put(mxtl::move(iblk), kBlockDirty);
+                }
+                // extents are sorted, so each indirect block is visited once
+                if ((status = fs_->BlockNew(ext->start, &inum[i], &iblk)) != NO_ERROR) {
+                    goto fail;
+                }
+                icount++;
+                cur = i;
+            }
+            static_cast<uint32_t*>(iblk->data())[j] = ext->start + k;
+        }
+    }
+    if (iblk != nullptr) {
+        fs_->bc_->Put(mxtl::move(iblk), kBlockDirty);
+    }
+
+    ReservationRelease();
+    memcpy(inode_.dnum, dnum, sizeof(dnum));
+    memcpy(inode_.inum, inum, sizeof(inum));
+    inode_.flags &= ~kMinfsInodeFlagExtents;
+    inode_.block_count += icount;
+    InodeSync(kMxFsSyncDefault);
+    return NO_ERROR;
+
+fail:
+    for (uint32_t i = 0; i < kMinfsIndirect; i++) {
+        if (inum[i] != 0) {
+            fs_->BlocksFree(inum[i], 1);
+        }
+    }
+    return status;
+}
+
+} // namespace minfs
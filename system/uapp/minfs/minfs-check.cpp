@@ -7,6 +7,9 @@
 #include <string.h>
 #include <unistd.h>
 
+#include <magenta/new.h>
+#include <mxtl/unique_ptr.h>
+
 #include "minfs.h"
 #include "minfs-private.h"
 
@@ -37,6 +40,20 @@ mx_status_t get_inode(const Minfs* fs, minfs_inode_t* inode, uint32_t ino) {
 
 mx_status_t get_inode_nth_bno(const Minfs* fs, minfs_inode_t* inode, uint32_t n,
                               uint32_t* bno_out) {
+    if (inode->flags & kMinfsInodeFlagExtents) {
+        if (n >= kMinfsMaxFileBlock) {
+            return ERR_OUT_OF_RANGE;
+        }
+        *bno_out = 0;
+        for (unsigned e = 0; (e < kMinfsExtents) && inode->extent[e].count; e++) {
+            const minfs_extent_t* ext = &inode->extent[e];
+            if ((n >= ext->logical) && (n - ext->logical < ext->count)) {
+                *bno_out = ext->start + (n - ext->logical);
+                break;
+            }
+        }
+        return NO_ERROR;
+    }
     if (n < kMinfsDirect) {
         *bno_out = inode->dnum[n];
         return NO_ERROR;
@@ -287,18 +304,220 @@ const char* check_data_block(CheckMaps* chk, const Minfs* fs, uint32_t bno) {
     return nullptr;
 }
 
-mx_status_t check_file(CheckMaps* chk, const Minfs* fs,
-                       minfs_inode_t* inode, uint32_t ino) {
-    info("Direct blocks: \n");
-    for (unsigned n = 0; n < kMinfsDirect; n++) {
-        info(" %d,", inode->dnum[n]);
+// Collect the offsets of all live dirents, in ascending order.
+mx_status_t collect_live_dirents(const Minfs* fs, minfs_inode_t* inode, uint32_t ino,
+                                 uint32_t* offs, uint32_t max, uint32_t* count,
+                                 bool* append_ok, uint32_t append_off) {
+    *count = 0;
+    *append_ok = false;
+    size_t off = 0;
+    while (true) {
+        uint32_t data[MINFS_DIRENT_SIZE];
+        mx_status_t status = file_read(fs, inode, data, MINFS_DIRENT_SIZE, off);
+        if (status != MINFS_DIRENT_SIZE) {
+            return status < 0 ? status : ERR_IO;
+        }
+        minfs_dirent_t* de = reinterpret_cast<minfs_dirent_t*>(data);
+        uint32_t rlen = static_cast<uint32_t>(MinfsReclen(de, off));
+        bool is_last = de->reclen & kMinfsReclenLast;
+        if (!is_last && ((rlen < MINFS_DIRENT_SIZE) || (rlen & 3))) {
+            return ERR_IO_DATA_INTEGRITY;
+        }
+        if (off == append_off) {
+            *append_ok = true;
+        }
+        if (de->ino != 0) {
+            if (*count == max) {
+                error("check: ino#%u: more dirents than dirent_count (%u)\n", ino, max);
+                return ERR_IO_DATA_INTEGRITY;
+            }
+            offs[(*count)++] = static_cast<uint32_t>(off);
+        }
+        if (is_last) {
+            return NO_ERROR;
+        }
+        off += rlen;
+    }
+}
+
+// Verify that the directory index, if there is one, holds exactly one entry
+// for every live dirent, and report how many blocks it occupies.
+mx_status_t check_dir_index(CheckMaps* chk, const Minfs* fs, minfs_inode_t* inode,
+                            uint32_t ino, uint32_t* blocks_out) {
+    *blocks_out = 0;
+    if (inode->dir_index == 0) {
+        return NO_ERROR;
+    }
+    const char* msg;
+    if ((msg = check_data_block(chk, fs, inode->dir_index)) != nullptr) {
+        error("check: ino#%u: directory index (@%u): %s\n", ino, inode->dir_index, msg);
+        return ERR_IO_DATA_INTEGRITY;
+    }
+    *blocks_out = 1;
+
+    AllocChecker ac;
+    mxtl::unique_ptr<minfs_dir_index_t> root(new (&ac) minfs_dir_index_t);
+    if (!ac.check()) {
+        return ERR_NO_MEMORY;
+    }
+    mxtl::unique_ptr<minfs_dir_bucket_t> bucket(new (&ac) minfs_dir_bucket_t);
+    if (!ac.check()) {
+        return ERR_NO_MEMORY;
+    }
+    mx_status_t status;
+    if ((status = fs->bc_->Read(inode->dir_index, root.get(), 0, sizeof(*root))) < 0) {
+        return status;
+    }
+    uint32_t nbuckets = root->bucket_count;
+    if ((root->magic != kMinfsDirIndexMagic) || (nbuckets == 0) ||
+        (nbuckets > kMinfsDirIndexMaxBuckets) || (nbuckets & (nbuckets - 1))) {
+        error("check: ino#%u: bad directory index header (magic %#x, %u buckets)\n",
+              ino, root->magic, nbuckets);
+        return ERR_IO_DATA_INTEGRITY;
+    }
+
+    uint32_t max = inode->dirent_count;
+    mxtl::unique_ptr<uint32_t[]> live(new (&ac) uint32_t[max]);
+    if (!ac.check()) {
+        return ERR_NO_MEMORY;
+    }
+    mxtl::unique_ptr<bool[]> seen(new (&ac) bool[max]());
+    if (!ac.check()) {
+        return ERR_NO_MEMORY;
+    }
+    uint32_t count;
+    bool append_ok;
+    if ((status = collect_live_dirents(fs, inode, ino, live.get(), max, &count, &append_ok,
+                                       root->append_off)) < 0) {
+        // check_directory() describes what is wrong with the dirents
+        return NO_ERROR;
+    }
+    if (!append_ok) {
+        error("check: ino#%u: directory index append offset %u is not a dirent\n",
+              ino, root->append_off);
     }
-    info(" ...\n");
 
-    uint32_t blocks = 0;
+    for (uint32_t n = 0; n < kMinfsDirIndexMaxBuckets; n++) {
+        uint32_t bno = root->bucket[n];
+        if (n >= nbuckets) {
+            if (bno != 0) {
+                error("check: ino#%u: directory index bucket %u(@%u) past bucket count\n",
+                      ino, n, bno);
+            }
+            continue;
+        }
+        if ((msg = check_data_block(chk, fs, bno)) != nullptr) {
+            error("check: ino#%u: directory index bucket %u(@%u): %s\n", ino, n, bno, msg);
+            return ERR_IO_DATA_INTEGRITY;
+        }
+        (*blocks_out)++;
+        if ((status = fs->bc_->Read(bno, bucket.get(), 0, sizeof(*bucket))) < 0) {
+            return status;
+        }
+        if (bucket->count > kMinfsDirBucketEntries) {
+            error("check: ino#%u: directory index bucket %u has %u entries\n",
+                  ino, n, bucket->count);
+            return ERR_IO_DATA_INTEGRITY;
+        }
+        for (uint32_t e = 0; e < bucket->count; e++) {
+            const minfs_dir_index_entry_t* entry = &bucket->entry[e];
+            if ((entry->hash & (nbuckets - 1)) != n) {
+                error("check: ino#%u: directory index entry for %u in wrong bucket %u\n",
+                      ino, entry->off, n);
+            }
+            const uint32_t* pos = static_cast<const uint32_t*>(
+                bsearch(&entry->off, live.get(), count, sizeof(uint32_t),
+                        [](const void* a, const void* b) -> int {
+                            uint32_t x = *static_cast<const uint32_t*>(a);
+                            uint32_t y = *static_cast<const uint32_t*>(b);
+                            return (x > y) - (x < y);
+                        }));
+            if (pos == nullptr) {
+                error("check: ino#%u: directory index entry for %u is not a live dirent\n",
+                      ino, entry->off);
+                continue;
+            }
+            size_t i = pos - live.get();
+            if (seen[i]) {
+                error("check: ino#%u: directory index has dirent %u twice\n", ino, entry->off);
+                continue;
+            }
+            seen[i] = true;
+
+            uint32_t record_full[DirentSize(NAME_MAX)];
+            minfs_dirent_t* de = reinterpret_cast<minfs_dirent_t*>(record_full);
+            if ((status = file_read(fs, inode, record_full, MINFS_DIRENT_SIZE,
+                                    entry->off)) != MINFS_DIRENT_SIZE) {
+                return status < 0 ? status : ERR_IO;
+            }
+            mx_status_t len = static_cast<mx_status_t>(DirentSize(de->namelen));
+            if ((status = file_read(fs, inode, record_full, len, entry->off)) != len) {
+                return status < 0 ? status : ERR_IO;
+            }
+            if (DirentHash(de->name, de->namelen) != entry->hash) {
+                error("check: ino#%u: directory index hash mismatch for '%.*s'\n",
+                      ino, de->namelen, de->name);
+            }
+        }
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        if (!seen[i]) {
+            error("check: ino#%u: dirent at %u missing from directory index\n", ino, live[i]);
+        }
+    }
+    return NO_ERROR;
+}
+
+// Extents must be packed, sorted, non-overlapping, and within the file size limit.
+mx_status_t check_extents(const minfs_inode_t* inode, uint32_t ino) {
+    uint32_t next = 0;
+    unsigned e;
+    for (e = 0; (e < kMinfsExtents) && inode->extent[e].count; e++) {
+        const minfs_extent_t* ext = &inode->extent[e];
+        info(" %u@%u+%u,", ext->logical, ext->start, ext->count);
+        if (ext->logical < next) {
+            error("check: ino#%u: extent %u overlaps or is out of order\n", ino, e);
+            return ERR_IO_DATA_INTEGRITY;
+        }
+        if ((ext->count > kMinfsMaxFileBlock) ||
+            (ext->logical > kMinfsMaxFileBlock - ext->count)) {
+            error("check: ino#%u: extent %u past max file size\n", ino, e);
+            return ERR_IO_DATA_INTEGRITY;
+        }
+        next = ext->logical + ext->count;
+    }
+    for (; e < kMinfsExtents; e++) {
+        const minfs_extent_t* ext = &inode->extent[e];
+        if (ext->start || ext->count || ext->logical) {
+            error("check: ino#%u: unused extent %u is not clear\n", ino, e);
+            return ERR_IO_DATA_INTEGRITY;
+        }
+    }
+    return NO_ERROR;
+}
+
+mx_status_t check_file(CheckMaps* chk, const Minfs* fs,
+                       minfs_inode_t* inode, uint32_t ino, uint32_t extra_blocks) {
+    // blocks held outside the block map (e.g. a directory index)
+    uint32_t blocks = extra_blocks;
+
+    if (inode->flags & kMinfsInodeFlagExtents) {
+        info("Extents: \n");
+        mx_status_t status;
+        if ((status = check_extents(inode, ino)) != NO_ERROR) {
+            return status;
+        }
+        info(" ...\n");
+    } else {
+        info("Direct blocks: \n");
+        for (unsigned n = 0; n < kMinfsDirect; n++) {
+            info(" %d,", inode->dnum[n]);
+        }
+        info(" ...\n");
+    }
 
     // count and sanity-check indirect blocks
-    for (unsigned n = 0; n < kMinfsIndirect; n++) {
+    for (unsigned n = 0; !(inode->flags & kMinfsInodeFlagExtents) && (n < kMinfsIndirect); n++) {
         if (inode->inum[n]) {
             const char* msg;
             if ((msg = check_data_block(chk, fs, inode->inum[n])) != nullptr) {
@@ -370,7 +589,11 @@ mx_status_t check_inode(CheckMaps* chk, const Minfs* fs, uint32_t ino, uint32_t
     if (inode.magic == kMinfsMagicDir) {
         info("ino#%u: DIR blks=%u links=%u\n",
              ino, inode.block_count, inode.link_count);
-        if ((status = check_file(chk, fs, &inode, ino)) < 0) {
+        uint32_t index_blocks;
+        if ((status = check_dir_index(chk, fs, &inode, ino, &index_blocks)) < 0) {
+            return status;
+        }
+        if ((status = check_file(chk, fs, &inode, ino, index_blocks)) < 0) {
             return status;
         }
         if ((status = check_directory(chk, fs, &inode, ino, parent, CD_DUMP)) < 0) {
@@ -382,7 +605,7 @@ mx_status_t check_inode(CheckMaps* chk, const Minfs* fs, uint32_t ino, uint32_t
     } else {
         info("ino#%u: FILE blks=%u links=%u size=%u\n",
              ino, inode.block_count, inode.link_count, inode.size);
-        if ((status = check_file(chk, fs, &inode, ino)) < 0) {
+        if ((status = check_file(chk, fs, &inode, ino, 0)) < 0) {
             return status;
         }
     }
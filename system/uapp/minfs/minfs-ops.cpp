@@ -17,6 +17,7 @@
 #ifdef __Fuchsia__
 #include <magenta/syscalls.h>
 #include <mxio/vfs.h>
+#include <mxtl/auto_lock.h>
 #endif
 
 #include "minfs-private.h"
@@ -126,6 +127,10 @@ void VnodeMinfs::InodeSync(uint32_t flags) {
 // Delete all blocks (relative to a file) from "start" (inclusive) to the end of
 // the file. Does not update mtime/atime.
 mx_status_t VnodeMinfs::BlocksShrink(uint32_t start) {
+    if (HasExtents()) {
+        return ExtentsShrink(start);
+    }
+
     mxtl::RefPtr<BlockNode> bitmap_blk = nullptr;
 
     bool doSync = false;
@@ -247,6 +252,33 @@ mx_status_t VnodeMinfs::InitVmo() {
         return status;
     }
 
+    if (HasExtents()) {
+        // Read each extent in as few device I/Os as possible.
+        AllocChecker ac;
+        mxtl::unique_ptr<char[]> buf(new (&ac) char[kMinfsMaxRunBlocks * kMinfsBlockSize]);
+        if (!ac.check()) {
+            return ERR_NO_MEMORY;
+        }
+        uint32_t blocks = static_cast<uint32_t>(mxtl::roundup(inode_.size, kMinfsBlockSize) /
+                                                kMinfsBlockSize);
+        for (uint32_t e = 0; (e < kMinfsExtents) && (inode_.extent[e].count != 0); e++) {
+            const minfs_extent_t* ext = &inode_.extent[e];
+            uint32_t end = mxtl::min(ext->logical + ext->count, blocks);
+            for (uint32_t n = ext->logical; n < end; n += kMinfsMaxRunBlocks) {
+                uint32_t count = mxtl::min(end - n, kMinfsMaxRunBlocks);
+                if (fs_->bc_->Readblks(ext->start + (n - ext->logical), count, buf.get())) {
+                    return ERR_IO;
+                }
+                if ((status = vmo_write_exact(vmo_, buf.get(), n * kMinfsBlockSize,
+                                              count * kMinfsBlockSize)) != NO_ERROR) {
+                    error("Failed to fill extent %u; error: %d\n", e, status);
+                    return status;
+                }
+            }
+        }
+        return NO_ERROR;
+    }
+
     // Initialize all direct blocks
     uint32_t bno;
     for (uint32_t d = 0; d < kMinfsDirect; d++) {
@@ -289,6 +321,10 @@ mx_status_t VnodeMinfs::InitVmo() {
 
 // Get the bno corresponding to the nth logical block within the file.
 mx_status_t VnodeMinfs::GetBno(uint32_t n, uint32_t* bno, bool alloc) {
+    if (HasExtents()) {
+        return ExtentGetBno(n, bno, alloc);
+    }
+
     uint32_t hint = 0;
     // direct blocks are simple... is there an entry in dnum[]?
     if (n < kMinfsDirect) {
@@ -499,6 +535,13 @@ mx_status_t VnodeMinfs::UnlinkChild(VnodeMinfs* childvn, minfs_dirent_t* de, Dir
     if ((status = WriteExactInternal(de, MINFS_DIRENT_SIZE, off)) != NO_ERROR) {
         goto fail;
     }
+    if (HasDirIndex()) {
+        if (DirIndexRemove(de->name, de->namelen, offs->off) != NO_ERROR) {
+            DirIndexDestroy();
+        } else {
+            DirIndexFreed(off);
+        }
+    }
 
     if (de->reclen & kMinfsReclenLast) {
         // Truncating the directory merely removed unused space; if it fails,
@@ -643,6 +686,10 @@ static mx_status_t add_dirent(VnodeMinfs* vndir, minfs_dirent_t* de, DirArgs* ar
         return status;
     }
     vndir->inode_.dirent_count++;
+    if (vndir->HasDirIndex() &&
+        (vndir->DirIndexInsert(args->name, args->len, off, true) != NO_ERROR)) {
+        vndir->DirIndexDestroy();
+    }
     if (args->type == kMinfsTypeDir) {
         // Child directory has '..' which will point to parent directory
         vndir->inode_.link_count++;
@@ -650,12 +697,53 @@ static mx_status_t add_dirent(VnodeMinfs* vndir, minfs_dirent_t* de, DirArgs* ar
     return DIR_CB_SAVE_SYNC;
 }
 
+// Merge the free dirent 'de' at 'off' with the dirent which follows it, if
+// that one is free too.
+static mx_status_t merge_free_next(VnodeMinfs* vndir, minfs_dirent_t* de, size_t off,
+                                   bool* merged) {
+    size_t off_next = off + MinfsReclen(de, off);
+    minfs_dirent_t de_next;
+    mx_status_t status;
+    *merged = false;
+    if ((status = vndir->ReadExactInternal(&de_next, MINFS_DIRENT_SIZE, off_next)) != NO_ERROR) {
+        return status;
+    } else if ((status = validate_dirent(&de_next, MINFS_DIRENT_SIZE, off_next)) != NO_ERROR) {
+        return status;
+    } else if (de_next.ino != 0) {
+        return NO_ERROR;
+    }
+    size_t coalesced_size = MinfsReclen(de, off) + MinfsReclen(&de_next, off_next);
+    if (!(de_next.reclen & kMinfsReclenLast) && (coalesced_size >= kMinfsReclenMask)) {
+        return ERR_IO;
+    }
+    de->reclen = static_cast<uint32_t>(coalesced_size & kMinfsReclenMask) |
+        (de_next.reclen & kMinfsReclenLast);
+    if ((status = vndir->WriteExactInternal(de, MINFS_DIRENT_SIZE, off)) != NO_ERROR) {
+        return status;
+    }
+    vndir->DirIndexFreed(off);
+    *merged = true;
+    return NO_ERROR;
+}
+
 static mx_status_t cb_dir_append(VnodeMinfs* vndir, minfs_dirent_t* de,
                                  DirArgs* args, DirectoryOffset* offs) {
     uint32_t reclen = static_cast<uint32_t>(MinfsReclen(de, offs->off));
     if (de->ino == 0) {
         // empty entry, do we fit?
         if (args->reclen > reclen) {
+            // Unlinking through the directory index does not coalesce with
+            // the previous dirent, so adjacent free dirents are merged here.
+            if (!(de->reclen & kMinfsReclenLast)) {
+                bool merged;
+                mx_status_t status;
+                if ((status = merge_free_next(vndir, de, offs->off, &merged)) != NO_ERROR) {
+                    return status;
+                } else if (merged) {
+                    // Revisit the grown dirent
+                    return DIR_CB_NEXT;
+                }
+            }
             return do_next_dirent(de, offs);
         }
         return add_dirent(vndir, de, args, offs->off);
@@ -689,6 +777,7 @@ static mx_status_t cb_dir_append(VnodeMinfs* vndir, minfs_dirent_t* de,
 
 // Calls a callback 'func' on all direntries in a directory 'vn' with the
 // provided arguments, reacting to the return code of the callback.
+// Iteration begins at 'start', which must be the offset of a dirent.
 //
 // When 'func' is called, it receives a few arguments:
 //  'vndir': The directory on which the callback is operating
@@ -699,14 +788,12 @@ static mx_status_t cb_dir_append(VnodeMinfs* vndir, minfs_dirent_t* de,
 //  'offs': Offset info about where in the directory this direntry is located.
 //          Since 'func' may create / remove surrounding dirents, it is responsible for
 //          updating the offset information to access the next dirent.
-mx_status_t VnodeMinfs::ForEachDirent(DirArgs* args,
-                                      mx_status_t (*func)(VnodeMinfs*, minfs_dirent_t*, DirArgs*,
-                                                          DirectoryOffset*)) {
+mx_status_t VnodeMinfs::ForEachDirent(DirArgs* args, DirentCallback func, size_t start) {
     char data[kMinfsMaxDirentSize];
     minfs_dirent_t* de = (minfs_dirent_t*) data;
     DirectoryOffset offs = {
-        .off = 0,
-        .off_prev = 0,
+        .off = start,
+        .off_prev = start,
     };
     while (offs.off + MINFS_DIRENT_SIZE < kMinfsMaxDirectorySize) {
         trace(MINFS, "Reading dirent at offset %zd\n", offs.off);
@@ -733,9 +820,126 @@ mx_status_t VnodeMinfs::ForEachDirent(DirArgs* args,
     return ERR_NOT_FOUND;
 }
 
+// Rather than scanning the whole directory, only visit the dirents the
+// directory index says may match; there is almost always just one.
+constexpr size_t kMaxIndexCandidates = 8;
+
+mx_status_t VnodeMinfs::LookupDirent(DirArgs* args, DirentCallback func) {
+    uint32_t candidates[kMaxIndexCandidates];
+    size_t count;
+    if (!HasDirIndex() ||
+        (DirIndexCandidates(args->name, args->len, candidates, countof(candidates),
+                            &count) != NO_ERROR)) {
+        return ForEachDirent(args, func);
+    }
+
+    char data[kMinfsMaxDirentSize];
+    minfs_dirent_t* de = (minfs_dirent_t*) data;
+    for (size_t i = 0; i < count; i++) {
+        size_t off = candidates[i];
+        size_t r;
+        mx_status_t status = ReadInternal(data, kMinfsMaxDirentSize, off, &r);
+        if (status != NO_ERROR) {
+            return status;
+        } else if ((status = validate_dirent(de, r, off)) != NO_ERROR) {
+            return status;
+        } else if ((de->ino == 0) || (de->namelen != args->len) ||
+                   memcmp(de->name, args->name, args->len)) {
+            continue;
+        }
+
+        DirectoryOffset offs = {
+            .off = off,
+            .off_prev = off,
+        };
+        switch ((status = func(this, de, args, &offs))) {
+        case DIR_CB_NEXT:
+            return ERR_NOT_FOUND;
+        case DIR_CB_SAVE_SYNC:
+            inode_.seq_num++;
+            InodeSync(kMxFsSyncMtime);
+            return NO_ERROR;
+        case DIR_CB_DONE:
+        default:
+            return status;
+        }
+    }
+    return ERR_NOT_FOUND;
+}
+
+mx_status_t VnodeMinfs::AppendDirent(DirArgs* args) {
+    // Indexed directories remember where the last dirent was added (or the
+    // lowest dirent freed since), and start looking for space there.
+    size_t start = DirIndexAppendOffset();
+    mx_status_t status = ForEachDirent(args, cb_dir_append, start);
+    if ((status == ERR_NOT_FOUND) && (start != 0)) {
+        status = ForEachDirent(args, cb_dir_append);
+    }
+
+    // Index the directory once it is large enough to benefit. Should that
+    // fail, only try again once the directory has doubled in size.
+    uint32_t count = inode_.dirent_count;
+    if ((status == NO_ERROR) && !HasDirIndex() &&
+        (count >= kMinfsDirIndexMinEntries) && ((count & (count - 1)) == 0)) {
+        mx_status_t index_status = DirIndexCreate();
+        if (index_status != NO_ERROR) {
+            warn("minfs: ino#%u: could not index directory: %d\n", ino_, index_status);
+        }
+    }
+    return status;
+}
+
+static mx_status_t cb_dir_index(VnodeMinfs* vndir, minfs_dirent_t* de,
+                                DirArgs* args, DirectoryOffset* offs) {
+    if (de->ino != 0) {
+        mx_status_t status = vndir->DirIndexInsert(de->name, de->namelen, offs->off, false);
+        if (status != NO_ERROR) {
+            return status;
+        }
+    }
+    return do_next_dirent(de, offs);
+}
+
+mx_status_t VnodeMinfs::DirIndexCreate() {
+    trace(MINFS, "DirIndexCreate() ino=%u dirents=%u\n", ino_, inode_.dirent_count);
+    uint32_t bno;
+    mxtl::RefPtr<BlockNode> rblk;
+    mx_status_t status;
+    if ((status = fs_->BlockNew(0, &bno, &rblk)) != NO_ERROR) {
+        return status;
+    }
+    uint32_t bucket_bno;
+    mxtl::RefPtr<BlockNode> bblk;
+    if ((status = fs_->BlockNew(bno, &bucket_bno, &bblk)) != NO_ERROR) {
+        fs_->bc_->Put(rblk, kBlockDirty);
+        fs_->DirIndexFree(bno, nullptr);
+        return status;
+    }
+    fs_->bc_->Put(bblk, kBlockDirty);
+
+    minfs_dir_index_t* root = static_cast<minfs_dir_index_t*>(rblk->data());
+    root->magic = kMinfsDirIndexMagic;
+    root->bucket_count = 1;
+    root->append_off = 0;
+    root->bucket[0] = bucket_bno;
+    fs_->bc_->Put(rblk, kBlockDirty);
+    inode_.dir_index = bno;
+    inode_.block_count += 2;
+
+    // Walking off the end of the directory is the only success
+    DirArgs args = DirArgs();
+    if ((status = ForEachDirent(&args, cb_dir_index)) != ERR_NOT_FOUND) {
+        DirIndexDestroy();
+        return (status < 0) ? status : ERR_IO;
+    }
+    InodeSync(kMxFsSyncDefault);
+    return NO_ERROR;
+}
+
 void VnodeMinfs::Release() {
     trace(MINFS, "minfs_release() vn=%p(#%u)%s\n", this, ino_,
           inode_.link_count ? "" : " link-count is zero");
+    ReservationRelease();
     if (inode_.link_count == 0) {
         InodeDestroy();
     }
@@ -788,12 +992,15 @@ mx_status_t VnodeMinfs::ReadInternal(void* data, size_t len, size_t off, size_t*
 
     mx_status_t status;
 #ifdef __Fuchsia__
-    if ((status = InitVmo()) != NO_ERROR) {
-        return status;
-    } else if ((status = mx_vmo_read(vmo_, data, off, len, actual)) != NO_ERROR) {
-        return status;
+    // Directories are read a block at a time through the block cache rather
+    // than a VMO, so touching one dirent does not read the whole directory.
+    if (!IsDirectory()) {
+        if ((status = InitVmo()) != NO_ERROR) {
+            return status;
+        }
+        return mx_vmo_read(vmo_, data, off, len, actual);
     }
-#else
+#endif
     void* start = data;
     uint32_t n = off / kMinfsBlockSize;
     size_t adjust = off % kMinfsBlockSize;
@@ -811,11 +1018,10 @@ mx_status_t VnodeMinfs::ReadInternal(void* data, size_t len, size_t off, size_t*
             return status;
         }
         if (bno != 0) {
-            char bdata[kMinfsBlockSize];
-            if (fs_->bc_->Readblk(bno, bdata)) {
+            if (fs_->bc_->Read(bno, data, static_cast<uint32_t>(adjust),
+                               static_cast<uint32_t>(xfer)) != NO_ERROR) {
                 return ERR_IO;
             }
-            memcpy(data, bdata + adjust, xfer);
         } else {
             // If the block is not allocated, just read zeros
             memset(data, 0, xfer);
@@ -827,7 +1033,6 @@ mx_status_t VnodeMinfs::ReadInternal(void* data, size_t len, size_t off, size_t*
         n++;
     }
     *actual = (uintptr_t)data - (uintptr_t)start;
-#endif
     return NO_ERROR;
 }
 
@@ -856,13 +1061,19 @@ mx_status_t VnodeMinfs::WriteInternal(const void* data, size_t len, size_t off,
 
     mx_status_t status;
 #ifdef __Fuchsia__
-    if ((status = InitVmo()) != NO_ERROR) {
+    if (!IsDirectory() && ((status = InitVmo()) != NO_ERROR)) {
         return status;
     }
 #endif
     const void* const start = data;
     uint32_t n = static_cast<uint32_t>(off / kMinfsBlockSize);
     size_t adjust = off % kMinfsBlockSize;
+#ifdef __Fuchsia__
+    // Whole blocks which are contiguous on disk are written in one go.
+    uint32_t run_bno = 0;
+    uint32_t run_count = 0;
+    const void* run_data = nullptr;
+#endif
 
     while ((len > 0) && (n < kMinfsMaxFileBlock)) {
         size_t xfer;
@@ -873,58 +1084,65 @@ mx_status_t VnodeMinfs::WriteInternal(const void* data, size_t len, size_t off,
         }
 
 #ifdef __Fuchsia__
-        size_t xfer_off = n * kMinfsBlockSize + adjust;
-        if ((xfer_off + xfer) > inode_.size) {
-            size_t new_size = xfer_off + xfer;
-            if ((status = mx_vmo_set_size(vmo_, mxtl::roundup(new_size, kMinfsBlockSize))) != NO_ERROR) {
+        if (IsDirectory()) {
+            if ((status = WriteBlockCached(n, adjust, data, xfer)) != NO_ERROR) {
                 goto done;
             }
-            inode_.size = static_cast<uint32_t>(new_size);
-        }
-
-        // TODO(smklein): If a failure occurs after writing to the VMO, but
-        // before updating the data to disk, then our in-memory representation
-        // of the file may not be consistent with the on-disk representation of
-        // the file. As a consequence, an error is returned (ERR_IO) rather than
-        // doing a partial read.
+        } else {
+            size_t xfer_off = n * kMinfsBlockSize + adjust;
+            if ((xfer_off + xfer) > inode_.size) {
+                size_t new_size = xfer_off + xfer;
+                if ((status = mx_vmo_set_size(vmo_, mxtl::roundup(new_size, kMinfsBlockSize))) != NO_ERROR) {
+                    goto done;
+                }
+                inode_.size = static_cast<uint32_t>(new_size);
+            }
 
-        // Update this block of the in-memory VMO
-        if ((status = vmo_write_exact(vmo_, data, xfer_off, xfer)) != NO_ERROR) {
-            return ERR_IO;
-        }
+            // TODO(smklein): If a failure occurs after writing to the VMO, but
+            // before updating the data to disk, then our in-memory representation
+            // of the file may not be consistent with the on-disk representation of
+            // the file. As a consequence, an error is returned (ERR_IO) rather than
+            // doing a partial read.
 
-        // Update this block on-disk
-        char bdata[kMinfsBlockSize];
-        // TODO(smklein): Can we write directly from the VMO to the block device,
-        // preventing the need for a 'bdata' variable?
-        if (xfer != kMinfsBlockSize) {
-            if (vmo_read_exact(vmo_, bdata, n * kMinfsBlockSize, kMinfsBlockSize) != NO_ERROR) {
+            // Update this block of the in-memory VMO
+            if ((status = vmo_write_exact(vmo_, data, xfer_off, xfer)) != NO_ERROR) {
                 return ERR_IO;
             }
-        }
-        const void* wdata = (xfer != kMinfsBlockSize) ? bdata : data;
-        uint32_t bno;
-        if ((status = GetBno(n, &bno, true)) != NO_ERROR) {
-            return status;
-        }
-        assert(bno != 0);
-        if (fs_->bc_->Writeblk(bno, wdata)) {
-            return ERR_IO;
+
+            // Update this block on-disk
+            uint32_t bno;
+            if ((status = GetBno(n, &bno, true)) != NO_ERROR) {
+                return status;
+            }
+            assert(bno != 0);
+            if (xfer == kMinfsBlockSize) {
+                if ((run_count != 0) && (bno == run_bno + run_count) &&
+                    (run_count < kMinfsMaxRunBlocks)) {
+                    run_count++;
+                } else {
+                    if ((run_count != 0) && fs_->bc_->Writeblks(run_bno, run_count, run_data)) {
+                        return ERR_IO;
+                    }
+                    run_bno = bno;
+                    run_count = 1;
+                    run_data = data;
+                }
+            } else {
+                // TODO(smklein): Can we write directly from the VMO to the block device,
+                // preventing the need for a 'bdata' variable?
+                char bdata[kMinfsBlockSize];
+                if (vmo_read_exact(vmo_, bdata, n * kMinfsBlockSize, kMinfsBlockSize) != NO_ERROR) {
+                    return ERR_IO;
+                }
+                if (fs_->bc_->Writeblk(bno, bdata)) {
+                    return ERR_IO;
+                }
+            }
         }
 #else
-        uint32_t bno;
-        if ((status = GetBno(n, &bno, true)) != NO_ERROR) {
+        if ((status = WriteBlockCached(n, adjust, data, xfer)) != NO_ERROR) {
             goto done;
         }
-        assert(bno != 0);
-        char wdata[kMinfsBlockSize];
-        if (fs_->bc_->Readblk(bno, wdata)) {
-            return ERR_IO;
-        }
-        memcpy(wdata + adjust, data, xfer);
-        if (fs_->bc_->Writeblk(bno, wdata)) {
-            return ERR_IO;
-        }
 #endif
 
         adjust = 0;
@@ -934,6 +1152,11 @@ mx_status_t VnodeMinfs::WriteInternal(const void* data, size_t len, size_t off,
     }
 
 done:
+#ifdef __Fuchsia__
+    if ((run_count != 0) && fs_->bc_->Writeblks(run_bno, run_count, run_data)) {
+        return ERR_IO;
+    }
+#endif
     len = (uintptr_t)data - (uintptr_t)start;
     if (len == 0) {
         // If more than zero bytes were requested, but zero bytes were written,
@@ -952,6 +1175,21 @@ done:
     return NO_ERROR;
 }
 
+mx_status_t VnodeMinfs::WriteBlockCached(uint32_t n, size_t adjust, const void* data,
+                                         size_t xfer) {
+    uint32_t bno;
+    mx_status_t status;
+    if ((status = GetBno(n, &bno, true)) != NO_ERROR) {
+        return status;
+    }
+    assert(bno != 0);
+    if (fs_->bc_->Write(bno, data, static_cast<uint32_t>(adjust),
+                        static_cast<uint32_t>(xfer)) != NO_ERROR) {
+        return ERR_IO;
+    }
+    return NO_ERROR;
+}
+
 mx_status_t VnodeMinfs::Lookup(fs::Vnode** out, const char* name, size_t len) {
     trace(MINFS, "minfs_lookup() vn=%p(#%u) name='%.*s'\n", this, ino_, (int)len, name);
     assert(len <= kMinfsMaxNameSize);
@@ -965,7 +1203,7 @@ mx_status_t VnodeMinfs::Lookup(fs::Vnode** out, const char* name, size_t len) {
     args.name = name;
     args.len = len;
     mx_status_t status;
-    if ((status = ForEachDirent(&args, cb_dir_find)) < 0) {
+    if ((status = LookupDirent(&args, cb_dir_find)) < 0) {
         return status;
     }
     VnodeMinfs* vn;
@@ -1086,9 +1324,10 @@ fail:
 }
 
 #ifdef __Fuchsia__
-VnodeMinfs::VnodeMinfs(Minfs* fs) : fs_(fs), vmo_(MX_HANDLE_INVALID) {}
+VnodeMinfs::VnodeMinfs(Minfs* fs) : fs_(fs), vmo_(MX_HANDLE_INVALID),
+    rsv_start_(0), rsv_count_(0) {}
 #else
-VnodeMinfs::VnodeMinfs(Minfs* fs) : fs_(fs) {}
+VnodeMinfs::VnodeMinfs(Minfs* fs) : fs_(fs), rsv_start_(0), rsv_count_(0) {}
 #endif
 
 mx_status_t VnodeMinfs::Allocate(Minfs* fs, uint32_t type, VnodeMinfs** out) {
@@ -1100,6 +1339,9 @@ mx_status_t VnodeMinfs::Allocate(Minfs* fs, uint32_t type, VnodeMinfs** out) {
     (*out)->inode_.magic = MinfsMagic(type);
     (*out)->inode_.create_time = (*out)->inode_.modify_time = minfs_gettime_utc();
     (*out)->inode_.link_count = (type == kMinfsTypeDir ? 2 : 1);
+    if (type == kMinfsTypeFile) {
+        (*out)->inode_.flags = kMinfsInodeFlagExtents;
+    }
     return NO_ERROR;
 }
 
@@ -1129,7 +1371,7 @@ mx_status_t VnodeMinfs::Create(fs::Vnode** out, const char* name, size_t len, ui
     args.len = len;
     // ensure file does not exist
     mx_status_t status;
-    if ((status = ForEachDirent(&args, cb_dir_find)) != ERR_NOT_FOUND) {
+    if ((status = LookupDirent(&args, cb_dir_find)) != ERR_NOT_FOUND) {
         return ERR_ALREADY_EXISTS;
     }
 
@@ -1159,7 +1401,7 @@ mx_status_t VnodeMinfs::Create(fs::Vnode** out, const char* name, size_t len, ui
     args.ino = vn->ino_;
     args.type = type;
     args.reclen = static_cast<uint32_t>(DirentSize(static_cast<uint8_t>(len)));
-    if ((status = ForEachDirent(&args, cb_dir_append)) < 0) {
+    if ((status = AppendDirent(&args)) < 0) {
         vn->Release(); // vn refcount +0
         return status;
     }
@@ -1181,6 +1423,8 @@ ssize_t VnodeMinfs::Ioctl(uint32_t op, const void* in_buf, size_t in_len, void*
             return strlen(kFsName);
         }
         case IOCTL_DEVMGR_UNMOUNT_FS: {
+            // Called with vfs_lock held, which Vfs::Ioctl keeps until it
+            // exits, so no other thread touches the disk after this.
             mx_status_t status = Sync();
             if (status != NO_ERROR) {
                 error("minfs unmount failed to sync; unmounting anyway: %d\n", status);
@@ -1210,7 +1454,7 @@ mx_status_t VnodeMinfs::Unlink(const char* name, size_t len, bool must_be_dir) {
     args.name = name;
     args.len = len;
     args.type = must_be_dir ? kMinfsTypeDir : 0;
-    return ForEachDirent(&args, cb_dir_unlink);
+    return LookupDirent(&args, cb_dir_unlink);
 }
 
 mx_status_t VnodeMinfs::Truncate(size_t len) {
@@ -1229,7 +1473,7 @@ mx_status_t VnodeMinfs::Truncate(size_t len) {
 mx_status_t VnodeMinfs::TruncateInternal(size_t len) {
     mx_status_t r = 0;
 #ifdef __Fuchsia__
-    if (InitVmo() != NO_ERROR) {
+    if (!IsDirectory() && (InitVmo() != NO_ERROR)) {
         return ERR_IO;
     }
 #endif
@@ -1262,15 +1506,23 @@ mx_status_t VnodeMinfs::TruncateInternal(size_t len) {
             if (bno != 0) {
                 size_t adjust = len % kMinfsBlockSize;
 #ifdef __Fuchsia__
-                if ((r = vmo_read_exact(vmo_, bdata, len - adjust, adjust)) != NO_ERROR) {
-                    return ERR_IO;
-                }
-                memset(bdata + adjust, 0, kMinfsBlockSize - adjust);
+                if (IsDirectory()) {
+                    if (fs_->bc_->Readblk(bno, bdata)) {
+                        return ERR_IO;
+                    }
+                    memset(bdata + adjust, 0, kMinfsBlockSize - adjust);
+                } else {
+                    if ((r = vmo_read_exact(vmo_, bdata, len - adjust, adjust)) != NO_ERROR) {
+                        return ERR_IO;
+                    }
+                    memset(bdata + adjust, 0, kMinfsBlockSize - adjust);
 
-                // TODO(smklein): Remove this write when shrinking VMO size
-                // automatically sets partial pages to zero.
-                if ((r = vmo_write_exact(vmo_, bdata, len - adjust, kMinfsBlockSize)) != NO_ERROR) {
-                    return ERR_IO;
+                    // TODO(smklein): Remove this write when shrinking VMO size
+                    // automatically sets partial pages to zero.
+                    if ((r = vmo_write_exact(vmo_, bdata, len - adjust,
+                                             kMinfsBlockSize)) != NO_ERROR) {
+                        return ERR_IO;
+                    }
                 }
 #else
                 if (fs_->bc_->Readblk(bno, bdata)) {
@@ -1297,7 +1549,8 @@ mx_status_t VnodeMinfs::TruncateInternal(size_t len) {
     }
 
 #ifdef __Fuchsia__
-    if ((r = mx_vmo_set_size(vmo_, mxtl::roundup(len, kMinfsBlockSize))) != NO_ERROR) {
+    if (!IsDirectory() &&
+        ((r = mx_vmo_set_size(vmo_, mxtl::roundup(len, kMinfsBlockSize))) != NO_ERROR)) {
         return r;
     }
 #endif
@@ -1360,7 +1613,7 @@ mx_status_t VnodeMinfs::Rename(fs::Vnode* _newdir, const char* oldname, size_t o
     DirArgs args = DirArgs();
     args.name = oldname;
     args.len = oldlen;
-    if ((status = ForEachDirent(&args, cb_dir_find)) < 0) {
+    if ((status = LookupDirent(&args, cb_dir_find)) < 0) {
         return status;
     } else if ((status = fs_->VnodeGet(&oldvn, args.ino)) < 0) {
         return status;
@@ -1380,11 +1633,11 @@ mx_status_t VnodeMinfs::Rename(fs::Vnode* _newdir, const char* oldname, size_t o
     args.len = newlen;
     args.ino = oldvn->ino_;
     args.type = oldvn->IsDirectory() ? kMinfsTypeDir : kMinfsTypeFile;
-    status = newdir->ForEachDirent(&args, cb_dir_attempt_rename);
+    status = newdir->LookupDirent(&args, cb_dir_attempt_rename);
     if (status == ERR_NOT_FOUND) {
         // if 'newname' does not exist, create it
         args.reclen = static_cast<uint32_t>(DirentSize(static_cast<uint8_t>(newlen)));
-        if ((status = newdir->ForEachDirent(&args, cb_dir_append)) < 0) {
+        if ((status = newdir->AppendDirent(&args)) < 0) {
             goto done;
         }
         status = NO_ERROR;
@@ -1403,7 +1656,7 @@ mx_status_t VnodeMinfs::Rename(fs::Vnode* _newdir, const char* oldname, size_t o
         args.name = "..";
         args.len = 2;
         args.ino = newdir->ino_;
-        if ((status = vn->ForEachDirent(&args, cb_dir_update_inode)) < 0) {
+        if ((status = vn->LookupDirent(&args, cb_dir_update_inode)) < 0) {
             vn->RefRelease();
             goto done;
         }
@@ -1417,7 +1670,7 @@ mx_status_t VnodeMinfs::Rename(fs::Vnode* _newdir, const char* oldname, size_t o
     // finally, remove oldname from its original position
     args.name = oldname;
     args.len = oldlen;
-    status = ForEachDirent(&args, cb_dir_force_unlink);
+    status = LookupDirent(&args, cb_dir_force_unlink);
 done:
     oldvn->RefRelease();
     return status;
@@ -1450,14 +1703,14 @@ mx_status_t VnodeMinfs::Link(const char* name, size_t len, fs::Vnode* _target) {
     args.name = name;
     args.len = len;
     mx_status_t status;
-    if ((status = ForEachDirent(&args, cb_dir_find)) != ERR_NOT_FOUND) {
+    if ((status = LookupDirent(&args, cb_dir_find)) != ERR_NOT_FOUND) {
         return (status == NO_ERROR) ? ERR_ALREADY_EXISTS : status;
     }
 
     args.ino = target->ino_;
     args.type = kMinfsTypeFile; // We can't hard link directories
     args.reclen = static_cast<uint32_t>(DirentSize(static_cast<uint8_t>(len)));
-    if ((status = ForEachDirent(&args, cb_dir_append)) < 0) {
+    if ((status = AppendDirent(&args)) < 0) {
         return status;
     }
 
@@ -29,6 +29,14 @@ constexpr uint32_t kMxFsSyncCtime   = (1<<1);
 
 constexpr uint32_t kMinfsBlockCacheSize = 64;
 
+// Bounds on the number of blocks reserved ahead of a sequential writer
+// of an extent-mapped file. The window grows with the file.
+constexpr uint32_t kMinfsReserveMin = 8;
+constexpr uint32_t kMinfsReserveMax = 256;
+
+// Largest run of blocks moved in a single device I/O.
+constexpr uint32_t kMinfsMaxRunBlocks = 32;
+
 // Used by fsck
 struct CheckMaps {
     RawBitmap checked_inodes;
@@ -59,9 +67,35 @@ public:
     // Acquires the block if out_block is not null.
     mx_status_t BlockNew(uint32_t hint, uint32_t* out_bno, mxtl::RefPtr<BlockNode>* out_block);
 
+    // Allocate the free block 'bno', as BlockNew() does.
+    mx_status_t BlockAllocate(uint32_t bno, mxtl::RefPtr<BlockNode>* out_block);
+
+    // Release 'count' blocks starting at 'start' in the block bitmap.
+    mx_status_t BlocksFree(uint32_t start, uint32_t count);
+
+    // Find up to 'want' contiguous blocks which are neither allocated nor
+    // reserved, searching from 'hint'. A run of the full length is preferred
+    // over a shorter one closer to 'hint'. Nothing is allocated.
+    mx_status_t BlockFindRun(uint32_t hint, uint32_t want,
+                             uint32_t* out_start, uint32_t* out_count);
+
+    // Returns how many of the 'want' blocks starting at 'start' are free and
+    // unreserved, stopping at the first which is not.
+    uint32_t BlockRunAt(uint32_t start, uint32_t want) const;
+
+    // Reservations keep other allocations away from a run of free blocks.
+    // They live only in memory and are advisory: when no unreserved block
+    // is left, BlockNew() takes reserved ones.
+    void BlockReserve(uint32_t start, uint32_t count);
+    void BlockUnreserve(uint32_t start, uint32_t count);
+
     // free ino in inode bitmap, release all blocks held by inode
     mx_status_t InoFree(const minfs_inode_t& inode, uint32_t ino);
 
+    // release the blocks of the directory index rooted at 'bno', returning
+    // the number of blocks released in 'out_count' (if not null)
+    mx_status_t DirIndexFree(uint32_t bno, uint32_t* out_count);
+
     // Writes back an inode into the inode table on persistent storage.
     // Does not modify inode bitmap.
     mx_status_t InodeSync(uint32_t ino, const minfs_inode_t* inode);
@@ -89,10 +123,13 @@ private:
     // Find a free inode, allocate it in the inode bitmap, and write it back to disk
     mx_status_t InoNew(const minfs_inode_t* inode, uint32_t* ino_out);
     mx_status_t LoadBitmaps();
+    // Find a run of 'run_len' blocks which are free and unreserved in [start, end).
+    mx_status_t FindUnreserved(size_t start, size_t end, size_t run_len, size_t* out) const;
 
     uint32_t abmblks_;
     uint32_t ibmblks_;
     RawBitmap inode_map_;
+    RawBitmap reserved_map_;
 #ifdef __Fuchsia__
     mxtl::unique_ptr<MappedVmo> inode_table_;
 #endif
@@ -130,6 +167,7 @@ public:
     static mx_status_t AllocateHollow(Minfs* fs, VnodeMinfs** out);
 
     bool IsDirectory() const { return inode_.magic == kMinfsMagicDir; }
+    bool HasExtents() const { return inode_.flags & kMinfsInodeFlagExtents; }
     bool IsDeletedDirectory() const { return flags_ & kMinfsFlagDeletedDirectory; }
     bool CanUnlink() const;
 
@@ -137,6 +175,18 @@ public:
     static size_t GetHash(uint32_t key) { return INO_HASH(key); }
 
     mx_status_t UnlinkChild(VnodeMinfs* child, minfs_dirent_t* de, DirectoryOffset* offs);
+
+    // Directory hash index (dir-index.cpp). Index maintenance failures are
+    // not fatal: the index is dropped and lookups fall back to ForEachDirent.
+    bool HasDirIndex() const { return inode_.dir_index != 0; }
+    // Records the live dirent at 'off'. If 'append', 'off' also becomes the
+    // offset at which the next search for free space starts.
+    mx_status_t DirIndexInsert(const char* name, size_t len, size_t off, bool append);
+    // Forgets the dirent at 'off'.
+    mx_status_t DirIndexRemove(const char* name, size_t len, size_t off);
+    // Notes that the free record at 'free_off' may have room for new dirents.
+    void DirIndexFreed(size_t free_off);
+    void DirIndexDestroy();
     mx_status_t ReadInternal(void* data, size_t len, size_t off, size_t* actual);
     mx_status_t ReadExactInternal(void* data, size_t len, size_t off);
     mx_status_t WriteInternal(const void* data, size_t len, size_t off, size_t* actual);
@@ -187,21 +237,50 @@ private:
     // of the file. Does not update mtime/atime.
     mx_status_t BlocksShrink(uint32_t start);
 
+    // Extent-mapped files (extent.cpp): counterparts of GetBno and BlocksShrink.
+    mx_status_t ExtentGetBno(uint32_t n, uint32_t* bno, bool alloc);
+    mx_status_t ExtentsShrink(uint32_t start);
+    // Allocate a block for a file, at 'goal' if possible, from (or starting)
+    // this vnode's reservation.
+    mx_status_t ExtentBlockNew(uint32_t goal, uint32_t* out_bno);
+    // Rewrite the inode to use the block map, once it has run out of extents.
+    mx_status_t ExtentsConvert();
+    // Give back the unused part of the reservation.
+    void ReservationRelease();
+
     // Update the vnode's inode and write it to disk
     void InodeSync(uint32_t flags);
     // Destroy the inode on disk (and free associated resources)
     mx_status_t InodeDestroy();
 
     // Directories only
-    mx_status_t ForEachDirent(DirArgs* args,
-                              mx_status_t (*func)(VnodeMinfs*, minfs_dirent_t*, DirArgs*,
-                                                  DirectoryOffset*));
+    using DirentCallback = mx_status_t (*)(VnodeMinfs*, minfs_dirent_t*, DirArgs*,
+                                           DirectoryOffset*);
+    mx_status_t ForEachDirent(DirArgs* args, DirentCallback func, size_t start = 0);
+    // Calls 'func' on the dirent named by 'args' only, consulting the hash
+    // index if there is one. 'func' sees no previous dirent.
+    mx_status_t LookupDirent(DirArgs* args, DirentCallback func);
+    // Adds the dirent described by 'args', in the first free space found.
+    mx_status_t AppendDirent(DirArgs* args);
+    mx_status_t DirIndexCreate();
+    // Returns the offsets of all dirents whose name hashes like 'name', or
+    // ERR_BUFFER_TOO_SMALL if there are more than 'max' of them.
+    mx_status_t DirIndexCandidates(const char* name, size_t len, uint32_t* offs,
+                                   size_t max, size_t* actual);
+    mx_status_t DirIndexSplit(minfs_dir_index_t* root);
+    size_t DirIndexAppendOffset();
+
+    // Writes 'xfer' bytes to the 'nth' block of the file at 'adjust', through
+    // the block cache, allocating the block if needed.
+    mx_status_t WriteBlockCached(uint32_t n, size_t adjust, const void* data, size_t xfer);
 
 #ifdef __Fuchsia__
     // The following functionality interacts with handles directly, and are not applicable outside
     // Fuchsia (since there is no "handle-equivalent" in host-side tools).
     mx_status_t GetHandles(uint32_t flags, mx_handle_t* hnds,
                            uint32_t* type, void* extra, uint32_t* esize) final;
+    mx_status_t Mmap(uint32_t flags, mx_handle_t* out, size_t* off, size_t* len) final;
+    bool CanReadConcurrently() final;
 
     // TODO(smklein): When we have can register MinFS as a pager service, and
     // it can properly handle pages faults on a vnode's contents, then we can
@@ -209,6 +288,10 @@ private:
     // a VMO into memory when it is read/written.
     mx_handle_t vmo_;
 #endif
+
+    // Blocks reserved for the next appends to this (extent-mapped) file.
+    uint32_t rsv_start_;
+    uint32_t rsv_count_;
 };
 
 // write the inode data of this vnode to disk (default does not update time values)
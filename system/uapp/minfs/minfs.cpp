@@ -105,6 +105,20 @@ mx_status_t Minfs::InoFree(const minfs_inode_t& inode, uint32_t ino) {
     memcpy(block_ibm->data(), bmdata, kMinfsBlockSize);
     bc_->Put(block_ibm, kBlockDirty);
 
+    if (inode.flags & kMinfsInodeFlagExtents) {
+        // release all extents
+        for (unsigned n = 0; (n < kMinfsExtents) && (inode.extent[n].count != 0); n++) {
+            mx_status_t status = BlocksFree(inode.extent[n].start, inode.extent[n].count);
+            if (status != NO_ERROR) {
+                return status;
+            }
+        }
+        if (inode.dir_index != 0) {
+            return DirIndexFree(inode.dir_index, nullptr);
+        }
+        return NO_ERROR;
+    }
+
     mxtl::RefPtr<BlockNode> bitmap_blk;
 
     // release all direct blocks
@@ -149,6 +163,50 @@ mx_status_t Minfs::InoFree(const minfs_inode_t& inode, uint32_t ino) {
     }
     BitmapBlockPut(bitmap_blk);
 
+    // release the directory index, if any
+    if (inode.dir_index != 0) {
+        return DirIndexFree(inode.dir_index, nullptr);
+    }
+    return NO_ERROR;
+}
+
+mx_status_t Minfs::DirIndexFree(uint32_t bno, uint32_t* out_count) {
+    mxtl::RefPtr<BlockNode> blk;
+    if ((blk = bc_->Get(bno)) == nullptr) {
+        return ERR_IO;
+    }
+    const minfs_dir_index_t* root = static_cast<const minfs_dir_index_t*>(blk->data());
+    mxtl::RefPtr<BlockNode> bitmap_blk;
+    uint32_t count = 0;
+
+    // release all bucket blocks
+    if (root->magic == kMinfsDirIndexMagic) {
+        for (unsigned n = 0; n < kMinfsDirIndexMaxBuckets; n++) {
+            uint32_t b = root->bucket[n];
+            if ((b < info_.dat_block) || (b >= info_.block_count)) {
+                continue;
+            }
+            if ((bitmap_blk = BitmapBlockGet(bitmap_blk, b)) == nullptr) {
+                bc_->Put(blk, 0);
+                return ERR_IO;
+            }
+            block_map_.Clear(b, b + 1);
+            count++;
+        }
+    }
+    bc_->Put(blk, 0);
+
+    // release the root itself
+    if ((bitmap_blk = BitmapBlockGet(bitmap_blk, bno)) == nullptr) {
+        return ERR_IO;
+    }
+    block_map_.Clear(bno, bno + 1);
+    count++;
+    BitmapBlockPut(bitmap_blk);
+
+    if (out_count != nullptr) {
+        *out_count = count;
+    }
     return NO_ERROR;
 }
 
@@ -266,17 +324,25 @@ mx_status_t Minfs::VnodeGet(VnodeMinfs** out, uint32_t ino) {
 // If hint is nonzero it indicates which block number to start the search for
 // free blocks from.
 mx_status_t Minfs::BlockNew(uint32_t hint, uint32_t* out_bno, mxtl::RefPtr<BlockNode> *out_block) {
-    size_t bitoff_start;
+    uint32_t bno;
+    uint32_t count;
     mx_status_t status;
-    if ((status = block_map_.Find(false, hint, block_map_.size(), 1, &bitoff_start)) != NO_ERROR) {
-        if ((status = block_map_.Find(false, 0, hint, 1, &bitoff_start)) != NO_ERROR) {
-            return ERR_NO_SPACE;
-        }
+    if ((status = BlockFindRun(hint, 1, &bno, &count)) != NO_ERROR) {
+        return status;
     }
-    status = block_map_.Set(bitoff_start, bitoff_start + 1);
-    assert(status == NO_ERROR);
-    uint32_t bno = static_cast<uint32_t>(bitoff_start);
+    if ((status = BlockAllocate(bno, out_block)) != NO_ERROR) {
+        return status;
+    }
+    *out_bno = bno;
+    return NO_ERROR;
+}
+
+mx_status_t Minfs::BlockAllocate(uint32_t bno, mxtl::RefPtr<BlockNode>* out_block) {
     assert(bno != 0); // Cannot allocate root block
+    assert(!block_map_.Get(bno, bno + 1));
+    mx_status_t status = block_map_.Set(bno, bno + 1);
+    assert(status == NO_ERROR);
+    reserved_map_.Clear(bno, bno + 1);
 
     // obtain the in-memory bitmap block
     uint32_t bmbno;
@@ -302,10 +368,80 @@ mx_status_t Minfs::BlockNew(uint32_t hint, uint32_t* out_bno, mxtl::RefPtr<Block
     // commit the bitmap
     memcpy(block_abm->data(), bmdata, kMinfsBlockSize);
     bc_->Put(block_abm, kBlockDirty);
-    *out_bno = bno;
     return NO_ERROR;
 }
 
+mx_status_t Minfs::BlocksFree(uint32_t start, uint32_t count) {
+    mxtl::RefPtr<BlockNode> bitmap_blk;
+    uint32_t end = start + count;
+    for (uint32_t n = start; n < end;) {
+        if ((bitmap_blk = BitmapBlockGet(bitmap_blk, n)) == nullptr) {
+            return ERR_IO;
+        }
+        // clear up to the end of this bitmap block at once
+        uint32_t next = mxtl::min(end, (n / kMinfsBlockBits + 1) * kMinfsBlockBits);
+        block_map_.Clear(n, next);
+        n = next;
+    }
+    BitmapBlockPut(bitmap_blk);
+    return NO_ERROR;
+}
+
+mx_status_t Minfs::FindUnreserved(size_t start, size_t end, size_t run_len,
+                                  size_t* out) const {
+    while (start < end) {
+        size_t bno;
+        if (block_map_.Find(false, start, end, run_len, &bno) != NO_ERROR) {
+            return ERR_NO_RESOURCES;
+        }
+        size_t rsv = reserved_map_.Scan(bno, bno + run_len, false);
+        if (rsv == bno + run_len) {
+            *out = bno;
+            return NO_ERROR;
+        }
+        // skip past the reservation in the way
+        start = reserved_map_.Scan(rsv, end, true);
+    }
+    return ERR_NO_RESOURCES;
+}
+
+mx_status_t Minfs::BlockFindRun(uint32_t hint, uint32_t want,
+                                uint32_t* out_start, uint32_t* out_count) {
+    size_t max = block_map_.size();
+    if (hint >= max) {
+        hint = 0;
+    }
+    size_t bno;
+    if ((FindUnreserved(hint, max, want, &bno) != NO_ERROR) &&
+        (FindUnreserved(0, mxtl::min(max, static_cast<size_t>(hint) + want), want,
+                        &bno) != NO_ERROR) &&
+        (FindUnreserved(0, max, 1, &bno) != NO_ERROR) &&
+        (block_map_.Find(false, 0, max, 1, &bno) != NO_ERROR)) {
+        return ERR_NO_SPACE;
+    }
+    *out_start = static_cast<uint32_t>(bno);
+    *out_count = mxtl::max(BlockRunAt(*out_start, want), 1u);
+    return NO_ERROR;
+}
+
+uint32_t Minfs::BlockRunAt(uint32_t start, uint32_t want) const {
+    size_t end = mxtl::min(block_map_.size(), static_cast<size_t>(start) + want);
+    if (start >= end) {
+        return 0;
+    }
+    end = block_map_.Scan(start, end, false);
+    end = reserved_map_.Scan(start, end, false);
+    return static_cast<uint32_t>(end - start);
+}
+
+void Minfs::BlockReserve(uint32_t start, uint32_t count) {
+    reserved_map_.Set(start, start + count);
+}
+
+void Minfs::BlockUnreserve(uint32_t start, uint32_t count) {
+    reserved_map_.Clear(start, start + count);
+}
+
 void minfs_dir_init(void* bdata, uint32_t ino_self, uint32_t ino_parent) {
 #define DE0_SIZE DirentSize(1)
 
@@ -353,6 +489,9 @@ mx_status_t Minfs::Create(Minfs** out, Bcache* bc, minfs_info_t* info) {
     if ((status = fs->inode_map_.Reset(fs->ibmblks_ * kMinfsBlockBits)) < 0) {
         return status;
     }
+    if ((status = fs->reserved_map_.Reset(fs->abmblks_ * kMinfsBlockBits)) < 0) {
+        return status;
+    }
     // this keeps the underlying storage a block multiple but ensures we
     // can't allocate beyond the last real block or inode
     if ((status = fs->block_map_.Shrink(fs->info_.block_count)) < 0) {
@@ -361,6 +500,9 @@ mx_status_t Minfs::Create(Minfs** out, Bcache* bc, minfs_info_t* info) {
     if ((status = fs->inode_map_.Shrink(fs->info_.inode_count)) < 0) {
         return status;
     }
+    if ((status = fs->reserved_map_.Shrink(fs->info_.block_count)) < 0) {
+        return status;
+    }
 
     if ((status = fs->LoadBitmaps()) < 0) {
         return status;
@@ -375,10 +517,11 @@ mx_status_t Minfs::Create(Minfs** out, Bcache* bc, minfs_info_t* info) {
         return status;
     }
 
-    for (uint32_t n = 0; n < inoblks; n++) {
+    for (uint32_t n = 0; n < inoblks; n += kMinfsMaxRunBlocks) {
         void* bmdata = (void*)((uintptr_t)(fs->inode_table_->GetData()) +
                                (uintptr_t)(kMinfsBlockSize * n));
-        if (fs->bc_->Readblk(fs->info_.ino_block + n, bmdata)) {
+        uint32_t count = mxtl::min(inoblks - n, kMinfsMaxRunBlocks);
+        if (fs->bc_->Readblks(fs->info_.ino_block + n, count, bmdata)) {
             error("minfs: failed reading inode table\n");
         }
     }
@@ -389,17 +532,12 @@ mx_status_t Minfs::Create(Minfs** out, Bcache* bc, minfs_info_t* info) {
 }
 
 mx_status_t Minfs::LoadBitmaps() {
-    for (uint32_t n = 0; n < abmblks_; n++) {
-        void* bmdata = GetBlock(block_map_, n);
-        if (bc_->Readblk(info_.abm_block + n, bmdata)) {
-            error("minfs: failed reading alloc bitmap\n");
-        }
+    // Each bitmap is contiguous both on disk and in memory.
+    if (bc_->Readblks(info_.abm_block, abmblks_, GetBlock(block_map_, 0))) {
+        error("minfs: failed reading alloc bitmap\n");
     }
-    for (uint32_t n = 0; n < ibmblks_; n++) {
-        void* bmdata = GetBlock(inode_map_, n);
-        if (bc_->Readblk(info_.ibm_block + n, bmdata)) {
-            error("minfs: failed reading inode bitmap\n");
-        }
+    if (bc_->Readblks(info_.ibm_block, ibmblks_, GetBlock(inode_map_, 0))) {
+        error("minfs: failed reading inode bitmap\n");
     }
     return NO_ERROR;
 }
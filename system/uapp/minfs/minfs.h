@@ -34,7 +34,7 @@ namespace minfs {
 
 constexpr uint64_t kMinfsMagic0 = (0x002153466e694d21ULL);
 constexpr uint64_t kMinfsMagic1 = (0x385000d3d3d3d304ULL);
-constexpr uint32_t kMinfsVersion = 0x00000002;
+constexpr uint32_t kMinfsVersion = 0x00000003;
 
 constexpr uint32_t kMinfsRootIno        = 1;
 constexpr uint32_t kMinfsFlagClean      = 1;
@@ -45,6 +45,7 @@ constexpr uint32_t kMinfsInodesPerBlock = (kMinfsBlockSize / kMinfsInodeSize);
 
 constexpr uint32_t kMinfsDirect   = 16;
 constexpr uint32_t kMinfsIndirect = 32;
+constexpr uint32_t kMinfsExtents  = 16;
 
 // not possible to have a block at or past this one
 // due to the limitations of the inode and indirect blocks
@@ -88,6 +89,16 @@ typedef struct {
 //   at offset: ino % kMinfsInodesPerBlock
 // - inode 0 is never used, should be marked allocated but ignored
 
+// A run of 'count' physically contiguous blocks, starting at block 'start',
+// holding blocks [logical, logical + count) of a file.
+typedef struct {
+    uint32_t start;
+    uint32_t count;
+    uint32_t logical;
+} minfs_extent_t;
+
+constexpr uint32_t kMinfsInodeFlagExtents = 0x00000001;
+
 typedef struct {
     uint32_t magic;
     uint32_t size;
@@ -98,13 +109,32 @@ typedef struct {
     uint32_t seq_num;               // bumped when modified
     uint32_t gen_num;               // bumped when deleted
     uint32_t dirent_count;          // for directories
-    uint32_t rsvd[5];
-    uint32_t dnum[kMinfsDirect];    // direct blocks
-    uint32_t inum[kMinfsIndirect];  // indirect blocks
+    uint32_t dir_index;             // for directories: hash index root bno
+    uint32_t flags;                 // kMinfsInodeFlag*
+    uint32_t rsvd[3];
+    union {
+        struct {
+            uint32_t dnum[kMinfsDirect];    // direct blocks
+            uint32_t inum[kMinfsIndirect];  // indirect blocks
+        };
+        minfs_extent_t extent[kMinfsExtents];   // if kMinfsInodeFlagExtents
+    };
 } minfs_inode_t;
 
 static_assert(sizeof(minfs_inode_t) == kMinfsInodeSize,
               "minfs inode size is wrong");
+static_assert(sizeof(minfs_extent_t) * kMinfsExtents ==
+              sizeof(uint32_t) * (kMinfsDirect + kMinfsIndirect),
+              "minfs extents must overlay the block map exactly");
+
+// Notes:
+// - an inode with kMinfsInodeFlagExtents maps its data through extent[]
+//   instead of dnum[] and inum[]; blocks covered by no extent are holes
+// - extents in use are packed at the front of extent[], sorted by logical
+//   block and non-overlapping; unused slots are all zero
+// - extent-mapped files never have blocks at or past kMinfsMaxFileBlock
+// - a file needing more extents than fit in the inode is converted back to
+//   the block map
 
 typedef struct {
     uint32_t ino;                   // inode number
@@ -148,6 +178,56 @@ static_assert(kMinfsMaxDirectorySize <= kMinfsReclenMask,
 //   record starts. If the MAX_DIR_SIZE is increased, this 'last' record will
 //   also increase in size.
 
+// Large directories carry a hash index mapping the name of every live
+// dirent to its offset within the directory, so lookups need not scan
+// every dirent block.
+
+constexpr uint32_t kMinfsDirIndexMagic      = 0x78646e49; // "Indx"
+constexpr uint32_t kMinfsDirIndexMinEntries = 64;
+constexpr uint32_t kMinfsDirIndexMaxBuckets = 1024;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t bucket_count;          // power of two
+    uint32_t append_off;            // where to start looking for free space
+    uint32_t rsvd;
+    uint32_t bucket[kMinfsDirIndexMaxBuckets];  // bucket blocks
+} minfs_dir_index_t;
+
+typedef struct {
+    uint32_t hash;                  // DirentHash() of the name
+    uint32_t off;                   // offset of the dirent in the directory
+} minfs_dir_index_entry_t;
+
+constexpr uint32_t kMinfsDirBucketEntries =
+    (kMinfsBlockSize - 2 * sizeof(uint32_t)) / sizeof(minfs_dir_index_entry_t);
+
+typedef struct {
+    uint32_t count;
+    uint32_t rsvd;
+    minfs_dir_index_entry_t entry[kMinfsDirBucketEntries];
+} minfs_dir_bucket_t;
+
+static_assert(sizeof(minfs_dir_index_t) <= kMinfsBlockSize,
+              "minfs directory index root too large");
+static_assert(sizeof(minfs_dir_bucket_t) <= kMinfsBlockSize,
+              "minfs directory index bucket too large");
+
+static inline uint32_t DirentHash(const char* name, size_t len) {
+    return fnv1a32(name, len);
+}
+
+// Notes:
+// - inode.dir_index is the block holding the minfs_dir_index_t, or 0 for a
+//   directory without an index; index blocks count toward block_count
+// - the entry for a name lives in bucket[hash & (bucket_count - 1)]; when a
+//   bucket fills, every bucket is split in two and bucket_count doubles,
+//   which allocates bucket_count blocks in one go (see DirIndexSplit())
+// - bucket[] slots at or past bucket_count are 0
+// - every live dirent (including "." and "..") has exactly one entry, and
+//   live dirents never move, so only create and unlink touch the index
+// - append_off always names a dirent record boundary
+
 
 // blocksize   8K    16K    32K
 // 16 dir =  128K   256K   512K
@@ -238,10 +318,15 @@ public:
                               uint32_t num);
 
     // Raw block read functions.
-    // These do not track blocks (or attempt to access the block cache)
+    // These do not track blocks, though Writeblk updates any cached copy.
     mx_status_t Readblk(uint32_t bno, void* data);
     mx_status_t Writeblk(uint32_t bno, const void* data);
 
+    // Raw transfers of 'count' consecutive blocks starting at 'bno', as a
+    // single device I/O. Like Writeblk, Writeblks updates any cached copies.
+    mx_status_t Readblks(uint32_t bno, uint32_t count, void* data);
+    mx_status_t Writeblks(uint32_t bno, uint32_t count, const void* data);
+
     uint32_t Maxblk() const { return blockmax_; };
 
     // acquire a block, reading from disk if necessary,
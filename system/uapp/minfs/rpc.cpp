@@ -20,6 +20,7 @@
 #include <magenta/processargs.h>
 #include <magenta/syscalls.h>
 #include <magenta/types.h>
+#include <mxtl/algorithm.h>
 
 #include "minfs-private.h"
 
@@ -28,6 +29,10 @@ mxio_dispatcher_t* vfs_dispatcher;
 
 namespace minfs {
 
+// Reads of files already in memory are served in parallel by up to this
+// many threads.
+constexpr uint32_t kMaxDispatchThreads = 4;
+
 mx_status_t VnodeMinfs::GetHandles(uint32_t flags, mx_handle_t* hnds,
                                    uint32_t* type, void* extra, uint32_t* esize) {
     // local vnode or device as a directory, we will create the handles
@@ -39,6 +44,37 @@ mx_status_t VnodeMinfs::GetHandles(uint32_t flags, mx_handle_t* hnds,
     return 1;
 }
 
+mx_status_t VnodeMinfs::Mmap(uint32_t flags, mx_handle_t* out, size_t* off, size_t* len) {
+    if (IsDirectory()) {
+        return ERR_NOT_FILE;
+    }
+    // Stores through a mapping would never reach the disk, so only
+    // read-only mappings are offered.
+    if (flags & MXIO_MMAP_FLAG_WRITE) {
+        return ERR_NOT_SUPPORTED;
+    }
+    mx_status_t status;
+    if ((status = InitVmo()) != NO_ERROR) {
+        return status;
+    }
+    mx_rights_t rights = MX_RIGHT_DUPLICATE | MX_RIGHT_TRANSFER | MX_RIGHT_MAP | MX_RIGHT_READ;
+    if (flags & MXIO_MMAP_FLAG_EXEC) {
+        rights |= MX_RIGHT_EXECUTE;
+    }
+    if ((status = mx_handle_duplicate(vmo_, rights, out)) != NO_ERROR) {
+        return status;
+    }
+    *off = 0;
+    *len = inode_.size;
+    return NO_ERROR;
+}
+
+bool VnodeMinfs::CanReadConcurrently() {
+    // Once a file is in its VMO, reading it touches nothing else. Filling
+    // the VMO goes through the block cache, which every vnode shares.
+    return !IsDirectory() && (vmo_ != MX_HANDLE_INVALID);
+}
+
 mx_handle_t vfs_rpc_server(VnodeMinfs* vn) {
     vfs_iostate_t* ios;
     mx_status_t r;
@@ -72,7 +108,8 @@ mx_handle_t vfs_rpc_server(VnodeMinfs* vn) {
     }
     //TODO: ref count
     //vn_acquire(vn);
-    mxio_dispatcher_run(vfs_dispatcher);
+    uint32_t threads = mxtl::min(mx_system_get_num_cpus(), kMaxDispatchThreads);
+    mxio_dispatcher_run_threads(vfs_dispatcher, "minfs-dispatch", threads);
     return NO_ERROR;
 }
 
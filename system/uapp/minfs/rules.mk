@@ -22,6 +22,8 @@ MODULE_SRCS += \
     $(LOCAL_DIR)/minfs.cpp \
     $(LOCAL_DIR)/minfs-ops.cpp \
     $(LOCAL_DIR)/minfs-check.cpp \
+    $(LOCAL_DIR)/dir-index.cpp \
+    $(LOCAL_DIR)/extent.cpp \
 
 MODULE_STATIC_LIBS := \
     system/ulib/fs \
@@ -54,6 +56,8 @@ MODULE_SRCS := \
     $(LOCAL_DIR)/minfs.cpp \
     $(LOCAL_DIR)/minfs-ops.cpp \
     $(LOCAL_DIR)/minfs-check.cpp \
+    $(LOCAL_DIR)/dir-index.cpp \
+    $(LOCAL_DIR)/extent.cpp \
     system/ulib/fs/vfs.cpp \
     system/ulib/mxcpp/new.cpp \
     system/ulib/mxcpp/pure_virtual.cpp \
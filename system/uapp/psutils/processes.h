@@ -4,9 +4,14 @@
 
 #pragma once
 
+#include <magenta/compiler.h>
 #include <magenta/syscalls.h>
 
+__BEGIN_CDECLS
+
 typedef mx_status_t (job_callback_t)(int depth, mx_handle_t job, mx_koid_t koid);
 typedef mx_status_t (process_callback_t)(int depth, mx_handle_t process, mx_koid_t koid);
 
 mx_status_t walk_process_tree(job_callback_t job_callback, process_callback_t process_callback);
+
+__END_CDECLS
@@ -40,6 +40,18 @@ MODULE_LIBS := system/ulib/mxio system/ulib/magenta system/ulib/c
 
 include make/module.mk
 
+MODULE := $(LOCAL_DIR).top
+
+MODULE_TYPE := userapp
+
+MODULE_SRCS += $(LOCAL_DIR)/top.c $(LOCAL_DIR)/processes.c
+
+MODULE_NAME := top
+
+MODULE_LIBS := system/ulib/mxio system/ulib/magenta system/ulib/c
+
+include make/module.mk
+
 MODULE := $(LOCAL_DIR).vmaps
 
 MODULE_TYPE := userapp
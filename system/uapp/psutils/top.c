@@ -0,0 +1,273 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <magenta/device/sysinfo.h>
+#include <magenta/syscalls.h>
+#include <magenta/syscalls/object.h>
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "processes.h"
+
+// A process and its thread stats at one point in time.
+typedef struct {
+    mx_koid_t koid;
+    char name[MX_MAX_NAME_LEN];
+    mx_info_thread_stats_t stats;
+    // Change since the previous sample.
+    mx_time_t runtime_delta;
+    mx_time_t queue_delta;
+    uint64_t switches_delta;
+} proc_entry_t;
+
+// An array of processes.
+typedef struct {
+    proc_entry_t* entries;
+    size_t num_entries;
+    size_t capacity; // allocation size
+} proc_table_t;
+
+// Adds a process entry to the specified table. |*entry| is copied.
+static void add_entry(proc_table_t* table, const proc_entry_t* entry) {
+    if (table->num_entries + 1 >= table->capacity) {
+        size_t new_cap = table->capacity * 2;
+        if (new_cap < 128) {
+            new_cap = 128;
+        }
+        table->entries = realloc(table->entries, new_cap * sizeof(*entry));
+        table->capacity = new_cap;
+    }
+    table->entries[table->num_entries++] = *entry;
+}
+
+// The table being built by process_callback.
+static proc_table_t* sample;
+
+// Adds a process's stats to |sample|. Processes which go away while the
+// tree is being walked are skipped.
+static mx_status_t process_callback(int depth, mx_handle_t process, mx_koid_t koid) {
+    proc_entry_t e = {.koid = koid};
+    if (mx_object_get_property(process, MX_PROP_NAME, e.name, sizeof(e.name)) != NO_ERROR) {
+        return NO_ERROR;
+    }
+    if (mx_object_get_info(process, MX_INFO_THREAD_STATS, &e.stats, sizeof(e.stats),
+                           NULL, NULL) != NO_ERROR) {
+        return NO_ERROR;
+    }
+    add_entry(sample, &e);
+    return NO_ERROR;
+}
+
+static int compare_koid(const void* a, const void* b) {
+    mx_koid_t ka = ((const proc_entry_t*)a)->koid;
+    mx_koid_t kb = ((const proc_entry_t*)b)->koid;
+    return (ka > kb) - (ka < kb);
+}
+
+static int compare_runtime_delta(const void* a, const void* b) {
+    mx_time_t ra = ((const proc_entry_t*)a)->runtime_delta;
+    mx_time_t rb = ((const proc_entry_t*)b)->runtime_delta;
+    return (ra < rb) - (ra > rb);
+}
+
+// Fills in the deltas of |cur| against |prev|, which is sorted by koid.
+// Processes which are new since |prev| are charged for their whole life.
+static void compute_deltas(proc_table_t* cur, const proc_table_t* prev) {
+    for (size_t i = 0; i < cur->num_entries; i++) {
+        proc_entry_t* e = cur->entries + i;
+        const proc_entry_t* p = NULL;
+        if (prev->num_entries > 0) {
+            p = bsearch(e, prev->entries, prev->num_entries, sizeof(*e), compare_koid);
+        }
+        e->runtime_delta = e->stats.total_runtime - (p ? p->stats.total_runtime : 0);
+        e->queue_delta = e->stats.total_queue_time - (p ? p->stats.total_queue_time : 0);
+        e->switches_delta = e->stats.context_switches - (p ? p->stats.context_switches : 0);
+    }
+}
+
+// Returns a handle to the root resource, or MX_HANDLE_INVALID if the
+// caller may not have it.
+static mx_handle_t get_root_resource(void) {
+    int fd = open("/dev/misc/sysinfo", O_RDWR);
+    if (fd < 0) {
+        return MX_HANDLE_INVALID;
+    }
+    mx_handle_t root_resource;
+    ssize_t n = ioctl_sysinfo_get_root_resource(fd, &root_resource);
+    close(fd);
+    return (n == sizeof(root_resource)) ? root_resource : MX_HANDLE_INVALID;
+}
+
+// Returns how many cpus the kernel keeps stats for, or 0 if it will not say.
+static size_t get_cpu_count(mx_handle_t root_resource) {
+    size_t actual = 0;
+    size_t avail = 0;
+    mx_status_t status = mx_object_get_info(root_resource, MX_INFO_CPU_STATS, NULL, 0,
+                                            &actual, &avail);
+    if (status < 0 && status != ERR_BUFFER_TOO_SMALL) {
+        return 0;
+    }
+    return avail;
+}
+
+static size_t get_cpu_stats(mx_handle_t root_resource, mx_info_cpu_stats_t* stats,
+                            size_t count) {
+    size_t actual = 0;
+    size_t avail;
+    if (mx_object_get_info(root_resource, MX_INFO_CPU_STATS, stats,
+                           count * sizeof(*stats), &actual, &avail) < 0) {
+        return 0;
+    }
+    return actual;
+}
+
+// Prints one line per online cpu: how busy it was over |elapsed|, and the
+// rates of the counters which usually explain why.
+static void print_cpus(const mx_info_cpu_stats_t* old_stats, const mx_info_cpu_stats_t* stats,
+                       size_t count, mx_time_t elapsed) {
+    printf("CPU    LOAD  CSW/s   PMPT/s   INT/s  SYSC/s\n");
+    for (size_t i = 0; i < count; i++) {
+        const mx_info_cpu_stats_t* o = old_stats + i;
+        const mx_info_cpu_stats_t* s = stats + i;
+        if (!(s->flags & MX_INFO_CPU_STATS_FLAG_ONLINE)) {
+            continue;
+        }
+        mx_time_t idle = s->idle_time - o->idle_time;
+        if (idle > elapsed) {
+            idle = elapsed;
+        }
+        unsigned busy = (unsigned)(((elapsed - idle) * 1000) / elapsed);
+#define RATE(f) ((s->f - o->f) * MX_SEC(1) / elapsed)
+        printf("%3" PRIu32 " %4u.%u%% %6" PRIu64 " %8" PRIu64 " %7" PRIu64 " %7" PRIu64 "\n",
+               s->cpu_number, busy / 10, busy % 10, RATE(context_switches),
+               RATE(preempts) + RATE(irq_preempts), RATE(ints) + RATE(timer_ints),
+               RATE(syscalls));
+#undef RATE
+    }
+    printf("\n");
+}
+
+// Prints the |max_lines| busiest processes in |table|, which must already
+// be sorted.
+static void print_procs(const proc_table_t* table, mx_time_t elapsed, size_t max_lines) {
+    printf("%8s %6s %10s %9s %6s %s\n",
+           "KOID", "CPU", "TIME(ms)", "QUEUE(ms)", "CSW", "NAME");
+    for (size_t i = 0; i < table->num_entries && i < max_lines; i++) {
+        const proc_entry_t* e = table->entries + i;
+        unsigned cpu = (unsigned)((e->runtime_delta * 1000) / elapsed);
+        printf("%8" PRIu64 " %3u.%u%% %10" PRIu64 " %9" PRIu64 " %6" PRIu64 " %s\n",
+               e->koid, cpu / 10, cpu % 10, e->stats.total_runtime / MX_MSEC(1),
+               e->queue_delta / MX_MSEC(1), e->switches_delta, e->name);
+    }
+}
+
+static void usage(const char* name) {
+    fprintf(stderr,
+            "usage: %s [-d <seconds>] [-n <iterations>] [-l <lines>]\n"
+            "Shows the processes which used the most cpu time in each interval.\n"
+            "  -d  seconds between updates (default 1)\n"
+            "  -n  number of updates before exiting (default: run forever)\n"
+            "  -l  number of processes to show (default 20)\n",
+            name);
+}
+
+int main(int argc, char** argv) {
+    int delay = 1;
+    int iterations = -1;
+    size_t max_lines = 20;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        } else if (!strcmp(arg, "-d")) {
+            delay = atoi(argv[++i]);
+        } else if (!strcmp(arg, "-n")) {
+            iterations = atoi(argv[++i]);
+        } else if (!strcmp(arg, "-l")) {
+            max_lines = (size_t)atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (delay <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // cpu stats are a bonus: show them if we are allowed to
+    mx_handle_t root_resource = get_root_resource();
+    mx_info_cpu_stats_t* cpu_stats[2] = {};
+    size_t cpu_count = 0;
+    if (root_resource != MX_HANDLE_INVALID) {
+        size_t max_cpus = get_cpu_count(root_resource);
+        if (max_cpus > 0) {
+            cpu_stats[0] = calloc(max_cpus, sizeof(mx_info_cpu_stats_t));
+            cpu_stats[1] = calloc(max_cpus, sizeof(mx_info_cpu_stats_t));
+        }
+        if (cpu_stats[0] != NULL && cpu_stats[1] != NULL) {
+            cpu_count = get_cpu_stats(root_resource, cpu_stats[0], max_cpus);
+        }
+    }
+
+    proc_table_t tables[2] = {};
+    proc_table_t* prev = &tables[0];
+    proc_table_t* cur = &tables[1];
+    sample = prev;
+    mx_status_t status = walk_process_tree(NULL, process_callback);
+    if (status != NO_ERROR) {
+        fprintf(stderr, "top: cannot walk the process tree: %d\n", status);
+        return 1;
+    }
+    qsort(prev->entries, prev->num_entries, sizeof(proc_entry_t), compare_koid);
+    mx_time_t last = mx_time_get(MX_CLOCK_MONOTONIC);
+
+    for (int n = 0; iterations < 0 || n < iterations; n++) {
+        mx_nanosleep(MX_SEC(delay));
+
+        cur->num_entries = 0;
+        sample = cur;
+        walk_process_tree(NULL, process_callback);
+        mx_time_t now = mx_time_get(MX_CLOCK_MONOTONIC);
+        mx_time_t elapsed = now - last;
+        last = now;
+
+        if (cpu_count > 0) {
+            size_t count = get_cpu_stats(root_resource, cpu_stats[1], cpu_count);
+            print_cpus(cpu_stats[0], cpu_stats[1], count, elapsed);
+            if (count == cpu_count) {
+                mx_info_cpu_stats_t* t = cpu_stats[0];
+                cpu_stats[0] = cpu_stats[1];
+                cpu_stats[1] = t;
+            }
+        }
+
+        compute_deltas(cur, prev);
+        qsort(cur->entries, cur->num_entries, sizeof(proc_entry_t), compare_runtime_delta);
+        print_procs(cur, elapsed, max_lines);
+        printf("\n");
+
+        // the next interval is measured against this one
+        qsort(cur->entries, cur->num_entries, sizeof(proc_entry_t), compare_koid);
+        proc_table_t* t = prev;
+        prev = cur;
+        cur = t;
+    }
+
+    free(tables[0].entries);
+    free(tables[1].entries);
+    free(cpu_stats[0]);
+    free(cpu_stats[1]);
+    if (root_resource != MX_HANDLE_INVALID) {
+        mx_handle_close(root_resource);
+    }
+    return 0;
+}
@@ -0,0 +1,29 @@
+# Copyright 2017 The Fuchsia Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+LOCAL_DIR := $(GET_LOCAL_DIR)
+
+MODULE := $(LOCAL_DIR)
+
+MODULE_TYPE := userapp
+
+# The dso list and process tree walking are shared with crashlogger and
+# psutils; refer back to their sources rather than copying them.
+MODULE_SRCS += \
+    $(LOCAL_DIR)/sampler.cpp \
+    system/core/crashlogger/dso-list.cpp \
+    system/core/crashlogger/utils.cpp \
+    system/uapp/psutils/processes.c \
+
+MODULE_NAME := sampler
+
+MODULE_COMPILEFLAGS += -Isystem/core/crashlogger -Isystem/uapp/psutils
+
+MODULE_LIBS := \
+    system/ulib/mxcpp \
+    system/ulib/mxio \
+    system/ulib/magenta \
+    system/ulib/c
+
+include make/module.mk
@@ -0,0 +1,295 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// sampler: a statistical profiler built on MTRACE_KIND_SAMPLE.
+//
+// Samples every cpu for a while, then prints the dso list of each process
+// that was seen (in the format scripts/symbolize understands) and one line
+// per distinct call chain in "folded" form, root first, followed by the
+// number of times it was seen, ready to be fed to a flame graph tool:
+//
+//   devmgr;libc.so+0x1234;app:devmgr+0x5678 42
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <magenta/device/sysinfo.h>
+#include <magenta/mtrace.h>
+#include <magenta/syscalls.h>
+#include <magenta/syscalls/object.h>
+
+#include "dso-list.h"
+#include "processes.h"
+#include "utils.h"
+
+// dso-list.cpp and utils.cpp are shared with crashlogger, which defines this.
+int verbosity_level = 0;
+
+namespace {
+
+// A process which was sampled.
+struct proc_info {
+    mx_koid_t koid;
+    char name[MX_MAX_NAME_LEN];
+    dsoinfo_t* dsos;
+};
+
+proc_info* procs;
+size_t num_procs;
+
+int compare_proc_koid(const void* a, const void* b) {
+    mx_koid_t ka = static_cast<const proc_info*>(a)->koid;
+    mx_koid_t kb = static_cast<const proc_info*>(b)->koid;
+    return (ka > kb) - (ka < kb);
+}
+
+proc_info* find_proc(mx_koid_t koid) {
+    proc_info key = {};
+    key.koid = koid;
+    return static_cast<proc_info*>(
+        bsearch(&key, procs, num_procs, sizeof(proc_info), compare_proc_koid));
+}
+
+// Fills in the name and dsos of the processes we have samples for.
+mx_status_t process_callback(int depth, mx_handle_t process, mx_koid_t koid) {
+    proc_info* p = find_proc(koid);
+    if (p == nullptr) {
+        return NO_ERROR;
+    }
+    mx_object_get_property(process, MX_PROP_NAME, p->name, sizeof(p->name));
+    p->dsos = dso_fetch_list(process, p->name);
+    return NO_ERROR;
+}
+
+mx_handle_t get_root_resource() {
+    int fd = open("/dev/misc/sysinfo", O_RDWR);
+    if (fd < 0) {
+        return MX_HANDLE_INVALID;
+    }
+    mx_handle_t root_resource;
+    ssize_t n = ioctl_sysinfo_get_root_resource(fd, &root_resource);
+    close(fd);
+    return (n == sizeof(root_resource)) ? root_resource : MX_HANDLE_INVALID;
+}
+
+// Calls |func| on each record in |buf|, which holds a whole sample buffer.
+template <typename F>
+void for_each_record(const uint8_t* buf, F func) {
+    auto header = reinterpret_cast<const mx_sample_buffer_header_t*>(buf);
+    const uint8_t* p = buf + sizeof(*header);
+    const uint8_t* end = p + header->size;
+    while (p + sizeof(mx_sample_record_t) <= end) {
+        auto record = reinterpret_cast<const mx_sample_record_t*>(p);
+        size_t len = sizeof(*record) + record->num_frames * sizeof(uint64_t);
+        if (p + len > end) {
+            break;
+        }
+        func(record, reinterpret_cast<const uint64_t*>(record + 1));
+        p += len;
+    }
+}
+
+// Appends ";<frame>" to |out| for |pc|, as dso+offset when it can.
+void append_frame(char* out, size_t out_size, const proc_info* p, bool user, uint64_t pc) {
+    size_t len = strlen(out);
+    dsoinfo_t* dso = (user && p != nullptr) ? dso_lookup(p->dsos, pc) : nullptr;
+    if (dso != nullptr) {
+        snprintf(out + len, out_size - len, ";%s+%#" PRIx64, dso->name, pc - dso->base);
+    } else {
+        snprintf(out + len, out_size - len, ";%#" PRIx64, pc);
+    }
+}
+
+// Formats a sample as a folded call chain, root first.
+char* fold(const mx_sample_record_t* record, const uint64_t* frames) {
+    char buf[4096];
+    bool user = (record->flags & MX_SAMPLE_FLAG_USER) != 0;
+    const proc_info* p = (record->pid != 0) ? find_proc(record->pid) : nullptr;
+    if (p != nullptr && p->name[0] != '\0') {
+        snprintf(buf, sizeof(buf), "%s", p->name);
+    } else if (record->pid != 0) {
+        snprintf(buf, sizeof(buf), "pid:%" PRIu64, record->pid);
+    } else {
+        snprintf(buf, sizeof(buf), "kernel");
+    }
+    if (!user && record->pid != 0) {
+        snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), ";kernel");
+    }
+    for (uint32_t i = record->num_frames; i > 0; i--) {
+        append_frame(buf, sizeof(buf), p, user, frames[i - 1]);
+    }
+    append_frame(buf, sizeof(buf), p, user, record->pc);
+    return strdup(buf);
+}
+
+int compare_string(const void* a, const void* b) {
+    return strcmp(*static_cast<char* const*>(a), *static_cast<char* const*>(b));
+}
+
+void usage(const char* name) {
+    fprintf(stderr,
+            "usage: %s [-t <seconds>] [-p <usec>] [-d <frames>] [-b <KB>]\n"
+            "Samples what every cpu is running and prints folded call chains.\n"
+            "  -t  seconds to sample for (default 5)\n"
+            "  -p  microseconds between samples on each cpu (default 1000)\n"
+            "  -d  maximum call chain depth (default 16, 0 for just the pc)\n"
+            "  -b  kilobytes of buffer per cpu (default 1024)\n",
+            name);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    int seconds = 5;
+    int period_us = 1000;
+    int depth = 16;
+    int buffer_kb = 1024;
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        } else if (!strcmp(arg, "-t")) {
+            seconds = atoi(argv[++i]);
+        } else if (!strcmp(arg, "-p")) {
+            period_us = atoi(argv[++i]);
+        } else if (!strcmp(arg, "-d")) {
+            depth = atoi(argv[++i]);
+        } else if (!strcmp(arg, "-b")) {
+            buffer_kb = atoi(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (seconds <= 0 || period_us <= 0 || depth < 0 || depth > MTRACE_SAMPLE_MAX_FRAMES ||
+        buffer_kb <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    mx_handle_t root_resource = get_root_resource();
+    if (root_resource == MX_HANDLE_INVALID) {
+        fprintf(stderr, "sampler: cannot obtain root resource\n");
+        return 1;
+    }
+
+    uint32_t num_cpus = mx_system_get_num_cpus();
+    if (num_cpus > MTRACE_SAMPLE_MAX_CPUS) {
+        num_cpus = MTRACE_SAMPLE_MAX_CPUS;
+    }
+    mx_sample_config_t config = {};
+    config.period = MX_USEC(period_us);
+    config.max_frames = depth;
+    config.num_buffers = num_cpus;
+    size_t buffer_size = (size_t)buffer_kb * 1024;
+    mx_status_t status;
+    for (uint32_t cpu = 0; cpu < num_cpus; cpu++) {
+        if ((status = mx_vmo_create(buffer_size, 0, &config.buffers[cpu])) != NO_ERROR) {
+            fprintf(stderr, "sampler: cannot create buffer: %d\n", status);
+            return 1;
+        }
+    }
+
+    status = mx_mtrace_control(root_resource, MTRACE_KIND_SAMPLE, MTRACE_SAMPLE_START, 0,
+                               &config, sizeof(config));
+    if (status != NO_ERROR) {
+        fprintf(stderr, "sampler: cannot start sampling: %d\n", status);
+        return 1;
+    }
+    mx_nanosleep(MX_SEC(seconds));
+    status = mx_mtrace_control(root_resource, MTRACE_KIND_SAMPLE, MTRACE_SAMPLE_STOP, 0,
+                               nullptr, 0);
+    if (status != NO_ERROR) {
+        fprintf(stderr, "sampler: cannot stop sampling: %d\n", status);
+        return 1;
+    }
+
+    // pull the samples out of the buffers
+    uint8_t* buffers[MTRACE_SAMPLE_MAX_CPUS] = {};
+    uint64_t num_samples = 0;
+    uint64_t dropped = 0;
+    for (uint32_t cpu = 0; cpu < num_cpus; cpu++) {
+        uint8_t* buf = static_cast<uint8_t*>(malloc(buffer_size));
+        size_t actual;
+        if (buf == nullptr ||
+            mx_vmo_read(config.buffers[cpu], buf, 0, buffer_size, &actual) != NO_ERROR ||
+            actual != buffer_size) {
+            free(buf);
+            continue;
+        }
+        mx_handle_close(config.buffers[cpu]);
+        auto header = reinterpret_cast<mx_sample_buffer_header_t*>(buf);
+        if (header->magic != MX_SAMPLE_BUFFER_MAGIC ||
+            header->size > buffer_size - sizeof(*header)) {
+            free(buf);
+            continue;
+        }
+        dropped += header->dropped;
+        buffers[cpu] = buf;
+        for_each_record(buf, [&num_samples](const mx_sample_record_t*, const uint64_t*) {
+            num_samples++;
+        });
+    }
+
+    // find the processes which were sampled, while they are still around
+    procs = static_cast<proc_info*>(calloc(num_samples + 1, sizeof(proc_info)));
+    for (uint32_t cpu = 0; cpu < num_cpus; cpu++) {
+        if (buffers[cpu] == nullptr) {
+            continue;
+        }
+        for_each_record(buffers[cpu], [](const mx_sample_record_t* record, const uint64_t*) {
+            if (record->pid != 0 && find_proc(record->pid) == nullptr) {
+                procs[num_procs].koid = record->pid;
+                num_procs++;
+                qsort(procs, num_procs, sizeof(proc_info), compare_proc_koid);
+            }
+        });
+    }
+    walk_process_tree(nullptr, process_callback);
+
+    char** stacks = static_cast<char**>(calloc(num_samples + 1, sizeof(char*)));
+    size_t num_stacks = 0;
+    for (uint32_t cpu = 0; cpu < num_cpus; cpu++) {
+        if (buffers[cpu] == nullptr) {
+            continue;
+        }
+        for_each_record(buffers[cpu], [stacks, &num_stacks](const mx_sample_record_t* record,
+                                                            const uint64_t* frames) {
+            stacks[num_stacks++] = fold(record, frames);
+        });
+        free(buffers[cpu]);
+    }
+    qsort(stacks, num_stacks, sizeof(char*), compare_string);
+
+    printf("%" PRIu64 " samples on %u cpus, %" PRIu64 " dropped\n",
+           num_samples, num_cpus, dropped);
+    for (size_t i = 0; i < num_procs; i++) {
+        printf("process %" PRIu64 " %s\n", procs[i].koid, procs[i].name);
+        dso_print_list(procs[i].dsos);
+    }
+    for (size_t i = 0; i < num_stacks;) {
+        size_t n = 1;
+        while (i + n < num_stacks && !strcmp(stacks[i], stacks[i + n])) {
+            free(stacks[i + n]);
+            n++;
+        }
+        printf("%s %zu\n", stacks[i], n);
+        free(stacks[i]);
+        i += n;
+    }
+
+    for (size_t i = 0; i < num_procs; i++) {
+        dso_free_list(procs[i].dsos);
+    }
+    free(procs);
+    free(stacks);
+    mx_handle_close(root_resource);
+    return 0;
+}
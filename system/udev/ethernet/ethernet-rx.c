@@ -0,0 +1,120 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "ethernet-rx.h"
+
+#include <magenta/syscalls.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#define FAIL_REPORT_RATE 50
+
+// ensure that we will not exceed fifo capacity
+static_assert((FIFO_DEPTH * FIFO_ESIZE) <= 4096, "");
+
+mx_status_t eth_rx_flush(eth_rx_t* rx, mx_handle_t fifo) {
+    mx_status_t status;
+    uint32_t count;
+
+    if (rx->done_count == 0) {
+        return NO_ERROR;
+    }
+
+    status = mx_fifo_write(fifo, rx->done, sizeof(eth_fifo_entry_t) * rx->done_count, &count);
+    if (status < 0) {
+        if (status == ERR_SHOULD_WAIT) {
+            if ((rx->fail_write++ % FAIL_REPORT_RATE) == 0) {
+                printf("eth: no rx_fifo space available (%u times)\n", rx->fail_write);
+            }
+            return ERR_SHOULD_WAIT;
+        }
+        // Fatal, should force teardown
+        printf("eth: rx_fifo write failed %d\n", status);
+        rx->done_count = 0;
+        return status;
+    }
+    if (count < rx->done_count) {
+        memmove(rx->done, rx->done + count,
+                sizeof(eth_fifo_entry_t) * (rx->done_count - count));
+    }
+    rx->done_count -= count;
+    return (rx->done_count == 0) ? NO_ERROR : ERR_SHOULD_WAIT;
+}
+
+// obtain the next client-supplied rx buffer, refilling the local
+// cache from the rx fifo in bulk when it runs dry
+static mx_status_t eth_rx_get_buffer(eth_rx_t* rx, mx_handle_t fifo, eth_fifo_entry_t** out) {
+    if (rx->avail_next == rx->avail_count) {
+        mx_status_t status;
+        uint32_t count;
+        rx->avail_next = 0;
+        rx->avail_count = 0;
+        if ((status = mx_fifo_read(fifo, rx->avail, sizeof(rx->avail), &count)) < 0) {
+            return status;
+        }
+        rx->avail_count = count;
+    }
+    *out = &rx->avail[rx->avail_next++];
+    return NO_ERROR;
+}
+
+void eth_rx_handle(eth_rx_t* rx, mx_handle_t fifo, void* io_buf, size_t io_size,
+                   const void* data, size_t len, uint32_t extra) {
+    eth_fifo_entry_t* avail;
+    mx_status_t status;
+
+    if (rx->done_count == countof(rx->done)) {
+        eth_rx_flush(rx, fifo);
+        if (rx->done_count == countof(rx->done)) {
+            // nowhere to return the buffer to yet, drop the packet
+            return;
+        }
+    }
+
+    if ((status = eth_rx_get_buffer(rx, fifo, &avail)) < 0) {
+        if (status == ERR_SHOULD_WAIT) {
+            if ((rx->fail_read++ % FAIL_REPORT_RATE) == 0) {
+                printf("eth: no rx buffers available (%u times)\n", rx->fail_read);
+            }
+        } else {
+            // Fatal, should force teardown
+            printf("eth: rx fifo read failed %d\n", status);
+        }
+        return;
+    }
+
+    eth_fifo_entry_t* e = &rx->done[rx->done_count++];
+    *e = *avail;
+
+    if ((e->offset >= io_size) || ((e->length > (io_size - e->offset)))) {
+        // invalid offset/length. report error. drop packet
+        e->length = 0;
+        e->flags = ETH_FIFO_INVALID;
+    } else if (len > e->length) {
+        e->length = 0;
+        e->flags = ETH_FIFO_INVALID;
+    } else {
+        // packet fits. deliver it
+        memcpy(io_buf + e->offset, data, len);
+        e->length = len;
+        e->flags = ETH_FIFO_RX_OK | extra;
+    }
+}
+
+mx_status_t eth_rx_release(eth_rx_t* rx, mx_handle_t fifo) {
+    // anything that does not fit behind the already filled buffers
+    // stays cached and is handed out first after a restart
+    while ((rx->avail_next < rx->avail_count) && (rx->done_count < countof(rx->done))) {
+        eth_fifo_entry_t* e = &rx->done[rx->done_count++];
+        *e = rx->avail[rx->avail_next++];
+        e->length = 0;
+        e->flags = 0;
+    }
+    if (rx->avail_next == rx->avail_count) {
+        rx->avail_next = 0;
+        rx->avail_count = 0;
+    }
+    return eth_rx_flush(rx, fifo);
+}
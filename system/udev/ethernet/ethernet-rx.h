@@ -0,0 +1,57 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <magenta/compiler.h>
+#include <magenta/device/ethernet.h>
+#include <magenta/types.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+__BEGIN_CDECLS
+
+#define FIFO_DEPTH 256
+#define FIFO_ESIZE sizeof(eth_fifo_entry_t)
+
+// receive side buffer bookkeeping for one ethernet instance
+//
+// The client hands empty buffers to the driver over the rx fifo and
+// gets them back, filled or not, over the same fifo.  Buffers are
+// read from the fifo in bulk and returned in bulk, so at any time
+// some may be cached here rather than owned by the client.
+typedef struct eth_rx {
+    // rx buffers read from the rx fifo in bulk but not yet filled
+    eth_fifo_entry_t avail[FIFO_DEPTH];
+    uint32_t avail_next;
+    uint32_t avail_count;
+
+    // filled rx buffers waiting to be written back to the rx fifo
+    // (flushed at the end of each batch of recv()s from the ethermac)
+    eth_fifo_entry_t done[FIFO_DEPTH];
+    uint32_t done_count;
+
+    uint32_t fail_read;
+    uint32_t fail_write;
+} eth_rx_t;
+
+// copy a received packet into the next client buffer and queue that
+// buffer for return, dropping the packet if there is no buffer to
+// put it in or no room to queue it
+void eth_rx_handle(eth_rx_t* rx, mx_handle_t fifo, void* io_buf, size_t io_size,
+                   const void* data, size_t len, uint32_t extra);
+
+// return queued buffers to the client with a single fifo write
+// returns ERR_SHOULD_WAIT if the fifo had no room for all of them;
+// the rest stay queued and the caller should flush again once the
+// fifo is writable
+mx_status_t eth_rx_flush(eth_rx_t* rx, mx_handle_t fifo);
+
+// queue the cached, unfilled buffers for return to the client (with
+// neither ETH_FIFO_RX_OK nor a length set) and flush, so that they
+// are not stranded while the instance is stopped
+mx_status_t eth_rx_release(eth_rx_t* rx, mx_handle_t fifo);
+
+__END_CDECLS
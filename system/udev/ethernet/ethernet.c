@@ -18,8 +18,7 @@
 #include <string.h>
 #include <threads.h>
 
-#define FIFO_DEPTH 256
-#define FIFO_ESIZE sizeof(eth_fifo_entry_t)
+#include "ethernet-rx.h"
 
 #define TRACE 0
 
@@ -31,9 +30,6 @@
     } while (0)
 #endif
 
-// ensure that we will not exceed fifo capacity
-static_assert((FIFO_DEPTH * FIFO_ESIZE) <= 4096, "");
-
 // ethernet device
 typedef struct ethdev0 {
     // shared state
@@ -83,6 +79,10 @@ static void eth0_downref(ethdev0_t* edev0) {
 // This client wants to observe loopback tx packets
 #define ETHDEV_TX_LISTEN (16u)
 
+// rx buffers are waiting for room in the rx_fifo and the
+// tx thread has been asked to flush them when there is
+#define ETHDEV_RX_WAIT (32u)
+
 // ethernet instance device
 typedef struct ethdev {
     list_node_t node;
@@ -107,10 +107,14 @@ typedef struct ethdev {
     // fifo thread
     thrd_t tx_thr;
 
+    // signaled to wake the tx thread when rx buffers
+    // need to be flushed once the rx_fifo has room
+    mx_handle_t rx_wait_event;
+
+    eth_rx_t rx;
+
     mx_device_t dev;
 
-    uint32_t fail_rx_read;
-    uint32_t fail_rx_write;
     uint32_t fail_tx_write;
 } ethdev_t;
 
@@ -119,51 +123,24 @@ typedef struct ethdev {
 #define get_ethdev(d) containerof(d, ethdev_t, dev)
 #define get_ethdev0(d) containerof(d, ethdev0_t, dev)
 
-static void eth_handle_rx(ethdev_t* edev, const void* data, size_t len, uint32_t extra) {
-    eth_fifo_entry_t e;
-    mx_status_t status;
-    uint32_t count;
-
-    // TODO: read multiple and cache locally to reduce syscalls
-    if ((status = mx_fifo_read(edev->rx_fifo, &e, sizeof(e), &count)) < 0) {
-        if (status == ERR_SHOULD_WAIT) {
-            if ((edev->fail_rx_read++ % FAIL_REPORT_RATE) == 0) {
-                printf("eth: no rx buffers available (%u times)\n",
-                       edev->fail_rx_read);
-            }
-        } else {
-            // Fatal, should force teardown
-            printf("eth: rx fifo read failed %d\n", status);
-        }
-        return;
+// ask the tx thread to flush the rx buffers the rx_fifo had
+// no room for once it becomes writable, rather than leaving
+// them until the next packet arrives
+static void eth_rx_wait_locked(ethdev_t* edev) {
+    if (!(edev->state & ETHDEV_RX_WAIT)) {
+        edev->state |= ETHDEV_RX_WAIT;
+        mx_object_signal(edev->rx_wait_event, 0, MX_EVENT_SIGNALED);
     }
+}
 
-    if ((e.offset >= edev->io_size) || ((e.length > (edev->io_size - e.offset)))) {
-        // invalid offset/length. report error. drop packet
-        e.length = 0;
-        e.flags = ETH_FIFO_INVALID;
-    } else if (len > e.length) {
-        e.length = 0;
-        e.flags = ETH_FIFO_INVALID;
-    } else {
-        // packet fits. deliver it
-        memcpy(edev->io_buf + e.offset, data, len);
-        e.length = len;
-        e.flags = ETH_FIFO_RX_OK | extra;
+static void eth_rx_flush_locked(ethdev_t* edev) {
+    if (eth_rx_flush(&edev->rx, edev->rx_fifo) == ERR_SHOULD_WAIT) {
+        eth_rx_wait_locked(edev);
     }
+}
 
-    if ((status = mx_fifo_write(edev->rx_fifo, &e, sizeof(e), &count)) < 0) {
-        if (status == ERR_SHOULD_WAIT) {
-            if ((edev->fail_rx_write++ % FAIL_REPORT_RATE) == 0) {
-                printf("eth: no rx_fifo space available (%u times)\n",
-                       edev->fail_rx_write);
-            }
-        } else {
-            // Fatal, should force teardown
-            printf("eth: rx_fifo write failed %d\n", status);
-        }
-        return;
-    }
+static void eth_handle_rx(ethdev_t* edev, const void* data, size_t len, uint32_t extra) {
+    eth_rx_handle(&edev->rx, edev->rx_fifo, edev->io_buf, edev->io_size, data, len, extra);
 }
 
 static void eth0_status(void* cookie, uint32_t status) {
@@ -179,6 +156,9 @@ static void eth0_recv(void* cookie, void* data, size_t len, uint32_t flags) {
     mtx_lock(&edev0->lock);
     list_for_every_entry(&edev0->list_active, edev, ethdev_t, node) {
         eth_handle_rx(edev, data, len, 0);
+        if (!(flags & ETHMAC_RX_MORE)) {
+            eth_rx_flush_locked(edev);
+        }
     }
     mtx_unlock(&edev0->lock);
 }
@@ -188,17 +168,33 @@ static ethmac_ifc_t ethmac_ifc = {
     .recv = eth0_recv,
 };
 
-static void eth_tx_echo(ethdev0_t* edev0, const void* data, size_t len) {
+static void eth_tx_echo(ethdev0_t* edev0, const ethmac_txbuf_t* bufs, size_t count) {
     ethdev_t* edev;
     mtx_lock(&edev0->lock);
     list_for_every_entry(&edev0->list_active, edev, ethdev_t, node) {
         if (edev->state & ETHDEV_TX_LISTEN) {
-            eth_handle_rx(edev, data, len, ETH_FIFO_RX_TX);
+            for (size_t n = 0; n < count; n++) {
+                eth_handle_rx(edev, bufs[n].data, bufs[n].length, ETH_FIFO_RX_TX);
+            }
+            eth_rx_flush_locked(edev);
         }
     }
     mtx_unlock(&edev0->lock);
 }
 
+static void eth_send(ethdev0_t* edev0, const ethmac_txbuf_t* bufs, size_t count) {
+    if (count == 0) {
+        return;
+    }
+    if (edev0->macops->send_batch) {
+        edev0->macops->send_batch(edev0->mac, 0, bufs, count);
+    } else {
+        for (size_t n = 0; n < count; n++) {
+            edev0->macops->send(edev0->mac, 0, bufs[n].data, bufs[n].length);
+        }
+    }
+}
+
 static mx_status_t eth_tx_listen_locked(ethdev_t* edev, bool yes) {
     ethdev0_t* edev0 = edev->edev0;
 
@@ -229,22 +225,55 @@ static mx_status_t eth_tx_listen_locked(ethdev_t* edev, bool yes) {
     return NO_ERROR;
 }
 
+// flush rx buffers that were waiting for room in the rx_fifo
+// returns true if some are still waiting
+static bool eth_rx_retry(ethdev_t* edev) {
+    ethdev0_t* edev0 = edev->edev0;
+    bool waiting = false;
+
+    mtx_lock(&edev0->lock);
+    if (!(edev->state & ETHDEV_DEAD) &&
+        (eth_rx_flush(&edev->rx, edev->rx_fifo) == ERR_SHOULD_WAIT)) {
+        waiting = true;
+    } else {
+        edev->state &= (~ETHDEV_RX_WAIT);
+    }
+    mtx_unlock(&edev0->lock);
+    return waiting;
+}
+
 static int eth_tx_thread(void* arg) {
     ethdev_t* edev = (ethdev_t*)arg;
     ethdev0_t* edev0 = edev->edev0;
     eth_fifo_entry_t entries[FIFO_DEPTH / 2];
+    ethmac_txbuf_t bufs[FIFO_DEPTH / 2];
     mx_status_t status;
     uint32_t count;
+    bool rx_wait = false;
 
     for (;;) {
         if ((status = mx_fifo_read(edev->tx_fifo, entries, sizeof(entries), &count)) < 0) {
             if (status == ERR_SHOULD_WAIT) {
-                if ((status = mx_object_wait_one(edev->tx_fifo,
-                                                 MX_FIFO_READABLE | MX_FIFO_PEER_CLOSED,
-                                                 MX_TIME_INFINITE, NULL)) < 0) {
+                // while rx buffers are waiting for room in the rx_fifo,
+                // also wake up when the client makes some
+                mx_wait_item_t items[] = {
+                    { .handle = edev->tx_fifo,
+                      .waitfor = MX_FIFO_READABLE | MX_FIFO_PEER_CLOSED },
+                    { .handle = edev->rx_wait_event, .waitfor = MX_EVENT_SIGNALED },
+                    { .handle = edev->rx_fifo, .waitfor = MX_FIFO_WRITABLE },
+                };
+                if ((status = mx_object_wait_many(items, rx_wait ? 3 : 2,
+                                                  MX_TIME_INFINITE)) < 0) {
                     printf("eth: tx_fifo: error waiting: %d\n", status);
                     break;
                 }
+                if (items[1].pending & MX_EVENT_SIGNALED) {
+                    mx_object_signal(edev->rx_wait_event, MX_EVENT_SIGNALED, 0);
+                    rx_wait = true;
+                }
+                if (rx_wait && (items[2].pending & MX_FIFO_WRITABLE)) {
+                    rx_wait = eth_rx_retry(edev);
+                }
                 continue;
             } else {
                 printf("eth: tx_fifo: cannot read: %d\n", status);
@@ -253,18 +282,24 @@ static int eth_tx_thread(void* arg) {
         }
 
         uint32_t n = count;
+        size_t nbufs = 0;
         for (eth_fifo_entry_t* e = entries; count-- > 0; e++) {
             if ((e->offset > edev->io_size) || ((e->length > (edev->io_size - e->offset)))) {
                 e->flags = ETH_FIFO_INVALID;
             } else {
-                edev0->macops->send(edev0->mac, 0, edev->io_buf + e->offset, e->length);
+                bufs[nbufs].data = edev->io_buf + e->offset;
+                bufs[nbufs].length = e->length;
+                nbufs++;
                 e->flags = ETH_FIFO_TX_OK;
-                if (edev->state & ETHDEV_TX_LOOPBACK) {
-                    eth_tx_echo(edev0, edev->io_buf + e->offset, e->length);
-                }
             }
         }
 
+        // hand the whole burst to the ethermac at once
+        eth_send(edev0, bufs, nbufs);
+        if ((nbufs > 0) && (edev->state & ETHDEV_TX_LOOPBACK)) {
+            eth_tx_echo(edev0, bufs, nbufs);
+        }
+
         if ((status = mx_fifo_write(edev->tx_fifo, entries, sizeof(eth_fifo_entry_t) * n, &count)) < 0) {
             if (status == ERR_SHOULD_WAIT) {
                 if ((edev->fail_tx_write++ % FAIL_REPORT_RATE) == 0) {
@@ -366,9 +401,16 @@ static mx_status_t eth_start_locked(ethdev_t* edev) {
     }
 
     if (!(edev->state & ETHDEV_TX_THREAD)) {
+        mx_status_t status;
+        if ((status = mx_event_create(0, &edev->rx_wait_event)) < 0) {
+            printf("eth: failed to create rx wait event: %d\n", status);
+            return status;
+        }
         int r = thrd_create_with_name(&edev->tx_thr, eth_tx_thread,
                                       edev, "eth-tx-thread");
         if (r != thrd_success) {
+            mx_handle_close(edev->rx_wait_event);
+            edev->rx_wait_event = MX_HANDLE_INVALID;
             printf("eth: failed to start tx thread: %d\n", r);
             return ERR_INTERNAL;
         }
@@ -397,6 +439,13 @@ static mx_status_t eth_stop_locked(ethdev_t* edev) {
     ethdev0_t* edev0 = edev->edev0;
 
     if (edev->state & ETHDEV_RUNNING) {
+        if (!(edev->state & ETHDEV_DEAD)) {
+            // hand back the buffers cached for future packets too,
+            // the client may not restart us before it wants them
+            if (eth_rx_release(&edev->rx, edev->rx_fifo) == ERR_SHOULD_WAIT) {
+                eth_rx_wait_locked(edev);
+            }
+        }
         edev->state &= (~ETHDEV_RUNNING);
         list_delete(&edev->node);
         list_add_tail(&edev0->list_idle, &edev->node);
@@ -502,6 +551,8 @@ static void eth_kill_locked(ethdev_t* edev) {
         int ret;
         thrd_join(edev->tx_thr, &ret);
         xprintf("eth: kill: tx thread exited\n");
+        mx_handle_close(edev->rx_wait_event);
+        edev->rx_wait_event = MX_HANDLE_INVALID;
     }
 
     if (edev->io_buf) {
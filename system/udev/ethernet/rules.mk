@@ -8,7 +8,9 @@ MODULE := $(LOCAL_DIR)
 
 MODULE_TYPE := driver
 
-MODULE_SRCS := $(LOCAL_DIR)/ethernet.c
+MODULE_SRCS := \
+    $(LOCAL_DIR)/ethernet.c \
+    $(LOCAL_DIR)/ethernet-rx.c \
 
 MODULE_STATIC_LIBS := system/ulib/ddk
 
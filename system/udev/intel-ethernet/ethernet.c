@@ -59,7 +59,8 @@ static int irq_thread(void* arg) {
 
             while (eth_rx(&edev->eth, &data, &len) == NO_ERROR) {
                 if (edev->ifc) {
-                    edev->ifc->recv(edev->cookie, data, len, 0);
+                    uint32_t flags = eth_rx_more(&edev->eth) ? ETHMAC_RX_MORE : 0;
+                    edev->ifc->recv(edev->cookie, data, len, flags);
                 }
                 eth_rx_ack(&edev->eth);
             }
@@ -114,11 +115,18 @@ static void eth_send(mx_device_t* dev, uint32_t options, void* data, size_t leng
     eth_tx(&edev->eth, data, length);
 }
 
+static void eth_send_batch(mx_device_t* dev, uint32_t options,
+                           const ethmac_txbuf_t* bufs, size_t count) {
+    ethernet_device_t* edev = get_eth_device(dev);
+    eth_tx_batch(&edev->eth, bufs, count);
+}
+
 static ethmac_protocol_t ethmac_ops = {
     .query = eth_query,
     .stop = eth_stop,
     .start = eth_start,
     .send = eth_send,
+    .send_batch = eth_send_batch,
 };
 
 static mx_status_t eth_release(mx_device_t* dev) {
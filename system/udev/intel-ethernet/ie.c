@@ -18,6 +18,7 @@
 #include <magenta/types.h>
 #include <magenta/syscalls.h>
 #include <ddk/driver.h>
+#include <ddk/protocol/ethernet.h>
 typedef int status_t;
 #define __nanosleep(x) mx_nanosleep(x);
 #define REG32(addr) ((volatile uint32_t *)(uintptr_t)(addr))
@@ -72,16 +73,13 @@ void eth_rx_ack(ethdev_t* eth) {
     eth->rx_rd_ptr = n;
 }
 
-status_t eth_tx(ethdev_t* eth, const void* data, size_t len) {
-    if ((len < 60) || (len > ETH_TXBUF_DSIZE)) {
-        return ERR_INVALID_ARGS;
-    }
-
-    mx_status_t status = NO_ERROR;
-
-    mtx_lock(&eth->send_lock);
+bool eth_rx_more(ethdev_t* eth) {
+    uint32_t n = (eth->rx_rd_ptr + 1) & (ETH_RXBUF_COUNT - 1);
+    return (eth->rxd[n].info & IE_RXD_DONE) != 0;
+}
 
-    // reclaim completed buffers from hw
+// reclaim completed buffers from hw
+static void eth_tx_reclaim_locked(ethdev_t* eth) {
     uint32_t n = eth->tx_rd_ptr;
     for (;;) {
         uint64_t info = eth->txd[n].info;
@@ -98,30 +96,69 @@ status_t eth_tx(ethdev_t* eth, const void* data, size_t len) {
         n = (n + 1) & (ETH_TXBUF_COUNT - 1);
     }
     eth->tx_rd_ptr = n;
+}
+
+// obtain buffer, copy into it, setup descriptor
+// the caller is responsible for informing hw via IE_TDT
+static status_t eth_tx_queue_locked(ethdev_t* eth, const void* data, size_t len) {
+    if ((len < 60) || (len > ETH_TXBUF_DSIZE)) {
+        return ERR_INVALID_ARGS;
+    }
 
-    // obtain buffer, copy into it, setup descriptor
     framebuf_t *frame = list_remove_head_type(&eth->free_frames, framebuf_t, node);
     if (frame == NULL) {
-        status = ERR_NO_MEMORY;
-        goto out;
+        return ERR_NO_MEMORY;
     }
 
-    n = eth->tx_wr_ptr;
+    uint32_t n = eth->tx_wr_ptr;
     memcpy(frame->data, data, len);
     eth->txd[n].addr = frame->phys;
     eth->txd[n].info = IE_TXD_LEN(len) | IE_TXD_EOP | IE_TXD_IFCS | IE_TXD_RS;
     list_add_tail(&eth->busy_frames, &frame->node);
 
-    // inform hw of buffer availability
-    n = (n + 1) & (ETH_TXBUF_COUNT - 1);
-    eth->tx_wr_ptr = n;
-    writel(n, IE_TDT);
+    eth->tx_wr_ptr = (n + 1) & (ETH_TXBUF_COUNT - 1);
+    return NO_ERROR;
+}
+
+status_t eth_tx(ethdev_t* eth, const void* data, size_t len) {
+    mtx_lock(&eth->send_lock);
+
+    eth_tx_reclaim_locked(eth);
+    mx_status_t status = eth_tx_queue_locked(eth, data, len);
+    if (status == NO_ERROR) {
+        // inform hw of buffer availability
+        writel(eth->tx_wr_ptr, IE_TDT);
+    }
 
-out:
     mtx_unlock(&eth->send_lock);
     return status;
 }
 
+size_t eth_tx_batch(ethdev_t* eth, const ethmac_txbuf_t* bufs, size_t count) {
+    size_t queued = 0;
+
+    mtx_lock(&eth->send_lock);
+
+    eth_tx_reclaim_locked(eth);
+    for (size_t i = 0; i < count; i++) {
+        mx_status_t status = eth_tx_queue_locked(eth, bufs[i].data, bufs[i].length);
+        if (status == ERR_NO_MEMORY) {
+            // ring is full, drop the rest of the burst
+            break;
+        }
+        if (status == NO_ERROR) {
+            queued++;
+        }
+    }
+    if (queued > 0) {
+        // inform hw of buffer availability, once for the whole burst
+        writel(eth->tx_wr_ptr, IE_TDT);
+    }
+
+    mtx_unlock(&eth->send_lock);
+    return queued;
+}
+
 status_t eth_reset_hw(ethdev_t* eth) {
     // TODO: don't rely on bootloader having initialized the
     // controller in order to obtain the mac address
@@ -68,7 +68,14 @@ void eth_dump_regs(ethdev_t* eth);
 status_t eth_rx(ethdev_t* eth, void** data, size_t* len);
 void eth_rx_ack(ethdev_t* eth);
 
+// true if the frame after the current one is also ready
+bool eth_rx_more(ethdev_t* eth);
+
 status_t eth_tx(ethdev_t* eth, const void* data, size_t len);
 
+// queue a burst of frames with a single tail pointer update
+// returns the number of frames queued
+size_t eth_tx_batch(ethdev_t* eth, const ethmac_txbuf_t* bufs, size_t count);
+
 #define ETH_IRQ_RX IE_INT_RXT0
 unsigned eth_handle_irq(ethdev_t* eth);
@@ -4,10 +4,17 @@
 
 #pragma once
 
+#include <magenta/compiler.h>
+#include <magenta/types.h>
 
-#pragma GCC visibility push(hidden)
+__BEGIN_CDECLS
 
-#include <magenta/types.h>
+// A compressed bootfs that is decompressed on demand.  The LZ4 frame is
+// made of independent 64kB blocks, so any range of the image can be
+// decompressed without touching the blocks before it.
+typedef struct bootfs_lazy bootfs_lazy_t;
+
+#pragma GCC visibility push(hidden)
 
 // Decompress bootdata at offset of total size length into a new VMO
 // On failure, errmsg is a human readable error description to provide
@@ -16,4 +23,33 @@ mx_status_t decompress_bootdata(mx_handle_t vmar, mx_handle_t vmo,
                                 size_t offset, size_t length,
                                 mx_handle_t* out, const char** errmsg);
 
+// Index the compressed bootdata at offset of total size length without
+// decompressing it.  Only the bootfs directory is decompressed up front,
+// so the VMO returned by bootfs_lazy_vmo() can be handed to bootfs_parse()
+// immediately; file contents read back as zeros until their range has
+// been populated.
+//
+// The compressed data stays mapped until every block has been populated.
+// Not available in userboot, which only links decompress.c.
+mx_status_t decompress_bootdata_lazy(mx_handle_t vmar, mx_handle_t vmo,
+                                     size_t offset, size_t length,
+                                     bootfs_lazy_t** out, const char** errmsg);
+
+// The VMO holding the (partially) decompressed image.  The handle is owned
+// by the bootfs_lazy_t and is laid out like the output of
+// decompress_bootdata().
+mx_handle_t bootfs_lazy_vmo(bootfs_lazy_t* lz);
+
+// Decompress every block overlapping [off, off + len) of the image that has
+// not been decompressed yet.  Returns ERR_OUT_OF_RANGE if the range runs
+// past the image and ERR_IO_DATA_INTEGRITY if a block in it is corrupt; a
+// corrupt block keeps failing on later calls.
+mx_status_t bootfs_lazy_populate(bootfs_lazy_t* lz, uint64_t off, uint64_t len);
+
+// Decompress the whole image using up to nthreads threads, each working on
+// independent blocks.
+mx_status_t bootfs_lazy_populate_all(bootfs_lazy_t* lz, uint32_t nthreads);
+
 #pragma GCC visibility pop
+
+__END_CDECLS
@@ -0,0 +1,380 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <bootdata/decompress.h>
+
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#include <magenta/boot/bootdata.h>
+#include <magenta/compiler.h>
+#include <magenta/syscalls.h>
+
+#include <lz4/lz4.h>
+
+#include "lz4-frame.h"
+
+#define BLOCK_EMPTY 0
+#define BLOCK_BUSY  1
+#define BLOCK_DONE  2
+#define BLOCK_ERROR 3
+
+#define MAX_THREADS 16
+
+typedef struct {
+    // offset of the block payload from the start of the compressed frame
+    size_t src_off;
+    // size as stored in the frame, including MX_LZ4_BLOCK_UNCOMPRESSED
+    uint32_t src_len;
+    uint8_t state;
+} lz4_block_t;
+
+struct bootfs_lazy {
+    // Block state is shared between bootfs_lazy_populate_all()'s workers.
+    mtx_t lock;
+    cnd_t cnd;
+
+    mx_handle_t vmar;
+    mx_handle_t vmo;
+
+    // The compressed bootdata item; unmapped once every block is done.
+    uintptr_t src_map;
+    size_t src_map_len;
+    const uint8_t* src;
+
+    // The decompressed image, mapped read/write for the lifetime of lz.
+    uintptr_t dst_map;
+    size_t dst_map_len;
+    size_t content_size;
+
+    size_t pending;
+    size_t nblocks;
+    lz4_block_t blocks[];
+};
+
+static mx_status_t lazy_decompress_block(bootfs_lazy_t* lz, size_t n) {
+    const lz4_block_t* b = &lz->blocks[n];
+    size_t off = n * MX_LZ4_BLOCK_SIZE;
+    size_t expected = lz->content_size - off;
+    if (expected > MX_LZ4_BLOCK_SIZE) {
+        expected = MX_LZ4_BLOCK_SIZE;
+    }
+    const uint8_t* src = lz->src + b->src_off;
+    uint8_t* dst = (uint8_t*)lz->dst_map + sizeof(bootdata_t) + off;
+
+    if (b->src_len & MX_LZ4_BLOCK_UNCOMPRESSED) {
+        if ((b->src_len & ~MX_LZ4_BLOCK_UNCOMPRESSED) != expected) {
+            return ERR_IO_DATA_INTEGRITY;
+        }
+        memcpy(dst, src, expected);
+        return NO_ERROR;
+    }
+    int dcmp = LZ4_decompress_safe((const char*)src, (char*)dst, b->src_len, expected);
+    if ((dcmp < 0) || ((size_t)dcmp != expected)) {
+        return ERR_IO_DATA_INTEGRITY;
+    }
+    return NO_ERROR;
+}
+
+static mx_status_t lazy_fill_block(bootfs_lazy_t* lz, size_t n) {
+    mx_status_t status;
+
+    mtx_lock(&lz->lock);
+    for (;;) {
+        switch (lz->blocks[n].state) {
+        case BLOCK_DONE:
+            mtx_unlock(&lz->lock);
+            return NO_ERROR;
+        case BLOCK_ERROR:
+            mtx_unlock(&lz->lock);
+            return ERR_IO_DATA_INTEGRITY;
+        case BLOCK_BUSY:
+            cnd_wait(&lz->cnd, &lz->lock);
+            continue;
+        }
+        break;
+    }
+    lz->blocks[n].state = BLOCK_BUSY;
+    mtx_unlock(&lz->lock);
+
+    status = lazy_decompress_block(lz, n);
+
+    mtx_lock(&lz->lock);
+    lz->blocks[n].state = (status < 0) ? BLOCK_ERROR : BLOCK_DONE;
+    if ((status == NO_ERROR) && (--lz->pending == 0)) {
+        // Nothing will read the compressed image again.
+        mx_vmar_unmap(lz->vmar, lz->src_map, lz->src_map_len);
+        lz->src = NULL;
+    }
+    cnd_broadcast(&lz->cnd);
+    mtx_unlock(&lz->lock);
+    return status;
+}
+
+mx_status_t bootfs_lazy_populate(bootfs_lazy_t* lz, uint64_t off, uint64_t len) {
+    // The bootdata header is not part of the LZ4 frame.
+    uint64_t end = off + len;
+    if ((end < off) || (end > sizeof(bootdata_t) + lz->content_size)) {
+        return ERR_OUT_OF_RANGE;
+    }
+    if (end <= sizeof(bootdata_t)) {
+        return NO_ERROR;
+    }
+    off = (off < sizeof(bootdata_t)) ? 0 : off - sizeof(bootdata_t);
+    end -= sizeof(bootdata_t);
+
+    for (size_t n = off / MX_LZ4_BLOCK_SIZE; n * MX_LZ4_BLOCK_SIZE < end; n++) {
+        mx_status_t status = lazy_fill_block(lz, n);
+        if (status < 0) {
+            return status;
+        }
+    }
+    return NO_ERROR;
+}
+
+typedef struct {
+    bootfs_lazy_t* lz;
+    atomic_size_t next;
+    atomic_int status;
+} populate_all_t;
+
+static int lazy_populate_thread(void* arg) {
+    populate_all_t* pa = arg;
+    size_t n;
+    while ((n = atomic_fetch_add(&pa->next, 1)) < pa->lz->nblocks) {
+        mx_status_t status = lazy_fill_block(pa->lz, n);
+        if (status < 0) {
+            atomic_store(&pa->status, status);
+            break;
+        }
+    }
+    return 0;
+}
+
+mx_status_t bootfs_lazy_populate_all(bootfs_lazy_t* lz, uint32_t nthreads) {
+    populate_all_t pa = {
+        .lz = lz,
+    };
+    atomic_init(&pa.next, 0);
+    atomic_init(&pa.status, NO_ERROR);
+
+    if (nthreads > MAX_THREADS) {
+        nthreads = MAX_THREADS;
+    }
+    if (nthreads > lz->nblocks) {
+        nthreads = lz->nblocks;
+    }
+
+    // The calling thread is one of the workers.
+    thrd_t t[MAX_THREADS];
+    uint32_t started = 0;
+    while (started + 1 < nthreads) {
+        if (thrd_create_with_name(&t[started], lazy_populate_thread, &pa,
+                                  "bootfs-lz4") != thrd_success) {
+            break;
+        }
+        started++;
+    }
+    lazy_populate_thread(&pa);
+    for (uint32_t i = 0; i < started; i++) {
+        thrd_join(t[i], NULL);
+    }
+    return atomic_load(&pa.status);
+}
+
+mx_handle_t bootfs_lazy_vmo(bootfs_lazy_t* lz) {
+    return lz->vmo;
+}
+
+// Walk the bootfs directory, populating it as we go, since its size is
+// only known by finding the end marker.
+static mx_status_t lazy_populate_dir(bootfs_lazy_t* lz) {
+    size_t limit = sizeof(bootdata_t) + lz->content_size;
+    size_t off = sizeof(bootdata_t);
+    mx_status_t status;
+    uint32_t header[3];
+
+    for (;;) {
+        if (off + sizeof(header) > limit) {
+            return NO_ERROR;
+        }
+        if ((status = bootfs_lazy_populate(lz, off, sizeof(header))) < 0) {
+            return status;
+        }
+        memcpy(header, (const uint8_t*)lz->dst_map + off, sizeof(header));
+        if (header[0] == 0) {
+            return NO_ERROR;
+        }
+        off += sizeof(header);
+        if (header[0] > limit - off) {
+            return ERR_IO_DATA_INTEGRITY;
+        }
+        if ((status = bootfs_lazy_populate(lz, off, header[0])) < 0) {
+            return status;
+        }
+        off += header[0];
+    }
+}
+
+static mx_status_t lazy_index(bootfs_lazy_t** out, const uint8_t* data,
+                              size_t length, const char** err) {
+    const bootdata_t* hdr = (const bootdata_t*)data;
+    const uint8_t* end = data + length;
+
+    // Skip past the bootdata header
+    data += sizeof(bootdata_t);
+
+    if ((size_t)(end - data) < sizeof(uint32_t) + sizeof(lz4_frame_desc)) {
+        *err = "compressed bootfs truncated";
+        return ERR_INVALID_ARGS;
+    }
+    if (*(const uint32_t*)data != MX_LZ4_MAGIC) {
+        *err = "bad magic number for compressed bootfs";
+        return ERR_INVALID_ARGS;
+    }
+    data += sizeof(uint32_t);
+
+    if (hdr->extra < sizeof(bootdata_t)) {
+        *err = "lz4 output size too small";
+        return ERR_INVALID_ARGS;
+    }
+    size_t content_size = hdr->extra - sizeof(bootdata_t);
+    mx_status_t status = check_lz4_frame((const lz4_frame_desc*)data, content_size, err);
+    if (status < 0) {
+        return status;
+    }
+    data += sizeof(lz4_frame_desc);
+
+    size_t nblocks = (content_size + MX_LZ4_BLOCK_SIZE - 1) / MX_LZ4_BLOCK_SIZE;
+    bootfs_lazy_t* lz = calloc(1, sizeof(bootfs_lazy_t) + nblocks * sizeof(lz4_block_t));
+    if (lz == NULL) {
+        *err = "out of memory for bootfs block index";
+        return ERR_NO_MEMORY;
+    }
+
+    // Record where each block starts. Nothing is decompressed here.
+    const uint8_t* frame = data;
+    size_t n = 0;
+    for (;;) {
+        if ((size_t)(end - data) < sizeof(uint32_t)) {
+            *err = "compressed bootfs truncated";
+            goto fail;
+        }
+        uint32_t blocksize = *(const uint32_t*)data;
+        data += sizeof(uint32_t);
+        if (blocksize == 0) {
+            break;
+        }
+        uint32_t actual = blocksize & ~MX_LZ4_BLOCK_UNCOMPRESSED;
+        if ((n == nblocks) || (actual > (size_t)(end - data))) {
+            *err = "bootdata size error; outsize does not match decompressed size";
+            goto fail;
+        }
+        lz->blocks[n].src_off = data - frame;
+        lz->blocks[n].src_len = blocksize;
+        data += actual;
+        n++;
+    }
+    if (n != nblocks) {
+        *err = "bootdata size error; outsize does not match decompressed size";
+        goto fail;
+    }
+
+    lz->src = frame;
+    lz->content_size = content_size;
+    lz->nblocks = nblocks;
+    lz->pending = nblocks;
+    *out = lz;
+    return NO_ERROR;
+
+fail:
+    free(lz);
+    return ERR_INVALID_ARGS;
+}
+
+mx_status_t decompress_bootdata_lazy(mx_handle_t vmar, mx_handle_t vmo,
+                                     size_t offset, size_t length,
+                                     bootfs_lazy_t** out, const char** err) {
+    *err = "none";
+
+    uintptr_t addr = 0;
+    size_t aligned_offset = offset & ~(PAGE_SIZE - 1);
+    size_t align_shift = offset - aligned_offset;
+    size_t map_len = length + align_shift;
+    mx_status_t status = mx_vmar_map(vmar, 0, vmo, aligned_offset, map_len,
+                                     MX_VM_FLAG_PERM_READ, &addr);
+    if (status < 0) {
+        *err = "mx_vmar_map failed on bootfs vmo";
+        return status;
+    }
+
+    const bootdata_t* hdr = (const bootdata_t*)(addr + align_shift);
+    if (((hdr->type != BOOTDATA_BOOTFS_BOOT) && (hdr->type != BOOTDATA_BOOTFS_SYSTEM)) ||
+        !(hdr->flags & BOOTDATA_BOOTFS_FLAG_COMPRESSED)) {
+        *err = "not a compressed bootfs, not attempting decompression";
+        mx_vmar_unmap(vmar, addr, map_len);
+        return ERR_NOT_SUPPORTED;
+    }
+
+    bootfs_lazy_t* lz;
+    if ((status = lazy_index(&lz, (const uint8_t*)hdr, length, err)) < 0) {
+        mx_vmar_unmap(vmar, addr, map_len);
+        return status;
+    }
+    lz->vmar = vmar;
+    lz->src_map = addr;
+    lz->src_map_len = map_len;
+    mtx_init(&lz->lock, mtx_plain);
+    cnd_init(&lz->cnd);
+
+    size_t newsize = (hdr->extra + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    if (newsize < hdr->extra) {
+        *err = "lz4 output size too large";
+        status = ERR_NO_MEMORY;
+        goto fail;
+    }
+    if ((status = mx_vmo_create((uint64_t)newsize, 0, &lz->vmo)) < 0) {
+        *err = "mx_vmo_create failed for decompressing bootfs";
+        goto fail;
+    }
+    if ((status = mx_vmar_map(vmar, 0, lz->vmo, 0, newsize,
+                              MX_VM_FLAG_PERM_READ | MX_VM_FLAG_PERM_WRITE,
+                              &lz->dst_map)) < 0) {
+        *err = "mx_vmar_map failed on bootfs vmo during decompression";
+        goto fail;
+    }
+    lz->dst_map_len = newsize;
+
+    // Copy the bootdata header but mark it as not compressed
+    bootdata_t* boothdr = (bootdata_t*)lz->dst_map;
+    *boothdr = *hdr;
+    boothdr->length = hdr->extra;
+    boothdr->flags &= ~BOOTDATA_BOOTFS_FLAG_COMPRESSED;
+
+    if ((status = lazy_populate_dir(lz)) < 0) {
+        *err = "lz4 decompression of bootfs directory failed";
+        goto fail;
+    }
+
+    *out = lz;
+    return NO_ERROR;
+
+fail:
+    if (lz->dst_map) {
+        mx_vmar_unmap(vmar, lz->dst_map, lz->dst_map_len);
+    }
+    if (lz->vmo != MX_HANDLE_INVALID) {
+        mx_handle_close(lz->vmo);
+    }
+    if (lz->src != NULL) {
+        mx_vmar_unmap(vmar, addr, map_len);
+    }
+    cnd_destroy(&lz->cnd);
+    mtx_destroy(&lz->lock);
+    free(lz);
+    return status;
+}
@@ -8,7 +8,9 @@ MODULE := $(LOCAL_DIR)
 
 MODULE_TYPE := userlib
 
-MODULE_SRCS += $(LOCAL_DIR)/decompress.c
+MODULE_SRCS += \
+    $(LOCAL_DIR)/decompress.c \
+    $(LOCAL_DIR)/lazy.c
 
 MODULE_LIBS := \
     third_party/ulib/lz4 \
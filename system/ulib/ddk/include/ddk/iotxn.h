@@ -126,6 +126,24 @@ struct iotxn {
 #define IOTXN_ALLOC_CONTIGUOUS (1 << 0)    // allocate a contiguous vmo
 #define IOTXN_ALLOC_POOL       (1 << 1)    // freelist this iotxn on iotxn_release
 
+// iotxns allocated with IOTXN_ALLOC_POOL (and all clones) are returned to
+// a pool on iotxn_release().  The pool groups them by size classes at most
+// 25% apart and keeps a small per-thread cache in front of the shared lists.
+// Pooled iotxns may be backed by a vmo larger than requested; vmo_length is
+// always the requested size.  Any iotxn_alloc() may be satisfied from the
+// pool, in which case the iotxn is pooled again when released.
+typedef struct iotxn_pool_stats {
+    uint64_t alloc_count;       // iotxn_alloc() and iotxn_clone() calls
+    uint64_t thread_hits;       // allocations served from a per-thread cache
+    uint64_t pool_hits;         // allocations served from the shared lists
+    uint64_t misses;            // allocations that created a new iotxn
+    uint64_t release_count;     // iotxns released to the pool
+    uint64_t evictions;         // released iotxns freed because the pool was full
+    uint64_t cached_count;      // iotxns currently held by the pool
+    uint64_t cached_bytes;      // memory currently held by the pool
+    uint64_t max_cached_bytes;  // limit on cached_bytes
+} iotxn_pool_stats_t;
+
 // create a new iotxn with payload space of data_size
 mx_status_t iotxn_alloc(iotxn_t** out, uint32_t alloc_flags, uint64_t data_size);
 
@@ -134,6 +152,13 @@ mx_status_t iotxn_alloc(iotxn_t** out, uint32_t alloc_flags, uint64_t data_size)
 // but not free the iotxn itself.
 void iotxn_init(iotxn_t* txn, mx_handle_t vmo_handle, uint64_t vmo_offset, uint64_t length);
 
+// obtain a snapshot of the process-wide iotxn pool statistics
+void iotxn_pool_stats(iotxn_pool_stats_t* stats);
+
+// bound the memory (vmo capacity plus bookkeeping) retained by the pool
+// iotxns released while the pool is at its limit are freed instead
+void iotxn_pool_set_max_bytes(size_t max_bytes);
+
 // queue an iotxn against a device
 void iotxn_queue(mx_device_t* dev, iotxn_t* txn);
 
@@ -45,6 +45,15 @@ typedef struct ethmac_info {
 
 #define ETHMAC_STATUS_ONLINE (1u)
 
+// recv() flags
+//
+// ETHMAC_RX_MORE indicates that the driver has more frames ready
+// and will call recv() again before returning from its interrupt
+// handler.  The ethernet layer may defer returning completed buffers
+// to its clients until it sees a recv() without this flag, so drivers
+// must never set it on the last frame of a burst.
+#define ETHMAC_RX_MORE (1u)
+
 typedef struct ethmac_ifc_virt {
     void (*status)(void* cookie, uint32_t status);
 
@@ -56,6 +65,12 @@ typedef struct ethmac_ifc_virt {
     void (*complete_tx)(void* cookie, uint32_t count);
 } ethmac_ifc_t;
 
+// A single frame to be transmitted via send_batch()
+typedef struct ethmac_txbuf {
+    void* data;
+    size_t length;
+} ethmac_txbuf_t;
+
 
 // The ethernet midlayer will never call ethermac_protocol
 // methods from multiple threads simultaneously, but it
@@ -84,6 +99,13 @@ typedef struct ethmac_protocol {
                      uintptr_t pa0, uintptr_t pa1, size_t length);
     void (*queue_rx)(mx_device_t* dev, uint32_t options,
                      uintptr_t pa0, uintptr_t pa1, size_t length);
+
+    // send_batch() is optional and, like send(), only valid if FEATURE_TX_QUEUE
+    // is not present.  It transmits |count| frames in order, allowing the
+    // driver to post a burst of descriptors and notify the hardware once.
+    // If it is NULL, the ethernet layer calls send() for each frame instead.
+    void (*send_batch)(mx_device_t* dev, uint32_t options,
+                       const ethmac_txbuf_t* bufs, size_t count);
 } ethmac_protocol_t;
 
 
@@ -31,9 +31,72 @@
 #define IOTXN_PFLAG_PHYSMAP    (1 << 2)   // we performed physmap() on this vmo
 #define IOTXN_PFLAG_MMAP       (1 << 3)   // we performed mmap() on this vmo
 #define IOTXN_PFLAG_FREE       (1 << 4)   // this txn has been released
-
-static list_node_t free_list = LIST_INITIAL_VALUE(free_list);
-static mtx_t free_list_mutex = MTX_INIT;
+#define IOTXN_PFLAG_PRIV       (1 << 5)   // this txn is embedded in an iotxn_priv_t
+
+// iotxns created by iotxn_alloc() and iotxn_clone() carry some extra
+// state used by the pool
+typedef struct iotxn_priv {
+    iotxn_t txn;
+
+    uint32_t bucket;        // pool bucket, or IOTXN_BUCKET_NONE if not pooled
+    uint64_t vmo_capacity;  // size of the vmo we created (>= vmo_length)
+    uint64_t mmap_length;   // length mapped by iotxn_mmap()
+} iotxn_priv_t;
+
+#define get_priv(txn) containerof(txn, iotxn_priv_t, txn)
+
+// Released iotxns are cached in buckets by size class, so an allocation
+// can reuse any vmo of its class rather than only exact size matches.
+// Class 0 holds iotxns without a payload (clones and zero-sized txns).
+// Classes 1 to 4 hold vmos of 1 to 4 pages, and past that there are
+// IOTXN_CLASS_STEPS classes per doubling (5, 6, 7 and 8 pages, then 10,
+// 12, 14 and 16, and so on up to 2048), so a vmo is at most 25% larger
+// than the request it was made for.  Power-of-two classes could nearly
+// double it, which wastes too much of the scarce contiguous memory.
+// Contiguous and non-contiguous vmos live in separate buckets.
+//
+// Each thread keeps a small magazine of iotxns per bucket which it can
+// allocate from and release into without locking.  Full magazines spill
+// half their contents into the shared per-bucket free lists, and empty
+// ones refill from them.
+#define IOTXN_CLASS_STEPS   4
+#define IOTXN_SIZE_CLASSES  41
+#define IOTXN_BUCKETS       (IOTXN_SIZE_CLASSES * 2)
+#define IOTXN_BUCKET_NONE   UINT32_MAX
+#define IOTXN_MAGAZINE_SIZE 8
+
+#define IOTXN_POOL_DEFAULT_MAX_BYTES (32u * 1024 * 1024)
+
+typedef struct iotxn_bucket {
+    mtx_t lock;
+    list_node_t free_list;
+} iotxn_bucket_t;
+
+typedef struct iotxn_magazine {
+    uint32_t count[IOTXN_BUCKETS];
+    iotxn_priv_t* txns[IOTXN_BUCKETS][IOTXN_MAGAZINE_SIZE];
+} iotxn_magazine_t;
+
+static iotxn_bucket_t buckets[IOTXN_BUCKETS];
+static once_flag pool_once = ONCE_FLAG_INIT;
+static tss_t magazine_key;
+static bool magazines_enabled;
+static thread_local iotxn_magazine_t* magazine;
+
+static atomic_uint_fast64_t pool_max_bytes = IOTXN_POOL_DEFAULT_MAX_BYTES;
+static atomic_uint_fast64_t pool_bytes;
+static atomic_uint_fast64_t pool_count;
+
+static struct {
+    atomic_uint_fast64_t alloc_count;
+    atomic_uint_fast64_t thread_hits;
+    atomic_uint_fast64_t pool_hits;
+    atomic_uint_fast64_t misses;
+    atomic_uint_fast64_t release_count;
+    atomic_uint_fast64_t evictions;
+} pool_stats;
+
+#define stat_inc(name) atomic_fetch_add_explicit(&pool_stats.name, 1, memory_order_relaxed)
 
 // This assert will fail if we attempt to access the buffer of a cloned txn after it has been completed
 #define ASSERT_BUFFER_VALID(priv) MX_DEBUG_ASSERT(!(priv->flags & IOTXN_FLAG_DEAD))
@@ -50,29 +113,205 @@ static bool do_free_phys(uint32_t pflags) {
     return (pflags & IOTXN_PFLAG_PHYSMAP);
 }
 
-static iotxn_t* find_in_free_list(uint32_t pflags, uint64_t data_size) {
-    bool found = false;
-    iotxn_t* txn = NULL;
-    //xprintf("find_in_free_list pflags 0x%x data_size 0x%" PRIx64 "\n", pflags, data_size);
-    mtx_lock(&free_list_mutex);
-    list_for_every_entry (&free_list, txn, iotxn_t, node) {
-        //xprintf("find_in_free_list for_every txn %p\n", txn);
-        if ((txn->pflags & pflags) && (txn->vmo_length == data_size)) {
-            found = true;
+static uint64_t mmap_length(iotxn_t* txn) {
+    return (txn->pflags & IOTXN_PFLAG_PRIV) ? get_priv(txn)->mmap_length : txn->vmo_length;
+}
+
+static uint64_t class_to_pages(uint32_t cls) {
+    if (cls <= IOTXN_CLASS_STEPS) {
+        return cls;
+    }
+    uint32_t doubling = (cls - 1) / IOTXN_CLASS_STEPS;
+    uint32_t step = (cls - 1) % IOTXN_CLASS_STEPS;
+    return (uint64_t)(IOTXN_CLASS_STEPS + 1 + step) << (doubling - 1);
+}
+
+// returns IOTXN_SIZE_CLASSES if data_size is too large to be pooled
+static uint32_t size_to_class(uint64_t data_size) {
+    if (data_size == 0) {
+        return 0;
+    }
+    uint64_t pages = (data_size + PAGE_SIZE - 1) / PAGE_SIZE;
+    uint32_t cls = 1;
+    while (class_to_pages(cls) < pages) {
+        if (++cls == IOTXN_SIZE_CLASSES) {
             break;
         }
     }
-    if (found) {
-        txn->pflags &= ~IOTXN_PFLAG_FREE;
-        list_delete(&txn->node);
+    return cls;
+}
+
+static uint64_t class_to_capacity(uint32_t cls) {
+    return class_to_pages(cls) * PAGE_SIZE;
+}
+
+static uint32_t class_to_bucket(uint32_t cls, uint32_t pflags) {
+    if (cls >= IOTXN_SIZE_CLASSES) {
+        return IOTXN_BUCKET_NONE;
+    }
+    if ((cls > 0) && (pflags & IOTXN_PFLAG_CONTIGUOUS)) {
+        return cls + IOTXN_SIZE_CLASSES;
+    }
+    return cls;
+}
+
+// memory accounted against the pool limit for a cached txn
+static uint64_t pool_cost(iotxn_priv_t* priv) {
+    return priv->vmo_capacity + sizeof(iotxn_priv_t);
+}
+
+// move the contents of a magazine to the shared lists
+static void magazine_flush(iotxn_magazine_t* mag) {
+    for (uint32_t b = 0; b < IOTXN_BUCKETS; b++) {
+        if (mag->count[b] == 0) {
+            continue;
+        }
+        mtx_lock(&buckets[b].lock);
+        while (mag->count[b] > 0) {
+            list_add_head(&buckets[b].free_list, &mag->txns[b][--mag->count[b]]->txn.node);
+        }
+        mtx_unlock(&buckets[b].lock);
+    }
+}
+
+// called when a thread with a magazine exits
+static void magazine_destroy(void* arg) {
+    iotxn_magazine_t* mag = arg;
+    magazine_flush(mag);
+    free(mag);
+    magazine = NULL;
+}
+
+static void pool_init(void) {
+    for (uint32_t b = 0; b < IOTXN_BUCKETS; b++) {
+        mtx_init(&buckets[b].lock, mtx_plain);
+        list_initialize(&buckets[b].free_list);
+    }
+    if (tss_create(&magazine_key, magazine_destroy) == thrd_success) {
+        magazines_enabled = true;
+    } else {
+        // threads will use the shared lists only
+        printf("iotxn: cannot create per-thread caches\n");
+    }
+}
+
+static iotxn_magazine_t* get_magazine(void) {
+    if ((magazine == NULL) && magazines_enabled) {
+        iotxn_magazine_t* mag = calloc(1, sizeof(iotxn_magazine_t));
+        if ((mag != NULL) && (tss_set(magazine_key, mag) != thrd_success)) {
+            free(mag);
+            mag = NULL;
+        }
+        magazine = mag;
+    }
+    return magazine;
+}
+
+// take a txn out of the pool, preferring this thread's magazine
+static iotxn_priv_t* pool_get(uint32_t bucket) {
+    iotxn_priv_t* priv = NULL;
+    iotxn_magazine_t* mag = magazine;
+
+    if ((mag != NULL) && (mag->count[bucket] > 0)) {
+        priv = mag->txns[bucket][--mag->count[bucket]];
+        stat_inc(thread_hits);
+    } else {
+        iotxn_bucket_t* b = &buckets[bucket];
+        mtx_lock(&b->lock);
+        priv = list_remove_head_type(&b->free_list, iotxn_priv_t, txn.node);
+        if ((priv != NULL) && (mag != NULL)) {
+            // refill half the magazine while we hold the lock
+            iotxn_priv_t* extra;
+            while ((mag->count[bucket] < (IOTXN_MAGAZINE_SIZE / 2)) &&
+                   ((extra = list_remove_head_type(&b->free_list, iotxn_priv_t, txn.node)) != NULL)) {
+                mag->txns[bucket][mag->count[bucket]++] = extra;
+            }
+        }
+        mtx_unlock(&b->lock);
+        if (priv != NULL) {
+            stat_inc(pool_hits);
+        }
+    }
+
+    if (priv != NULL) {
+        atomic_fetch_sub(&pool_bytes, pool_cost(priv));
+        atomic_fetch_sub(&pool_count, 1);
+        MX_DEBUG_ASSERT(priv->txn.pflags & IOTXN_PFLAG_FREE);
     }
-    mtx_unlock(&free_list_mutex);
-    //xprintf("find_in_free_list found %d txn %p\n", found, txn);
-    return found ? txn : NULL;
+    return priv;
 }
 
-// return the iotxn into the free list
+// reserve space in the pool for a released txn
+// returns false if caching it would exceed the pool limit
+static bool pool_reserve(iotxn_priv_t* priv) {
+    uint64_t cost = pool_cost(priv);
+    uint64_t max = atomic_load(&pool_max_bytes);
+    uint64_t cur = atomic_load(&pool_bytes);
+    do {
+        if ((cur + cost) > max) {
+            return false;
+        }
+    } while (!atomic_compare_exchange_weak(&pool_bytes, &cur, cur + cost));
+    atomic_fetch_add(&pool_count, 1);
+    return true;
+}
+
+// return a txn to the pool; space must have been reserved with pool_reserve()
+static void pool_put(iotxn_priv_t* priv) {
+    uint32_t bucket = priv->bucket;
+    iotxn_bucket_t* b = &buckets[bucket];
+    iotxn_magazine_t* mag = get_magazine();
+
+    if (mag == NULL) {
+        mtx_lock(&b->lock);
+        list_add_head(&b->free_list, &priv->txn.node);
+        mtx_unlock(&b->lock);
+        return;
+    }
+
+    if (mag->count[bucket] == IOTXN_MAGAZINE_SIZE) {
+        // spill the older half of the magazine into the shared list
+        mtx_lock(&b->lock);
+        for (uint32_t n = 0; n < (IOTXN_MAGAZINE_SIZE / 2); n++) {
+            list_add_head(&b->free_list, &mag->txns[bucket][n]->txn.node);
+        }
+        mtx_unlock(&b->lock);
+        memmove(&mag->txns[bucket][0], &mag->txns[bucket][IOTXN_MAGAZINE_SIZE / 2],
+                sizeof(iotxn_priv_t*) * (IOTXN_MAGAZINE_SIZE / 2));
+        mag->count[bucket] -= IOTXN_MAGAZINE_SIZE / 2;
+    }
+    mag->txns[bucket][mag->count[bucket]++] = priv;
+}
+
+// free the iotxn
+static void iotxn_release_free(iotxn_t* txn) {
+    if (do_free_phys(txn->pflags)) {
+        if (txn->phys != NULL) {
+            free(txn->phys);
+        }
+    }
+    if (txn->pflags & IOTXN_PFLAG_MMAP) {
+        if (txn->virt) {
+            mx_vmar_unmap(mx_vmar_root_self(), (uintptr_t)txn->virt, mmap_length(txn));
+        }
+    }
+    if (txn->pflags & IOTXN_PFLAG_ALLOC) {
+        mx_handle_close(txn->vmo_handle);
+    }
+    free(txn->pflags & IOTXN_PFLAG_PRIV ? (void*)get_priv(txn) : (void*)txn);
+}
+
+// return the iotxn into the pool
 static void iotxn_release_free_list(iotxn_t* txn) {
+    iotxn_priv_t* priv = get_priv(txn);
+
+    stat_inc(release_count);
+    if (!pool_reserve(priv)) {
+        stat_inc(evictions);
+        iotxn_release_free(txn);
+        return;
+    }
+
     mx_handle_t vmo_handle = txn->vmo_handle;
     uint64_t vmo_offset = txn->vmo_offset;
     uint64_t vmo_length = txn->vmo_length;
@@ -85,14 +324,19 @@ static void iotxn_release_free_list(iotxn_t* txn) {
     memset(txn, 0, sizeof(iotxn_t));
 
     if (pflags & IOTXN_PFLAG_ALLOC) {
-        // if we allocated the vmo, keep it around
+        // if we allocated the vmo, keep it around, along with any
+        // mapping and physical page list we made for it
         txn->vmo_handle = vmo_handle;
         txn->vmo_offset = vmo_offset;
         txn->vmo_length = vmo_length;
-        txn->virt = virt;
-        txn->phys = phys;
-        txn->phys_offset = phys_offset;
-        txn->phys_length = phys_length;
+        if (pflags & IOTXN_PFLAG_MMAP) {
+            txn->virt = virt;
+        }
+        if (pflags & IOTXN_PFLAG_PHYSMAP) {
+            txn->phys = phys;
+            txn->phys_offset = phys_offset;
+            txn->phys_length = phys_length;
+        }
         txn->pflags = pflags;
     } else {
         if (do_free_phys(pflags)) {
@@ -103,37 +347,44 @@ static void iotxn_release_free_list(iotxn_t* txn) {
         if (pflags & IOTXN_PFLAG_MMAP) {
             // only unmap if we called mmap()
             if (virt) {
-                mx_vmar_unmap(mx_vmar_root_self(), (uintptr_t)virt, vmo_length);
+                mx_vmar_unmap(mx_vmar_root_self(), (uintptr_t)virt, priv->mmap_length);
             }
         }
+        txn->pflags = pflags & (IOTXN_PFLAG_CONTIGUOUS | IOTXN_PFLAG_PRIV);
     }
 
     txn->pflags |= IOTXN_PFLAG_FREE;
     txn->release_cb = iotxn_release_free_list;
 
-    mtx_lock(&free_list_mutex);
-    list_add_head(&free_list, &txn->node);
-    mtx_unlock(&free_list_mutex);
+    pool_put(priv);
 
     xprintf("iotxn_release_free_list released txn %p\n", txn);
 }
 
-// free the iotxn
-static void iotxn_release_free(iotxn_t* txn) {
-    if (do_free_phys(txn->pflags)) {
-        if (txn->phys != NULL) {
+// prepare a txn taken from the pool to hold data_size bytes
+static void iotxn_pool_reuse(iotxn_priv_t* priv, uint64_t data_size) {
+    iotxn_t* txn = &priv->txn;
+
+    // the cached mapping and page list are only still valid if they
+    // cover the same range of the vmo as before
+    if ((txn->vmo_offset != 0) || (txn->vmo_length != data_size)) {
+        bool keep_phys = (txn->pflags & IOTXN_PFLAG_CONTIGUOUS) && (txn->vmo_offset == 0);
+        if ((txn->pflags & IOTXN_PFLAG_PHYSMAP) && !keep_phys) {
             free(txn->phys);
+            txn->phys = NULL;
+            txn->phys_offset = 0;
+            txn->phys_length = 0;
+            txn->pflags &= ~IOTXN_PFLAG_PHYSMAP;
         }
-    }
-    if (txn->pflags & IOTXN_PFLAG_MMAP) {
-        if (txn->virt) {
-            mx_vmar_unmap(mx_vmar_root_self(), (uintptr_t)txn->virt, txn->vmo_length);
+        if (txn->pflags & IOTXN_PFLAG_MMAP) {
+            mx_vmar_unmap(mx_vmar_root_self(), (uintptr_t)txn->virt, priv->mmap_length);
+            txn->virt = NULL;
+            txn->pflags &= ~IOTXN_PFLAG_MMAP;
         }
     }
-    if (txn->pflags & IOTXN_PFLAG_ALLOC) {
-        mx_handle_close(txn->vmo_handle);
-    }
-    free(txn);
+    txn->vmo_offset = 0;
+    txn->vmo_length = data_size;
+    txn->pflags &= ~IOTXN_PFLAG_FREE;
 }
 
 // releases data for a statically allocated iotxn
@@ -156,6 +407,59 @@ static void iotxn_release_static(iotxn_t* txn) {
             txn->virt = NULL;
         }
     }
+    txn->pflags &= ~(IOTXN_PFLAG_PHYSMAP | IOTXN_PFLAG_MMAP);
+}
+
+void iotxn_pool_set_max_bytes(size_t max_bytes) {
+    call_once(&pool_once, pool_init);
+    atomic_store(&pool_max_bytes, max_bytes);
+
+    // Magazines count against the limit like the shared lists do. Ours is
+    // emptied into the shared lists so it can be trimmed along with them;
+    // other threads' magazines cannot be touched from here, and drain as
+    // those threads reuse their txns, since releases which would exceed
+    // the limit are freed.
+    if (magazine != NULL) {
+        magazine_flush(magazine);
+    }
+
+    // trim the shared lists, largest first
+    for (uint32_t cls = IOTXN_SIZE_CLASSES; cls-- > 0;) {
+        for (uint32_t n = 0; n < 2; n++) {
+            uint32_t bucket = class_to_bucket(cls, n ? IOTXN_PFLAG_CONTIGUOUS : 0);
+            iotxn_bucket_t* b = &buckets[bucket];
+            for (;;) {
+                if (atomic_load(&pool_bytes) <= max_bytes) {
+                    return;
+                }
+                mtx_lock(&b->lock);
+                iotxn_priv_t* priv = list_remove_head_type(&b->free_list, iotxn_priv_t, txn.node);
+                mtx_unlock(&b->lock);
+                if (priv == NULL) {
+                    break;
+                }
+                atomic_fetch_sub(&pool_bytes, pool_cost(priv));
+                atomic_fetch_sub(&pool_count, 1);
+                stat_inc(evictions);
+                iotxn_release_free(&priv->txn);
+            }
+            if (cls == 0) {
+                break;
+            }
+        }
+    }
+}
+
+void iotxn_pool_stats(iotxn_pool_stats_t* stats) {
+    stats->alloc_count = atomic_load(&pool_stats.alloc_count);
+    stats->thread_hits = atomic_load(&pool_stats.thread_hits);
+    stats->pool_hits = atomic_load(&pool_stats.pool_hits);
+    stats->misses = atomic_load(&pool_stats.misses);
+    stats->release_count = atomic_load(&pool_stats.release_count);
+    stats->evictions = atomic_load(&pool_stats.evictions);
+    stats->cached_count = atomic_load(&pool_count);
+    stats->cached_bytes = atomic_load(&pool_bytes);
+    stats->max_cached_bytes = atomic_load(&pool_max_bytes);
 }
 
 void iotxn_complete(iotxn_t* txn, mx_status_t status, mx_off_t actual) {
@@ -258,6 +562,9 @@ mx_status_t iotxn_physmap(iotxn_t* txn) {
     } else {
         status = iotxn_physmap_paged(txn);
     }
+    if (status == NO_ERROR) {
+        txn->pflags |= IOTXN_PFLAG_PHYSMAP;
+    }
     return status;
 }
 
@@ -270,6 +577,9 @@ mx_status_t iotxn_mmap(iotxn_t* txn, void** data) {
     mx_status_t status = mx_vmar_map(mx_vmar_root_self(), 0, txn->vmo_handle, txn->vmo_offset, txn->vmo_length, MX_VM_FLAG_PERM_READ | MX_VM_FLAG_PERM_WRITE, (uintptr_t*)(&txn->virt));
     if (status == NO_ERROR) {
         txn->pflags |= IOTXN_PFLAG_MMAP;
+        if (txn->pflags & IOTXN_PFLAG_PRIV) {
+            get_priv(txn)->mmap_length = txn->vmo_length;
+        }
         *data = txn->virt;
     }
     return status;
@@ -277,24 +587,31 @@ mx_status_t iotxn_mmap(iotxn_t* txn, void** data) {
 
 mx_status_t iotxn_clone(iotxn_t* txn, iotxn_t** out) {
     xprintf("iotxn_clone txn %p\n", txn);
-    // look in clone list first
+    call_once(&pool_once, pool_init);
+    stat_inc(alloc_count);
+
+    // clones have no payload of their own, look in the pool first
     // TODO if out is set, init into out
-    // need to check the contiguous flag because they have preallocated space
-    // for phys
-    iotxn_t* clone = find_in_free_list(txn->pflags & IOTXN_PFLAG_CONTIGUOUS, 0);
-    if (clone == NULL) {
-        clone = calloc(1, sizeof(iotxn_t));
-        if (clone == NULL) {
+    uint32_t bucket = class_to_bucket(0, 0);
+    iotxn_priv_t* priv = pool_get(bucket);
+    if (priv == NULL) {
+        stat_inc(misses);
+        priv = calloc(1, sizeof(iotxn_priv_t));
+        if (priv == NULL) {
             return ERR_NO_MEMORY;
         }
     }
+    iotxn_t* clone = &priv->txn;
 
     memcpy(clone, txn, sizeof(iotxn_t));
     // the only relevant pflag for a clone is the contiguous bit
-    clone->pflags = txn->pflags & IOTXN_PFLAG_CONTIGUOUS;
+    clone->pflags = (txn->pflags & IOTXN_PFLAG_CONTIGUOUS) | IOTXN_PFLAG_PRIV;
     clone->complete_cb = NULL;
     // clones are always freelisted on release
     clone->release_cb = iotxn_release_free_list;
+    priv->bucket = bucket;
+    priv->vmo_capacity = 0;
+    priv->mmap_length = 0;
 
     *out = clone;
     return NO_ERROR;
@@ -312,47 +629,65 @@ void iotxn_cacheop(iotxn_t* txn, uint32_t op, size_t offset, size_t length) {
 
 mx_status_t iotxn_alloc(iotxn_t** out, uint32_t alloc_flags, uint64_t data_size) {
     //xprintf("iotxn_alloc: alloc_flags 0x%x data_size 0x%" PRIx64 "\n", alloc_flags, data_size);
-
-    // look in free list first for a iotxn with data_size
-    iotxn_t* txn = find_in_free_list(alloc_flags_to_pflags(alloc_flags), data_size);
-    if (txn != NULL) {
-        //xprintf("iotxn_alloc: found iotxn with size 0x%" PRIx64 " in free list\n", data_size);
+    call_once(&pool_once, pool_init);
+    stat_inc(alloc_count);
+
+    uint32_t pflags = alloc_flags_to_pflags(alloc_flags);
+    uint32_t cls = size_to_class(data_size);
+    uint32_t bucket = class_to_bucket(cls, pflags);
+
+    // look in the pool first for a iotxn of the right size class
+    iotxn_priv_t* priv = (bucket != IOTXN_BUCKET_NONE) ? pool_get(bucket) : NULL;
+    if (priv != NULL) {
+        //xprintf("iotxn_alloc: found iotxn with size 0x%" PRIx64 " in pool\n", data_size);
+        iotxn_pool_reuse(priv, data_size);
         goto out;
     }
 
     // didn't find one that fits, allocate a new one
-    txn = calloc(1, sizeof(iotxn_t));
-    if (!txn) {
+    stat_inc(misses);
+    priv = calloc(1, sizeof(iotxn_priv_t));
+    if (!priv) {
         return ERR_NO_MEMORY;
     }
+    iotxn_t* txn = &priv->txn;
+    txn->pflags = IOTXN_PFLAG_PRIV;
+
+    // pooled txns get a vmo of the full size class so they can be
+    // reused for any request in that class
+    uint64_t capacity = data_size;
+    if ((alloc_flags & IOTXN_ALLOC_POOL) && (bucket != IOTXN_BUCKET_NONE)) {
+        capacity = class_to_capacity(cls);
+        priv->bucket = bucket;
+        txn->release_cb = iotxn_release_free_list;
+    } else {
+        priv->bucket = IOTXN_BUCKET_NONE;
+        txn->release_cb = iotxn_release_free;
+    }
+
     if (data_size > 0) {
         mx_status_t status;
         if (alloc_flags & IOTXN_ALLOC_CONTIGUOUS) {
-            status = mx_vmo_create_contiguous(get_root_resource(), data_size, 0, &txn->vmo_handle);
+            status = mx_vmo_create_contiguous(get_root_resource(), capacity, 0, &txn->vmo_handle);
             txn->pflags |= IOTXN_PFLAG_CONTIGUOUS;
-            // point phys to the extra space
         } else {
-            status = mx_vmo_create(data_size, 0, &txn->vmo_handle);
+            status = mx_vmo_create(capacity, 0, &txn->vmo_handle);
         }
         if (status != NO_ERROR) {
             xprintf("iotxn_alloc: error %d in mx_vmo_create, flags 0x%x\n", status, alloc_flags);
-            free(txn);
+            free(priv);
             return status;
         }
         txn->vmo_offset = 0;
         txn->vmo_length = data_size;
         txn->pflags |= IOTXN_PFLAG_ALLOC;
-        if (alloc_flags & IOTXN_ALLOC_POOL) {
-            txn->release_cb = iotxn_release_free_list;
-        } else {
-            txn->release_cb = iotxn_release_free;
-        }
     }
+    priv->vmo_capacity = capacity;
 
 out:
-    MX_DEBUG_ASSERT(txn != NULL);
-    MX_DEBUG_ASSERT(!(txn->pflags & IOTXN_PFLAG_FREE));
-    *out = txn;
+    MX_DEBUG_ASSERT(priv != NULL);
+    MX_DEBUG_ASSERT(!(priv->txn.pflags & IOTXN_PFLAG_FREE));
+    *out = &priv->txn;
     return NO_ERROR;
 }
 
@@ -20,6 +20,11 @@
 #include <magenta/compiler.h>
 #include <magenta/types.h>
 
+#ifdef __Fuchsia__
+#include <magenta/thread_annotations.h>
+#include <mxtl/mutex.h>
+#endif
+
 #include <mxio/vfs.h>
 #include <mxio/dispatcher.h>
 
@@ -36,6 +41,14 @@
 #define FS_FD_BLOCKDEVICE 200
 #endif
 
+// A lock which should be used to protect lookup and walk operations,
+// and everything shared between vnodes
+#ifdef __Fuchsia__
+__BEGIN_CDECLS
+extern mtx_t vfs_lock;
+__END_CDECLS
+#endif
+
 #ifdef __cplusplus
 
 namespace fs {
@@ -51,6 +64,14 @@ namespace fs {
 // The lower half of flags (V_FLAG_RESERVED_MASK) is reserved
 // for usage by fs::Vnode, but the upper half of flags may
 // be used by subclasses of Vnode.
+//
+// Operations arriving over rpc hold the vnode's io lock, and all but
+// reads also hold vfs_lock, which is taken first. A filesystem served
+// by several dispatcher threads (mxio_dispatcher_run_threads) may let
+// reads of different vnodes run at once by overriding
+// CanReadConcurrently. Ioctl is called without either lock, except for
+// IOCTL_DEVMGR_UNMOUNT_FS, which is called with vfs_lock held and is
+// followed by exit().
 
 class Vnode {
 public:
@@ -69,6 +90,24 @@ public:
     //  - Returns the number of handles acquired.
     virtual mx_status_t GetHandles(uint32_t flags, mx_handle_t* hnds,
                                    uint32_t* type, void* extra, uint32_t* esize) = 0;
+
+    // Acquire a VMO holding the contents of vn, with rights matching the
+    // MXIO_MMAP_FLAG_* bits in flags. The file occupies [*off, *off + *len)
+    // within the VMO.
+    virtual mx_status_t Mmap(uint32_t flags, mx_handle_t* out, size_t* off, size_t* len) {
+        return ERR_NOT_SUPPORTED;
+    }
+
+    // Returns true if the next Read may run holding only this vnode's io
+    // lock, at the same time as operations on other vnodes. Called with the
+    // io lock held. A read which could touch state shared with other
+    // vnodes, such as a block cache, must not run concurrently.
+    virtual bool CanReadConcurrently() {
+        return false;
+    }
+
+    // Serializes io on this vnode. Taken after vfs_lock, if both are taken.
+    mxtl::Mutex* io_lock() { return &io_lock_; }
 #endif
 
     virtual mx_status_t IoctlWatchDir(const void* in_buf, size_t in_len, void* out_buf, size_t out_len) {
@@ -201,6 +240,9 @@ protected:
     mx_handle_t remote_;
 private:
     uint32_t refcount_;
+#ifdef __Fuchsia__
+    mxtl::Mutex io_lock_;
+#endif
 };
 
 struct Vfs {
@@ -211,6 +253,10 @@ struct Vfs {
     // the underlying filesystem functions (lookup, create, open).
     static mx_status_t Open(Vnode* vn, Vnode** out, const char* path, const char** pathout,
                             uint32_t flags, uint32_t mode);
+    // Traverse the path to the target vnode and fetch its attributes,
+    // without opening it. Like Open, returns a positive remote handle (and
+    // the path remaining to be resolved there) at a mount point.
+    static mx_status_t Stat(Vnode* vn, const char* path, const char** pathout, vnattr_t* attr);
     static mx_status_t Unlink(Vnode* vn, const char* path, size_t len);
     static mx_status_t Link(Vnode* vn, const char* oldpath, const char* newpath,
                             const char** oldpathout, const char** newpathout);
@@ -220,10 +266,14 @@ struct Vfs {
     static ssize_t Ioctl(Vnode* vn, uint32_t op, const void* in_buf, size_t in_len,
                          void* out_buf, size_t out_len);
 
+#ifdef __Fuchsia__
     // Pins a handle to a remote filesystem onto a vnode, if possible.
-    static mx_status_t InstallRemote(Vnode* vn, mx_handle_t h);
+    static mx_status_t InstallRemote(Vnode* vn, mx_handle_t h) TA_REQ(vfs_lock);
     // Unpin a handle to a remote filesystem from a vnode, if one exists.
-    static mx_status_t UninstallRemote(Vnode* vn, mx_handle_t* h);
+    static mx_status_t UninstallRemote(Vnode* vn, mx_handle_t* h) TA_REQ(vfs_lock);
+    // Unpins all remote filesystems, as vfs_uninstall_all() does.
+    static mx_status_t UninstallAll(mx_time_t timeout) TA_REQ(vfs_lock);
+#endif
 };
 
 mx_status_t vfs_fill_dirent(vdirent_t* de, size_t delen,
@@ -249,10 +299,6 @@ typedef struct vdircookie {
     void* p;
 } vdircookie_t;
 
-// A lock which should be used to protect lookup and walk operations
-#ifdef __Fuchsia__
-extern mtx_t vfs_lock;
-#endif
 extern mxio_dispatcher_t* vfs_dispatcher;
 
 // The following function must be defined by the filesystem linking
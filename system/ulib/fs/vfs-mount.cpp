@@ -83,7 +83,6 @@ mx_status_t Vfs::InstallRemote(Vnode* vn, mx_handle_t h) {
     }
     // Save this node in the list of mounted vnodes
     mount_point->SetNode(mxtl::move(vn));
-    mxtl::AutoLock lock(&vfs_lock);
     remote_list.push_front(mxtl::move(mount_point));
     return NO_ERROR;
 }
@@ -91,35 +90,29 @@ mx_status_t Vfs::InstallRemote(Vnode* vn, mx_handle_t h) {
 // Uninstall the remote filesystem mounted on vn. Removes vn from the
 // remote_list, and sends its corresponding filesystem an 'unmount' signal.
 mx_status_t Vfs::UninstallRemote(Vnode* vn, mx_handle_t* h) {
-    mxtl::unique_ptr<MountNode> mount_point;
-    {
-        mxtl::AutoLock lock(&vfs_lock);
-        mount_point = remote_list.erase_if([&vn](const MountNode& node) {
-            return node.VnodeMatch(vn);
-        });
-        if (!mount_point) {
-            return ERR_NOT_FOUND;
-        }
+    mxtl::unique_ptr<MountNode> mount_point = remote_list.erase_if([&vn](const MountNode& node) {
+        return node.VnodeMatch(vn);
+    });
+    if (!mount_point) {
+        return ERR_NOT_FOUND;
     }
     *h = mount_point->ReleaseRemote();
     return NO_ERROR;
 }
 
-} // namespace fs
-
 // Uninstall all remote filesystems. Acts like 'UninstallRemote' for all
 // known remotes.
-mx_status_t vfs_uninstall_all(mx_time_t timeout) {
-    mxtl::unique_ptr<fs::MountNode> mount_point;
-    for (;;) {
-        {
-            mxtl::AutoLock lock(&vfs_lock);
-            mount_point = fs::remote_list.pop_front();
-        }
-        if (mount_point) {
-            vfs_unmount_handle(mount_point->ReleaseRemote(), timeout);
-        } else {
-            return NO_ERROR;
-        }
+mx_status_t Vfs::UninstallAll(mx_time_t timeout) {
+    mxtl::unique_ptr<MountNode> mount_point;
+    while ((mount_point = remote_list.pop_front()) != nullptr) {
+        vfs_unmount_handle(mount_point->ReleaseRemote(), timeout);
     }
+    return NO_ERROR;
+}
+
+} // namespace fs
+
+mx_status_t vfs_uninstall_all(mx_time_t timeout) {
+    mxtl::AutoLock lock(&vfs_lock);
+    return fs::Vfs::UninstallAll(timeout);
 }
@@ -2,12 +2,16 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <magenta/process.h>
+#include <magenta/syscalls.h>
 #include <mxio/debug.h>
 #include <mxio/dispatcher.h>
 #include <mxio/io.h>
 #include <mxio/remoteio.h>
 #include <mxio/vfs.h>
 
+#include <mxtl/auto_lock.h>
+
 #include <fcntl.h>
 #include <limits.h>
 #include <stdlib.h>
@@ -40,6 +44,16 @@ void txn_handoff_clone(mx_handle_t srv, mx_handle_t rh) {
     mxrio_txn_handoff(srv, rh, &msg);
 }
 
+void txn_handoff_stat_at(mx_handle_t srv, mx_handle_t rh, const char* path) {
+    mxrio_msg_t msg;
+    memset(&msg, 0, MXRIO_HDR_SZ);
+    size_t len = strlen(path);
+    msg.op = MXRIO_STAT_AT;
+    msg.datalen = static_cast<uint32_t>(len) + 1;
+    memcpy(msg.data, path, len + 1);
+    mxrio_txn_handoff(srv, rh, &msg);
+}
+
 void txn_handoff_two_path_op(mx_handle_t srv, mx_handle_t rh, uint32_t op, const char* oldpath,
                              const char* newpath) {
     mxrio_msg_t msg;
@@ -63,15 +77,18 @@ void vfs_rpc_open(mxrio_msg_t* msg, mx_handle_t rh, fs::Vnode* vn, const char* p
 
     mx_status_t r;
 
+    // The refcount is guarded by vfs_lock, so hold it until the new
+    // connection has its own reference.
     mtx_lock(&vfs_lock);
     r = Vfs::Open(vn, &vn, path, &path, flags, mode);
-    mtx_unlock(&vfs_lock);
 
     if (r < 0) {
+        mtx_unlock(&vfs_lock);
         xprintf("vfs: open: r=%d\n", r);
         goto done;
     }
     if (r > 0) {
+        mtx_unlock(&vfs_lock);
         //TODO: unify remote vnodes and remote devices
         //      eliminate vfs_get_handles() and the other
         //      reply pipe path
@@ -82,19 +99,22 @@ void vfs_rpc_open(mxrio_msg_t* msg, mx_handle_t rh, fs::Vnode* vn, const char* p
     obj.esize = 0;
     if ((r = vn->GetHandles(flags, obj.handle, &obj.type, obj.extra, &obj.esize)) < 0) {
         vn->Close();
+        mtx_unlock(&vfs_lock);
         goto done;
     }
     if (obj.type == 0) {
+        vn->RefRelease();
+        mtx_unlock(&vfs_lock);
         // device is non-local, handle is the server that
         // can clone it for us, redirect the rpc to there
         txn_handoff_open(obj.handle[0], rh, ".", flags, mode);
-        vn->RefRelease();
         return;
     }
 
     // drop the ref from VfsOpen
     // the backend behind get_handles holds the on-going ref
     vn->RefRelease();
+    mtx_unlock(&vfs_lock);
     obj.hcount = r;
     r = NO_ERROR;
 
@@ -152,6 +172,197 @@ void vfs_rpc_link(mxrio_msg_t* msg, mx_handle_t rh, fs::Vnode* vn,
     }
 }
 
+void vfs_rpc_stat_at(mxrio_msg_t* msg, mx_handle_t rh, fs::Vnode* vn, const char* path) {
+    mxrio_stat_reply_t reply;
+    memset(&reply, 0, sizeof(reply));
+    mx_status_t r;
+
+    mtx_lock(&vfs_lock);
+    r = Vfs::Stat(vn, path, &path, &reply.attr);
+    mtx_unlock(&vfs_lock);
+
+    if (r > 0) {
+        // Remote filesystem -- forward the request.
+        txn_handoff_stat_at(r, rh, path);
+        return;
+    }
+    reply.status = r;
+    uint32_t size = (r == NO_ERROR) ? static_cast<uint32_t>(sizeof(reply)) :
+                                      static_cast<uint32_t>(MXRIO_OBJECT_MINSIZE);
+    mx_channel_write(rh, 0, &reply, size, nullptr, 0);
+    mx_handle_close(rh);
+}
+
+// A vdirent_attr_t is at most this many times the size of the vdirent_t
+// for the same name: 64 bytes for a one character name, against 12.
+constexpr size_t kReaddirAttrGrowth = 6;
+constexpr size_t kReaddirAttrMin = kReaddirAttrGrowth * (sizeof(vdirent_t) + NAME_MAX + 1);
+
+// Fill data with vdirent_attr_t records for the entries following the
+// directory cookie. Names are read in batches small enough that the
+// records built from them always fit, so the cookie never needs to be
+// rewound.
+mx_status_t vfs_rpc_readdir_attr(vfs_iostate_t* ios, fs::Vnode* vn, uint8_t* data, size_t len) {
+    if (len < kReaddirAttrMin) {
+        return ERR_BUFFER_TOO_SMALL;
+    }
+    char names[MXIO_CHUNK_SIZE / kReaddirAttrGrowth];
+    size_t pos = 0;
+
+    mtx_lock(&vfs_lock);
+    for (;;) {
+        size_t want = (len - pos) / kReaddirAttrGrowth;
+        if (want > sizeof(names)) {
+            want = sizeof(names);
+        }
+        mx_status_t r = vn->Readdir(&ios->dircookie, names, want);
+        if (r <= 0) {
+            mtx_unlock(&vfs_lock);
+            return (pos > 0) ? static_cast<mx_status_t>(pos) : r;
+        }
+        for (size_t off = 0; off < static_cast<size_t>(r);) {
+            vdirent_t* de = reinterpret_cast<vdirent_t*>(names + off);
+            off += de->size;
+            size_t namelen = strlen(de->name);
+            size_t sz = (sizeof(vdirent_attr_t) + namelen + 1 + 7) & ~static_cast<size_t>(7);
+            MX_DEBUG_ASSERT(pos + sz <= len);
+            vdirent_attr_t* out = reinterpret_cast<vdirent_attr_t*>(data + pos);
+            out->size = static_cast<uint32_t>(sz);
+            out->type = de->type;
+            memcpy(out->name, de->name, namelen + 1);
+
+            Vnode* child;
+            if ((vn->Lookup(&child, de->name, namelen) != NO_ERROR)) {
+                child = nullptr;
+            }
+            if ((child == nullptr) || (child->Getattr(&out->attr) != NO_ERROR)) {
+                memset(&out->attr, 0, sizeof(out->attr));
+                out->attr.mode = DTYPE_TO_VTYPE(de->type);
+            }
+            if (child != nullptr) {
+                child->RefRelease();
+            }
+            pos += sz;
+        }
+    }
+}
+
+// Reads from vn into data. Reads which the filesystem says touch only vn
+// hold just its io lock, so reads of different files can run at once.
+ssize_t vfs_rpc_read(Vnode* vn, void* data, size_t len, size_t off) {
+    {
+        mxtl::AutoLock io_lock(vn->io_lock());
+        if (vn->CanReadConcurrently()) {
+            return vn->Read(data, len, off);
+        }
+    }
+    // vfs_lock must be taken first
+    mxtl::AutoLock lock(&vfs_lock);
+    mxtl::AutoLock io_lock(vn->io_lock());
+    return vn->Read(data, len, off);
+}
+
+// Transfers through a VMO are copied in pieces of at most this size.
+constexpr size_t kVmoXferBufSize = 64 * 1024;
+
+// Moves data between |vn| and |vmo|. The VMO belongs to the client, which
+// may make it smaller at any time, so rather than map it the data is
+// copied through a bounce buffer with mx_vmo_read() and mx_vmo_write(),
+// which check their bounds against the VMO as it is. Takes ownership of
+// |vmo|.
+ssize_t vfs_rpc_vmo_xfer(vfs_iostate_t* ios, Vnode* vn, bool write,
+                         const mxrio_vmo_xfer_t* xfer, mx_handle_t vmo) {
+    if ((xfer->length == 0) || (xfer->length > MXIO_VMO_XFER_MAX) ||
+        ((xfer->flags & MXIO_VMO_XFER_FLAG_AT) && (xfer->offset < 0))) {
+        mx_handle_close(vmo);
+        return ERR_INVALID_ARGS;
+    }
+    size_t len = static_cast<size_t>(xfer->length);
+    uint64_t vmo_size;
+    mx_status_t status;
+    if ((status = mx_vmo_get_size(vmo, &vmo_size)) < 0) {
+        mx_handle_close(vmo);
+        return status;
+    }
+    if (vmo_size < len) {
+        mx_handle_close(vmo);
+        return ERR_INVALID_ARGS;
+    }
+    size_t buf_len = (len < kVmoXferBufSize) ? len : kVmoXferBufSize;
+    uint8_t* buf = static_cast<uint8_t*>(malloc(buf_len));
+    if (buf == nullptr) {
+        mx_handle_close(vmo);
+        return ERR_NO_MEMORY;
+    }
+    bool at = (xfer->flags & MXIO_VMO_XFER_FLAG_AT) != 0;
+
+    // Returns what was moved before an error, if anything, like a short
+    // read or write would.
+    size_t done = 0;
+    ssize_t r = NO_ERROR;
+    if (!write) {
+        size_t off = at ? xfer->offset : ios->io_off;
+        while (done < len) {
+            size_t n = ((len - done) < buf_len) ? (len - done) : buf_len;
+            if ((r = vfs_rpc_read(vn, buf, n, off + done)) <= 0) {
+                break;
+            }
+            size_t actual;
+            if ((status = mx_vmo_write(vmo, buf, done, r, &actual)) < 0) {
+                r = status;
+                break;
+            }
+            done += actual;
+            if ((actual < static_cast<size_t>(r)) || (static_cast<size_t>(r) < n)) {
+                break;
+            }
+        }
+        if (!at) {
+            ios->io_off += done;
+        }
+    } else {
+        // Hold the locks throughout, so that the pieces land together.
+        mxtl::AutoLock lock(&vfs_lock);
+        mxtl::AutoLock io_lock(vn->io_lock());
+        size_t off;
+        if (at) {
+            off = xfer->offset;
+        } else {
+            if (ios->io_flags & O_APPEND) {
+                vnattr_t attr;
+                if ((status = vn->Getattr(&attr)) < 0) {
+                    free(buf);
+                    mx_handle_close(vmo);
+                    return status;
+                }
+                ios->io_off = attr.size;
+            }
+            off = ios->io_off;
+        }
+        while (done < len) {
+            size_t n = ((len - done) < buf_len) ? (len - done) : buf_len;
+            size_t actual;
+            if ((status = mx_vmo_read(vmo, buf, done, n, &actual)) < 0) {
+                r = status;
+                break;
+            }
+            if ((r = vn->Write(buf, actual, off + done)) <= 0) {
+                break;
+            }
+            done += r;
+            if (static_cast<size_t>(r) < n) {
+                break;
+            }
+        }
+        if (!at) {
+            ios->io_off += done;
+        }
+    }
+    free(buf);
+    mx_handle_close(vmo);
+    return ((done > 0) || (r >= 0)) ? static_cast<ssize_t>(done) : r;
+}
+
 } // namespace anonymous
 
 mx_status_t Vnode::Serve(uint32_t flags, mx_handle_t* out) {
@@ -182,6 +393,9 @@ mx_status_t Vnode::Serve(uint32_t flags, mx_handle_t* out) {
 
 } // namespace fs
 
+// Everything but open, close and the namespace operations (which lock
+// what they need themselves) works on the one vnode, and holds
+// vfs_lock and its io lock throughout, except for reads and ioctls.
 mx_status_t vfs_handler_generic(mxrio_msg_t* msg, mx_handle_t rh, void* cookie) {
     vfs_iostate_t* ios = static_cast<vfs_iostate_t*>(cookie);
     Vnode* vn = ios->vn;
@@ -210,14 +424,19 @@ mx_status_t vfs_handler_generic(mxrio_msg_t* msg, mx_handle_t rh, void* cookie)
         }
         return ERR_DISPATCHER_INDIRECT;
     }
-    case MXRIO_CLOSE:
+    case MXRIO_CLOSE: {
         // this will drop the ref on the vn
+        mxtl::AutoLock lock(&vfs_lock);
         fs::Vfs::Close(vn);
         free(ios);
         return NO_ERROR;
+    }
     case MXRIO_CLONE: {
         mxrio_object_t obj;
-        obj.status = vn->Serve(ios->io_flags, obj.handle);
+        {
+            mxtl::AutoLock lock(&vfs_lock);
+            obj.status = vn->Serve(ios->io_flags, obj.handle);
+        }
         obj.type = MXIO_PROTOCOL_REMOTE;
         mx_channel_write(msg->handle[0], 0, &obj, MXRIO_OBJECT_MINSIZE,
                          obj.handle, (obj.status < 0) ? 0 : 1);
@@ -225,7 +444,7 @@ mx_status_t vfs_handler_generic(mxrio_msg_t* msg, mx_handle_t rh, void* cookie)
         return ERR_DISPATCHER_INDIRECT;
     }
     case MXRIO_READ: {
-        ssize_t r = vn->Read(msg->data, arg, ios->io_off);
+        ssize_t r = fs::vfs_rpc_read(vn, msg->data, arg, ios->io_off);
         if (r >= 0) {
             ios->io_off += r;
             msg->arg2.off = ios->io_off;
@@ -234,13 +453,15 @@ mx_status_t vfs_handler_generic(mxrio_msg_t* msg, mx_handle_t rh, void* cookie)
         return static_cast<mx_status_t>(r);
     }
     case MXRIO_READ_AT: {
-        ssize_t r = vn->Read(msg->data, arg, msg->arg2.off);
+        ssize_t r = fs::vfs_rpc_read(vn, msg->data, arg, msg->arg2.off);
         if (r >= 0) {
             msg->datalen = static_cast<uint32_t>(r);
         }
         return static_cast<mx_status_t>(r);
     }
     case MXRIO_WRITE: {
+        mxtl::AutoLock lock(&vfs_lock);
+        mxtl::AutoLock io_lock(vn->io_lock());
         if (ios->io_flags & O_APPEND) {
             vnattr_t attr;
             mx_status_t r;
@@ -257,10 +478,29 @@ mx_status_t vfs_handler_generic(mxrio_msg_t* msg, mx_handle_t rh, void* cookie)
         return static_cast<mx_status_t>(r);
     }
     case MXRIO_WRITE_AT: {
+        mxtl::AutoLock lock(&vfs_lock);
+        mxtl::AutoLock io_lock(vn->io_lock());
         ssize_t r = vn->Write(msg->data, len, msg->arg2.off);
         return static_cast<mx_status_t>(r);
     }
+    case MXRIO_READ_VMO:
+    case MXRIO_WRITE_VMO: {
+        if (len != sizeof(mxrio_vmo_xfer_t)) {
+            mx_handle_close(msg->handle[0]);
+            return ERR_INVALID_ARGS;
+        }
+        mxrio_vmo_xfer_t xfer;
+        memcpy(&xfer, msg->data, sizeof(xfer));
+        ssize_t r = fs::vfs_rpc_vmo_xfer(ios, vn, MXRIO_OP(msg->op) == MXRIO_WRITE_VMO,
+                                         &xfer, msg->handle[0]);
+        if (r >= 0) {
+            msg->arg2.off = ios->io_off;
+        }
+        return static_cast<mx_status_t>(r);
+    }
     case MXRIO_SEEK: {
+        mxtl::AutoLock lock(&vfs_lock);
+        mxtl::AutoLock io_lock(vn->io_lock());
         vnattr_t attr;
         mx_status_t r;
         if ((r = vn->Getattr(&attr)) < 0) {
@@ -320,6 +560,8 @@ mx_status_t vfs_handler_generic(mxrio_msg_t* msg, mx_handle_t rh, void* cookie)
         return NO_ERROR;
     }
     case MXRIO_STAT: {
+        mxtl::AutoLock lock(&vfs_lock);
+        mxtl::AutoLock io_lock(vn->io_lock());
         mx_status_t r;
         msg->datalen = sizeof(vnattr_t);
         if ((r = vn->Getattr((vnattr_t*)msg->data)) < 0) {
@@ -328,6 +570,8 @@ mx_status_t vfs_handler_generic(mxrio_msg_t* msg, mx_handle_t rh, void* cookie)
         return msg->datalen;
     }
     case MXRIO_SETATTR: {
+        mxtl::AutoLock lock(&vfs_lock);
+        mxtl::AutoLock io_lock(vn->io_lock());
         mx_status_t r = vn->Setattr((vnattr_t*)msg->data);
         return r;
     }
@@ -347,6 +591,29 @@ mx_status_t vfs_handler_generic(mxrio_msg_t* msg, mx_handle_t rh, void* cookie)
         }
         return r;
     }
+    case MXRIO_READDIR_ATTR: {
+        if ((arg < 0) || (arg > MXIO_CHUNK_SIZE)) {
+            return ERR_INVALID_ARGS;
+        }
+        if (msg->arg2.off == READDIR_CMD_RESET) {
+            memset(&ios->dircookie, 0, sizeof(ios->dircookie));
+        }
+        mx_status_t r = fs::vfs_rpc_readdir_attr(ios, vn, msg->data, arg);
+        if (r >= 0) {
+            msg->datalen = r;
+        }
+        return r;
+    }
+    case MXRIO_STAT_AT: {
+        char* path = (char*)msg->data;
+        if ((len < 1) || (len > PATH_MAX)) {
+            fs::mxrio_reply_channel_status(msg->handle[0], ERR_INVALID_ARGS);
+        } else {
+            path[len] = 0;
+            fs::vfs_rpc_stat_at(msg, msg->handle[0], vn, path);
+        }
+        return ERR_DISPATCHER_INDIRECT;
+    }
     case MXRIO_IOCTL_1H: {
         if ((len > MXIO_IOCTL_MAX_INPUT) ||
             (arg > (ssize_t)sizeof(msg->data)) ||
@@ -411,6 +678,8 @@ mx_status_t vfs_handler_generic(mxrio_msg_t* msg, mx_handle_t rh, void* cookie)
         if (msg->arg2.off < 0) {
             return ERR_INVALID_ARGS;
         }
+        mxtl::AutoLock lock(&vfs_lock);
+        mxtl::AutoLock io_lock(vn->io_lock());
         return vn->Truncate(msg->arg2.off);
     }
     case MXRIO_RENAME: {
@@ -448,10 +717,35 @@ mx_status_t vfs_handler_generic(mxrio_msg_t* msg, mx_handle_t rh, void* cookie)
         return ERR_DISPATCHER_INDIRECT;
     }
     case MXRIO_SYNC: {
+        mxtl::AutoLock lock(&vfs_lock);
+        mxtl::AutoLock io_lock(vn->io_lock());
         return vn->Sync();
     }
-    case MXRIO_UNLINK:
+    case MXRIO_MMAP: {
+        if (len != sizeof(mxrio_mmap_data_t)) {
+            return ERR_INVALID_ARGS;
+        }
+        mxrio_mmap_data_t* data = reinterpret_cast<mxrio_mmap_data_t*>(msg->data);
+        if ((data->flags & MXIO_MMAP_FLAG_WRITE) && ((ios->io_flags & O_ACCMODE) == O_RDONLY)) {
+            return ERR_ACCESS_DENIED;
+        }
+        mxtl::AutoLock lock(&vfs_lock);
+        mxtl::AutoLock io_lock(vn->io_lock());
+        size_t off, length;
+        mx_status_t r = vn->Mmap(data->flags, &msg->handle[0], &off, &length);
+        if (r < 0) {
+            return r;
+        }
+        data->offset = off;
+        data->length = length;
+        msg->datalen = sizeof(mxrio_mmap_data_t);
+        msg->hcount = 1;
+        return NO_ERROR;
+    }
+    case MXRIO_UNLINK: {
+        mxtl::AutoLock lock(&vfs_lock);
         return fs::Vfs::Unlink(vn, (const char*)msg->data, len);
+    }
     default:
         // close inbound handles so they do not leak
         for (unsigned i = 0; i < MXRIO_HC(msg->op); i++) {
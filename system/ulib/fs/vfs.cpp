@@ -4,6 +4,7 @@
 
 #ifdef __Fuchsia__
 #include <magenta/syscalls.h>
+#include <mxtl/auto_lock.h>
 #endif
 
 #include <mxio/dispatcher.h>
@@ -147,7 +148,14 @@ mx_status_t Vfs::Open(Vnode* vndir, Vnode** out, const char* path,
             return r;
         }
         if (flags & O_TRUNC) {
-            if ((r = vn->Truncate(0)) < 0) {
+            {
+#ifdef __Fuchsia__
+                // Reads of vn may be running with only its io lock held.
+                mxtl::AutoLock io_lock(vn->io_lock());
+#endif
+                r = vn->Truncate(0);
+            }
+            if (r < 0) {
                 if (r != ERR_NOT_SUPPORTED) {
                     // devfs does not support this, but we should not fail
                     vn->RefRelease();
@@ -162,6 +170,54 @@ mx_status_t Vfs::Open(Vnode* vndir, Vnode** out, const char* path,
     return NO_ERROR;
 }
 
+mx_status_t Vfs::Stat(Vnode* vndir, const char* path, const char** pathout, vnattr_t* attr) {
+    trace(VFS, "VfsStat: path='%s'\n", path);
+    mx_status_t r;
+    if ((r = Vfs::Walk(vndir, &vndir, path, &path)) < 0) {
+        return r;
+    }
+    if (r > 0) {
+        // remote filesystem, return handle and path through to caller
+        vndir->RefRelease();
+        *pathout = path;
+        return r;
+    }
+
+    size_t len = strlen(path);
+    bool must_be_dir = false;
+    if ((r = vfs_name_trim(path, len, &len, &must_be_dir)) != NO_ERROR) {
+        vndir->RefRelease();
+        return r;
+    }
+
+    Vnode* vn;
+    r = vndir->Lookup(&vn, path, len);
+    vndir->RefRelease();
+    if (r < 0) {
+        return r;
+    }
+    if (vn->IsDevice()) {
+        // Devices report their own attributes, which takes a connection
+        // to the device; the caller must open it instead.
+        vn->RefRelease();
+        return ERR_NOT_SUPPORTED;
+    } else if (vn->IsRemote()) {
+        // Mount point: the root of the remote filesystem is the target.
+        *pathout = ".";
+        r = vn->WaitForRemote();
+        vn->RefRelease();
+        return r;
+    }
+
+    r = vn->Getattr(attr);
+    vn->RefRelease();
+    if ((r == NO_ERROR) && must_be_dir && !S_ISDIR(attr->mode)) {
+        return ERR_NOT_DIR;
+    }
+    *pathout = "";
+    return r;
+}
+
 mx_status_t Vfs::Unlink(Vnode* vndir, const char* path, size_t len) {
     bool must_be_dir;
     mx_status_t r;
@@ -289,6 +345,7 @@ ssize_t Vfs::Ioctl(Vnode* vn, uint32_t op, const void* in_buf, size_t in_len,
         }
         mx_handle_t h = *(mx_handle_t*)in_buf;
         mx_status_t status;
+        mxtl::AutoLock lock(&vfs_lock);
         if ((status = Vfs::InstallRemote(vn, h)) < 0) {
             // If we can't install the filesystem, we shoot off a quick "unmount"
             // signal to the filesystem process, since we are the owner of its
@@ -306,10 +363,14 @@ ssize_t Vfs::Ioctl(Vnode* vn, uint32_t op, const void* in_buf, size_t in_len,
             return ERR_INVALID_ARGS;
         }
         mx_handle_t* h = (mx_handle_t*)out_buf;
+        mxtl::AutoLock lock(&vfs_lock);
         return Vfs::UninstallRemote(vn, h);
     }
     case IOCTL_DEVMGR_UNMOUNT_FS: {
-        vfs_uninstall_all(MX_TIME_INFINITE);
+        // Hold vfs_lock until we exit, so that no other dispatcher thread
+        // touches the filesystem once it has been torn down.
+        mtx_lock(&vfs_lock);
+        Vfs::UninstallAll(MX_TIME_INFINITE);
         vn->Ioctl(op, in_buf, in_len, out_buf, out_len);
         exit(0);
     }
@@ -0,0 +1,106 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "gfx-kernels.h"
+
+#include <arm_neon.h>
+
+// Advanced SIMD is mandatory on arm64, so there is nothing to probe.
+
+static void fill16_neon(uint16_t* dst, uint16_t color, size_t count) {
+    uint16x8_t v = vdupq_n_u16(color);
+    for (; count >= 32; count -= 32, dst += 32) {
+        vst1q_u16(dst + 0, v);
+        vst1q_u16(dst + 8, v);
+        vst1q_u16(dst + 16, v);
+        vst1q_u16(dst + 24, v);
+    }
+    for (; count >= 8; count -= 8, dst += 8) {
+        vst1q_u16(dst, v);
+    }
+    while (count--) {
+        *dst++ = color;
+    }
+}
+
+static void fill32_neon(uint32_t* dst, uint32_t color, size_t count) {
+    uint32x4_t v = vdupq_n_u32(color);
+    for (; count >= 16; count -= 16, dst += 16) {
+        vst1q_u32(dst + 0, v);
+        vst1q_u32(dst + 4, v);
+        vst1q_u32(dst + 8, v);
+        vst1q_u32(dst + 12, v);
+    }
+    for (; count >= 4; count -= 4, dst += 4) {
+        vst1q_u32(dst, v);
+    }
+    while (count--) {
+        *dst++ = color;
+    }
+}
+
+// Eight pixels at a time, de-interleaved into b, g, r, a planes.
+// (s * (a + 1)) / 256 + (d * (254 - a)) / 256 per channel, alpha a + 1,
+// with fully transparent and fully opaque source pixels passed through.
+static void blend32_neon(uint32_t* dst, const uint32_t* src, size_t count) {
+    const uint8x8_t one = vdup_n_u8(1);
+    const uint8x8_t inv = vdup_n_u8(254);
+    const uint8x8_t zero = vdup_n_u8(0);
+    const uint8x8_t full = vdup_n_u8(255);
+
+    for (; count >= 8; count -= 8, dst += 8, src += 8) {
+        uint8x8x4_t s = vld4_u8((const uint8_t*)src);
+        uint8x8x4_t d = vld4_u8((const uint8_t*)dst);
+        uint8x8_t a = s.val[3];
+        uint8x8_t sa = vadd_u8(a, one);
+        uint8x8_t da = vsub_u8(inv, a);
+        uint8x8_t opaque = vceq_u8(a, full);
+        uint8x8_t clear = vceq_u8(a, zero);
+
+        uint8x8x4_t r;
+        for (int c = 0; c < 3; c++) {
+            r.val[c] = vadd_u8(vshrn_n_u16(vmull_u8(s.val[c], sa), 8),
+                               vshrn_n_u16(vmull_u8(d.val[c], da), 8));
+        }
+        r.val[3] = sa;
+        for (int c = 0; c < 4; c++) {
+            r.val[c] = vbsl_u8(opaque, s.val[c], r.val[c]);
+            r.val[c] = vbsl_u8(clear, d.val[c], r.val[c]);
+        }
+        vst4_u8((uint8_t*)dst, r);
+    }
+    while (count--) {
+        *dst = alpha32_add_ignore_destalpha(*dst, *src);
+        dst++;
+        src++;
+    }
+}
+
+static void argb8888_to_rgb565_neon(uint16_t* dst, const uint32_t* src, size_t count) {
+    for (; count >= 8; count -= 8, dst += 8, src += 8) {
+        uint8x8x4_t p = vld4_u8((const uint8_t*)src);
+        // r in the top bits, then shift-insert the top bits of g and b
+        uint16x8_t v = vshll_n_u8(p.val[2], 8);
+        v = vsriq_n_u16(v, vshll_n_u8(p.val[1], 8), 5);
+        v = vsriq_n_u16(v, vshll_n_u8(p.val[0], 8), 11);
+        vst1q_u16(dst, v);
+    }
+    gfx_kernels_generic.argb8888_to_rgb565(dst, src, count);
+}
+
+static const gfx_kernels_t gfx_kernels_neon = {
+    .name = "neon",
+    .fill16 = fill16_neon,
+    .fill32 = fill32_neon,
+    .blend32 = blend32_neon,
+    .argb8888_to_rgb565 = argb8888_to_rgb565_neon,
+};
+
+size_t gfx_arch_kernels(const gfx_kernels_t** out, size_t max) {
+    if (max == 0) {
+        return 0;
+    }
+    out[0] = &gfx_kernels_neon;
+    return 1;
+}
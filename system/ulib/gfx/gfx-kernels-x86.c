@@ -0,0 +1,264 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <cpuid.h>
+#include <immintrin.h>
+#include <stdbool.h>
+
+#include "gfx-kernels.h"
+
+// SSE2 is part of the x86-64 baseline.  The AVX2 kernels are compiled
+// for that target individually and only used if cpuid says so.
+#define AVX2 __attribute__((target("avx2")))
+
+static void fill16_sse2(uint16_t* dst, uint16_t color, size_t count) {
+    while (count && ((uintptr_t)dst & 15)) {
+        *dst++ = color;
+        count--;
+    }
+    __m128i v = _mm_set1_epi16((short)color);
+    for (; count >= 32; count -= 32, dst += 32) {
+        _mm_store_si128((__m128i*)dst + 0, v);
+        _mm_store_si128((__m128i*)dst + 1, v);
+        _mm_store_si128((__m128i*)dst + 2, v);
+        _mm_store_si128((__m128i*)dst + 3, v);
+    }
+    for (; count >= 8; count -= 8, dst += 8) {
+        _mm_store_si128((__m128i*)dst, v);
+    }
+    while (count--) {
+        *dst++ = color;
+    }
+}
+
+static void fill32_sse2(uint32_t* dst, uint32_t color, size_t count) {
+    while (count && ((uintptr_t)dst & 15)) {
+        *dst++ = color;
+        count--;
+    }
+    __m128i v = _mm_set1_epi32((int)color);
+    for (; count >= 16; count -= 16, dst += 16) {
+        _mm_store_si128((__m128i*)dst + 0, v);
+        _mm_store_si128((__m128i*)dst + 1, v);
+        _mm_store_si128((__m128i*)dst + 2, v);
+        _mm_store_si128((__m128i*)dst + 3, v);
+    }
+    for (; count >= 4; count -= 4, dst += 4) {
+        _mm_store_si128((__m128i*)dst, v);
+    }
+    while (count--) {
+        *dst++ = color;
+    }
+}
+
+// Blend 16 bits per channel: (s * (a + 1)) / 256 + (d * (254 - a)) / 256
+// with the result alpha set to a + 1, matching the scalar version.
+// Fully transparent and fully opaque source pixels are passed through.
+static inline __m128i blend4_sse2(__m128i s, __m128i d) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i amask = _mm_set1_epi32((int)0xff000000);
+
+    __m128i sa = _mm_and_si128(s, amask);
+    __m128i opaque = _mm_cmpeq_epi32(sa, amask);
+    __m128i clear = _mm_cmpeq_epi32(sa, zero);
+
+    // a + 1 and 254 - a in both 16-bit halves of each pixel's 32 bits
+    __m128i a = _mm_add_epi32(_mm_srli_epi32(s, 24), _mm_set1_epi32(1));
+    __m128i ainv = _mm_sub_epi32(_mm_set1_epi32(255), a);
+    __m128i a16 = _mm_or_si128(a, _mm_slli_epi32(a, 16));
+    __m128i ainv16 = _mm_or_si128(ainv, _mm_slli_epi32(ainv, 16));
+
+    __m128i lo = _mm_add_epi16(
+        _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(s, zero),
+                                       _mm_unpacklo_epi32(a16, a16)), 8),
+        _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero),
+                                       _mm_unpacklo_epi32(ainv16, ainv16)), 8));
+    __m128i hi = _mm_add_epi16(
+        _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(s, zero),
+                                       _mm_unpackhi_epi32(a16, a16)), 8),
+        _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero),
+                                       _mm_unpackhi_epi32(ainv16, ainv16)), 8));
+    __m128i r = _mm_packus_epi16(lo, hi);
+    r = _mm_or_si128(_mm_andnot_si128(amask, r), _mm_slli_epi32(a, 24));
+
+    r = _mm_or_si128(_mm_and_si128(opaque, s), _mm_andnot_si128(opaque, r));
+    return _mm_or_si128(_mm_and_si128(clear, d), _mm_andnot_si128(clear, r));
+}
+
+static void blend32_sse2(uint32_t* dst, const uint32_t* src, size_t count) {
+    for (; count >= 4; count -= 4, dst += 4, src += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i*)src);
+        __m128i d = _mm_loadu_si128((const __m128i*)dst);
+        _mm_storeu_si128((__m128i*)dst, blend4_sse2(s, d));
+    }
+    while (count--) {
+        *dst = alpha32_add_ignore_destalpha(*dst, *src);
+        dst++;
+        src++;
+    }
+}
+
+static inline __m128i rgb565_sse2(__m128i p) {
+    const __m128i b = _mm_and_si128(_mm_srli_epi32(p, 3), _mm_set1_epi32(0x001f));
+    const __m128i g = _mm_and_si128(_mm_srli_epi32(p, 5), _mm_set1_epi32(0x07e0));
+    const __m128i r = _mm_and_si128(_mm_srli_epi32(p, 8), _mm_set1_epi32(0xf800));
+    __m128i v = _mm_or_si128(_mm_or_si128(b, g), r);
+    // sign extend so the saturating pack below keeps the low 16 bits
+    return _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+}
+
+static void argb8888_to_rgb565_sse2(uint16_t* dst, const uint32_t* src, size_t count) {
+    for (; count >= 8; count -= 8, dst += 8, src += 8) {
+        __m128i p0 = rgb565_sse2(_mm_loadu_si128((const __m128i*)src));
+        __m128i p1 = rgb565_sse2(_mm_loadu_si128((const __m128i*)src + 1));
+        _mm_storeu_si128((__m128i*)dst, _mm_packs_epi32(p0, p1));
+    }
+    gfx_kernels_generic.argb8888_to_rgb565(dst, src, count);
+}
+
+static const gfx_kernels_t gfx_kernels_sse2 = {
+    .name = "sse2",
+    .fill16 = fill16_sse2,
+    .fill32 = fill32_sse2,
+    .blend32 = blend32_sse2,
+    .argb8888_to_rgb565 = argb8888_to_rgb565_sse2,
+};
+
+AVX2 static void fill16_avx2(uint16_t* dst, uint16_t color, size_t count) {
+    while (count && ((uintptr_t)dst & 31)) {
+        *dst++ = color;
+        count--;
+    }
+    __m256i v = _mm256_set1_epi16((short)color);
+    for (; count >= 64; count -= 64, dst += 64) {
+        _mm256_store_si256((__m256i*)dst + 0, v);
+        _mm256_store_si256((__m256i*)dst + 1, v);
+        _mm256_store_si256((__m256i*)dst + 2, v);
+        _mm256_store_si256((__m256i*)dst + 3, v);
+    }
+    for (; count >= 16; count -= 16, dst += 16) {
+        _mm256_store_si256((__m256i*)dst, v);
+    }
+    while (count--) {
+        *dst++ = color;
+    }
+}
+
+AVX2 static void fill32_avx2(uint32_t* dst, uint32_t color, size_t count) {
+    while (count && ((uintptr_t)dst & 31)) {
+        *dst++ = color;
+        count--;
+    }
+    __m256i v = _mm256_set1_epi32((int)color);
+    for (; count >= 32; count -= 32, dst += 32) {
+        _mm256_store_si256((__m256i*)dst + 0, v);
+        _mm256_store_si256((__m256i*)dst + 1, v);
+        _mm256_store_si256((__m256i*)dst + 2, v);
+        _mm256_store_si256((__m256i*)dst + 3, v);
+    }
+    for (; count >= 8; count -= 8, dst += 8) {
+        _mm256_store_si256((__m256i*)dst, v);
+    }
+    while (count--) {
+        *dst++ = color;
+    }
+}
+
+// Same as blend4_sse2(); unpack and pack stay within 128-bit lanes, so the
+// pixel order is preserved.
+AVX2 static inline __m256i blend8_avx2(__m256i s, __m256i d) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i amask = _mm256_set1_epi32((int)0xff000000);
+
+    __m256i sa = _mm256_and_si256(s, amask);
+    __m256i opaque = _mm256_cmpeq_epi32(sa, amask);
+    __m256i clear = _mm256_cmpeq_epi32(sa, zero);
+
+    __m256i a = _mm256_add_epi32(_mm256_srli_epi32(s, 24), _mm256_set1_epi32(1));
+    __m256i ainv = _mm256_sub_epi32(_mm256_set1_epi32(255), a);
+    __m256i a16 = _mm256_or_si256(a, _mm256_slli_epi32(a, 16));
+    __m256i ainv16 = _mm256_or_si256(ainv, _mm256_slli_epi32(ainv, 16));
+
+    __m256i lo = _mm256_add_epi16(
+        _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(s, zero),
+                                             _mm256_unpacklo_epi32(a16, a16)), 8),
+        _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero),
+                                             _mm256_unpacklo_epi32(ainv16, ainv16)), 8));
+    __m256i hi = _mm256_add_epi16(
+        _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(s, zero),
+                                             _mm256_unpackhi_epi32(a16, a16)), 8),
+        _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero),
+                                             _mm256_unpackhi_epi32(ainv16, ainv16)), 8));
+    __m256i r = _mm256_packus_epi16(lo, hi);
+    r = _mm256_or_si256(_mm256_andnot_si256(amask, r), _mm256_slli_epi32(a, 24));
+
+    r = _mm256_blendv_epi8(r, s, opaque);
+    return _mm256_blendv_epi8(r, d, clear);
+}
+
+AVX2 static void blend32_avx2(uint32_t* dst, const uint32_t* src, size_t count) {
+    for (; count >= 8; count -= 8, dst += 8, src += 8) {
+        __m256i s = _mm256_loadu_si256((const __m256i*)src);
+        __m256i d = _mm256_loadu_si256((const __m256i*)dst);
+        _mm256_storeu_si256((__m256i*)dst, blend8_avx2(s, d));
+    }
+    blend32_sse2(dst, src, count);
+}
+
+AVX2 static inline __m256i rgb565_avx2(__m256i p) {
+    const __m256i b = _mm256_and_si256(_mm256_srli_epi32(p, 3), _mm256_set1_epi32(0x001f));
+    const __m256i g = _mm256_and_si256(_mm256_srli_epi32(p, 5), _mm256_set1_epi32(0x07e0));
+    const __m256i r = _mm256_and_si256(_mm256_srli_epi32(p, 8), _mm256_set1_epi32(0xf800));
+    __m256i v = _mm256_or_si256(_mm256_or_si256(b, g), r);
+    return _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16);
+}
+
+AVX2 static void argb8888_to_rgb565_avx2(uint16_t* dst, const uint32_t* src, size_t count) {
+    for (; count >= 16; count -= 16, dst += 16, src += 16) {
+        __m256i p0 = rgb565_avx2(_mm256_loadu_si256((const __m256i*)src));
+        __m256i p1 = rgb565_avx2(_mm256_loadu_si256((const __m256i*)src + 1));
+        // the pack interleaves 128-bit lanes; put them back in order
+        __m256i v = _mm256_permute4x64_epi64(_mm256_packs_epi32(p0, p1), 0xd8);
+        _mm256_storeu_si256((__m256i*)dst, v);
+    }
+    argb8888_to_rgb565_sse2(dst, src, count);
+}
+
+static const gfx_kernels_t gfx_kernels_avx2 = {
+    .name = "avx2",
+    .fill16 = fill16_avx2,
+    .fill32 = fill32_avx2,
+    .blend32 = blend32_avx2,
+    .argb8888_to_rgb565 = argb8888_to_rgb565_avx2,
+};
+
+static bool cpu_has_avx2(void) {
+    uint32_t a, b, c, d;
+    if (__get_cpuid_max(0, NULL) < 7) {
+        return false;
+    }
+    __cpuid(1, a, b, c, d);
+    if (!(c & bit_OSXSAVE) || !(c & bit_AVX)) {
+        return false;
+    }
+    // the OS must save and restore the ymm registers
+    uint32_t xcr0_lo, xcr0_hi;
+    __asm__ volatile("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+    if ((xcr0_lo & 0x6) != 0x6) {
+        return false;
+    }
+    __cpuid_count(7, 0, a, b, c, d);
+    return (b & bit_AVX2) != 0;
+}
+
+size_t gfx_arch_kernels(const gfx_kernels_t** out, size_t max) {
+    size_t n = 0;
+    if ((n < max) && cpu_has_avx2()) {
+        out[n++] = &gfx_kernels_avx2;
+    }
+    if (n < max) {
+        out[n++] = &gfx_kernels_sse2;
+    }
+    return n;
+}
@@ -0,0 +1,47 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "gfx-kernels.h"
+
+// Portable versions of the span kernels; the reference the SIMD versions
+// must match bit for bit.
+
+static void fill16_generic(uint16_t* dst, uint16_t color, size_t count) {
+    while (count--) {
+        *dst++ = color;
+    }
+}
+
+static void fill32_generic(uint32_t* dst, uint32_t color, size_t count) {
+    while (count--) {
+        *dst++ = color;
+    }
+}
+
+static void blend32_generic(uint32_t* dst, const uint32_t* src, size_t count) {
+    while (count--) {
+        *dst = alpha32_add_ignore_destalpha(*dst, *src);
+        dst++;
+        src++;
+    }
+}
+
+static void argb8888_to_rgb565_generic(uint16_t* dst, const uint32_t* src, size_t count) {
+    while (count--) {
+        uint32_t in = *src++;
+        *dst++ = (uint16_t)(((in >> 3) & 0x1f) |
+                            (((in >> 10) & 0x3f) << 5) |
+                            (((in >> 19) & 0x1f) << 11));
+    }
+}
+
+const gfx_kernels_t gfx_kernels_generic = {
+    .name = "generic",
+    .fill16 = fill16_generic,
+    .fill32 = fill32_generic,
+    .blend32 = blend32_generic,
+    .argb8888_to_rgb565 = argb8888_to_rgb565_generic,
+};
+
+const gfx_kernels_t* gfx_kernels = &gfx_kernels_generic;
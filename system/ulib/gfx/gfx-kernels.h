@@ -0,0 +1,37 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <magenta/compiler.h>
+
+__BEGIN_CDECLS
+
+// Span kernels behind the rectangle operations in gfx.c.  Each operates on
+// count pixels of a single row; callers clip and walk the rows.
+typedef struct gfx_kernels {
+    const char* name;
+    void (*fill16)(uint16_t* dst, uint16_t color, size_t count);
+    void (*fill32)(uint32_t* dst, uint32_t color, size_t count);
+    // alpha blend src over dst, as alpha32_add_ignore_destalpha()
+    void (*blend32)(uint32_t* dst, const uint32_t* src, size_t count);
+    // as ARGB8888_to_RGB565(), dropping alpha
+    void (*argb8888_to_rgb565)(uint16_t* dst, const uint32_t* src, size_t count);
+} gfx_kernels_t;
+
+extern const gfx_kernels_t gfx_kernels_generic;
+
+// Kernels for the current architecture that this CPU can run, best first.
+// Returns the number of entries stored in out.
+size_t gfx_arch_kernels(const gfx_kernels_t** out, size_t max);
+
+// The kernels currently in use; set up by gfx_init_surface().
+extern const gfx_kernels_t* gfx_kernels;
+
+uint32_t alpha32_add_ignore_destalpha(uint32_t dest, uint32_t src);
+
+__END_CDECLS
@@ -20,6 +20,9 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <threads.h>
+
+#include "gfx-kernels.h"
 
 #define TRACE 0
 
@@ -214,154 +217,60 @@ void gfx_putchar(gfx_surface* surface, const gfx_font* font, unsigned ch, unsign
     surface->putchar(surface, font, ch, x, y, fg, bg);
 }
 
-static void copyrect8(gfx_surface* surface, unsigned x, unsigned y, unsigned width, unsigned height, unsigned x2, unsigned y2) {
-    // copy
-    const uint8_t* src = &((const uint8_t*)surface->ptr)[x + y * surface->stride];
-    uint8_t* dest = &((uint8_t*)surface->ptr)[x2 + y2 * surface->stride];
-    unsigned stride_diff = surface->stride - width;
+// Rows are copied in the order that keeps an overlapping source intact;
+// memmove takes care of overlap within a row.
+static void copyrect(gfx_surface* surface, unsigned x, unsigned y, unsigned width, unsigned height, unsigned x2, unsigned y2) {
+    size_t pitch = surface->stride * surface->pixelsize;
+    size_t len = width * surface->pixelsize;
+    const uint8_t* src = (const uint8_t*)surface->ptr + y * pitch + x * surface->pixelsize;
+    uint8_t* dest = (uint8_t*)surface->ptr + y2 * pitch + x2 * surface->pixelsize;
 
     if (dest < src) {
-        unsigned i, j;
-        for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest++;
-                src++;
-            }
-            dest += stride_diff;
-            src += stride_diff;
+        for (unsigned i = 0; i < height; i++) {
+            memmove(dest, src, len);
+            dest += pitch;
+            src += pitch;
         }
     } else {
         // copy backwards
-        src += (height-1) * surface->stride + (width-1);
-        dest += (height-1) * surface->stride + (width-1);
-
-        unsigned i, j;
-        for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest--;
-                src--;
-            }
-            dest -= stride_diff;
-            src -= stride_diff;
+        src += (height - 1) * pitch;
+        dest += (height - 1) * pitch;
+        for (unsigned i = 0; i < height; i++) {
+            memmove(dest, src, len);
+            dest -= pitch;
+            src -= pitch;
         }
     }
 }
 
 static void fillrect8(gfx_surface* surface, unsigned x, unsigned y, unsigned width, unsigned height, unsigned color) {
     uint8_t* dest = &((uint8_t*)surface->ptr)[x + y * surface->stride];
-    unsigned stride_diff = surface->stride - width;
 
     uint8_t color8 = (uint8_t)(surface->translate_color(color));
 
-    unsigned i, j;
-    for (i = 0; i < height; i++) {
-        for (j = 0; j < width; j++) {
-            *dest = color8;
-            dest++;
-        }
-        dest += stride_diff;
-    }
-}
-
-static void copyrect16(gfx_surface* surface, unsigned x, unsigned y, unsigned width, unsigned height, unsigned x2, unsigned y2) {
-    // copy
-    const uint16_t* src = &((const uint16_t*)surface->ptr)[x + y * surface->stride];
-    uint16_t* dest = &((uint16_t*)surface->ptr)[x2 + y2 * surface->stride];
-    unsigned stride_diff = surface->stride - width;
-
-    if (dest < src) {
-        unsigned i, j;
-        for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest++;
-                src++;
-            }
-            dest += stride_diff;
-            src += stride_diff;
-        }
-    } else {
-        // copy backwards
-        src += (height-1) * surface->stride + (width-1);
-        dest += (height-1) * surface->stride + (width-1);
-
-        unsigned i, j;
-        for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest--;
-                src--;
-            }
-            dest -= stride_diff;
-            src -= stride_diff;
-        }
+    for (unsigned i = 0; i < height; i++) {
+        memset(dest, color8, width);
+        dest += surface->stride;
     }
 }
 
 static void fillrect16(gfx_surface* surface, unsigned x, unsigned y, unsigned width, unsigned height, unsigned color) {
     uint16_t* dest = &((uint16_t*)surface->ptr)[x + y * surface->stride];
-    unsigned stride_diff = surface->stride - width;
 
     uint16_t color16 = (uint16_t)(surface->translate_color(color));
 
-    unsigned i, j;
-    for (i = 0; i < height; i++) {
-        for (j = 0; j < width; j++) {
-            *dest = color16;
-            dest++;
-        }
-        dest += stride_diff;
-    }
-}
-
-static void copyrect32(gfx_surface* surface, unsigned x, unsigned y, unsigned width, unsigned height, unsigned x2, unsigned y2) {
-    // copy
-    const uint32_t* src = &((const uint32_t*)surface->ptr)[x + y * surface->stride];
-    uint32_t* dest = &((uint32_t*)surface->ptr)[x2 + y2 * surface->stride];
-    unsigned stride_diff = surface->stride - width;
-
-    if (dest < src) {
-        unsigned i, j;
-        for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest++;
-                src++;
-            }
-            dest += stride_diff;
-            src += stride_diff;
-        }
-    } else {
-        // copy backwards
-        src += (height-1) * surface->stride + (width-1);
-        dest += (height-1) * surface->stride + (width-1);
-
-        unsigned i, j;
-        for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest--;
-                src--;
-            }
-            dest -= stride_diff;
-            src -= stride_diff;
-        }
+    for (unsigned i = 0; i < height; i++) {
+        gfx_kernels->fill16(dest, color16, width);
+        dest += surface->stride;
     }
 }
 
 static void fillrect32(gfx_surface* surface, unsigned x, unsigned y, unsigned width, unsigned height, unsigned color) {
     uint32_t* dest = &((uint32_t*)surface->ptr)[x + y * surface->stride];
-    unsigned stride_diff = surface->stride - width;
 
-    unsigned i, j;
-    for (i = 0; i < height; i++) {
-        for (j = 0; j < width; j++) {
-            *dest = color;
-            dest++;
-        }
-        dest += stride_diff;
+    for (unsigned i = 0; i < height; i++) {
+        gfx_kernels->fill32(dest, color, width);
+        dest += surface->stride;
     }
 }
 
@@ -463,9 +372,15 @@ void gfx_surface_blend(struct gfx_surface* target, struct gfx_surface* source, u
 
 /**
  * @brief  Copy pixels from source to dest.
+ *
+ * Both surfaces must have the same format, except that 32 bit sources may
+ * be copied to a RGB 565 target.
  */
 void gfx_blend(gfx_surface* target, gfx_surface* source, unsigned srcx, unsigned srcy, unsigned width, unsigned height, unsigned destx, unsigned desty) {
-    assert(target->format == source->format);
+    assert(target->format == source->format ||
+           (target->format == MX_PIXEL_FORMAT_RGB_565 &&
+            (source->format == MX_PIXEL_FORMAT_ARGB_8888 ||
+             source->format == MX_PIXEL_FORMAT_RGB_x888)));
 
     xprintf("target %p, source %p, srcx %u, srcy %u, width %u, height %u, destx %u, desty %u\n", target, source, srcx, srcy, width, height, destx, desty);
 
@@ -490,82 +405,45 @@ void gfx_blend(gfx_surface* target, gfx_surface* source, unsigned srcx, unsigned
         height = source->height - srcy;
 
     // XXX total hack to deal with various blends
-    if (source->format == MX_PIXEL_FORMAT_RGB_565 && target->format == MX_PIXEL_FORMAT_RGB_565) {
-        // 16 bit to 16 bit
-        const uint16_t* src = &((const uint16_t*)source->ptr)[srcx + srcy * source->stride];
-        uint16_t* dest = &((uint16_t*)target->ptr)[destx + desty * target->stride];
-        unsigned dest_stride_diff = target->stride - width;
-        unsigned source_stride_diff = source->stride - width;
-
-        xprintf("w %u h %u dstride %u sstride %u\n", width, height, dest_stride_diff, source_stride_diff);
-
-        unsigned i, j;
-        for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest++;
-                src++;
-            }
-            dest += dest_stride_diff;
-            src += source_stride_diff;
+    if (source->format == target->format &&
+        (source->format == MX_PIXEL_FORMAT_RGB_565 ||
+         source->format == MX_PIXEL_FORMAT_RGB_x888 ||
+         source->format == MX_PIXEL_FORMAT_MONO_1)) {
+        // same format, no alpha
+        size_t len = width * source->pixelsize;
+        const uint8_t* src = (const uint8_t*)source->ptr + (srcx + srcy * source->stride) * source->pixelsize;
+        uint8_t* dest = (uint8_t*)target->ptr + (destx + desty * target->stride) * target->pixelsize;
+
+        xprintf("w %u h %u len %zu\n", width, height, len);
+
+        for (unsigned i = 0; i < height; i++) {
+            memmove(dest, src, len);
+            dest += target->stride * target->pixelsize;
+            src += source->stride * source->pixelsize;
         }
     } else if (source->format == MX_PIXEL_FORMAT_ARGB_8888 && target->format == MX_PIXEL_FORMAT_ARGB_8888) {
         // both are 32 bit modes, both alpha
         const uint32_t* src = &((const uint32_t*)source->ptr)[srcx + srcy * source->stride];
         uint32_t* dest = &((uint32_t*)target->ptr)[destx + desty * target->stride];
-        unsigned dest_stride_diff = target->stride - width;
-        unsigned source_stride_diff = source->stride - width;
-
-        xprintf("w %u h %u dstride %u sstride %u\n", width, height, dest_stride_diff, source_stride_diff);
-
-        unsigned i, j;
-        for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                // XXX ignores destination alpha
-                *dest = alpha32_add_ignore_destalpha(*dest, *src);
-                dest++;
-                src++;
-            }
-            dest += dest_stride_diff;
-            src += source_stride_diff;
-        }
-    } else if (source->format == MX_PIXEL_FORMAT_RGB_x888 && target->format == MX_PIXEL_FORMAT_RGB_x888) {
-        // both are 32 bit modes, no alpha
-        const uint32_t* src = &((const uint32_t*)source->ptr)[srcx + srcy * source->stride];
-        uint32_t* dest = &((uint32_t*)target->ptr)[destx + desty * target->stride];
-        unsigned dest_stride_diff = target->stride - width;
-        unsigned source_stride_diff = source->stride - width;
 
-        xprintf("w %u h %u dstride %u sstride %u\n", width, height, dest_stride_diff, source_stride_diff);
+        xprintf("w %u h %u dstride %u sstride %u\n", width, height, target->stride, source->stride);
 
-        unsigned i, j;
-        for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest++;
-                src++;
-            }
-            dest += dest_stride_diff;
-            src += source_stride_diff;
+        for (unsigned i = 0; i < height; i++) {
+            // XXX ignores destination alpha
+            gfx_kernels->blend32(dest, src, width);
+            dest += target->stride;
+            src += source->stride;
         }
-    } else if (source->format == MX_PIXEL_FORMAT_MONO_1 && target->format == MX_PIXEL_FORMAT_MONO_1) {
-        // both are 8 bit modes, no alpha
-        const uint8_t* src = &((const uint8_t*)source->ptr)[srcx + srcy * source->stride];
-        uint8_t* dest = &((uint8_t*)target->ptr)[destx + desty * target->stride];
-        unsigned dest_stride_diff = target->stride - width;
-        unsigned source_stride_diff = source->stride - width;
-
-        xprintf("w %u h %u dstride %u sstride %u\n", width, height, dest_stride_diff, source_stride_diff);
-
-        unsigned i, j;
-        for (i = 0; i < height; i++) {
-            for (j = 0; j < width; j++) {
-                *dest = *src;
-                dest++;
-                src++;
-            }
-            dest += dest_stride_diff;
-            src += source_stride_diff;
+    } else if ((source->format == MX_PIXEL_FORMAT_ARGB_8888 || source->format == MX_PIXEL_FORMAT_RGB_x888) &&
+               target->format == MX_PIXEL_FORMAT_RGB_565) {
+        // 32 bit to 16 bit, alpha dropped
+        const uint32_t* src = &((const uint32_t*)source->ptr)[srcx + srcy * source->stride];
+        uint16_t* dest = &((uint16_t*)target->ptr)[destx + desty * target->stride];
+
+        for (unsigned i = 0; i < height; i++) {
+            gfx_kernels->argb8888_to_rgb565(dest, src, width);
+            dest += target->stride;
+            src += source->stride;
         }
     } else {
         xprintf("gfx_surface_blend: unimplemented colorspace combination (source %d target %d)\n", source->format, target->format);
@@ -612,6 +490,40 @@ void gfx_flush_rows(struct gfx_surface* surface, unsigned start, unsigned end) {
         surface->flush(start, end);
 }
 
+#define GFX_MAX_KERNELS 4
+
+static once_flag kernels_once = ONCE_FLAG_INIT;
+
+static void select_kernels(void) {
+    const gfx_kernels_t* k;
+    if (gfx_arch_kernels(&k, 1) == 1) {
+        gfx_kernels = k;
+    }
+}
+
+/**
+ * @brief  Select the pixel kernels by name.
+ */
+mx_status_t gfx_set_kernels(const char* name) {
+    call_once(&kernels_once, select_kernels);
+
+    const gfx_kernels_t* k[GFX_MAX_KERNELS];
+    size_t n = gfx_arch_kernels(k, GFX_MAX_KERNELS - 1);
+    k[n++] = &gfx_kernels_generic;
+    for (size_t i = 0; i < n; i++) {
+        if (!strcmp(k[i]->name, name)) {
+            gfx_kernels = k[i];
+            return NO_ERROR;
+        }
+    }
+    return ERR_NOT_SUPPORTED;
+}
+
+const char* gfx_get_kernels(void) {
+    call_once(&kernels_once, select_kernels);
+    return gfx_kernels->name;
+}
+
 /**
  * @brief  Create a new graphics surface object
  */
@@ -633,6 +545,8 @@ int gfx_init_surface(gfx_surface* surface, void* ptr, unsigned width, unsigned h
     assert(height > 0);
     assert(stride >= width);
 
+    call_once(&kernels_once, select_kernels);
+
     surface->flags = flags;
     surface->format = format;
     surface->width = width;
@@ -644,7 +558,7 @@ int gfx_init_surface(gfx_surface* surface, void* ptr, unsigned width, unsigned h
     switch (format) {
     case MX_PIXEL_FORMAT_RGB_565:
         surface->translate_color = &ARGB8888_to_RGB565;
-        surface->copyrect = &copyrect16;
+        surface->copyrect = &copyrect;
         surface->fillrect = &fillrect16;
         surface->putpixel = &putpixel16;
         surface->putchar = &putchar16;
@@ -654,7 +568,7 @@ int gfx_init_surface(gfx_surface* surface, void* ptr, unsigned width, unsigned h
     case MX_PIXEL_FORMAT_RGB_x888:
     case MX_PIXEL_FORMAT_ARGB_8888:
         surface->translate_color = NULL;
-        surface->copyrect = &copyrect32;
+        surface->copyrect = &copyrect;
         surface->fillrect = &fillrect32;
         surface->putpixel = &putpixel32;
         surface->putchar = &putchar32;
@@ -663,7 +577,7 @@ int gfx_init_surface(gfx_surface* surface, void* ptr, unsigned width, unsigned h
         break;
     case MX_PIXEL_FORMAT_MONO_1:
         surface->translate_color = &ARGB8888_to_Luma;
-        surface->copyrect = &copyrect8;
+        surface->copyrect = &copyrect;
         surface->fillrect = &fillrect8;
         surface->putpixel = &putpixel8;
         surface->putchar = &putchar8;
@@ -672,7 +586,7 @@ int gfx_init_surface(gfx_surface* surface, void* ptr, unsigned width, unsigned h
         break;
     case MX_PIXEL_FORMAT_RGB_332:
         surface->translate_color = &ARGB8888_to_RGB332;
-        surface->copyrect = &copyrect8;
+        surface->copyrect = &copyrect;
         surface->fillrect = &fillrect8;
         surface->putpixel = &putpixel8;
         surface->putchar = &putchar8;
@@ -681,7 +595,7 @@ int gfx_init_surface(gfx_surface* surface, void* ptr, unsigned width, unsigned h
         break;
     case MX_PIXEL_FORMAT_RGB_2220:
         surface->translate_color = &ARGB8888_to_RGB2220;
-        surface->copyrect = &copyrect8;
+        surface->copyrect = &copyrect;
         surface->fillrect = &fillrect8;
         surface->putpixel = &putpixel8;
         surface->putchar = &putchar8;
@@ -80,6 +80,7 @@ void gfx_line(gfx_surface* surface, unsigned x1, unsigned y1, unsigned x2, unsig
 void gfx_surface_blend(struct gfx_surface* target, struct gfx_surface* source, unsigned destx, unsigned desty);
 
 // blend an area from the source surface to the target surface
+// 32 bit sources may also be copied to RGB 565 targets
 void gfx_blend(struct gfx_surface* target, struct gfx_surface* source, unsigned srcx, unsigned srcy, unsigned width, unsigned height, unsigned destx, unsigned desty);
 
 // copy entire lines from src to dst, which must be the same stride and pixel format
@@ -105,6 +106,14 @@ mx_status_t gfx_init_surface(gfx_surface* surface, void* ptr, unsigned width, un
 // optionally frees the buffer if the free bit is set
 void gfx_surface_destroy(struct gfx_surface* surface);
 
+// select the fill, blend and conversion kernels by name: "generic", or
+// "sse2"/"avx2" on x86 and "neon" on arm64; the best one the cpu supports
+// is used by default.  returns ERR_NOT_SUPPORTED if unavailable.
+mx_status_t gfx_set_kernels(const char* name);
+
+// name of the kernels in use
+const char* gfx_get_kernels(void);
+
 // utility routine to fill the display with a little moire pattern
 void gfx_draw_pattern(void);
 
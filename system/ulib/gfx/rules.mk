@@ -16,5 +16,12 @@ MODULE_LIBS := \
 
 MODULE_SRCS += \
     $(LOCAL_DIR)/gfx.c \
+    $(LOCAL_DIR)/gfx-kernels.c \
+
+ifeq ($(ARCH),arm64)
+MODULE_SRCS += $(LOCAL_DIR)/gfx-kernels-arm64.c
+else ifeq ($(ARCH),x86)
+MODULE_SRCS += $(LOCAL_DIR)/gfx-kernels-x86.c
+endif
 
 include make/module.mk
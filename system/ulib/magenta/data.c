@@ -15,4 +15,14 @@ const struct vdso_constants DATA_CONSTANTS = {
     0,
     0,
     0,
+    0,
+    0,
+    0,
+    0,
+};
+
+// Likewise, but the kernel keeps rewriting this one in place as the
+// values change; see VDso::SetUtcOffset.
+const struct vdso_time_values DATA_TIME_VALUES = {
+    0x7fffffffffffffff,
 };
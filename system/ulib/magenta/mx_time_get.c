@@ -0,0 +1,66 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <magenta/syscalls.h>
+
+#include <lib/fixed_point.h>
+
+#include "private.h"
+
+// Read the counter the kernel's current_time_hires() is based on, if
+// the kernel published one in DATA_CONSTANTS.  Returns false if there
+// is none and the kernel has to be asked instead.
+static bool read_user_clock(uint64_t* ticks) {
+    switch (DATA_CONSTANTS.user_clock) {
+#if __aarch64__
+    case VDSO_USER_CLOCK_CNTVCT:
+        __asm__ volatile("mrs %0, cntvct_el0" : "=r" (*ticks));
+        return true;
+    case VDSO_USER_CLOCK_CNTPCT:
+        __asm__ volatile("mrs %0, cntpct_el0" : "=r" (*ticks));
+        return true;
+#elif __x86_64__
+    case VDSO_USER_CLOCK_TSC: {
+        uint32_t ticks_low;
+        uint32_t ticks_high;
+        __asm__ volatile("rdtsc" : "=a" (ticks_low), "=d" (ticks_high));
+        *ticks = ((uint64_t)ticks_high << 32) | ticks_low;
+        return true;
+    }
+#endif
+    default:
+        return false;
+    }
+}
+
+mx_time_t _mx_time_get(uint32_t clock_id) {
+    uint64_t ticks;
+    switch (clock_id) {
+    case MX_CLOCK_MONOTONIC:
+    case MX_CLOCK_UTC:
+        if (read_user_clock(&ticks)) {
+            // Same arithmetic as the kernel so the results agree exactly.
+            struct fp_32_64 ns_per_tick = {
+                DATA_CONSTANTS.ns_per_tick_l0,
+                DATA_CONSTANTS.ns_per_tick_l32,
+                DATA_CONSTANTS.ns_per_tick_l64,
+            };
+            mx_time_t now = u64_mul_u64_fp32_64(ticks, ns_per_tick);
+            if (clock_id == MX_CLOCK_UTC) {
+                now += __atomic_load_n(&DATA_TIME_VALUES.utc_offset,
+                                       __ATOMIC_RELAXED);
+            }
+            return now;
+        }
+        break;
+    }
+    return SYSCALL_mx_time_get_via_kernel(clock_id);
+}
+
+__typeof(mx_time_get) mx_time_get
+    __attribute__((weak, alias("_mx_time_get")));
+
+// Used by CODE_soft_ticks_get and any other calls within the vDSO.
+__typeof(mx_time_get) VDSO_mx_time_get
+    __attribute__((alias("_mx_time_get")));
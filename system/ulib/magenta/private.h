@@ -12,6 +12,9 @@
 extern const struct vdso_constants DATA_CONSTANTS
     __attribute__((visibility("hidden")));
 
+extern const struct vdso_time_values DATA_TIME_VALUES
+    __attribute__((visibility("hidden")));
+
 // This declares the VDSO_mx_* aliases for the vDSO entry points.
 // Calls made from within the vDSO must use these names rather than
 // the public names so as to avoid PLT entries.
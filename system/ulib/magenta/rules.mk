@@ -11,7 +11,7 @@ MODULE_TYPE := userlib
 # This library should not depend on libc.
 MODULE_COMPILEFLAGS := -ffreestanding
 
-MODULE_HEADER_DEPS := kernel/lib/vdso
+MODULE_HEADER_DEPS := kernel/lib/vdso kernel/lib/fixed_point
 
 MODULE_SRCS := \
     $(LOCAL_DIR)/data.c \
@@ -22,6 +22,7 @@ MODULE_SRCS := \
     $(LOCAL_DIR)/mx_system_get_version.c \
     $(LOCAL_DIR)/mx_ticks_get.c \
     $(LOCAL_DIR)/mx_ticks_per_second.c \
+    $(LOCAL_DIR)/mx_time_get.c \
 
 ifeq ($(ARCH),arm64)
 MODULE_SRCS += \
@@ -11,9 +11,15 @@ _\name:
 .cfi_startproc
 .endm
 
-.macro syscall_entry_end name
+// With hidden=1 the entry point is only callable from within the vDSO
+// (the SYSCALL_mx_* stubs for internal syscalls) and is not exported.
+.macro syscall_entry_end name, hidden=0
 .cfi_endproc
 .size _\name, . - _\name
+.if \hidden
+.hidden _\name
+.hidden \name
+.endif
 
 .weak \name
 .type \name,STT_FUNC
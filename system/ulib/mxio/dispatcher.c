@@ -2,6 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <stdatomic.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -44,6 +45,8 @@ struct mxio_dispatcher {
     mx_handle_t ioport;
     mxio_dispatcher_cb_t default_cb;
     thrd_t t;
+    // threads running the loop; the last one out destroys the dispatcher
+    atomic_int threads;
 };
 
 static void mxio_dispatcher_destroy(mxio_dispatcher_t* md) {
@@ -147,7 +150,9 @@ static int mxio_dispatcher_thread(void* _md) {
     }
 
     xprintf("dispatcher: FATAL ERROR, EXITING\n");
-    mxio_dispatcher_destroy(md);
+    if (atomic_fetch_sub(&md->threads, 1) == 1) {
+        mxio_dispatcher_destroy(md);
+    }
     return NO_ERROR;
 }
 
@@ -173,6 +178,7 @@ mx_status_t mxio_dispatcher_start(mxio_dispatcher_t* md, const char* name) {
     mx_status_t r;
     mtx_lock(&md->lock);
     if (md->t == NULL) {
+        atomic_fetch_add(&md->threads, 1);
         if (thrd_create_with_name(&md->t, mxio_dispatcher_thread, md, name) != thrd_success) {
             mxio_dispatcher_destroy(md);
             r = ERR_NO_RESOURCES;
@@ -188,7 +194,32 @@ mx_status_t mxio_dispatcher_start(mxio_dispatcher_t* md, const char* name) {
 }
 
 void mxio_dispatcher_run(mxio_dispatcher_t* md) {
+    atomic_fetch_add(&md->threads, 1);
+    mxio_dispatcher_thread(md);
+}
+
+void mxio_dispatcher_run_threads(mxio_dispatcher_t* md, const char* name, uint32_t count) {
+    // A handler is only re-armed once its callback returns, which is
+    // what keeps each channel's messages in order across threads.
+    // Repeating waits would hand the next message to another thread.
+#if USE_WAIT_ONCE
+    // Count ourselves first, so a helper which exits early cannot take
+    // the dispatcher down with it.
+    atomic_fetch_add(&md->threads, 1);
+    for (uint32_t i = 1; i < count; i++) {
+        thrd_t t;
+        atomic_fetch_add(&md->threads, 1);
+        if (thrd_create_with_name(&t, mxio_dispatcher_thread, md, name) != thrd_success) {
+            printf("dispatcher: could only start %u threads\n", i);
+            atomic_fetch_sub(&md->threads, 1);
+            break;
+        }
+        thrd_detach(t);
+    }
     mxio_dispatcher_thread(md);
+#else
+    mxio_dispatcher_run(md);
+#endif
 }
 
 mx_status_t mxio_dispatcher_add(mxio_dispatcher_t* md, mx_handle_t h, void* func, void* cookie) {
@@ -9,8 +9,8 @@
 #include <sys/epoll.h>
 #include <threads.h>
 
-#include <magenta/listnode.h>
 #include <magenta/syscalls.h>
+#include <magenta/syscalls/port.h>
 #include <mxio/io.h>
 #include <mxio/util.h>
 
@@ -20,52 +20,134 @@
 // TODO: should use a system default
 #define MAX_WAIT_EVENTS 1024
 
+#define MIN_BUCKETS 16
+
+// An fd registered with an epoll instance.  The port packets for it carry
+// |key|, which pairs the fd with a generation number so that packets
+// queued for an earlier registration of the same fd can be told apart.
 typedef struct mxio_epoll_cookie {
-    list_node_t node;
+    struct mxio_epoll_cookie* next;
+    // Links cookies waiting to be re-armed at the end of an epoll_wait.
+    struct mxio_epoll_cookie* rearm_next;
     mxio_t* io;
     struct epoll_event ep_event;
+    mx_handle_t h;
+    mx_signals_t signals;
+    uint64_t key;
     int fd;
+    // Set when re-arming failed, so the port will not tell us about this
+    // fd any more; it is reported with EPOLLERR until it can be armed.
+    bool disarmed;
+    // The batch of events this fd was last reported in, and where, so
+    // that it is reported at most once per epoll_wait.
+    uint32_t report_seq;
+    int report_index;
 } mxio_epoll_cookie_t;
 
 typedef struct mxio_epoll {
     mxio_t io;
     mx_handle_t h;
     mtx_t cookies_lock;
-    list_node_t cookies;
+    // Hash table of cookies by fd, with |num_buckets| a power of two.
+    mxio_epoll_cookie_t** buckets;
+    size_t num_buckets;
+    size_t num_cookies;
+    size_t num_disarmed;
+    uint32_t generation;
+    uint32_t report_seq;
 } mxio_epoll_t;
 
-static void mxio_epoll_cookie_add(mxio_epoll_t* epio,
-                                  mxio_epoll_cookie_t* cookie) {
-    mtx_lock(&epio->cookies_lock);
-    list_add_head(&epio->cookies, &cookie->node);
-    mtx_unlock(&epio->cookies_lock);
+static inline mxio_epoll_cookie_t** mxio_epoll_bucket(mxio_epoll_t* epio, int fd) {
+    return &epio->buckets[(unsigned)fd & (epio->num_buckets - 1)];
 }
 
-static mxio_epoll_cookie_t* mxio_epoll_cookie_get(mxio_epoll_t* epio, int fd,
-                                                  bool remove) {
-    mxio_epoll_cookie_t* cookie = NULL;
-    mxio_epoll_cookie_t* entry = NULL;
-    mtx_lock(&epio->cookies_lock);
-    list_for_every_entry(&epio->cookies, entry, mxio_epoll_cookie_t, node) {
-        // doesn't have to be _safe as we break immediately after deletion
-        if (entry->fd == fd) {
-            if (remove) {
-                list_delete(&entry->node);
-            }
-            cookie = entry;
-            break;
+// Must be called with cookies_lock held.
+static mxio_epoll_cookie_t* mxio_epoll_cookie_find(mxio_epoll_t* epio, int fd) {
+    if (epio->num_buckets == 0) {
+        return NULL;
+    }
+    for (mxio_epoll_cookie_t* c = *mxio_epoll_bucket(epio, fd); c != NULL; c = c->next) {
+        if (c->fd == fd) {
+            return c;
         }
     }
-    mtx_unlock(&epio->cookies_lock);
-    return cookie;
+    return NULL;
 }
 
-static mxio_epoll_cookie_t* mxio_epoll_cookie_find(mxio_epoll_t* epio, int fd) {
-    return mxio_epoll_cookie_get(epio, fd, false);
+// Must be called with cookies_lock held.
+static mx_status_t mxio_epoll_cookie_add(mxio_epoll_t* epio,
+                                         mxio_epoll_cookie_t* cookie) {
+    if (epio->num_cookies >= epio->num_buckets) {
+        // Keep chains short by doubling the table once it is full.
+        size_t num_buckets = epio->num_buckets ? epio->num_buckets * 2 : MIN_BUCKETS;
+        mxio_epoll_cookie_t** buckets = calloc(num_buckets, sizeof(*buckets));
+        if (buckets == NULL) {
+            return ERR_NO_MEMORY;
+        }
+        for (size_t i = 0; i < epio->num_buckets; i++) {
+            mxio_epoll_cookie_t* c = epio->buckets[i];
+            while (c != NULL) {
+                mxio_epoll_cookie_t* next = c->next;
+                mxio_epoll_cookie_t** b = &buckets[(unsigned)c->fd & (num_buckets - 1)];
+                c->next = *b;
+                *b = c;
+                c = next;
+            }
+        }
+        free(epio->buckets);
+        epio->buckets = buckets;
+        epio->num_buckets = num_buckets;
+    }
+    mxio_epoll_cookie_t** b = mxio_epoll_bucket(epio, cookie->fd);
+    cookie->next = *b;
+    *b = cookie;
+    epio->num_cookies++;
+    return NO_ERROR;
 }
 
+// Must be called with cookies_lock held.
 static mxio_epoll_cookie_t* mxio_epoll_cookie_remove(mxio_epoll_t* epio, int fd) {
-    return mxio_epoll_cookie_get(epio, fd, true);
+    if (epio->num_buckets == 0) {
+        return NULL;
+    }
+    for (mxio_epoll_cookie_t** c = mxio_epoll_bucket(epio, fd); *c != NULL; c = &(*c)->next) {
+        if ((*c)->fd == fd) {
+            mxio_epoll_cookie_t* cookie = *c;
+            *c = cookie->next;
+            epio->num_cookies--;
+            return cookie;
+        }
+    }
+    return NULL;
+}
+
+// Asks the port for a packet when the cookie's signals are asserted.
+// Edge-triggered cookies get a packet on every change for as long as they
+// stay registered; the others get one packet and are re-armed once it has
+// been handled.
+static mx_status_t mxio_epoll_cookie_arm(mxio_epoll_t* epio,
+                                         mxio_epoll_cookie_t* cookie) {
+    uint32_t events = cookie->ep_event.events;
+    uint32_t options = ((events & EPOLLET) && !(events & EPOLLONESHOT)) ?
+        MX_WAIT_ASYNC_REPEATING : MX_WAIT_ASYNC_ONCE;
+    return mx_object_wait_async(cookie->h, epio->h, cookie->key, cookie->signals, options);
+}
+
+// (Re)registers the cookie's io with the port for |ep_event|.
+static mx_status_t mxio_epoll_cookie_set(mxio_epoll_t* epio, mxio_epoll_cookie_t* cookie,
+                                         const struct epoll_event* ep_event) {
+    mx_handle_t h = MX_HANDLE_INVALID;
+    mx_signals_t signals = 0;
+    cookie->io->ops->wait_begin(cookie->io, ep_event->events, &h, &signals);
+    if (h == MX_HANDLE_INVALID) {
+        // wait operation is not applicable to the handle
+        return ERR_INVALID_ARGS;
+    }
+    cookie->h = h;
+    cookie->signals = signals;
+    cookie->ep_event = *ep_event;
+    cookie->key = ((uint64_t)++epio->generation << 32) | (uint32_t)cookie->fd;
+    return mxio_epoll_cookie_arm(epio, cookie);
 }
 
 static mx_status_t mxio_epoll_close(mxio_t* io) {
@@ -74,13 +156,20 @@ static mx_status_t mxio_epoll_close(mxio_t* io) {
     epio->h = MX_HANDLE_INVALID;
     mx_handle_close(h);
 
-    mxio_epoll_cookie_t* cookie;
     mtx_lock(&epio->cookies_lock);
-    while ((cookie = list_remove_head_type(&epio->cookies, mxio_epoll_cookie_t,
-                                           node))) {
-        mxio_release(cookie->io);
-        free(cookie);
+    for (size_t i = 0; i < epio->num_buckets; i++) {
+        mxio_epoll_cookie_t* cookie = epio->buckets[i];
+        while (cookie != NULL) {
+            mxio_epoll_cookie_t* next = cookie->next;
+            mxio_release(cookie->io);
+            free(cookie);
+            cookie = next;
+        }
     }
+    free(epio->buckets);
+    epio->buckets = NULL;
+    epio->num_buckets = 0;
+    epio->num_cookies = 0;
     mtx_unlock(&epio->cookies_lock);
     return NO_ERROR;
 }
@@ -112,14 +201,13 @@ mxio_t* mxio_epoll_create(mx_handle_t h) {
     epio->io.flags |= MXIO_FLAG_EPOLL;
     epio->h = h;
     mtx_init(&epio->cookies_lock, mtx_plain);
-    list_initialize(&epio->cookies);
     return &epio->io;
 }
 
 mx_status_t mxio_epoll(mxio_t** out) {
     mx_handle_t h;
     mx_status_t status;
-    if ((status = mx_waitset_create(0, &h)) < 0) {
+    if ((status = mx_port_create(MX_PORT_OPT_V2, &h)) < 0) {
         return status;
     }
     mxio_t* io;
@@ -175,66 +263,65 @@ int epoll_ctl(int epfd, int op, int fd, struct epoll_event* ep_event) {
         goto fail_no_io;
     }
 
+    mtx_lock(&epio->cookies_lock);
     mxio_epoll_cookie_t* cookie;
     switch (op) {
     case EPOLL_CTL_ADD:
-        if (mxio_epoll_cookie_find(epio, fd) != NULL)  {
+        if (mxio_epoll_cookie_find(epio, fd) != NULL) {
             r = ERR_ALREADY_EXISTS;
-            goto end;
+            break;
         }
         // create a new cookie
         cookie = calloc(1, sizeof(mxio_epoll_cookie_t));
         if (cookie == NULL) {
             r = ERR_NO_MEMORY;
-            goto end;
+            break;
         }
-        mxio_acquire(io);
         cookie->io = io;
         cookie->fd = fd;
+        if ((r = mxio_epoll_cookie_add(epio, cookie)) < 0) {
+            free(cookie);
+            break;
+        }
+        if ((r = mxio_epoll_cookie_set(epio, cookie, ep_event)) < 0) {
+            mxio_epoll_cookie_remove(epio, fd);
+            free(cookie);
+            break;
+        }
+        mxio_acquire(io);
         break;
     case EPOLL_CTL_MOD:
+        if ((cookie = mxio_epoll_cookie_find(epio, fd)) == NULL) {
+            r = ERR_NOT_FOUND;
+            break;
+        }
+        // Packets already queued under the old key are dropped when they
+        // are dequeued.
+        mx_port_cancel(epio->h, cookie->h, cookie->key);
+        if ((r = mxio_epoll_cookie_set(epio, cookie, ep_event)) == NO_ERROR &&
+            cookie->disarmed) {
+            cookie->disarmed = false;
+            epio->num_disarmed--;
+        }
+        break;
     case EPOLL_CTL_DEL:
-        // or retrieve an existing cookie and remove the current epoll event
-        cookie = mxio_epoll_cookie_remove(epio, fd);
-        if (cookie == NULL) {
+        if ((cookie = mxio_epoll_cookie_remove(epio, fd)) == NULL) {
             r = ERR_NOT_FOUND;
-            goto end;
+            break;
         }
-        if ((r = mx_waitset_remove(epio->h, (uint64_t)(uintptr_t)cookie)) < 0) {
-            mxio_epoll_cookie_add(epio, cookie);
-            goto end;
+        mx_port_cancel(epio->h, cookie->h, cookie->key);
+        if (cookie->disarmed) {
+            epio->num_disarmed--;
         }
+        mxio_release(cookie->io);
+        free(cookie);
         break;
     default:
         r = ERR_INVALID_ARGS;
-        goto end;
-    }
-
-    if (op == EPOLL_CTL_DEL) {
-        // free the cookie
-        mxio_release(cookie->io);
-        free(cookie);
-    } else {
-        // or add a new epoll event and put the cookie into the list
-        mx_handle_t h = MX_HANDLE_INVALID;
-        mx_signals_t signals = 0;
-        io->ops->wait_begin(io, ep_event->events, &h, &signals);
-        if (h == MX_HANDLE_INVALID) {
-            // wait operation is not applicable to the handle
-            r = ERR_INVALID_ARGS;
-            goto end;
-        }
-
-        cookie->ep_event = *ep_event;
-        if ((r = mx_waitset_add(epio->h, (uint64_t)(uintptr_t)cookie, h, signals)) < 0) {
-            mxio_release(cookie->io);
-            free(cookie);
-            goto end;
-        }
-        mxio_epoll_cookie_add(epio, cookie);
+        break;
     }
+    mtx_unlock(&epio->cookies_lock);
 
- end:
     mxio_release(io);
  fail_no_io:
     mxio_release(&epio->io);
@@ -242,6 +329,101 @@ int epoll_ctl(int epfd, int op, int fd, struct epoll_event* ep_event) {
     return STATUS(r);
 }
 
+// Returns true if the cookie already has one of the first |n| entries
+// of the events being collected for the current batch.
+// Must be called with cookies_lock held.
+static bool mxio_epoll_reported(mxio_epoll_t* epio, mxio_epoll_cookie_t* cookie, int n) {
+    return cookie->report_seq == epio->report_seq && cookie->report_index < n;
+}
+
+// Adds |events| for the cookie to the events being collected for the
+// current batch, merging them into its earlier entry if it has one.
+// Returns the new number of entries.
+// Must be called with cookies_lock held.
+static int mxio_epoll_report(mxio_epoll_t* epio, mxio_epoll_cookie_t* cookie,
+                             uint32_t events, struct epoll_event* ep_events, int n) {
+    if (mxio_epoll_reported(epio, cookie, n)) {
+        ep_events[cookie->report_index].events |= events;
+        return n;
+    }
+    cookie->report_seq = epio->report_seq;
+    cookie->report_index = n;
+    ep_events[n].events = events;
+    ep_events[n].data = cookie->ep_event.data;
+    return n + 1;
+}
+
+// Retries arming the cookies which could not be re-armed, and reports
+// EPOLLERR for those that still cannot be, as far as there is room.
+// Returns the new number of entries.
+// Must be called with cookies_lock held.
+static int mxio_epoll_report_disarmed(mxio_epoll_t* epio, struct epoll_event* ep_events,
+                                      int n, int maxevents) {
+    if (epio->num_disarmed == 0) {
+        return n;
+    }
+    for (size_t i = 0; i < epio->num_buckets; i++) {
+        for (mxio_epoll_cookie_t* c = epio->buckets[i]; c != NULL; c = c->next) {
+            if (!c->disarmed) {
+                continue;
+            }
+            if (mxio_epoll_cookie_arm(epio, c) == NO_ERROR) {
+                c->disarmed = false;
+                epio->num_disarmed--;
+                continue;
+            }
+            if (n < maxevents || mxio_epoll_reported(epio, c, n)) {
+                n = mxio_epoll_report(epio, c, EPOLLERR, ep_events, n);
+            }
+        }
+    }
+    return n;
+}
+
+// Turns a packet into an event for the cookie it was queued for, if any.
+// Cookies that need arming again are pushed onto |rearm| rather than armed
+// here, so that a level-triggered fd whose signal is still asserted does
+// not queue another packet that the same epoll_wait would then report.
+// Returns the new number of entries in |ep_events|.
+// Must be called with cookies_lock held.
+static int mxio_epoll_cookie_event(mxio_epoll_t* epio, const mx_port_packet_t* packet,
+                                   struct epoll_event* ep_events, int n,
+                                   mxio_epoll_cookie_t** rearm) {
+    mxio_epoll_cookie_t* cookie = mxio_epoll_cookie_find(epio, (int)(uint32_t)packet->key);
+    if (cookie == NULL || cookie->key != packet->key) {
+        // stale packet
+        return n;
+    }
+
+    uint32_t requested = cookie->ep_event.events;
+    mx_signals_t observed = packet->signal.observed;
+    if (!(requested & EPOLLET)) {
+        // Level-triggered events report the state as it is now, which may
+        // have changed since the packet was queued.
+        mx_object_wait_one(cookie->h, 0u, 0u, &observed);
+    }
+
+    uint32_t events;
+    cookie->io->ops->wait_end(cookie->io, observed, &events);
+    // mask unrequested events except HUP/ERR
+    events &= requested | EPOLLHUP | EPOLLERR;
+
+    // Cookies armed for a single packet need arming again, unless they are
+    // one-shot and have now fired.
+    bool once = !(requested & EPOLLET) || (requested & EPOLLONESHOT);
+    if (once && (events == 0 || !(requested & EPOLLONESHOT))) {
+        cookie->rearm_next = *rearm;
+        *rearm = cookie;
+    }
+
+    if (events == 0) {
+        return n;
+    }
+    // An edge-triggered fd can have several packets queued by now; they
+    // all go into the one event.
+    return mxio_epoll_report(epio, cookie, events, ep_events, n);
+}
+
 int epoll_wait(int epfd, struct epoll_event* ep_events, int maxevents, int timeout) {
     if (maxevents <= 0 || timeout < -1) {
         return ERRNO(EINVAL);
@@ -262,29 +444,56 @@ int epoll_wait(int epfd, struct epoll_event* ep_events, int maxevents, int timeo
     }
     mxio_epoll_t* epio = (mxio_epoll_t*)io;
 
-    mx_status_t r;
-    uint32_t num_results = maxevents;
-    mx_waitset_result_t results[maxevents];
-    mx_time_t tmo = (timeout >= 0) ? MX_MSEC(timeout) : MX_TIME_INFINITE;
-
-    if ((r = mx_waitset_wait(epio->h, tmo, results, &num_results)) < 0) {
-        mxio_release(io);
-        return (r == ERR_TIMED_OUT) ? 0 : ERROR(r);
+    mx_time_t deadline = 0;
+    if (timeout > 0) {
+        deadline = mx_time_get(MX_CLOCK_MONOTONIC) + MX_MSEC(timeout);
     }
 
-    for (uint32_t i = 0; i < num_results; i++) {
-        mxio_epoll_cookie_t* cookie = (mxio_epoll_cookie_t*)(uintptr_t)results[i].cookie;
-        mxio_t* io = cookie->io;
-        uint32_t events;
+    // Fds which could not be re-armed last time have nothing to wake us
+    // up, so report them before going to sleep.
+    int n = 0;
+    mtx_lock(&epio->cookies_lock);
+    epio->report_seq++;
+    n = mxio_epoll_report_disarmed(epio, ep_events, n, maxevents);
+    mtx_unlock(&epio->cookies_lock);
 
-        io->ops->wait_end(io, results[i].observed, &events);
-        // mask unrequested events except HUP/ERR
-        ep_events[i].events = events & (cookie->ep_event.events | EPOLLHUP | EPOLLERR);
+    // Packets for cookies that were since changed, or whose signals have
+    // already gone away again, don't count, so keep waiting until there is
+    // something to report or time runs out.
+    mx_port_packet_t packet;
+    while (n == 0) {
+        mx_time_t tmo = MX_TIME_INFINITE;
+        if (timeout >= 0) {
+            mx_time_t now = (timeout > 0) ? mx_time_get(MX_CLOCK_MONOTONIC) : deadline;
+            tmo = (now < deadline) ? deadline - now : 0;
+        }
+        mx_status_t r = mx_port_wait(epio->h, tmo, &packet, 0);
+        if (r < 0) {
+            mxio_release(io);
+            return (r == ERR_TIMED_OUT) ? 0 : ERROR(r);
+        }
 
-        ep_events[i].data = cookie->ep_event.data;
+        // Take whatever else is already queued, up to maxevents, without
+        // going back to sleep.
+        mxio_epoll_cookie_t* rearm = NULL;
+        mtx_lock(&epio->cookies_lock);
+        epio->report_seq++;
+        do {
+            n = mxio_epoll_cookie_event(epio, &packet, ep_events, n, &rearm);
+        } while (n < maxevents && mx_port_wait(epio->h, 0, &packet, 0) == NO_ERROR);
+        // Only now that the queue is drained can the reported cookies wait
+        // for their next packet.
+        for (; rearm != NULL; rearm = rearm->rearm_next) {
+            if (mxio_epoll_cookie_arm(epio, rearm) < 0 && !rearm->disarmed) {
+                rearm->disarmed = true;
+                epio->num_disarmed++;
+            }
+        }
+        n = mxio_epoll_report_disarmed(epio, ep_events, n, maxevents);
+        mtx_unlock(&epio->cookies_lock);
     }
     mxio_release(io);
-    return (int)num_results;
+    return n;
 }
 
 int epoll_pwait(int epfd, struct epoll_event* events, int maxevents, int timeout, const sigset_t* sigmask) {
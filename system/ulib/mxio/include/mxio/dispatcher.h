@@ -32,6 +32,12 @@ mx_status_t mxio_dispatcher_start(mxio_dispatcher_t* md, const char* name);
 // run the dispatcher loop on the current thread, never to return
 void mxio_dispatcher_run(mxio_dispatcher_t* md);
 
+// run the dispatcher loop on the current thread and count - 1 new ones,
+// never to return.  Messages from different channels may be handled at
+// the same time, but each channel's are still handled one at a time,
+// in order.
+void mxio_dispatcher_run_threads(mxio_dispatcher_t* md, const char* name, uint32_t count);
+
 // add a channel to the dispatcher, using the default callback
 mx_status_t mxio_dispatcher_add(mxio_dispatcher_t* md, mx_handle_t h,
                                 void* func, void* cookie);
@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <dirent.h>
 #include <limits.h>
 #include <stdbool.h>
 #include <sys/epoll.h>
@@ -55,4 +56,12 @@ mx_status_t mxio_pipe_half(mx_handle_t* handle, uint32_t* type);
 // the contents of the file, at offset off, of length len.
 mx_status_t mxio_get_vmo(int fd, mx_handle_t* vmo, size_t* off, size_t* len);
 
+typedef struct vnattr vnattr_t;
+
+// Like readdir(), but also return the attributes of the entry, as stat()
+// would. Filesystems that support it send them along with the names, so
+// listing a directory with attributes costs no more requests than
+// listing it without.
+struct dirent* mxio_readdir_attr(DIR* dir, vnattr_t* attr);
+
 __END_CDECLS
@@ -8,6 +8,7 @@
 #include <magenta/types.h>
 
 #include <mxio/limits.h>
+#include <mxio/vfs.h>
 
 #include <assert.h>
 #include <limits.h>
@@ -49,7 +50,12 @@ __BEGIN_CDECLS
 #define MXRIO_SETATTR      0x00000018
 #define MXRIO_SYNC         0x00000019
 #define MXRIO_LINK        (0x0000001a | MXRIO_ONE_HANDLE)
-#define MXRIO_NUM_OPS      27
+#define MXRIO_MMAP         0x0000001b
+#define MXRIO_STAT_AT     (0x0000001c | MXRIO_ONE_HANDLE)
+#define MXRIO_READDIR_ATTR 0x0000001d
+#define MXRIO_READ_VMO    (0x0000001e | MXRIO_ONE_HANDLE)
+#define MXRIO_WRITE_VMO   (0x0000001f | MXRIO_ONE_HANDLE)
+#define MXRIO_NUM_OPS      32
 
 #define MXRIO_OP(n)        ((n) & 0x3FF) // opcode
 #define MXRIO_HC(n)        (((n) >> 8) & 3) // handle count
@@ -62,7 +68,8 @@ __BEGIN_CDECLS
     "read_at", "write_at", "truncate", "rename", \
     "connect", "bind", "listen", "getsockname", \
     "getpeername", "getsockopt", "setsockopt", "getaddrinfo", \
-    "setattr", "sync", "link" }
+    "setattr", "sync", "link", "mmap", \
+    "stat_at", "readdir_attr", "read_vmo", "write_vmo" }
 
 const char* mxio_opname(uint32_t op);
 
@@ -113,6 +120,15 @@ typedef struct {
     mx_handle_t handle[MXIO_MAX_HANDLES];
 } mxrio_object_t;
 
+// STAT_AT also replies on a channel, so that it can be forwarded across
+// mount points. The reply starts with the same status and type header as
+// an object, followed on success by the vnattr_t of the path.
+typedef struct {
+    mx_status_t status;
+    uint32_t type;
+    vnattr_t attr;
+} mxrio_stat_reply_t;
+
 
 struct mxrio_msg {
     mx_txid_t txid;                    // transaction id
@@ -133,6 +149,46 @@ struct mxrio_msg {
 
 static_assert(MXIO_CHUNK_SIZE >= PATH_MAX, "MXIO_CHUNK_SIZE must be large enough to contain paths");
 
+// MXRIO_MMAP requests a VMO holding the contents of a file.
+// The request and reply data are a mxrio_mmap_data_t; on success the
+// reply carries the VMO as its only handle.
+#define MXIO_MMAP_FLAG_READ    (1u << 0)
+#define MXIO_MMAP_FLAG_WRITE   (1u << 1)
+#define MXIO_MMAP_FLAG_EXEC    (1u << 2)
+
+typedef struct mxrio_mmap_data {
+    uint32_t flags;                    // tx: MXIO_MMAP_FLAG_*
+    uint32_t reserved;
+    uint64_t offset;                   // rx: offset of the file's first byte in the VMO
+    uint64_t length;                   // rx: length of the file
+} mxrio_mmap_data_t;
+
+// MXRIO_READ_VMO and MXRIO_WRITE_VMO move up to MXIO_VMO_XFER_MAX bytes
+// in one transaction. The request carries a VMO, which the server reads the
+// file into, or writes the file from, starting at the VMO's first byte. The
+// VMO must be at least |length| bytes long. The request data is a
+// mxrio_vmo_xfer_t; the reply is the number of bytes moved, as for READ and
+// WRITE.
+#define MXIO_VMO_XFER_MAX (1024 * 1024)
+
+// A server that moves none of its files through VMOs answers READ_VMO and
+// WRITE_VMO with this, and the client goes back to READ and WRITE for the
+// rest of the connection. Any other error, ERR_NOT_SUPPORTED included, is
+// taken to apply to that one transfer, as are the ERR_NOT_SUPPORTED replies
+// of servers that predate these ops.
+#define ERR_MXRIO_NO_VMO_XFER (-9997)
+
+// Use |offset| rather than the connection's seek offset, as READ_AT and
+// WRITE_AT do. Otherwise the seek offset is advanced and returned in arg2.
+#define MXIO_VMO_XFER_FLAG_AT (1u << 0)
+
+typedef struct mxrio_vmo_xfer {
+    uint64_t length;                   // tx: bytes to move, <= MXIO_VMO_XFER_MAX
+    int64_t offset;                    // tx: file offset, if MXIO_VMO_XFER_FLAG_AT
+    uint32_t flags;                    // tx: MXIO_VMO_XFER_FLAG_*
+    uint32_t reserved;
+} mxrio_vmo_xfer_t;
+
 #define READDIR_CMD_NONE  0
 #define READDIR_CMD_RESET 1
 
@@ -167,6 +223,8 @@ static_assert(MXIO_CHUNK_SIZE >= PATH_MAX, "MXIO_CHUNK_SIZE must be large enough
 // SETATTR     0          0        <vnattr>          0           -               -
 // SYNC        0          0        0                 0           -               -
 // LINK        0          0        <name1>0<name2>0  0           -               -
+// READ_VMO    0          0        <vmo_xfer>        newoffset   -               -
+// WRITE_VMO   0          0        <vmo_xfer>        newoffset   -               -
 //
 // proposed:
 //
@@ -65,4 +65,14 @@ typedef struct vdirent {
     char name[0];
 } vdirent_t;
 
+// Entries returned by MXRIO_READDIR_ATTR. Sizes are rounded up to keep
+// attr 8-byte aligned. If the filesystem could not supply the attributes
+// of an entry, attr is zero except for the type bits of mode.
+typedef struct vdirent_attr {
+    uint32_t size;
+    uint32_t type;
+    vnattr_t attr;
+    char name[0];
+} vdirent_attr_t;
+
 __END_CDECLS
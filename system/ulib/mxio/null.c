@@ -76,7 +76,7 @@ ssize_t mxio_default_posix_ioctl(mxio_t* io, int req, va_list va) {
     return ERR_NOT_SUPPORTED;
 }
 
-mx_status_t mxio_default_get_vmo(mxio_t* io, mx_handle_t* out, size_t* off, size_t* len) {
+mx_status_t mxio_default_get_vmo(mxio_t* io, int flags, mx_handle_t* out, size_t* off, size_t* len) {
     return ERR_NOT_SUPPORTED;
 }
 
@@ -53,8 +53,15 @@ struct mxrio {
 
     // transaction id used for synchronous remoteio calls
     _Atomic mx_txid_t txid;
+
+    // set once the server has turned down MXRIO_READ_VMO or MXRIO_WRITE_VMO
+    atomic_bool no_vmo_xfer;
 };
 
+// Reads and writes of at least this much go through a VMO, up to
+// MXIO_VMO_XFER_MAX bytes per transaction, rather than MXIO_CHUNK_SIZE.
+#define MXIO_VMO_XFER_MIN (8 * MXIO_CHUNK_SIZE)
+
 static pthread_key_t rchannel_key;
 
 static void rchannel_cleanup(void* data) {
@@ -334,6 +341,56 @@ static ssize_t mxrio_ioctl(mxio_t* io, uint32_t op, const void* in_buf,
     return r;
 }
 
+// Sends a MXRIO_READ_VMO or MXRIO_WRITE_VMO moving |len| bytes through
+// a duplicate of |vmo|. |at| is whether |offset| is used, as for READ_AT.
+static mx_status_t vmo_xfer_txn(mxrio_t* rio, uint32_t op, mx_handle_t vmo, size_t len,
+                                bool at, off_t offset) {
+    mxrio_msg_t msg;
+    mx_status_t r;
+
+    memset(&msg, 0, MXRIO_HDR_SZ);
+    msg.op = op;
+    msg.datalen = sizeof(mxrio_vmo_xfer_t);
+    mxrio_vmo_xfer_t* xfer = (mxrio_vmo_xfer_t*)msg.data;
+    memset(xfer, 0, sizeof(*xfer));
+    xfer->length = len;
+    xfer->offset = offset;
+    xfer->flags = at ? MXIO_VMO_XFER_FLAG_AT : 0;
+    if ((r = mx_handle_duplicate(vmo, MX_RIGHT_SAME_RIGHTS, &msg.handle[0])) < 0) {
+        return r;
+    }
+    msg.hcount = 1;
+
+    if ((r = mxrio_txn(rio, &msg)) < 0) {
+        if (r == ERR_MXRIO_NO_VMO_XFER) {
+            atomic_store(&rio->no_vmo_xfer, true);
+        }
+        return r;
+    }
+    discard_handles(msg.handle, msg.hcount);
+    return (r > (mx_status_t)len) ? ERR_IO : r;
+}
+
+// Whether the next piece of a |len| byte transfer should use a VMO.
+static bool use_vmo_xfer(mxrio_t* rio, size_t len) {
+    return (len >= MXIO_VMO_XFER_MIN) && !atomic_load(&rio->no_vmo_xfer);
+}
+
+// Whether a transfer that moved |count| bytes so far should go on a
+// chunk at a time after the VMO transfer of its next piece failed with |r|.
+static bool vmo_xfer_fallback(mx_status_t r, ssize_t count) {
+    return (r == ERR_MXRIO_NO_VMO_XFER) || ((r == ERR_NOT_SUPPORTED) && (count == 0));
+}
+
+// Creates the VMO for a transfer on first use. The first piece of a
+// transfer is its largest, so that is the size it gets.
+static mx_status_t vmo_xfer_create(mx_handle_t* vmo, size_t len) {
+    if (*vmo != MX_HANDLE_INVALID) {
+        return NO_ERROR;
+    }
+    return mx_vmo_create(len, 0, vmo);
+}
+
 static ssize_t write_common(uint32_t op, mxio_t* io, const void* _data, size_t len, off_t offset) {
     mxrio_t* rio = (mxrio_t*)io;
     const uint8_t* data = _data;
@@ -341,25 +398,48 @@ static ssize_t write_common(uint32_t op, mxio_t* io, const void* _data, size_t l
     mx_status_t r = 0;
     mxrio_msg_t msg;
     ssize_t xfer;
+    mx_handle_t vmo = MX_HANDLE_INVALID;
+    bool chunked = false;
 
     while (len > 0) {
-        xfer = (len > MXIO_CHUNK_SIZE) ? MXIO_CHUNK_SIZE : len;
+        if (!chunked && use_vmo_xfer(rio, len)) {
+            xfer = (len > MXIO_VMO_XFER_MAX) ? MXIO_VMO_XFER_MAX : len;
+            size_t actual;
+            if ((r = vmo_xfer_create(&vmo, xfer)) < 0 ||
+                (r = mx_vmo_write(vmo, data, 0, xfer, &actual)) < 0) {
+                break;
+            }
+            if (actual != (size_t)xfer) {
+                r = ERR_IO;
+                break;
+            }
+            r = vmo_xfer_txn(rio, MXRIO_WRITE_VMO, vmo, xfer, op == MXRIO_WRITE_AT, offset);
+            if (vmo_xfer_fallback(r, count)) {
+                chunked = true;
+                continue;
+            }
+            if (r < 0) {
+                break;
+            }
+        } else {
+            xfer = (len > MXIO_CHUNK_SIZE) ? MXIO_CHUNK_SIZE : len;
 
-        memset(&msg, 0, MXRIO_HDR_SZ);
-        msg.op = op;
-        msg.datalen = xfer;
-        if (op == MXRIO_WRITE_AT)
-            msg.arg2.off = offset;
-        memcpy(msg.data, data, xfer);
+            memset(&msg, 0, MXRIO_HDR_SZ);
+            msg.op = op;
+            msg.datalen = xfer;
+            if (op == MXRIO_WRITE_AT)
+                msg.arg2.off = offset;
+            memcpy(msg.data, data, xfer);
 
-        if ((r = mxrio_txn(rio, &msg)) < 0) {
-            break;
-        }
-        discard_handles(msg.handle, msg.hcount);
+            if ((r = mxrio_txn(rio, &msg)) < 0) {
+                break;
+            }
+            discard_handles(msg.handle, msg.hcount);
 
-        if (r > xfer) {
-            r = ERR_IO;
-            break;
+            if (r > xfer) {
+                r = ERR_IO;
+                break;
+            }
         }
         count += r;
         data += r;
@@ -371,6 +451,9 @@ static ssize_t write_common(uint32_t op, mxio_t* io, const void* _data, size_t l
             break;
         }
     }
+    if (vmo != MX_HANDLE_INVALID) {
+        mx_handle_close(vmo);
+    }
     return count ? count : r;
 }
 
@@ -389,26 +472,50 @@ static ssize_t read_common(uint32_t op, mxio_t* io, void* _data, size_t len, off
     mx_status_t r = 0;
     mxrio_msg_t msg;
     ssize_t xfer;
+    mx_handle_t vmo = MX_HANDLE_INVALID;
+    bool chunked = false;
 
     while (len > 0) {
-        xfer = (len > MXIO_CHUNK_SIZE) ? MXIO_CHUNK_SIZE : len;
+        if (!chunked && use_vmo_xfer(rio, len)) {
+            xfer = (len > MXIO_VMO_XFER_MAX) ? MXIO_VMO_XFER_MAX : len;
+            if ((r = vmo_xfer_create(&vmo, xfer)) < 0) {
+                break;
+            }
+            r = vmo_xfer_txn(rio, MXRIO_READ_VMO, vmo, xfer, op == MXRIO_READ_AT, offset);
+            if (vmo_xfer_fallback(r, count)) {
+                chunked = true;
+                continue;
+            }
+            if (r < 0) {
+                break;
+            }
+            size_t actual;
+            mx_status_t status;
+            if ((status = mx_vmo_read(vmo, data, 0, r, &actual)) < 0 ||
+                (actual != (size_t)r)) {
+                r = (status < 0) ? status : ERR_IO;
+                break;
+            }
+        } else {
+            xfer = (len > MXIO_CHUNK_SIZE) ? MXIO_CHUNK_SIZE : len;
 
-        memset(&msg, 0, MXRIO_HDR_SZ);
-        msg.op = op;
-        msg.arg = xfer;
-        if (op == MXRIO_READ_AT)
-            msg.arg2.off = offset;
+            memset(&msg, 0, MXRIO_HDR_SZ);
+            msg.op = op;
+            msg.arg = xfer;
+            if (op == MXRIO_READ_AT)
+                msg.arg2.off = offset;
 
-        if ((r = mxrio_txn(rio, &msg)) < 0) {
-            break;
-        }
-        discard_handles(msg.handle, msg.hcount);
+            if ((r = mxrio_txn(rio, &msg)) < 0) {
+                break;
+            }
+            discard_handles(msg.handle, msg.hcount);
 
-        if ((r > (int)msg.datalen) || (r > xfer)) {
-            r = ERR_IO;
-            break;
+            if ((r > (int)msg.datalen) || (r > xfer)) {
+                r = ERR_IO;
+                break;
+            }
+            memcpy(data, msg.data, r);
         }
-        memcpy(data, msg.data, r);
         count += r;
         data += r;
         len -= r;
@@ -420,6 +527,9 @@ static ssize_t read_common(uint32_t op, mxio_t* io, void* _data, size_t len, off
             break;
         }
     }
+    if (vmo != MX_HANDLE_INVALID) {
+        mx_handle_close(vmo);
+    }
     return count ? count : r;
 }
 
@@ -473,8 +583,10 @@ static mx_status_t mxrio_close(mxio_t* io) {
     return r;
 }
 
-static mx_status_t mxrio_reply_channel_call(mxrio_t* rio, mxrio_msg_t* msg,
-                                            mxrio_object_t* info) {
+// Send msg along with a new reply channel, and wait for the reply to
+// arrive on it. On success, the caller reads and closes *out.
+static mx_status_t mxrio_reply_channel_send(mxrio_t* rio, mxrio_msg_t* msg,
+                                            mx_handle_t* out) {
     mx_status_t r;
     mx_handle_t h;
     if ((r = mx_channel_create(0, &h, &msg->handle[0])) < 0) {
@@ -492,6 +604,17 @@ static mx_status_t mxrio_reply_channel_call(mxrio_t* rio, mxrio_msg_t* msg,
 
     // Wait
     mx_object_wait_one(h, MX_CHANNEL_READABLE | MX_CHANNEL_PEER_CLOSED, MX_TIME_INFINITE, NULL);
+    *out = h;
+    return NO_ERROR;
+}
+
+static mx_status_t mxrio_reply_channel_call(mxrio_t* rio, mxrio_msg_t* msg,
+                                            mxrio_object_t* info) {
+    mx_status_t r;
+    mx_handle_t h;
+    if ((r = mxrio_reply_channel_send(rio, msg, &h)) < 0) {
+        return r;
+    }
 
     // Attempt to read the callback response
     memset(info, 0xfe, sizeof(*info));
@@ -549,6 +672,33 @@ static mx_status_t mxrio_misc(mxio_t* io, uint32_t op, int64_t off,
             discard_handles(info.handle, info.hcount);
             return r;
         }
+        case MXRIO_STAT_AT: {
+            mx_handle_t h;
+            if ((r = mxrio_reply_channel_send(rio, &msg, &h)) < 0) {
+                return r;
+            }
+            mxrio_stat_reply_t reply;
+            uint32_t dsize = sizeof(reply);
+            r = mx_channel_read(h, 0, &reply, dsize, &dsize, NULL, 0, NULL);
+            mx_handle_close(h);
+            if (r < 0) {
+                return r;
+            }
+            if (dsize < MXRIO_OBJECT_MINSIZE) {
+                return ERR_IO;
+            }
+            if (reply.status < 0) {
+                return reply.status;
+            }
+            dsize -= MXRIO_OBJECT_MINSIZE;
+            if (dsize > maxreply) {
+                return ERR_IO;
+            }
+            if (ptr && dsize > 0) {
+                memcpy(ptr, &reply.attr, dsize);
+            }
+            return dsize;
+        }
     }
 
     if ((r = mxrio_txn(rio, &msg)) < 0) {
@@ -701,6 +851,35 @@ static mx_status_t mxrio_unwrap(mxio_t* io, mx_handle_t* handles, uint32_t* type
     return r;
 }
 
+static mx_status_t mxrio_get_vmo(mxio_t* io, int flags, mx_handle_t* out, size_t* off, size_t* len) {
+    mxrio_t* rio = (mxrio_t*)io;
+    mxrio_msg_t msg;
+    mx_status_t r;
+
+    if ((out == NULL) || (off == NULL) || (len == NULL)) {
+        return ERR_INVALID_ARGS;
+    }
+
+    memset(&msg, 0, MXRIO_HDR_SZ);
+    msg.op = MXRIO_MMAP;
+    msg.datalen = sizeof(mxrio_mmap_data_t);
+    mxrio_mmap_data_t* data = (mxrio_mmap_data_t*)msg.data;
+    memset(data, 0, sizeof(*data));
+    data->flags = flags;
+
+    if ((r = mxrio_txn(rio, &msg)) < 0) {
+        return r;
+    }
+    if ((msg.hcount != 1) || (msg.datalen != sizeof(mxrio_mmap_data_t))) {
+        discard_handles(msg.handle, msg.hcount);
+        return ERR_IO;
+    }
+    *out = msg.handle[0];
+    *off = data->offset;
+    *len = data->length;
+    return NO_ERROR;
+}
+
 static void mxrio_wait_begin(mxio_t* io, uint32_t events, mx_handle_t* handle, mx_signals_t* _signals) {
     mxrio_t* rio = (void*)io;
     *handle = rio->h2;
@@ -729,7 +908,7 @@ static mxio_ops_t mx_remote_ops = {
     .wait_end = mxrio_wait_end,
     .unwrap = mxrio_unwrap,
     .posix_ioctl = mxio_default_posix_ioctl,
-    .get_vmo = mxio_default_get_vmo,
+    .get_vmo = mxrio_get_vmo,
 };
 
 mxio_t* mxio_remote_create(mx_handle_t h, mx_handle_t e) {
@@ -965,9 +1144,14 @@ static ssize_t mxsio_rx_dgram(mxio_t* io, void* buf, size_t buflen) {
     for (;;) {
         ssize_t r;
         mxrio_t* rio = (mxrio_t*)io;
-        // TODO: if mx_socket support dgram mode, we'll switch to it
-        if ((r = mx_channel_read(rio->h2, 0, buf, buflen, (uint32_t*)&n,
-                                 NULL, 0, NULL)) == NO_ERROR) {
+        if (io->flags & MXIO_FLAG_SOCKET_DGRAM) {
+            r = mx_socket_read(rio->h2, 0, buf, buflen, &n);
+        } else {
+            uint32_t actual = 0;
+            r = mx_channel_read(rio->h2, 0, buf, buflen, &actual, NULL, 0, NULL);
+            n = actual;
+        }
+        if (r == NO_ERROR) {
             return n;
         }
         if (r == ERR_REMOTE_CLOSED) {
@@ -998,9 +1182,32 @@ static ssize_t mxsio_rx_dgram(mxio_t* io, void* buf, size_t buflen) {
 
 static ssize_t mxsio_tx_dgram(mxio_t* io, const void* buf, size_t buflen) {
     mxrio_t* rio = (mxrio_t*)io;
-    // TODO: mx_channel_write never returns ERR_SHOULD_WAIT, which is a problem.
-    // if mx_socket supports dgram mode, we'll switch to it.
-    return mx_channel_write(rio->h2, 0, buf, buflen, NULL, 0);
+    if (!(io->flags & MXIO_FLAG_SOCKET_DGRAM)) {
+        // TODO: mx_channel_write never returns ERR_SHOULD_WAIT, which is a
+        // problem for servers that still hand out a channel.
+        return mx_channel_write(rio->h2, 0, buf, buflen, NULL, 0);
+    }
+    for (;;) {
+        mx_status_t r = mx_socket_write(rio->h2, 0, buf, buflen, NULL);
+        if (r != ERR_SHOULD_WAIT || (io->flags & MXIO_FLAG_NONBLOCK)) {
+            return r;
+        }
+        mx_signals_t pending;
+        r = mx_object_wait_one(rio->h2,
+                               MX_SOCKET_WRITABLE | MX_SOCKET_PEER_CLOSED,
+                               MX_TIME_INFINITE, &pending);
+        if (r < 0) {
+            return r;
+        }
+        if (pending & MX_SOCKET_WRITABLE) {
+            continue;
+        }
+        if (pending & MX_SOCKET_PEER_CLOSED) {
+            return ERR_REMOTE_CLOSED;
+        }
+        // impossible
+        return ERR_INTERNAL;
+    }
 }
 
 static ssize_t mxsio_recvmsg_dgram(mxio_t* io, struct msghdr* msg, int flags);
@@ -1219,6 +1426,15 @@ void mxio_socket_set_stream_ops(mxio_t* io) {
 void mxio_socket_set_dgram_ops(mxio_t* io) {
     mxrio_t* rio = (mxrio_t*)io;
     rio->io.ops = &mxio_socket_dgram_ops;
+
+    // Servers may hand us a datagram socket, which keeps message boundaries
+    // itself, or a channel.
+    mx_info_handle_basic_t info;
+    if (mx_object_get_info(rio->h2, MX_INFO_HANDLE_BASIC, &info, sizeof(info),
+                           NULL, NULL) == NO_ERROR &&
+        info.type == MX_OBJ_TYPE_SOCKET) {
+        rio->io.flags |= MXIO_FLAG_SOCKET_DGRAM;
+    }
 }
 
 mx_status_t mxio_socket_shutdown(mxio_t* io, int how) {
@@ -14,6 +14,7 @@
 #include <string.h>
 #include <sys/epoll.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/select.h>
 #include <sys/stat.h>
 #include <sys/uio.h>
@@ -21,6 +22,7 @@
 #include <threads.h>
 #include <unistd.h>
 
+#include <magenta/process.h>
 #include <magenta/processargs.h>
 #include <magenta/syscalls.h>
 
@@ -502,11 +504,92 @@ mx_status_t mxio_get_vmo(int fd, mx_handle_t* vmo, size_t* off, size_t* len) {
     if ((io = fd_to_io(fd)) == NULL) {
         return ERR_BAD_HANDLE;
     }
-    mx_status_t r = io->ops->get_vmo(io, vmo, off, len);
+    mx_status_t r = io->ops->get_vmo(io, MXIO_MMAP_FLAG_READ, vmo, off, len);
     mxio_release(io);
     return r;
 }
 
+// Map a private copy of [vmo_off, vmo_off + len) of vmo, for mappings the
+// file's own VMO cannot back: private writable ones, or ones whose offset
+// within the VMO is not page aligned.
+static mx_status_t mmap_file_copy(size_t offset, size_t len, uint32_t mx_flags,
+                                  mx_handle_t vmo, uint64_t vmo_off, uint64_t vmo_end,
+                                  uintptr_t* out) {
+    mx_handle_t copy;
+    mx_status_t r;
+    if ((r = mx_vmo_create(len, 0, &copy)) < 0) {
+        return r;
+    }
+    uint32_t fill_flags = (mx_flags & MX_VM_FLAG_SPECIFIC) |
+                          MX_VM_FLAG_PERM_READ | MX_VM_FLAG_PERM_WRITE;
+    uintptr_t ptr;
+    r = mx_vmar_map(mx_vmar_root_self(), offset, copy, 0, len, fill_flags, &ptr);
+    mx_handle_close(copy);
+    if (r < 0) {
+        return r;
+    }
+    // Read straight into the new mapping; anything past the end of the
+    // file stays zero.
+    if (vmo_off < vmo_end) {
+        size_t n = (vmo_end - vmo_off < len) ? vmo_end - vmo_off : len;
+        size_t actual;
+        if ((r = mx_vmo_read(vmo, (void*)ptr, vmo_off, n, &actual)) < 0) {
+            goto fail;
+        }
+    }
+    uint32_t prot = mx_flags & (MX_VM_FLAG_PERM_READ | MX_VM_FLAG_PERM_WRITE |
+                                MX_VM_FLAG_PERM_EXECUTE);
+    if ((prot != (MX_VM_FLAG_PERM_READ | MX_VM_FLAG_PERM_WRITE)) &&
+        ((r = mx_vmar_protect(mx_vmar_root_self(), ptr, len, prot)) < 0)) {
+        goto fail;
+    }
+    *out = ptr;
+    return NO_ERROR;
+fail:
+    mx_vmar_unmap(mx_vmar_root_self(), ptr, len);
+    return r;
+}
+
+// Called by mmap() in libc for mappings of files.
+mx_status_t _mmap_file(size_t offset, size_t len, uint32_t mx_flags, int flags,
+                       int fd, off_t fd_off, uintptr_t* out) {
+    mxio_t* io;
+    if ((io = fd_to_io(fd)) == NULL) {
+        return ERR_BAD_HANDLE;
+    }
+
+    // A private mapping that may be written must not change the file, so
+    // it is always backed by a copy; only a shared one needs a writable VMO.
+    bool private_write = (flags & MAP_PRIVATE) && (mx_flags & MX_VM_FLAG_PERM_WRITE);
+    int vflags = MXIO_MMAP_FLAG_READ;
+    vflags |= (mx_flags & MX_VM_FLAG_PERM_EXECUTE) ? MXIO_MMAP_FLAG_EXEC : 0;
+    vflags |= ((flags & MAP_SHARED) && (mx_flags & MX_VM_FLAG_PERM_WRITE)) ?
+              MXIO_MMAP_FLAG_WRITE : 0;
+
+    mx_handle_t vmo;
+    size_t vmo_off;
+    size_t vmo_len;
+    mx_status_t r = io->ops->get_vmo(io, vflags, &vmo, &vmo_off, &vmo_len);
+    mxio_release(io);
+    if (r < 0) {
+        return r;
+    }
+
+    uint64_t start = vmo_off + fd_off;
+    if (private_write || (start & (PAGE_SIZE - 1))) {
+        if (flags & MAP_SHARED) {
+            // Stores could never reach the file.
+            r = ERR_NOT_SUPPORTED;
+        } else {
+            r = mmap_file_copy(offset, len, mx_flags, vmo, start, vmo_off + vmo_len, out);
+        }
+    } else {
+        r = mx_vmar_map(mx_vmar_root_self(), offset, vmo, start, len, mx_flags, out);
+    }
+    mx_handle_close(vmo);
+    return r;
+}
+
 mx_status_t mxio_wait_fd(int fd, uint32_t events, uint32_t* _pending, mx_time_t timeout) {
     mx_status_t r = NO_ERROR;
     mxio_t* io;
@@ -538,27 +621,90 @@ mx_status_t mxio_wait_fd(int fd, uint32_t events, uint32_t* _pending, mx_time_t
     return r;
 }
 
-int mxio_stat(mxio_t* io, struct stat* s) {
-    vnattr_t attr;
-    int r = io->ops->misc(io, MXRIO_STAT, 0, sizeof(attr), &attr, 0);
+static void vnattr_to_stat(const vnattr_t* attr, struct stat* s) {
+    memset(s, 0, sizeof(struct stat));
+    s->st_mode = attr->mode;
+    s->st_ino = attr->inode;
+    s->st_size = attr->size;
+    s->st_nlink = attr->nlink;
+    s->st_ctim.tv_sec = attr->create_time / MX_SEC(1);
+    s->st_ctim.tv_nsec = attr->create_time % MX_SEC(1);
+    s->st_mtim.tv_sec = attr->modify_time / MX_SEC(1);
+    s->st_mtim.tv_nsec = attr->modify_time % MX_SEC(1);
+}
+
+static mx_status_t mxio_getattr(mxio_t* io, vnattr_t* attr) {
+    int r = io->ops->misc(io, MXRIO_STAT, 0, sizeof(*attr), attr, 0);
     if (r < 0) {
         return ERR_BAD_HANDLE;
     }
-    if (r < (int)sizeof(attr)) {
+    if (r < (int)sizeof(*attr)) {
         return ERR_IO;
     }
-    memset(s, 0, sizeof(struct stat));
-    s->st_mode = attr.mode;
-    s->st_ino = attr.inode;
-    s->st_size = attr.size;
-    s->st_nlink = attr.nlink;
-    s->st_ctim.tv_sec = attr.create_time / MX_SEC(1);
-    s->st_ctim.tv_nsec = attr.create_time % MX_SEC(1);
-    s->st_mtim.tv_sec = attr.modify_time / MX_SEC(1);
-    s->st_mtim.tv_nsec = attr.modify_time % MX_SEC(1);
+    return NO_ERROR;
+}
+
+int mxio_stat(mxio_t* io, struct stat* s) {
+    vnattr_t attr;
+    mx_status_t r = mxio_getattr(io, &attr);
+    if (r < 0) {
+        return r;
+    }
+    vnattr_to_stat(&attr, s);
     return 0;
 }
 
+// Fetch the attributes of path, relative to dirfd.
+static mx_status_t mxio_getattr_at(int dirfd, const char* path, vnattr_t* attr) {
+    if ((path == NULL) || (path[0] == 0)) {
+        return ERR_INVALID_ARGS;
+    }
+
+    // Ask for the attributes by path: one round trip, where opening the
+    // file, asking it and closing it again takes three.
+    const char* name = path;
+    mxio_t* iodir = mxio_iodir(&name, dirfd);
+    if (iodir == NULL) {
+        return ERR_BAD_HANDLE;
+    }
+    // The path goes out and the attributes come back in the same buffer,
+    // which must not be the caller's path.
+    union {
+        char path[PATH_MAX];
+        vnattr_t attr;
+    } buf;
+    size_t len = strlen(name);
+    if (len >= sizeof(buf.path)) {
+        mxio_release(iodir);
+        return ERR_BAD_PATH;
+    }
+    memcpy(buf.path, name, len);
+    mx_status_t r = iodir->ops->misc(iodir, MXRIO_STAT_AT, 0, sizeof(buf.attr),
+                                     buf.path, len);
+    mxio_release(iodir);
+    if (r >= 0) {
+        if (r < (int)sizeof(buf.attr)) {
+            return ERR_IO;
+        }
+        *attr = buf.attr;
+        return NO_ERROR;
+    }
+    if ((r != ERR_NOT_SUPPORTED) && (r != ERR_REMOTE_CLOSED)) {
+        return r;
+    }
+
+    // Devices, and servers that do not know the operation, have to be
+    // opened.
+    mxio_t* io;
+    if ((r = __mxio_open_at(&io, dirfd, path, 0, 0)) < 0) {
+        return r;
+    }
+    r = mxio_getattr(io, attr);
+    mxio_close(io);
+    mxio_release(io);
+    return r;
+}
+
 
 mx_status_t mxio_setattr(mxio_t* io, vnattr_t* vn){
     mx_status_t r = io->ops->misc(io, MXRIO_SETATTR, 0, 0, vn, sizeof(*vn));
@@ -934,12 +1080,12 @@ off_t lseek(int fd, off_t offset, int whence) {
     return r;
 }
 
-static int getdirents(int fd, void* ptr, size_t len, long cmd) {
+static mx_status_t getdirents(int fd, uint32_t op, void* ptr, size_t len, long cmd) {
     mxio_t* io = fd_to_io(fd);
     if (io == NULL) {
-        return ERRNO(EBADF);
+        return ERR_BAD_HANDLE;
     }
-    int r = STATUS(io->ops->misc(io, MXRIO_READDIR, cmd, len, ptr, 0));
+    mx_status_t r = io->ops->misc(io, op, cmd, len, ptr, 0);
     mxio_release(io);
     return r;
 }
@@ -1109,16 +1255,13 @@ int fstat(int fd, struct stat* s) {
 }
 
 int fstatat(int dirfd, const char* fn, struct stat* s, int flags) {
-    mxio_t* io;
-    mx_status_t r;
-
-    if ((r = __mxio_open_at(&io, dirfd, fn, 0, 0)) < 0) {
+    vnattr_t attr;
+    mx_status_t r = mxio_getattr_at(dirfd, fn, &attr);
+    if (r < 0) {
         return ERROR(r);
     }
-    r = mxio_stat(io, s);
-    mxio_close(io);
-    mxio_release(io);
-    return STATUS(r);
+    vnattr_to_stat(&attr, s);
+    return 0;
 }
 
 int stat(const char* fn, struct stat* s) {
@@ -1292,8 +1435,12 @@ struct __dirstream {
     // Offset into 'data' of next ptr. NULL to reset the
     // directory lazily on the next call to getdirents
     uint8_t* ptr;
+    // 'data' holds vdirent_attr_t rather than vdirent_t entries
+    bool attrs;
+    // The server does not support MXRIO_READDIR_ATTR
+    bool no_attrs;
     // Internal cache of dirents
-    uint8_t data[DIR_BUFSIZE];
+    uint8_t data[DIR_BUFSIZE] __ALIGNED(8);
     // Buffer returned to user
     struct dirent de;
 };
@@ -1339,18 +1486,33 @@ int closedir(DIR* dir) {
     return 0;
 }
 
-struct dirent* readdir(DIR* dir) {
-    mtx_lock(&dir->lock);
+// Return the next entry of dir. If attr is not NULL, also return the
+// attributes of the entry, fetching them along with the names when the
+// server supports it.
+static struct dirent* readdir_locked(DIR* dir, vnattr_t* attr) {
     struct dirent* de = &dir->de;
     for (;;) {
         if (dir->size >= sizeof(vdirent_t)) {
             vdirent_t* vde = (void*)dir->ptr;
             if (dir->size >= vde->size) {
+                const char* name = vde->name;
+                if (dir->attrs) {
+                    vdirent_attr_t* vda = (void*)dir->ptr;
+                    name = vda->name;
+                    if (attr != NULL) {
+                        *attr = vda->attr;
+                    }
+                } else if (attr != NULL) {
+                    if (mxio_getattr_at(dir->fd, name, attr) < 0) {
+                        memset(attr, 0, sizeof(*attr));
+                        attr->mode = DTYPE_TO_VTYPE(vde->type);
+                    }
+                }
                 de->d_ino = 0;
                 de->d_off = 0;
                 de->d_reclen = 0;
                 de->d_type = vde->type;
-                strcpy(de->d_name, vde->name);
+                strcpy(de->d_name, name);
                 dir->ptr += vde->size;
                 dir->size -= vde->size;
                 break;
@@ -1358,15 +1520,42 @@ struct dirent* readdir(DIR* dir) {
             dir->size = 0;
         }
         int64_t cmd = (dir->ptr == NULL) ? READDIR_CMD_RESET : READDIR_CMD_NONE;
-        int r = getdirents(dir->fd, dir->data, DIR_BUFSIZE, cmd);
+        mx_status_t r = ERR_NOT_SUPPORTED;
+        if ((attr != NULL) && !dir->no_attrs) {
+            r = getdirents(dir->fd, MXRIO_READDIR_ATTR, dir->data, DIR_BUFSIZE, cmd);
+            dir->attrs = true;
+            if (r == ERR_NOT_SUPPORTED) {
+                dir->no_attrs = true;
+            }
+        }
+        if (r == ERR_NOT_SUPPORTED) {
+            r = getdirents(dir->fd, MXRIO_READDIR, dir->data, DIR_BUFSIZE, cmd);
+            dir->attrs = false;
+        }
         if (r > 0) {
             dir->ptr = dir->data;
             dir->size = r;
             continue;
         }
+        if (r < 0) {
+            errno = mxio_status_to_errno(r);
+        }
         de = NULL;
         break;
     }
+    return de;
+}
+
+struct dirent* readdir(DIR* dir) {
+    mtx_lock(&dir->lock);
+    struct dirent* de = readdir_locked(dir, NULL);
+    mtx_unlock(&dir->lock);
+    return de;
+}
+
+struct dirent* mxio_readdir_attr(DIR* dir, vnattr_t* attr) {
+    mtx_lock(&dir->lock);
+    struct dirent* de = readdir_locked(dir, attr);
     mtx_unlock(&dir->lock);
     return de;
 }
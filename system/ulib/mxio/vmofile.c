@@ -135,12 +135,15 @@ static mx_status_t vmofile_misc(mxio_t* io, uint32_t op, int64_t off, uint32_t m
     }
 }
 
-mx_status_t vmofile_get_vmo(mxio_t* io, mx_handle_t* out, size_t* off, size_t* len) {
+mx_status_t vmofile_get_vmo(mxio_t* io, int flags, mx_handle_t* out, size_t* off, size_t* len) {
     vmofile_t* vf = (vmofile_t*)io;
 
     if ((out == NULL) || (off == NULL) || (len == NULL)) {
         return ERR_INVALID_ARGS;
     }
+    if (flags & MXIO_MMAP_FLAG_WRITE) {
+        return ERR_ACCESS_DENIED;
+    }
 
     *off = vf->off;
     *len = vf->end - vf->off;
@@ -0,0 +1,78 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <magenta/compiler.h>
+#include <magenta/types.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+__BEGIN_CDECLS;
+
+// A single producer, single consumer message ring in a VMO mapped by both
+// peers. Messages are copied straight into and out of the shared memory, so
+// the kernel is only entered to wake up a peer: the producer signals a
+// consumer which found the ring empty once it is non-empty, and the consumer
+// signals a producer which found the ring full once there is room again.
+//
+// The wakeups are user signals on a pair of eventpair handles, so a peer
+// can block in shm_ring_wait() or have them delivered to a port with
+// mx_object_wait_async() on |event|.
+//
+// Neither side trusts the other: a peer which scribbles over the ring can
+// only make reads fail with ERR_IO_DATA_INTEGRITY.
+
+// Asserted on the consumer's event when there may be messages to read.
+#define SHM_RING_SIGNAL_READABLE MX_USER_SIGNAL_0
+// Asserted on the producer's event when there may be room to write.
+#define SHM_RING_SIGNAL_WRITABLE MX_USER_SIGNAL_1
+
+typedef struct shm_ring_ctl shm_ring_ctl_t;
+
+typedef struct shm_ring {
+    mx_handle_t vmo;
+    mx_handle_t event;
+    shm_ring_ctl_t* ctl;
+    uint8_t* data;
+    // Bytes of message space, a power of two.
+    size_t size;
+} shm_ring_t;
+
+// Creates a ring with at least |size| bytes of message space, which is
+// rounded up to a power of two pages. |producer| and |consumer| are each
+// given a VMO handle and an eventpair handle, in that order, to pass to
+// shm_ring_init() in the two peers.
+mx_status_t shm_ring_create(size_t size, mx_handle_t producer[2], mx_handle_t consumer[2]);
+
+// Maps the ring. Takes ownership of |handles| whether or not it succeeds.
+mx_status_t shm_ring_init(shm_ring_t* ring, mx_handle_t handles[2]);
+
+// Unmaps the ring and closes its handles, which the peer sees as
+// ERR_REMOTE_CLOSED once it has drained what was written.
+void shm_ring_close(shm_ring_t* ring);
+
+// Largest message |ring| can carry.
+size_t shm_ring_max_message(const shm_ring_t* ring);
+
+// Producer side. Copies a message of |len| bytes into the ring. Returns
+// ERR_SHOULD_WAIT if there is not room for it yet and ERR_OUT_OF_RANGE if it
+// would never fit. ERR_REMOTE_CLOSED means the consumer was found to have
+// gone away, which is only checked when it would be woken or the ring is
+// full.
+mx_status_t shm_ring_write(shm_ring_t* ring, const void* data, size_t len);
+
+// Consumer side. Copies the next message into |data| and sets |*actual| to
+// its length. Returns ERR_SHOULD_WAIT if the ring is empty, or
+// ERR_REMOTE_CLOSED if it is empty and the producer has gone away. If the
+// message is larger than |len|, returns ERR_BUFFER_TOO_SMALL with its length
+// in |*actual| and leaves it in the ring.
+mx_status_t shm_ring_read(shm_ring_t* ring, void* data, size_t len, size_t* actual);
+
+// Waits for the signal a shm_ring_write() or shm_ring_read() which returned
+// ERR_SHOULD_WAIT is waiting for, or for the peer to go away.
+mx_status_t shm_ring_wait(shm_ring_t* ring, mx_time_t timeout);
+
+__END_CDECLS;
@@ -0,0 +1,206 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <shm-ring/ring.h>
+
+#include <limits.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#include <magenta/process.h>
+#include <magenta/syscalls.h>
+
+// The VMO holds this control page followed by the message space. |head| and
+// |tail| count bytes written and read since creation; each is only written
+// by one side and sits on a cache line of its own.
+struct shm_ring_ctl {
+    _Alignas(64) atomic_uint_fast64_t head;
+    _Alignas(64) atomic_uint_fast64_t tail;
+    // Set by a consumer which found the ring empty and a producer which
+    // found it full, for the other side to wake them.
+    _Alignas(64) atomic_int consumer_waiting;
+    _Alignas(64) atomic_int producer_waiting;
+};
+
+// Each message is preceded by a header and padded out to the next header.
+typedef struct {
+    uint32_t len;
+    uint32_t reserved;
+} msg_header_t;
+
+// A header with this length fills the rest of the ring, when a message is
+// too big for the space before the end.
+#define PAD_LEN UINT32_MAX
+
+static_assert(sizeof(struct shm_ring_ctl) <= PAGE_SIZE, "");
+
+static size_t msg_space(size_t len) {
+    return sizeof(msg_header_t) + ((len + sizeof(msg_header_t) - 1) & ~(sizeof(msg_header_t) - 1));
+}
+
+mx_status_t shm_ring_create(size_t size, mx_handle_t producer[2], mx_handle_t consumer[2]) {
+    if (size == 0 || size > (1ul << 31))
+        return ERR_INVALID_ARGS;
+    size_t ring_size = PAGE_SIZE;
+    while (ring_size < size)
+        ring_size <<= 1;
+
+    mx_handle_t vmo[2];
+    mx_handle_t event[2];
+    mx_status_t status = mx_vmo_create(PAGE_SIZE + ring_size, 0, &vmo[0]);
+    if (status != NO_ERROR)
+        return status;
+    if ((status = mx_handle_duplicate(vmo[0], MX_RIGHT_SAME_RIGHTS, &vmo[1])) != NO_ERROR) {
+        mx_handle_close(vmo[0]);
+        return status;
+    }
+    if ((status = mx_eventpair_create(0, &event[0], &event[1])) != NO_ERROR) {
+        mx_handle_close(vmo[0]);
+        mx_handle_close(vmo[1]);
+        return status;
+    }
+    producer[0] = vmo[0];
+    producer[1] = event[0];
+    consumer[0] = vmo[1];
+    consumer[1] = event[1];
+    return NO_ERROR;
+}
+
+mx_status_t shm_ring_init(shm_ring_t* ring, mx_handle_t handles[2]) {
+    memset(ring, 0, sizeof(*ring));
+    ring->vmo = handles[0];
+    ring->event = handles[1];
+
+    // The size comes from the VMO rather than anything the peer wrote.
+    uint64_t vmo_size;
+    mx_status_t status = mx_vmo_get_size(ring->vmo, &vmo_size);
+    if (status != NO_ERROR)
+        goto fail;
+    uint64_t size = vmo_size - PAGE_SIZE;
+    if (vmo_size <= PAGE_SIZE || (size & (size - 1)) != 0 || size > (1ul << 31)) {
+        status = ERR_INVALID_ARGS;
+        goto fail;
+    }
+
+    uintptr_t addr;
+    status = mx_vmar_map(mx_vmar_root_self(), 0, ring->vmo, 0, vmo_size,
+                         MX_VM_FLAG_PERM_READ | MX_VM_FLAG_PERM_WRITE, &addr);
+    if (status != NO_ERROR)
+        goto fail;
+    ring->ctl = (shm_ring_ctl_t*)addr;
+    ring->data = (uint8_t*)addr + PAGE_SIZE;
+    ring->size = size;
+    return NO_ERROR;
+
+fail:
+    mx_handle_close(ring->vmo);
+    mx_handle_close(ring->event);
+    ring->vmo = MX_HANDLE_INVALID;
+    ring->event = MX_HANDLE_INVALID;
+    return status;
+}
+
+void shm_ring_close(shm_ring_t* ring) {
+    if (ring->ctl != NULL)
+        mx_vmar_unmap(mx_vmar_root_self(), (uintptr_t)ring->ctl, PAGE_SIZE + ring->size);
+    mx_handle_close(ring->vmo);
+    mx_handle_close(ring->event);
+    memset(ring, 0, sizeof(*ring));
+}
+
+size_t shm_ring_max_message(const shm_ring_t* ring) {
+    // Half the ring, so a message always fits once the ring drains, however
+    // the space is split around the end.
+    return ring->size / 2 - sizeof(msg_header_t);
+}
+
+static mx_status_t peer_closed(shm_ring_t* ring) {
+    mx_signals_t pending = 0;
+    mx_object_wait_one(ring->event, MX_EPAIR_PEER_CLOSED, 0, &pending);
+    return (pending & MX_EPAIR_PEER_CLOSED) ? ERR_REMOTE_CLOSED : ERR_SHOULD_WAIT;
+}
+
+mx_status_t shm_ring_write(shm_ring_t* ring, const void* data, size_t len) {
+    if (len > shm_ring_max_message(ring))
+        return ERR_OUT_OF_RANGE;
+
+    struct shm_ring_ctl* ctl = ring->ctl;
+    const size_t need = msg_space(len);
+    const uint64_t head = atomic_load_explicit(&ctl->head, memory_order_relaxed);
+    const size_t offset = head & (ring->size - 1);
+    const size_t contig = ring->size - offset;
+    const size_t total = (contig < need) ? contig + need : need;
+
+    uint64_t tail = atomic_load_explicit(&ctl->tail, memory_order_acquire);
+    if (head + total - tail > ring->size) {
+        // Ask to be woken before looking again, so the consumer either sees
+        // the request or we see the room it made.
+        mx_object_signal(ring->event, SHM_RING_SIGNAL_WRITABLE, 0);
+        atomic_store(&ctl->producer_waiting, 1);
+        tail = atomic_load(&ctl->tail);
+        if (head + total - tail > ring->size)
+            return peer_closed(ring);
+    }
+
+    uint8_t* p = ring->data + offset;
+    if (contig < need) {
+        ((msg_header_t*)p)->len = PAD_LEN;
+        p = ring->data;
+    }
+    ((msg_header_t*)p)->len = (uint32_t)len;
+    memcpy(p + sizeof(msg_header_t), data, len);
+
+    atomic_store(&ctl->head, head + total);
+    if (atomic_exchange(&ctl->consumer_waiting, 0)) {
+        mx_status_t status = mx_object_signal_peer(ring->event, 0, SHM_RING_SIGNAL_READABLE);
+        if (status != NO_ERROR)
+            return status;
+    }
+    return NO_ERROR;
+}
+
+mx_status_t shm_ring_read(shm_ring_t* ring, void* data, size_t len, size_t* actual) {
+    struct shm_ring_ctl* ctl = ring->ctl;
+    uint64_t tail = atomic_load_explicit(&ctl->tail, memory_order_relaxed);
+    uint64_t head = atomic_load_explicit(&ctl->head, memory_order_acquire);
+
+    if (head == tail) {
+        mx_object_signal(ring->event, SHM_RING_SIGNAL_READABLE, 0);
+        atomic_store(&ctl->consumer_waiting, 1);
+        head = atomic_load(&ctl->head);
+        if (head == tail)
+            return peer_closed(ring);
+    }
+
+    size_t offset = tail & (ring->size - 1);
+    uint32_t msg_len = ((volatile msg_header_t*)(ring->data + offset))->len;
+    if (msg_len == PAD_LEN) {
+        tail += ring->size - offset;
+        offset = 0;
+        msg_len = ((volatile msg_header_t*)ring->data)->len;
+    }
+
+    const size_t need = msg_space(msg_len);
+    if (msg_len > shm_ring_max_message(ring) || head - tail > ring->size ||
+        need > head - tail || offset + need > ring->size)
+        return ERR_IO_DATA_INTEGRITY;
+
+    *actual = msg_len;
+    if (msg_len > len)
+        return ERR_BUFFER_TOO_SMALL;
+    memcpy(data, ring->data + offset + sizeof(msg_header_t), msg_len);
+
+    atomic_store(&ctl->tail, tail + need);
+    if (atomic_exchange(&ctl->producer_waiting, 0))
+        mx_object_signal_peer(ring->event, 0, SHM_RING_SIGNAL_WRITABLE);
+    return NO_ERROR;
+}
+
+mx_status_t shm_ring_wait(shm_ring_t* ring, mx_time_t timeout) {
+    mx_signals_t pending;
+    return mx_object_wait_one(ring->event,
+                              SHM_RING_SIGNAL_READABLE | SHM_RING_SIGNAL_WRITABLE |
+                                  MX_EPAIR_PEER_CLOSED,
+                              timeout, &pending);
+}
@@ -0,0 +1,301 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <bootdata/decompress.h>
+#include <lz4/lz4.h>
+#include <magenta/boot/bootdata.h>
+#include <magenta/process.h>
+#include <magenta/syscalls.h>
+#include <unittest/unittest.h>
+
+#include "lz4-frame.h"
+
+// Two full blocks and a short one.  Block 0 and 2 are LZ4 compressed,
+// block 1 is stored, so both decoders in lazy.c are exercised.
+#define CONTENT_SIZE (2 * MX_LZ4_BLOCK_SIZE + 5000)
+#define NBLOCKS 3
+#define STORED_BLOCK 1
+
+// The single file starts on the page after the directory.
+#define FILE_OFF 4096
+#define FILE_LEN (CONTENT_SIZE - FILE_OFF)
+
+// Damage to apply to the image once it has been laid out.
+#define CORRUPT_NONE      0
+#define CORRUPT_MAGIC     1
+#define CORRUPT_BLOCK     2
+#define CORRUPT_STORED    3
+#define CORRUPT_TRUNCATE  4
+#define CORRUPT_FLAGS     5
+
+static uint8_t content_byte(size_t off) {
+    // Never zero, so unpopulated ranges are easy to tell apart.
+    return (uint8_t)(off % 251 + 1);
+}
+
+static void fill_content(uint8_t* content) {
+    for (size_t i = 0; i < CONTENT_SIZE; i++) {
+        content[i] = content_byte(i);
+    }
+
+    // A bootfs directory with one entry, followed by the end marker.
+    memset(content, 0, FILE_OFF);
+    uint32_t header[3] = { 5, FILE_LEN, FILE_OFF };
+    memcpy(content, header, sizeof(header));
+    memcpy(content + sizeof(header), "file", 5);
+}
+
+// Build a compressed bootfs item the way mkbootfs lays it out and return
+// it in a new VMO.
+static mx_status_t make_image(int corrupt, mx_handle_t* vmo_out, size_t* len_out) {
+    uint8_t* content = malloc(CONTENT_SIZE);
+    size_t cap = sizeof(bootdata_t) + sizeof(uint32_t) + sizeof(lz4_frame_desc) +
+                 NBLOCKS * (sizeof(uint32_t) + LZ4_compressBound(MX_LZ4_BLOCK_SIZE)) +
+                 sizeof(uint32_t);
+    uint8_t* image = calloc(1, cap);
+    if ((content == NULL) || (image == NULL)) {
+        free(content);
+        free(image);
+        return ERR_NO_MEMORY;
+    }
+    fill_content(content);
+
+    bootdata_t* hdr = (bootdata_t*)image;
+    hdr->type = BOOTDATA_BOOTFS_BOOT;
+    hdr->extra = sizeof(bootdata_t) + CONTENT_SIZE;
+    hdr->flags = BOOTDATA_BOOTFS_FLAG_COMPRESSED;
+    size_t off = sizeof(bootdata_t);
+
+    uint32_t magic = MX_LZ4_MAGIC;
+    memcpy(image + off, &magic, sizeof(magic));
+    off += sizeof(magic);
+
+    lz4_frame_desc fd = {
+        .flag = MX_LZ4_FLAG_VERSION | MX_LZ4_FLAG_BLOCK_DEP | MX_LZ4_FLAG_CONTENT_SZ,
+        .block_desc = MX_LZ4_BLOCK_64KB,
+        .content_size = CONTENT_SIZE,
+    };
+    memcpy(image + off, &fd, sizeof(fd));
+    off += sizeof(fd);
+
+    for (size_t n = 0; n < NBLOCKS; n++) {
+        size_t src_off = n * MX_LZ4_BLOCK_SIZE;
+        size_t src_len = CONTENT_SIZE - src_off;
+        if (src_len > MX_LZ4_BLOCK_SIZE) {
+            src_len = MX_LZ4_BLOCK_SIZE;
+        }
+        uint8_t* size_ptr = image + off;
+        off += sizeof(uint32_t);
+
+        uint32_t blocksize;
+        if (n == STORED_BLOCK) {
+            if (corrupt == CORRUPT_STORED) {
+                // Consistent with the frame, but short of a full block.
+                src_len -= 1;
+            }
+            memcpy(image + off, content + src_off, src_len);
+            blocksize = src_len | MX_LZ4_BLOCK_UNCOMPRESSED;
+            off += src_len;
+        } else {
+            int r = LZ4_compress_default((const char*)content + src_off, (char*)image + off,
+                                         src_len, cap - off);
+            if (r <= 0) {
+                free(content);
+                free(image);
+                return ERR_INTERNAL;
+            }
+            blocksize = r;
+            if (corrupt == CORRUPT_BLOCK) {
+                // A literal run longer than the block itself.
+                memset(image + off, 0xff, r);
+            }
+            off += r;
+        }
+        memcpy(size_ptr, &blocksize, sizeof(blocksize));
+    }
+    uint32_t end_mark = 0;
+    memcpy(image + off, &end_mark, sizeof(end_mark));
+    off += sizeof(end_mark);
+    hdr->length = off - sizeof(bootdata_t);
+
+    switch (corrupt) {
+    case CORRUPT_MAGIC:
+        image[sizeof(bootdata_t)] ^= 0xff;
+        break;
+    case CORRUPT_TRUNCATE:
+        off -= sizeof(end_mark) + 100;
+        break;
+    case CORRUPT_FLAGS:
+        hdr->flags &= ~BOOTDATA_BOOTFS_FLAG_COMPRESSED;
+        break;
+    }
+
+    mx_handle_t vmo;
+    mx_status_t status = mx_vmo_create(off, 0, &vmo);
+    if (status == NO_ERROR) {
+        size_t actual;
+        status = mx_vmo_write(vmo, image, 0, off, &actual);
+        if (status == NO_ERROR) {
+            *vmo_out = vmo;
+            *len_out = off;
+        } else {
+            mx_handle_close(vmo);
+        }
+    }
+    free(content);
+    free(image);
+    return status;
+}
+
+static mx_status_t open_image(int corrupt, bootfs_lazy_t** out) {
+    mx_handle_t vmo;
+    size_t len;
+    mx_status_t status = make_image(corrupt, &vmo, &len);
+    if (status < 0) {
+        return status;
+    }
+    const char* err;
+    status = decompress_bootdata_lazy(mx_vmar_root_self(), vmo, 0, len, out, &err);
+    mx_handle_close(vmo);
+    return status;
+}
+
+// Compare [off, off + len) of the content, as laid out in the lazy VMO,
+// against what was compressed.  If expect_zero, the range must not have
+// been populated yet.
+static bool check_range(bootfs_lazy_t* lz, size_t off, size_t len, bool expect_zero) {
+    BEGIN_HELPER;
+    uint8_t* buf = malloc(len);
+    ASSERT_NONNULL(buf, "");
+    size_t actual;
+    ASSERT_EQ(mx_vmo_read(bootfs_lazy_vmo(lz), buf, sizeof(bootdata_t) + off, len, &actual),
+              NO_ERROR, "");
+    ASSERT_EQ(actual, len, "");
+    for (size_t i = 0; i < len; i++) {
+        uint8_t want = expect_zero ? 0 : content_byte(off + i);
+        uint8_t got = buf[i];
+        if (got != want) {
+            free(buf);
+            ASSERT_EQ(got, want, "unexpected byte in lazy bootfs");
+        }
+    }
+    free(buf);
+    END_HELPER;
+}
+
+static bool lazy_populate_test(void) {
+    BEGIN_TEST;
+    bootfs_lazy_t* lz;
+    ASSERT_EQ(open_image(CORRUPT_NONE, &lz), NO_ERROR, "");
+
+    // The directory is populated up front, with the bootdata header
+    // marked as no longer compressed.
+    bootdata_t hdr;
+    size_t actual;
+    ASSERT_EQ(mx_vmo_read(bootfs_lazy_vmo(lz), &hdr, 0, sizeof(hdr), &actual), NO_ERROR, "");
+    EXPECT_EQ(hdr.length, sizeof(bootdata_t) + CONTENT_SIZE, "");
+    EXPECT_EQ(hdr.flags & BOOTDATA_BOOTFS_FLAG_COMPRESSED, 0u, "");
+    uint32_t header[3];
+    ASSERT_EQ(mx_vmo_read(bootfs_lazy_vmo(lz), header, sizeof(bootdata_t), sizeof(header),
+                          &actual), NO_ERROR, "");
+    EXPECT_EQ(header[0], 5u, "");
+    EXPECT_EQ(header[1], (uint32_t)FILE_LEN, "");
+    EXPECT_EQ(header[2], (uint32_t)FILE_OFF, "");
+
+    // Nothing past the first block has been touched.
+    ASSERT_TRUE(check_range(lz, MX_LZ4_BLOCK_SIZE, CONTENT_SIZE - MX_LZ4_BLOCK_SIZE, true), "");
+
+    // Populating a range inside the stored block fills only that block.
+    size_t off = sizeof(bootdata_t) + MX_LZ4_BLOCK_SIZE + 100;
+    ASSERT_EQ(bootfs_lazy_populate(lz, off, 10), NO_ERROR, "");
+    ASSERT_TRUE(check_range(lz, MX_LZ4_BLOCK_SIZE, MX_LZ4_BLOCK_SIZE, false), "");
+    ASSERT_TRUE(check_range(lz, 2 * MX_LZ4_BLOCK_SIZE, CONTENT_SIZE - 2 * MX_LZ4_BLOCK_SIZE,
+                            true), "");
+
+    // The whole file, straddling all three blocks; already populated
+    // blocks are left alone.
+    ASSERT_EQ(bootfs_lazy_populate(lz, sizeof(bootdata_t) + FILE_OFF, FILE_LEN), NO_ERROR, "");
+    ASSERT_TRUE(check_range(lz, FILE_OFF, FILE_LEN, false), "");
+    ASSERT_EQ(bootfs_lazy_populate(lz, 0, sizeof(bootdata_t) + CONTENT_SIZE), NO_ERROR, "");
+    ASSERT_TRUE(check_range(lz, FILE_OFF, FILE_LEN, false), "");
+
+    // Ranges inside the bootdata header need no work.
+    EXPECT_EQ(bootfs_lazy_populate(lz, 0, sizeof(bootdata_t)), NO_ERROR, "");
+    END_TEST;
+}
+
+static bool lazy_populate_all_test(void) {
+    BEGIN_TEST;
+    for (uint32_t nthreads = 0; nthreads <= 4; nthreads++) {
+        bootfs_lazy_t* lz;
+        ASSERT_EQ(open_image(CORRUPT_NONE, &lz), NO_ERROR, "");
+        ASSERT_EQ(bootfs_lazy_populate_all(lz, nthreads), NO_ERROR, "");
+        ASSERT_TRUE(check_range(lz, FILE_OFF, FILE_LEN, false), "");
+    }
+    END_TEST;
+}
+
+static bool lazy_out_of_range_test(void) {
+    BEGIN_TEST;
+    bootfs_lazy_t* lz;
+    ASSERT_EQ(open_image(CORRUPT_NONE, &lz), NO_ERROR, "");
+
+    size_t end = sizeof(bootdata_t) + CONTENT_SIZE;
+    EXPECT_EQ(bootfs_lazy_populate(lz, end - 1, 1), NO_ERROR, "");
+    EXPECT_EQ(bootfs_lazy_populate(lz, end, 0), NO_ERROR, "");
+    EXPECT_EQ(bootfs_lazy_populate(lz, end - 1, 2), ERR_OUT_OF_RANGE, "");
+    EXPECT_EQ(bootfs_lazy_populate(lz, end + PAGE_SIZE, 1), ERR_OUT_OF_RANGE, "");
+    EXPECT_EQ(bootfs_lazy_populate(lz, 1, UINT64_MAX), ERR_OUT_OF_RANGE, "");
+    END_TEST;
+}
+
+static bool lazy_corrupt_block_test(void) {
+    BEGIN_TEST;
+    // Block 0 holds the directory, so a damaged compressed block is
+    // caught before the image is handed out.
+    bootfs_lazy_t* lz;
+    EXPECT_EQ(open_image(CORRUPT_BLOCK, &lz), ERR_IO_DATA_INTEGRITY, "");
+
+    // A stored block with the wrong size is only caught when the range
+    // it covers is populated, and keeps failing afterwards.
+    ASSERT_EQ(open_image(CORRUPT_STORED, &lz), NO_ERROR, "");
+    size_t off = sizeof(bootdata_t) + MX_LZ4_BLOCK_SIZE;
+    EXPECT_EQ(bootfs_lazy_populate(lz, off, 1), ERR_IO_DATA_INTEGRITY, "");
+    EXPECT_EQ(bootfs_lazy_populate(lz, off, 1), ERR_IO_DATA_INTEGRITY, "");
+    EXPECT_EQ(bootfs_lazy_populate_all(lz, 2), ERR_IO_DATA_INTEGRITY, "");
+
+    // Blocks on either side are unaffected.
+    EXPECT_EQ(bootfs_lazy_populate(lz, off - 1, 1), NO_ERROR, "");
+    EXPECT_EQ(bootfs_lazy_populate(lz, off + MX_LZ4_BLOCK_SIZE, 1), NO_ERROR, "");
+    END_TEST;
+}
+
+static bool lazy_bad_image_test(void) {
+    BEGIN_TEST;
+    bootfs_lazy_t* lz;
+    EXPECT_EQ(open_image(CORRUPT_MAGIC, &lz), ERR_INVALID_ARGS, "");
+    EXPECT_EQ(open_image(CORRUPT_TRUNCATE, &lz), ERR_INVALID_ARGS, "");
+    EXPECT_EQ(open_image(CORRUPT_FLAGS, &lz), ERR_NOT_SUPPORTED, "");
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(bootdata_lazy_tests)
+RUN_TEST(lazy_populate_test)
+RUN_TEST(lazy_populate_all_test)
+RUN_TEST(lazy_out_of_range_test)
+RUN_TEST(lazy_corrupt_block_test)
+RUN_TEST(lazy_bad_image_test)
+END_TEST_CASE(bootdata_lazy_tests)
+
+#ifndef BUILD_COMBINED_TESTS
+int main(int argc, char** argv) {
+    return unittest_run_all_tests(argc, argv) ? 0 : -1;
+}
+#endif
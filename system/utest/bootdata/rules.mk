@@ -0,0 +1,23 @@
+# Copyright 2017 The Fuchsia Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+LOCAL_DIR := $(GET_LOCAL_DIR)
+
+MODULE := $(LOCAL_DIR)
+
+MODULE_TYPE := usertest
+
+MODULE_SRCS += \
+    $(LOCAL_DIR)/lazy.c
+
+MODULE_NAME := bootdata-test
+
+# for the LZ4 frame layout private to libbootdata
+MODULE_COMPILEFLAGS := -Isystem/ulib/bootdata
+
+MODULE_STATIC_LIBS := system/ulib/bootdata third_party/ulib/lz4
+
+MODULE_LIBS := system/ulib/unittest system/ulib/mxio system/ulib/magenta system/ulib/c
+
+include make/module.mk
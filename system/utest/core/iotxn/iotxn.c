@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 
 #include <ddk/iotxn.h>
+#include <magenta/syscalls.h>
 
 #include <unittest/unittest.h>
 #include <stddef.h>
@@ -89,12 +90,103 @@ static bool test_physmap_unaligned_offset2(void) {
     END_TEST;
 }
 
+static bool test_pool_reuse_size_class(void) {
+    BEGIN_TEST;
+    iotxn_t* txn;
+    ASSERT_EQ(iotxn_alloc(&txn, IOTXN_ALLOC_POOL, PAGE_SIZE * 9), NO_ERROR, "");
+    ASSERT_EQ(txn->vmo_length, (uint64_t)(PAGE_SIZE * 9), "unexpected vmo_length");
+    mx_handle_t vmo = txn->vmo_handle;
+    // the vmo is sized to the class, not to the next power of two
+    uint64_t size;
+    ASSERT_EQ(mx_vmo_get_size(vmo, &size), NO_ERROR, "");
+    ASSERT_EQ(size, (uint64_t)(PAGE_SIZE * 10), "unexpected vmo size");
+    iotxn_release(txn);
+
+    // a different size in the same size class reuses the vmo
+    iotxn_pool_stats_t before, after;
+    iotxn_pool_stats(&before);
+    ASSERT_EQ(iotxn_alloc(&txn, IOTXN_ALLOC_POOL, PAGE_SIZE * 10), NO_ERROR, "");
+    iotxn_pool_stats(&after);
+    ASSERT_EQ(txn->vmo_handle, vmo, "expected vmo to be reused");
+    ASSERT_EQ(txn->vmo_offset, 0u, "unexpected vmo_offset");
+    ASSERT_EQ(txn->vmo_length, (uint64_t)(PAGE_SIZE * 10), "unexpected vmo_length");
+    ASSERT_EQ(after.misses, before.misses, "expected a pool hit");
+    ASSERT_EQ(after.thread_hits + after.pool_hits, before.thread_hits + before.pool_hits + 1, "");
+
+    // physmap must reflect the new length, not the cached one
+    ASSERT_EQ(iotxn_physmap(txn), NO_ERROR, "");
+    ASSERT_EQ(txn->phys_length, 10u, "unexpected phys_length");
+    iotxn_release(txn);
+
+    ASSERT_EQ(iotxn_alloc(&txn, IOTXN_ALLOC_POOL, PAGE_SIZE * 8), NO_ERROR, "");
+    ASSERT_NEQ(txn->vmo_handle, vmo, "expected a smaller size class");
+    ASSERT_EQ(iotxn_physmap(txn), NO_ERROR, "");
+    ASSERT_EQ(txn->phys_length, 8u, "unexpected phys_length");
+    iotxn_release(txn);
+    END_TEST;
+}
+
+static bool test_pool_clone(void) {
+    BEGIN_TEST;
+    iotxn_t* txn;
+    ASSERT_EQ(iotxn_alloc(&txn, IOTXN_ALLOC_POOL, PAGE_SIZE), NO_ERROR, "");
+    iotxn_t* clone;
+    ASSERT_EQ(iotxn_clone(txn, &clone), NO_ERROR, "");
+    iotxn_release(clone);
+
+    iotxn_pool_stats_t before, after;
+    iotxn_pool_stats(&before);
+    ASSERT_EQ(iotxn_clone(txn, &clone), NO_ERROR, "");
+    iotxn_pool_stats(&after);
+    ASSERT_EQ(after.misses, before.misses, "expected clone to come from the pool");
+    ASSERT_EQ(clone->vmo_handle, txn->vmo_handle, "expected clone to share the vmo");
+    iotxn_release(clone);
+    iotxn_release(txn);
+    END_TEST;
+}
+
+static bool test_pool_limit(void) {
+    BEGIN_TEST;
+    iotxn_pool_stats_t stats;
+    iotxn_pool_stats(&stats);
+    uint64_t old_max = stats.max_cached_bytes;
+
+    // leave a txn in this thread's cache, which the trim must also empty
+    iotxn_t* txn;
+    ASSERT_EQ(iotxn_alloc(&txn, IOTXN_ALLOC_POOL, PAGE_SIZE), NO_ERROR, "");
+    iotxn_release(txn);
+    iotxn_pool_stats(&stats);
+    ASSERT_GT(stats.cached_bytes, 0u, "expected txn to be cached");
+
+    // with no room in the pool, released txns are freed
+    iotxn_pool_set_max_bytes(0);
+    iotxn_pool_stats(&stats);
+    ASSERT_EQ(stats.cached_bytes, 0u, "expected pool to be trimmed");
+    ASSERT_EQ(stats.cached_count, 0u, "expected pool to be trimmed");
+
+    ASSERT_EQ(iotxn_alloc(&txn, IOTXN_ALLOC_POOL, PAGE_SIZE * 8), NO_ERROR, "");
+    iotxn_release(txn);
+    iotxn_pool_stats(&stats);
+    ASSERT_EQ(stats.cached_bytes, 0u, "expected txn to be freed");
+    ASSERT_EQ(stats.cached_count, 0u, "expected txn to be freed");
+
+    iotxn_pool_set_max_bytes(old_max);
+    ASSERT_EQ(iotxn_alloc(&txn, IOTXN_ALLOC_POOL, PAGE_SIZE * 8), NO_ERROR, "");
+    iotxn_release(txn);
+    iotxn_pool_stats(&stats);
+    ASSERT_GT(stats.cached_bytes, (uint64_t)(PAGE_SIZE * 8), "expected txn to be cached");
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(iotxn_tests)
 RUN_TEST(test_physmap_simple)
 RUN_TEST(test_physmap_clone)
 RUN_TEST(test_physmap_aligned_offset)
 RUN_TEST(test_physmap_unaligned_offset)
 RUN_TEST(test_physmap_unaligned_offset2)
+RUN_TEST(test_pool_reuse_size_class)
+RUN_TEST(test_pool_clone)
+RUN_TEST(test_pool_limit)
 END_TEST_CASE(iotxn_tests)
 
 #ifndef BUILD_COMBINED_TESTS
@@ -6,6 +6,7 @@
 #include <magenta/status.h>
 #include <magenta/syscalls.h>
 #include <magenta/syscalls/object.h>
+#include <magenta/threads.h>
 #include <mini-process/mini-process.h>
 #include <unittest/unittest.h>
 
@@ -13,6 +14,7 @@
 #include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <threads.h>
 
 #define LOCAL_TRACE 0
 #define LTRACEF(str, x...)                                  \
@@ -34,6 +36,44 @@ bool info_task_stats_smoke(void) {
     END_TEST;
 }
 
+// Tests that MX_INFO_THREAD_STATS seems to work, and that each level of
+// the task tree accounts for at least what the level below it does.
+bool info_thread_stats_smoke(void) {
+    BEGIN_TEST;
+    mx_info_thread_stats_t thread_info;
+    ASSERT_EQ(mx_object_get_info(thrd_get_mx_handle(thrd_current()), MX_INFO_THREAD_STATS,
+                                 &thread_info, sizeof(thread_info), NULL, NULL),
+              NO_ERROR, "");
+    EXPECT_GT(thread_info.total_runtime, 0u, "");
+    EXPECT_GT(thread_info.context_switches, 0u, "");
+
+    mx_info_thread_stats_t process_info;
+    ASSERT_EQ(mx_object_get_info(mx_process_self(), MX_INFO_THREAD_STATS,
+                                 &process_info, sizeof(process_info), NULL, NULL),
+              NO_ERROR, "");
+    EXPECT_GE(process_info.total_runtime, thread_info.total_runtime, "");
+    EXPECT_GE(process_info.context_switches, thread_info.context_switches, "");
+
+    mx_info_thread_stats_t job_info;
+    ASSERT_EQ(mx_object_get_info(mx_job_default(), MX_INFO_THREAD_STATS,
+                                 &job_info, sizeof(job_info), NULL, NULL),
+              NO_ERROR, "");
+    EXPECT_GE(job_info.total_runtime, process_info.total_runtime, "");
+    END_TEST;
+}
+
+bool info_thread_stats_non_task_handle_fails(void) {
+    BEGIN_TEST;
+    mx_handle_t event;
+    ASSERT_EQ(mx_event_create(0u, &event), NO_ERROR, "");
+    mx_info_thread_stats_t info;
+    EXPECT_EQ(mx_object_get_info(event, MX_INFO_THREAD_STATS,
+                                 &info, sizeof(info), NULL, NULL),
+              ERR_WRONG_TYPE, "");
+    mx_handle_close(event);
+    END_TEST;
+}
+
 // Structs to keep track of VMARs/mappings in the test child process.
 typedef struct test_mapping {
     uintptr_t base;
@@ -492,6 +532,8 @@ bool info_process_maps_bad_avail_fails(void) {
 
 BEGIN_TEST_CASE(object_info_tests)
 RUN_TEST(info_task_stats_smoke);
+RUN_TEST(info_thread_stats_smoke);
+RUN_TEST(info_thread_stats_non_task_handle_fails);
 RUN_TEST(info_process_maps_smoke);
 RUN_TEST(info_process_maps_self_fails);
 RUN_TEST(info_process_maps_invalid_handle_fails);
@@ -475,6 +475,111 @@ static bool threads_event_repeat() {
     return threads_event(MX_WAIT_ASYNC_REPEATING);
 }
 
+static bool wait_many_test(void) {
+    BEGIN_TEST;
+
+    mx_handle_t port;
+    EXPECT_EQ(mx_port_create(MX_PORT_OPT_V2, &port), NO_ERROR, "");
+
+    mx_port_packet_t out[40] = {};
+    uint32_t count = countof(out);
+    EXPECT_EQ(mx_port_wait_many(port, 0u, out, &count), ERR_TIMED_OUT, "");
+
+    count = 0u;
+    EXPECT_EQ(mx_port_wait_many(port, 0u, out, &count), ERR_INVALID_ARGS, "");
+
+    // More than the kernel takes in one go, to check the order across batches.
+    for (uint64_t ix = 0; ix != 35u; ++ix) {
+        mx_port_packet_t in = {};
+        in.key = ix;
+        in.type = MX_PKT_TYPE_USER;
+        EXPECT_EQ(mx_port_queue(port, &in, 0u), NO_ERROR, "");
+    }
+
+    count = 3u;
+    EXPECT_EQ(mx_port_wait_many(port, 0u, out, &count), NO_ERROR, "");
+    EXPECT_EQ(count, 3u, "");
+
+    count = countof(out) - 3u;
+    EXPECT_EQ(mx_port_wait_many(port, MX_TIME_INFINITE, out + 3, &count), NO_ERROR, "");
+    EXPECT_EQ(count, 32u, "");
+
+    for (uint64_t ix = 0; ix != 35u; ++ix) {
+        EXPECT_EQ(out[ix].key, ix, "");
+        EXPECT_EQ(out[ix].type, MX_PKT_TYPE_USER, "");
+    }
+
+    count = countof(out);
+    EXPECT_EQ(mx_port_wait_many(port, 0u, out, &count), ERR_TIMED_OUT, "");
+
+    EXPECT_EQ(mx_handle_close(port), NO_ERROR, "");
+
+    END_TEST;
+}
+
+struct producer_context {
+    mx_handle_t port;
+    uint64_t base;
+};
+
+constexpr uint64_t kPacketsPerProducer = 2000u;
+
+static int port_producer_thread(void* arg) {
+    auto ctx = reinterpret_cast<producer_context*>(arg);
+    for (uint64_t ix = 0; ix != kPacketsPerProducer; ++ix) {
+        mx_port_packet_t in = {};
+        in.key = ctx->base + ix;
+        in.type = MX_PKT_TYPE_USER;
+        auto st = mx_port_queue(ctx->port, &in, 0u);
+        if (st < 0)
+            return st;
+    }
+    return 0;
+}
+
+static bool wait_many_producers_test(void) {
+    BEGIN_TEST;
+
+    mx_handle_t port;
+    EXPECT_EQ(mx_port_create(MX_PORT_OPT_V2, &port), NO_ERROR, "");
+
+    thrd_t threads[4];
+    producer_context ctx[4];
+    for (size_t ix = 0; ix != countof(threads); ++ix) {
+        ctx[ix] = { port, ix * kPacketsPerProducer };
+        EXPECT_EQ(thrd_create(&threads[ix], port_producer_thread, &ctx[ix]),
+                  thrd_success, "");
+    }
+
+    // Packets of each producer must come out in the order it queued them.
+    uint64_t next[4] = {};
+    uint64_t received = 0u;
+    while (received < countof(threads) * kPacketsPerProducer) {
+        mx_port_packet_t out[64];
+        uint32_t count = countof(out);
+        ASSERT_EQ(mx_port_wait_many(port, MX_TIME_INFINITE, out, &count), NO_ERROR, "");
+        ASSERT_GT(count, 0u, "");
+        for (uint32_t ix = 0; ix != count; ++ix) {
+            uint64_t producer = out[ix].key / kPacketsPerProducer;
+            ASSERT_LT(producer, countof(threads), "");
+            EXPECT_EQ(out[ix].key % kPacketsPerProducer, next[producer], "");
+            next[producer]++;
+        }
+        received += count;
+    }
+
+    for (size_t ix = 0; ix != countof(threads); ++ix) {
+        int res;
+        EXPECT_EQ(thrd_join(threads[ix], &res), thrd_success, "");
+        EXPECT_EQ(res, 0, "");
+        EXPECT_EQ(next[ix], kPacketsPerProducer, "");
+    }
+
+    EXPECT_EQ(mx_handle_close(port), NO_ERROR, "");
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(port_tests)
 RUN_TEST(basic_test)
 RUN_TEST(queue_and_close_test)
@@ -493,6 +598,8 @@ RUN_TEST(cancel_event_key_once)
 RUN_TEST(cancel_event_key_repeat)
 RUN_TEST(threads_event_once)
 RUN_TEST(threads_event_repeat)
+RUN_TEST(wait_many_test)
+RUN_TEST(wait_many_producers_test)
 END_TEST_CASE(port_tests)
 
 #ifndef BUILD_COMBINED_TESTS
@@ -320,12 +320,69 @@ static bool pthread_getstack_other_thread_explicit_size() {
     END_TEST;
 }
 
+static thread_local int tls_data = 42;
+static thread_local int tls_bss;
+
+// Checks that the thread starts with fresh TLS, then dirties it and its
+// stack for whichever thread gets them next.
+static void* reuse_thread(void*) {
+    bool fresh = tls_data == 42 && tls_bss == 0;
+    tls_data = -1;
+    tls_bss = -1;
+    volatile uint8_t buffer[4096];
+    memset(const_cast<uint8_t*>(buffer), 0xff, sizeof(buffer));
+    return reinterpret_cast<void*>(static_cast<uintptr_t>(fresh));
+}
+
+static bool run_reuse_threads(const pthread_attr_t* attr, int count) {
+    BEGIN_HELPER;
+    for (int i = 0; i < count; i++) {
+        pthread_t thread;
+        ASSERT_EQ(pthread_create(&thread, attr, reuse_thread, nullptr), 0,
+                  "pthread_create failed");
+        void* fresh;
+        ASSERT_EQ(pthread_join(thread, &fresh), 0, "pthread_join failed");
+        ASSERT_TRUE(static_cast<bool>(reinterpret_cast<uintptr_t>(fresh)),
+                    "thread did not start with fresh TLS");
+    }
+    END_HELPER;
+}
+
+static bool pthread_reuse_thread_blocks() {
+    BEGIN_TEST;
+
+    pthread_attr_t attr;
+    ASSERT_EQ(pthread_attr_init(&attr), 0, "pthread_attr_init failed");
+    ASSERT_EQ(pthread_attr_setstacksize(&attr, 64 << 10), 0,
+              "pthread_attr_setstacksize failed");
+
+    // Threads of different sizes, one after another, with the cache on
+    // and off.
+    ASSERT_TRUE(run_reuse_threads(nullptr, 20), "");
+    ASSERT_TRUE(run_reuse_threads(&attr, 20), "");
+    ASSERT_EQ(pthread_setcachesize_np(0), 0, "");
+    ASSERT_TRUE(run_reuse_threads(nullptr, 5), "");
+    ASSERT_EQ(pthread_setcachesize_np(2u << 20), 0, "");
+    ASSERT_TRUE(run_reuse_threads(&attr, 20), "");
+
+    // Detached threads give back their stacks, which joined ones reuse.
+    for (int i = 0; i < 10; i++) {
+        pthread_t thread;
+        ASSERT_EQ(pthread_create(&thread, nullptr, reuse_thread, nullptr), 0, "");
+        ASSERT_EQ(pthread_detach(thread), 0, "");
+    }
+    ASSERT_TRUE(run_reuse_threads(nullptr, 20), "");
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(pthread_tests)
 RUN_TEST(pthread_test)
 RUN_TEST(pthread_self_main_thread_test)
 RUN_TEST(pthread_big_stack_size)
 RUN_TEST(pthread_getstack_main_thread)
 RUN_TEST(pthread_getstack_other_thread)
+RUN_TEST(pthread_reuse_thread_blocks)
 END_TEST_CASE(pthread_tests)
 
 #ifndef BUILD_COMBINED_TESTS
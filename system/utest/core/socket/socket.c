@@ -311,15 +311,180 @@ static bool socket_short_write(void) {
     mx_status_t status;
 
     mx_handle_t h0, h1;
-    status = mx_socket_create(0, &h0, &h1);
+    status = mx_socket_create(MX_SOCKET_CAPACITY(MX_SOCKET_CAPACITY_MIN), &h0, &h1);
     ASSERT_EQ(status, NO_ERROR, "");
 
-    // TODO(qsr): Request socket buffer and use (socket_buffer + 1).
-    const size_t buffer_size = 256 * 1024 + 1;
+    const size_t buffer_size = (1u << MX_SOCKET_CAPACITY_MIN) + 1;
     char* buffer = malloc(buffer_size);
     size_t written = 0;
     status = mx_socket_write(h0, 0u, buffer, buffer_size, &written);
-    EXPECT_LT(written, buffer_size, "");
+    ASSERT_EQ(status, NO_ERROR, "");
+    EXPECT_EQ(written, buffer_size - 2, "a buffer holds one byte less than its capacity");
+    EXPECT_EQ(get_satisfied_signals(h0) & MX_SOCKET_WRITABLE, 0u, "");
+
+    free(buffer);
+    mx_handle_close(h0);
+    mx_handle_close(h1);
+
+    END_TEST;
+}
+
+static bool socket_capacity(void) {
+    BEGIN_TEST;
+
+    mx_handle_t h0, h1;
+    EXPECT_EQ(mx_socket_create(MX_SOCKET_CAPACITY(MX_SOCKET_CAPACITY_MIN - 1), &h0, &h1),
+              ERR_OUT_OF_RANGE, "");
+    EXPECT_EQ(mx_socket_create(MX_SOCKET_CAPACITY(MX_SOCKET_CAPACITY_MAX + 1), &h0, &h1),
+              ERR_OUT_OF_RANGE, "");
+    EXPECT_EQ(mx_socket_create(1u << 4, &h0, &h1), ERR_INVALID_ARGS, "");
+
+    ASSERT_EQ(mx_socket_create(MX_SOCKET_CAPACITY(16), &h0, &h1), NO_ERROR, "");
+
+    // Fill and drain the buffer a few times, wrapping around at odd offsets.
+    const size_t chunk = 3 * 4096 + 17;
+    char* wbuf = malloc(chunk);
+    char* rbuf = malloc(chunk);
+    for (int round = 0; round < 16; round++) {
+        for (size_t i = 0; i < chunk; i++)
+            wbuf[i] = (char)(i + round);
+        size_t count = 0;
+        ASSERT_EQ(mx_socket_write(h0, 0u, wbuf, chunk, &count), NO_ERROR, "");
+        ASSERT_EQ(count, chunk, "");
+        ASSERT_EQ(mx_socket_read(h1, 0u, rbuf, chunk, &count), NO_ERROR, "");
+        ASSERT_EQ(count, chunk, "");
+        ASSERT_EQ(memcmp(wbuf, rbuf, chunk), 0, "");
+        EXPECT_EQ(get_satisfied_signals(h1) & MX_SOCKET_READABLE, 0u, "");
+    }
+
+    free(wbuf);
+    free(rbuf);
+    mx_handle_close(h0);
+    mx_handle_close(h1);
+
+    END_TEST;
+}
+
+static bool socket_datagram(void) {
+    BEGIN_TEST;
+
+    mx_handle_t h0, h1;
+    // a write option is not a create option
+    EXPECT_EQ(mx_socket_create(MX_SOCKET_HALF_CLOSE, &h0, &h1), ERR_INVALID_ARGS, "");
+    ASSERT_EQ(mx_socket_create(MX_SOCKET_DATAGRAM, &h0, &h1), NO_ERROR, "");
+    EXPECT_EQ(mx_socket_write(h0, MX_SOCKET_DATAGRAM, "x", 1u, NULL), ERR_INVALID_ARGS, "");
+
+    size_t count = 0;
+    ASSERT_EQ(mx_socket_write(h0, 0u, "packet1", 8u, &count), NO_ERROR, "");
+    EXPECT_EQ(count, 8u, "");
+    ASSERT_EQ(mx_socket_write(h0, 0u, "pkt2", 5u, &count), NO_ERROR, "");
+    ASSERT_EQ(mx_socket_write(h0, 0u, "", 0u, &count), NO_ERROR, "");
+    ASSERT_EQ(mx_socket_write(h0, 0u, "last", 5u, &count), NO_ERROR, "");
+
+    // The outstanding size is that of the next datagram.
+    ASSERT_EQ(mx_socket_read(h1, 0u, NULL, 0, &count), NO_ERROR, "");
+    EXPECT_EQ(count, 8u, "");
+
+    char rbuf[16] = {0};
+    ASSERT_EQ(mx_socket_read(h1, 0u, rbuf, sizeof(rbuf), &count), NO_ERROR, "");
+    EXPECT_EQ(count, 8u, "");
+    EXPECT_EQ(strcmp(rbuf, "packet1"), 0, "");
+
+    // A short read truncates the datagram.
+    memset(rbuf, 0, sizeof(rbuf));
+    ASSERT_EQ(mx_socket_read(h1, 0u, rbuf, 3u, &count), NO_ERROR, "");
+    EXPECT_EQ(count, 3u, "");
+    EXPECT_EQ(memcmp(rbuf, "pkt", 3), 0, "");
+
+    ASSERT_EQ(mx_socket_read(h1, 0u, rbuf, sizeof(rbuf), &count), NO_ERROR, "");
+    EXPECT_EQ(count, 0u, "");
+
+    ASSERT_EQ(mx_socket_read(h1, 0u, rbuf, sizeof(rbuf), &count), NO_ERROR, "");
+    EXPECT_EQ(count, 5u, "");
+    EXPECT_EQ(strcmp(rbuf, "last"), 0, "");
+
+    EXPECT_EQ(mx_socket_read(h1, 0u, rbuf, sizeof(rbuf), &count), ERR_SHOULD_WAIT, "");
+
+    mx_handle_close(h0);
+    mx_handle_close(h1);
+
+    END_TEST;
+}
+
+static bool socket_datagram_no_short_write(void) {
+    BEGIN_TEST;
+
+    mx_handle_t h0, h1;
+    ASSERT_EQ(mx_socket_create(MX_SOCKET_DATAGRAM | MX_SOCKET_CAPACITY(MX_SOCKET_CAPACITY_MIN),
+                               &h0, &h1), NO_ERROR, "");
+
+    const size_t capacity = 1u << MX_SOCKET_CAPACITY_MIN;
+    char* buffer = calloc(1, capacity);
+    size_t count = 0;
+
+    // Datagrams that can never fit are rejected outright.
+    EXPECT_EQ(mx_socket_write(h0, 0u, buffer, capacity, &count), ERR_OUT_OF_RANGE, "");
+
+    ASSERT_EQ(mx_socket_write(h0, 0u, buffer, capacity / 2, &count), NO_ERROR, "");
+
+    // This one would fit in an empty buffer but not alongside the first.
+    EXPECT_EQ(mx_socket_write(h0, 0u, buffer, capacity / 2, &count), ERR_SHOULD_WAIT, "");
+
+    ASSERT_EQ(mx_socket_read(h1, 0u, buffer, capacity, &count), NO_ERROR, "");
+    EXPECT_EQ(count, capacity / 2, "");
+    EXPECT_EQ(mx_socket_read(h1, 0u, buffer, capacity, &count), ERR_SHOULD_WAIT, "");
+
+    ASSERT_EQ(mx_socket_write(h0, 0u, buffer, capacity / 2, &count), NO_ERROR, "");
+
+    free(buffer);
+    mx_handle_close(h0);
+    mx_handle_close(h1);
+
+    END_TEST;
+}
+
+static bool socket_datagram_writable(void) {
+    BEGIN_TEST;
+
+    mx_handle_t h0, h1;
+    ASSERT_EQ(mx_socket_create(MX_SOCKET_DATAGRAM | MX_SOCKET_CAPACITY(MX_SOCKET_CAPACITY_MIN),
+                               &h0, &h1), NO_ERROR, "");
+
+    const size_t capacity = 1u << MX_SOCKET_CAPACITY_MIN;
+    char* buffer = calloc(1, capacity);
+    size_t count = 0;
+
+    // Two small datagrams and one half the buffer leave room for more
+    // small ones, so the socket is still writable.
+    ASSERT_EQ(mx_socket_write(h0, 0u, buffer, 16, &count), NO_ERROR, "");
+    ASSERT_EQ(mx_socket_write(h0, 0u, buffer, 16, &count), NO_ERROR, "");
+    ASSERT_EQ(mx_socket_write(h0, 0u, buffer, capacity / 2, &count), NO_ERROR, "");
+    EXPECT_EQ(get_satisfied_signals(h0) & MX_SOCKET_WRITABLE, MX_SOCKET_WRITABLE, "");
+
+    // A datagram that does not fit clears WRITABLE...
+    EXPECT_EQ(mx_socket_write(h0, 0u, buffer, capacity / 2, &count), ERR_SHOULD_WAIT, "");
+    EXPECT_EQ(get_satisfied_signals(h0) & MX_SOCKET_WRITABLE, 0u, "");
+
+    // ...and freeing less than it needs does not bring it back.
+    ASSERT_EQ(mx_socket_read(h1, 0u, buffer, capacity, &count), NO_ERROR, "");
+    EXPECT_EQ(count, 16u, "");
+    EXPECT_EQ(get_satisfied_signals(h0) & MX_SOCKET_WRITABLE, 0u, "");
+    ASSERT_EQ(mx_socket_read(h1, 0u, buffer, capacity, &count), NO_ERROR, "");
+    EXPECT_EQ(count, 16u, "");
+    EXPECT_EQ(get_satisfied_signals(h0) & MX_SOCKET_WRITABLE, 0u, "");
+
+    // Once it would fit, the writer is woken and the write succeeds.
+    ASSERT_EQ(mx_socket_read(h1, 0u, buffer, capacity, &count), NO_ERROR, "");
+    EXPECT_EQ(count, capacity / 2, "");
+    EXPECT_EQ(get_satisfied_signals(h0) & MX_SOCKET_WRITABLE, MX_SOCKET_WRITABLE, "");
+    ASSERT_EQ(mx_socket_write(h0, 0u, buffer, capacity / 2, &count), NO_ERROR, "");
+
+    // A smaller datagram may still go through while a larger one waits,
+    // and WRITABLE reflects the room left afterwards.
+    EXPECT_EQ(mx_socket_write(h0, 0u, buffer, capacity / 2, &count), ERR_SHOULD_WAIT, "");
+    EXPECT_EQ(get_satisfied_signals(h0) & MX_SOCKET_WRITABLE, 0u, "");
+    ASSERT_EQ(mx_socket_write(h0, 0u, buffer, 16, &count), NO_ERROR, "");
+    EXPECT_EQ(get_satisfied_signals(h0) & MX_SOCKET_WRITABLE, MX_SOCKET_WRITABLE, "");
 
     free(buffer);
     mx_handle_close(h0);
@@ -335,6 +500,10 @@ RUN_TEST(socket_half_close)
 RUN_TEST(socket_bytes_outstanding)
 RUN_TEST(socket_bytes_outstanding_half_close)
 RUN_TEST(socket_short_write)
+RUN_TEST(socket_capacity)
+RUN_TEST(socket_datagram)
+RUN_TEST(socket_datagram_no_short_write)
+RUN_TEST(socket_datagram_writable)
 END_TEST_CASE(socket_tests)
 
 #ifndef BUILD_COMBINED_TESTS
@@ -25,8 +25,33 @@ static bool elapsed_time_using_ticks(void) {
     END_TEST;
 }
 
+// mx_time_get is usually answered by the vDSO without entering the
+// kernel; it must still agree with the kernel's own notion of time.
+static bool monotonic_time_matches_kernel(void) {
+    BEGIN_TEST;
+
+    mx_time_t last = mx_time_get(MX_CLOCK_MONOTONIC);
+    for (int i = 0; i < 1000; i++) {
+        mx_time_t now = mx_time_get(MX_CLOCK_MONOTONIC);
+        ASSERT_GE(now, last, "Monotonic time went backwards");
+        last = now;
+    }
+
+    // The kernel wakes us no earlier than the deadline, by its clock.
+    mx_time_t before = mx_time_get(MX_CLOCK_MONOTONIC);
+    ASSERT_EQ(mx_nanosleep(MX_MSEC(10)), NO_ERROR, "");
+    mx_time_t after = mx_time_get(MX_CLOCK_MONOTONIC);
+    ASSERT_GE(after - before, MX_MSEC(10), "Slept less than requested");
+
+    // Clocks the vDSO does not handle itself still go to the kernel.
+    ASSERT_GT(mx_time_get(MX_CLOCK_THREAD), 0u, "");
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(ticks_tests)
 RUN_TEST(elapsed_time_using_ticks)
+RUN_TEST(monotonic_time_matches_kernel)
 END_TEST_CASE(ticks_tests)
 
 #ifndef BUILD_COMBINED_TESTS
@@ -242,6 +242,48 @@ bool wait_set_wait_single_thread_1_test(void) {
     END_TEST;
 }
 
+// Signals that an entry does not watch are still reported as they are when the wait returns.
+bool wait_set_wait_unwatched_signals_test(void) {
+    BEGIN_TEST;
+
+    mx_handle_t ev;
+    ASSERT_EQ(mx_event_create(0u, &ev), 0, "mx_event_create() failed");
+
+    mx_handle_t ws;
+    ASSERT_EQ(mx_waitset_create(0, &ws), NO_ERROR, "");
+    ASSERT_GT(ws, 0, "mx_waitset_create() failed");
+
+    const uint64_t cookie = 1u;
+    EXPECT_EQ(mx_waitset_add(ws, cookie, ev, MX_USER_SIGNAL_0), NO_ERROR, "");
+
+    ASSERT_EQ(mx_object_signal(ev, 0u, MX_USER_SIGNAL_0), NO_ERROR, "");
+    mx_waitset_result_t results[5] = {};
+    uint32_t num_results = 5u;
+    ASSERT_EQ(mx_waitset_wait(ws, 0u, results, &num_results), NO_ERROR, "");
+    ASSERT_EQ(num_results, 1u, "wrong num_results from mx_waitset_wait()");
+    EXPECT_TRUE(check_results(num_results, results, cookie, NO_ERROR, MX_USER_SIGNAL_0), "");
+
+    // Asserting an unwatched signal shows up in |observed|...
+    ASSERT_EQ(mx_object_signal(ev, 0u, MX_USER_SIGNAL_1), NO_ERROR, "");
+    num_results = 5u;
+    ASSERT_EQ(mx_waitset_wait(ws, 0u, results, &num_results), NO_ERROR, "");
+    ASSERT_EQ(num_results, 1u, "wrong num_results from mx_waitset_wait()");
+    EXPECT_TRUE(check_results(num_results, results, cookie, NO_ERROR,
+                              MX_USER_SIGNAL_0 | MX_USER_SIGNAL_1), "");
+
+    // ...and so does deasserting it.
+    ASSERT_EQ(mx_object_signal(ev, MX_USER_SIGNAL_1, 0u), NO_ERROR, "");
+    num_results = 5u;
+    ASSERT_EQ(mx_waitset_wait(ws, 0u, results, &num_results), NO_ERROR, "");
+    ASSERT_EQ(num_results, 1u, "wrong num_results from mx_waitset_wait()");
+    EXPECT_TRUE(check_results(num_results, results, cookie, NO_ERROR, MX_USER_SIGNAL_0), "");
+
+    EXPECT_EQ(mx_handle_close(ws), NO_ERROR, "");
+    EXPECT_EQ(mx_handle_close(ev), NO_ERROR, "");
+
+    END_TEST;
+}
+
 bool wait_set_wait_single_thread_2_test(void) {
     BEGIN_TEST;
 
@@ -383,6 +425,7 @@ RUN_TEST(wait_set_create_test)
 RUN_TEST(wait_set_add_remove_test)
 RUN_TEST(wait_set_bad_add_remove_test)
 RUN_TEST(wait_set_wait_single_thread_1_test)
+RUN_TEST(wait_set_wait_unwatched_signals_test)
 RUN_TEST(wait_set_wait_single_thread_2_test)
 RUN_TEST(wait_set_wait_threaded_test)
 RUN_TEST(wait_set_wait_cancelled_test)
@@ -0,0 +1,272 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <ddk/binding.h>
+#include <ddk/device.h>
+#include <ddk/driver.h>
+#include <unittest/unittest.h>
+
+#include "devhost.h"
+
+#define VID_INTEL 0x8086
+#define VID_NVIDIA 0x10de
+#define VID_GOOGLE 0x18d1
+
+// pci, one vendor
+static const mx_bind_inst_t pci_intel_binding[] = {
+    BI_ABORT_IF(NE, BIND_PROTOCOL, MX_PROTOCOL_PCI),
+    BI_ABORT_IF(NE, BIND_PCI_VID, VID_INTEL),
+    BI_MATCH_IF(EQ, BIND_PCI_DID, 0x1616),
+    BI_ABORT(),
+};
+
+// pci, any vendor
+static const mx_bind_inst_t pci_did_binding[] = {
+    BI_ABORT_IF(NE, BIND_PROTOCOL, MX_PROTOCOL_PCI),
+    BI_MATCH_IF(EQ, BIND_PCI_DID, 0x1234),
+    BI_ABORT(),
+};
+
+// usb, one vendor
+static const mx_bind_inst_t usb_google_binding[] = {
+    BI_ABORT_IF(NE, BIND_PROTOCOL, MX_PROTOCOL_USB),
+    BI_ABORT_IF(NE, BIND_USB_VID, VID_GOOGLE),
+    BI_MATCH(),
+};
+
+// two protocols
+static const mx_bind_inst_t block_or_misc_binding[] = {
+    BI_MATCH_IF(EQ, BIND_PROTOCOL, MX_PROTOCOL_BLOCK),
+    BI_MATCH_IF(EQ, BIND_PROTOCOL, MX_PROTOCOL_MISC),
+    BI_ABORT(),
+};
+
+// reaches its match through a goto
+static const mx_bind_inst_t usb_goto_binding[] = {
+    BI_GOTO_IF(EQ, BIND_PROTOCOL, MX_PROTOCOL_USB, 1),
+    BI_ABORT(),
+    BI_LABEL(1),
+    BI_MATCH(),
+};
+
+// anything but pci
+static const mx_bind_inst_t not_pci_binding[] = {
+    BI_ABORT_IF(EQ, BIND_PROTOCOL, MX_PROTOCOL_PCI),
+    BI_MATCH(),
+};
+
+// anything, but only when asked for
+static const mx_bind_inst_t on_request_binding[] = {
+    BI_ABORT_IF_AUTOBIND,
+    BI_MATCH(),
+};
+
+// nothing at all
+static const mx_bind_inst_t never_binding[] = {
+    BI_ABORT(),
+};
+
+#define DRIVER(n) { .name = #n, .binding = n##_binding, .binding_size = sizeof(n##_binding) }
+
+static mx_driver_t drivers[] = {
+    DRIVER(pci_intel),
+    DRIVER(pci_did),
+    DRIVER(usb_google),
+    DRIVER(block_or_misc),
+    DRIVER(usb_goto),
+    DRIVER(not_pci),
+    DRIVER(on_request),
+    DRIVER(never),
+};
+
+static mx_device_prop_t intel_gpu_props[] = {
+    { BIND_PROTOCOL, 0, MX_PROTOCOL_PCI },
+    { BIND_PCI_VID, 0, VID_INTEL },
+    { BIND_PCI_DID, 0, 0x1616 },
+};
+
+static mx_device_prop_t nvidia_props[] = {
+    { BIND_PROTOCOL, 0, MX_PROTOCOL_PCI },
+    { BIND_PCI_VID, 0, VID_NVIDIA },
+    { BIND_PCI_DID, 0, 0x1234 },
+};
+
+static mx_device_prop_t google_usb_props[] = {
+    { BIND_PROTOCOL, 0, MX_PROTOCOL_USB },
+    { BIND_USB_VID, 0, VID_GOOGLE },
+};
+
+static mx_device_prop_t other_usb_props[] = {
+    { BIND_PROTOCOL, 0, MX_PROTOCOL_USB },
+    { BIND_USB_VID, 0, VID_INTEL },
+};
+
+// the property overrides the protocol id
+static mx_device_prop_t block_props[] = {
+    { BIND_PROTOCOL, 0, MX_PROTOCOL_BLOCK },
+};
+
+static void init_device(mx_device_t* dev, uint32_t protocol_id,
+                        mx_device_prop_t* props, uint32_t prop_count) {
+    memset(dev, 0, sizeof(*dev));
+    dev->protocol_id = protocol_id;
+    dev->props = props;
+    dev->prop_count = prop_count;
+}
+
+typedef struct {
+    bool visited[countof(drivers)];
+    size_t last;
+    bool in_order;
+} visit_t;
+
+static bool visit(mx_driver_t* drv, void* cookie) {
+    visit_t* v = cookie;
+    size_t n = drv - drivers;
+    if (n < v->last) {
+        v->in_order = false;
+    }
+    v->last = n;
+    v->visited[n] = true;
+    return false;
+}
+
+static bool index_ready;
+
+static bool add_drivers(void) {
+    BEGIN_HELPER;
+    if (!index_ready) {
+        for (size_t n = 0; n < countof(drivers); n++) {
+            ASSERT_EQ(devhost_bind_index_add(&drivers[n]), NO_ERROR, drivers[n].name);
+        }
+        index_ready = true;
+    }
+    END_HELPER;
+}
+
+// Checks that the index visits, in the order they were added, every driver
+// whose program matches |dev|, and returns which drivers it visited.
+static bool check_device(mx_device_t* dev, visit_t* v) {
+    BEGIN_HELPER;
+    ASSERT_TRUE(add_drivers(), "");
+    memset(v, 0, sizeof(*v));
+    v->in_order = true;
+    devhost_bind_index_foreach(dev, visit, v);
+    EXPECT_TRUE(v->in_order, "drivers visited out of order");
+    for (size_t n = 0; n < countof(drivers); n++) {
+        if (devhost_is_bindable_drv(&drivers[n], dev, true) ||
+            devhost_is_bindable_drv(&drivers[n], dev, false)) {
+            EXPECT_TRUE(v->visited[n], drivers[n].name);
+        }
+    }
+    END_HELPER;
+}
+
+static size_t driver_index(const char* name) {
+    for (size_t n = 0; n < countof(drivers); n++) {
+        if (!strcmp(drivers[n].name, name)) {
+            return n;
+        }
+    }
+    return countof(drivers);
+}
+
+static bool visited(visit_t* v, const char* name) {
+    return v->visited[driver_index(name)];
+}
+
+static bool pci_devices_test(void) {
+    BEGIN_TEST;
+    mx_device_t dev;
+    visit_t v;
+
+    init_device(&dev, MX_PROTOCOL_PCI, intel_gpu_props, countof(intel_gpu_props));
+    ASSERT_TRUE(check_device(&dev, &v), "");
+    EXPECT_TRUE(visited(&v, "pci_intel"), "");
+    EXPECT_TRUE(visited(&v, "pci_did"), "");
+    EXPECT_FALSE(visited(&v, "usb_google"), "");
+    EXPECT_FALSE(visited(&v, "block_or_misc"), "");
+
+    // the vendor filter keeps the intel-only driver away
+    init_device(&dev, MX_PROTOCOL_PCI, nvidia_props, countof(nvidia_props));
+    ASSERT_TRUE(check_device(&dev, &v), "");
+    EXPECT_FALSE(visited(&v, "pci_intel"), "");
+    EXPECT_TRUE(visited(&v, "pci_did"), "");
+    END_TEST;
+}
+
+static bool usb_devices_test(void) {
+    BEGIN_TEST;
+    mx_device_t dev;
+    visit_t v;
+
+    init_device(&dev, MX_PROTOCOL_USB, google_usb_props, countof(google_usb_props));
+    ASSERT_TRUE(check_device(&dev, &v), "");
+    EXPECT_TRUE(visited(&v, "usb_google"), "");
+    EXPECT_TRUE(visited(&v, "usb_goto"), "");
+    EXPECT_FALSE(visited(&v, "pci_did"), "");
+
+    init_device(&dev, MX_PROTOCOL_USB, other_usb_props, countof(other_usb_props));
+    ASSERT_TRUE(check_device(&dev, &v), "");
+    EXPECT_FALSE(visited(&v, "usb_google"), "");
+    EXPECT_TRUE(visited(&v, "usb_goto"), "");
+    END_TEST;
+}
+
+static bool protocol_only_devices_test(void) {
+    BEGIN_TEST;
+    mx_device_t dev;
+    visit_t v;
+
+    // no properties: the protocol comes from the device
+    init_device(&dev, MX_PROTOCOL_MISC, NULL, 0);
+    ASSERT_TRUE(check_device(&dev, &v), "");
+    EXPECT_TRUE(visited(&v, "block_or_misc"), "");
+    EXPECT_FALSE(visited(&v, "usb_goto"), "");
+
+    init_device(&dev, MX_PROTOCOL_MISC, block_props, countof(block_props));
+    ASSERT_TRUE(check_device(&dev, &v), "");
+    EXPECT_TRUE(visited(&v, "block_or_misc"), "");
+
+    init_device(&dev, MX_PROTOCOL_CONSOLE, NULL, 0);
+    ASSERT_TRUE(check_device(&dev, &v), "");
+    EXPECT_FALSE(visited(&v, "block_or_misc"), "");
+    END_TEST;
+}
+
+// Programs the index cannot tie to protocols are tried against everything.
+static bool generic_drivers_test(void) {
+    BEGIN_TEST;
+    mx_device_t dev;
+    visit_t v;
+
+    init_device(&dev, MX_PROTOCOL_PCI, nvidia_props, countof(nvidia_props));
+    ASSERT_TRUE(check_device(&dev, &v), "");
+    EXPECT_TRUE(visited(&v, "not_pci"), "");
+    EXPECT_TRUE(visited(&v, "on_request"), "");
+    EXPECT_FALSE(visited(&v, "never"), "");
+
+    init_device(&dev, MX_PROTOCOL_BLOCK, NULL, 0);
+    ASSERT_TRUE(check_device(&dev, &v), "");
+    EXPECT_TRUE(visited(&v, "not_pci"), "");
+    EXPECT_TRUE(visited(&v, "on_request"), "");
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(devhost_binding_tests)
+RUN_TEST(pci_devices_test)
+RUN_TEST(usb_devices_test)
+RUN_TEST(protocol_only_devices_test)
+RUN_TEST(generic_drivers_test)
+END_TEST_CASE(devhost_binding_tests)
+
+#ifndef BUILD_COMBINED_TESTS
+int main(int argc, char** argv) {
+    return unittest_run_all_tests(argc, argv) ? 0 : -1;
+}
+#endif
@@ -0,0 +1,25 @@
+# Copyright 2017 The Fuchsia Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+LOCAL_DIR := $(GET_LOCAL_DIR)
+
+MODULE := $(LOCAL_DIR)
+
+MODULE_TYPE := usertest
+
+# Tests the binding program index in system/core/devmgr, which is built
+# into this test rather than into a library of its own.
+MODULE_SRCS += \
+    $(LOCAL_DIR)/devhost-binding.c \
+    system/core/devmgr/devhost-binding.c \
+
+MODULE_NAME := devhost-binding-test
+
+MODULE_COMPILEFLAGS := -Isystem/core/devmgr
+
+MODULE_HEADER_DEPS := system/ulib/ddk
+
+MODULE_LIBS := system/ulib/unittest system/ulib/mxio system/ulib/magenta system/ulib/c
+
+include make/module.mk
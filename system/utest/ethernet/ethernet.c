@@ -0,0 +1,186 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <magenta/device/ethernet.h>
+#include <magenta/syscalls.h>
+#include <unittest/unittest.h>
+
+#include "ethernet-rx.h"
+
+// a small fifo makes it easy to fill
+#define TEST_DEPTH 4
+#define TEST_BUFSIZE 64
+
+typedef struct rx_test {
+    mx_handle_t client;
+    mx_handle_t driver;
+    eth_rx_t rx;
+    uint8_t io_buf[TEST_DEPTH * TEST_BUFSIZE];
+} rx_test_t;
+
+static bool rx_test_init(rx_test_t* t) {
+    BEGIN_HELPER;
+    memset(t, 0, sizeof(*t));
+    ASSERT_EQ(mx_fifo_create(TEST_DEPTH, sizeof(eth_fifo_entry_t), 0,
+                             &t->client, &t->driver), NO_ERROR, "");
+    END_HELPER;
+}
+
+static void rx_test_fini(rx_test_t* t) {
+    mx_handle_close(t->client);
+    mx_handle_close(t->driver);
+}
+
+// queue TEST_DEPTH empty buffers from the client, tagged with
+// cookies first, first + 1, ...
+static bool queue_buffers(rx_test_t* t, uintptr_t first) {
+    BEGIN_HELPER;
+    eth_fifo_entry_t entries[TEST_DEPTH];
+    for (uint32_t n = 0; n < TEST_DEPTH; n++) {
+        entries[n].offset = n * TEST_BUFSIZE;
+        entries[n].length = TEST_BUFSIZE;
+        entries[n].flags = 0;
+        entries[n].cookie = (void*)(first + n);
+    }
+    uint32_t actual;
+    ASSERT_EQ(mx_fifo_write(t->client, entries, sizeof(entries), &actual), NO_ERROR, "");
+    ASSERT_EQ(actual, (uint32_t)TEST_DEPTH, "");
+    END_HELPER;
+}
+
+static void recv_packet(rx_test_t* t, uint8_t tag) {
+    uint8_t data[16];
+    memset(data, tag, sizeof(data));
+    eth_rx_handle(&t->rx, t->driver, t->io_buf, sizeof(t->io_buf), data, sizeof(data), 0);
+}
+
+// read count buffers back on the client side and check that they
+// carry the expected cookies, with a packet in them or not
+static bool expect_buffers(rx_test_t* t, uintptr_t first, uint32_t count, bool filled) {
+    BEGIN_HELPER;
+    eth_fifo_entry_t entries[TEST_DEPTH];
+    uint32_t actual;
+    ASSERT_EQ(mx_fifo_read(t->client, entries, sizeof(entries[0]) * count, &actual),
+              NO_ERROR, "");
+    ASSERT_EQ(actual, count, "");
+    for (uint32_t n = 0; n < count; n++) {
+        EXPECT_EQ((uintptr_t)entries[n].cookie, first + n, "wrong buffer returned");
+        if (filled) {
+            EXPECT_EQ(entries[n].flags, ETH_FIFO_RX_OK, "");
+            EXPECT_EQ(entries[n].length, 16u, "");
+        } else {
+            EXPECT_EQ(entries[n].flags, 0u, "");
+            EXPECT_EQ(entries[n].length, 0u, "");
+        }
+    }
+    END_HELPER;
+}
+
+static bool rx_fifo_full_test(void) {
+    BEGIN_TEST;
+    rx_test_t* t = malloc(sizeof(*t));
+    ASSERT_NONNULL(t, "");
+    ASSERT_TRUE(rx_test_init(t), "");
+
+    // fill the client's side of the fifo
+    ASSERT_TRUE(queue_buffers(t, 0), "");
+    for (uint8_t n = 0; n < TEST_DEPTH; n++) {
+        recv_packet(t, n);
+    }
+    ASSERT_EQ(eth_rx_flush(&t->rx, t->driver), NO_ERROR, "");
+
+    // with no room, filled buffers stay queued rather than being lost
+    ASSERT_TRUE(queue_buffers(t, TEST_DEPTH), "");
+    recv_packet(t, 4);
+    recv_packet(t, 5);
+    EXPECT_EQ(eth_rx_flush(&t->rx, t->driver), ERR_SHOULD_WAIT, "");
+    EXPECT_EQ(t->rx.done_count, 2u, "");
+    EXPECT_EQ(mx_object_wait_one(t->driver, MX_FIFO_WRITABLE, 0, NULL), ERR_TIMED_OUT, "");
+
+    // once the client drains the fifo it becomes writable and
+    // the queued buffers go out in order
+    ASSERT_TRUE(expect_buffers(t, 0, TEST_DEPTH, true), "");
+    EXPECT_EQ(mx_object_wait_one(t->driver, MX_FIFO_WRITABLE, 0, NULL), NO_ERROR, "");
+    EXPECT_EQ(eth_rx_flush(&t->rx, t->driver), NO_ERROR, "");
+    EXPECT_EQ(t->rx.done_count, 0u, "");
+    ASSERT_TRUE(expect_buffers(t, TEST_DEPTH, 2, true), "");
+    EXPECT_EQ(memcmp(t->io_buf + TEST_BUFSIZE, "\5\5\5\5", 4), 0, "");
+
+    rx_test_fini(t);
+    free(t);
+    END_TEST;
+}
+
+static bool rx_release_test(void) {
+    BEGIN_TEST;
+    rx_test_t* t = malloc(sizeof(*t));
+    ASSERT_NONNULL(t, "");
+    ASSERT_TRUE(rx_test_init(t), "");
+
+    // one packet pulls all of the client's buffers into the cache
+    ASSERT_TRUE(queue_buffers(t, 0), "");
+    recv_packet(t, 0);
+    ASSERT_EQ(eth_rx_flush(&t->rx, t->driver), NO_ERROR, "");
+    ASSERT_TRUE(expect_buffers(t, 0, 1, true), "");
+
+    // stopping hands the unused ones back empty
+    EXPECT_EQ(eth_rx_release(&t->rx, t->driver), NO_ERROR, "");
+    EXPECT_EQ(t->rx.avail_count, 0u, "");
+    ASSERT_TRUE(expect_buffers(t, 1, TEST_DEPTH - 1, false), "");
+
+    // and starting again uses buffers the client queues afterwards
+    ASSERT_TRUE(queue_buffers(t, 100), "");
+    recv_packet(t, 1);
+    ASSERT_EQ(eth_rx_flush(&t->rx, t->driver), NO_ERROR, "");
+    ASSERT_TRUE(expect_buffers(t, 100, 1, true), "");
+
+    rx_test_fini(t);
+    free(t);
+    END_TEST;
+}
+
+static bool rx_release_fifo_full_test(void) {
+    BEGIN_TEST;
+    rx_test_t* t = malloc(sizeof(*t));
+    ASSERT_NONNULL(t, "");
+    ASSERT_TRUE(rx_test_init(t), "");
+
+    ASSERT_TRUE(queue_buffers(t, 0), "");
+    for (uint8_t n = 0; n < TEST_DEPTH; n++) {
+        recv_packet(t, n);
+    }
+    ASSERT_EQ(eth_rx_flush(&t->rx, t->driver), NO_ERROR, "");
+    ASSERT_TRUE(queue_buffers(t, TEST_DEPTH), "");
+    recv_packet(t, 4);
+
+    // the fifo is full, so the released buffers wait behind the filled one
+    EXPECT_EQ(eth_rx_release(&t->rx, t->driver), ERR_SHOULD_WAIT, "");
+    EXPECT_EQ(t->rx.done_count, (uint32_t)TEST_DEPTH, "");
+    EXPECT_EQ(t->rx.avail_count, 0u, "");
+
+    ASSERT_TRUE(expect_buffers(t, 0, TEST_DEPTH, true), "");
+    EXPECT_EQ(eth_rx_flush(&t->rx, t->driver), NO_ERROR, "");
+    ASSERT_TRUE(expect_buffers(t, TEST_DEPTH, 1, true), "");
+    ASSERT_TRUE(expect_buffers(t, TEST_DEPTH + 1, TEST_DEPTH - 1, false), "");
+
+    rx_test_fini(t);
+    free(t);
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(ethernet_rx_tests)
+RUN_TEST(rx_fifo_full_test)
+RUN_TEST(rx_release_test)
+RUN_TEST(rx_release_fifo_full_test)
+END_TEST_CASE(ethernet_rx_tests)
+
+#ifndef BUILD_COMBINED_TESTS
+int main(int argc, char** argv) {
+    return unittest_run_all_tests(argc, argv) ? 0 : -1;
+}
+#endif
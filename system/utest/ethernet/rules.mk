@@ -0,0 +1,23 @@
+# Copyright 2017 The Fuchsia Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+LOCAL_DIR := $(GET_LOCAL_DIR)
+
+MODULE := $(LOCAL_DIR)
+
+MODULE_TYPE := usertest
+
+# Tests the rx buffer handling in system/udev/ethernet, which is built
+# into this test rather than into a library of its own.
+MODULE_SRCS += \
+    $(LOCAL_DIR)/ethernet.c \
+    system/udev/ethernet/ethernet-rx.c \
+
+MODULE_NAME := ethernet-test
+
+MODULE_COMPILEFLAGS := -Isystem/udev/ethernet
+
+MODULE_LIBS := system/ulib/unittest system/ulib/mxio system/ulib/magenta system/ulib/c
+
+include make/module.mk
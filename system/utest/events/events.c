@@ -3,6 +3,7 @@
 // found in the LICENSE file.
 
 #include <assert.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -273,12 +274,80 @@ static bool wait_many_failures_test(void) {
     END_TEST;
 }
 
+typedef struct {
+    mx_handle_t event;
+    mx_signals_t signals;
+    mx_signals_t observed;
+    atomic_int done;
+} waiter_t;
+
+static int waiter_thread(void* arg) {
+    waiter_t* waiter = arg;
+    mx_status_t status = mx_object_wait_one(waiter->event, waiter->signals, MX_TIME_INFINITE,
+                                            &waiter->observed);
+    atomic_store(&waiter->done, 1);
+    return status;
+}
+
+#define NUM_MASKS 5
+#define WAITERS_PER_MASK 4
+
+// More distinct signal masks are waited on than the kernel groups its
+// waiters by, so some are picked out one waiter at a time.
+static bool many_waiters_test(void) {
+    BEGIN_TEST;
+
+    mx_handle_t event;
+    ASSERT_EQ(mx_event_create(0u, &event), NO_ERROR, "");
+
+    waiter_t waiters[NUM_MASKS][WAITERS_PER_MASK];
+    thrd_t threads[NUM_MASKS][WAITERS_PER_MASK];
+    for (int mask = 0; mask < NUM_MASKS; mask++) {
+        for (int ix = 0; ix < WAITERS_PER_MASK; ix++) {
+            waiter_t* waiter = &waiters[mask][ix];
+            waiter->event = event;
+            waiter->signals = MX_USER_SIGNAL_0 << mask;
+            waiter->observed = 0u;
+            atomic_init(&waiter->done, 0);
+            ASSERT_EQ(thrd_create(&threads[mask][ix], waiter_thread, waiter), thrd_success, "");
+        }
+    }
+
+    // Signals nobody waits on must not wake anyone.
+    for (int i = 0; i < 100; i++) {
+        ASSERT_EQ(mx_object_signal(event, 0u, MX_USER_SIGNAL_7), NO_ERROR, "");
+        ASSERT_EQ(mx_object_signal(event, MX_USER_SIGNAL_7, 0u), NO_ERROR, "");
+    }
+
+    mx_signals_t asserted = 0u;
+    for (int mask = 0; mask < NUM_MASKS; mask++) {
+        asserted |= MX_USER_SIGNAL_0 << mask;
+        ASSERT_EQ(mx_object_signal(event, 0u, MX_USER_SIGNAL_0 << mask), NO_ERROR, "");
+
+        for (int ix = 0; ix < WAITERS_PER_MASK; ix++) {
+            int result;
+            ASSERT_EQ(thrd_join(threads[mask][ix], &result), thrd_success, "");
+            EXPECT_EQ(result, NO_ERROR, "");
+            EXPECT_EQ(waiters[mask][ix].observed & asserted, asserted, "");
+        }
+        for (int later = mask + 1; later < NUM_MASKS; later++) {
+            for (int ix = 0; ix < WAITERS_PER_MASK; ix++)
+                EXPECT_EQ(atomic_load(&waiters[later][ix].done), 0, "woken too early");
+        }
+    }
+
+    ASSERT_EQ(mx_handle_close(event), NO_ERROR, "");
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(event_tests)
 RUN_TEST(basic_test)
 RUN_TEST(user_signals_test)
 RUN_TEST(wait_signals_test)
 RUN_TEST(reset_test)
 RUN_TEST(wait_many_failures_test)
+RUN_TEST(many_waiters_test)
 END_TEST_CASE(event_tests)
 
 int main(int argc, char** argv) {
@@ -19,8 +19,10 @@ MODULE_SRCS := \
     $(LOCAL_DIR)/test-append.c \
     $(LOCAL_DIR)/test-basic.c \
     $(LOCAL_DIR)/test-directory.c \
+    $(LOCAL_DIR)/test-large-io.c \
     $(LOCAL_DIR)/test-link.c \
     $(LOCAL_DIR)/test-maxfile.c \
+    $(LOCAL_DIR)/test-mmap.c \
     $(LOCAL_DIR)/test-overflow.c \
     $(LOCAL_DIR)/test-persist.c \
     $(LOCAL_DIR)/test-rw-workers.c \
@@ -4,6 +4,7 @@
 
 #include <assert.h>
 #include <dirent.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
 #include <stdbool.h>
@@ -15,6 +16,8 @@
 #include <unistd.h>
 
 #include <magenta/compiler.h>
+#include <mxio/io.h>
+#include <mxio/vfs.h>
 
 #include "filesystems.h"
 #include "misc.h"
@@ -252,6 +255,187 @@ bool test_directory_readdir(void) {
     END_TEST;
 }
 
+bool test_directory_readdir_large(void) {
+    BEGIN_TEST;
+
+    const int num_entries = 1000;
+    ASSERT_EQ(mkdir("::dir", 0755), 0, "");
+    for (int i = 0; i < num_entries; i++) {
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "::dir/%05d", i);
+        ASSERT_EQ(mkdir(path, 0755), 0, "");
+    }
+
+    // Every entry must be returned exactly once, even though it takes many
+    // readdir calls to enumerate them all.
+    bool* seen = calloc(num_entries, sizeof(bool));
+    ASSERT_NEQ(seen, NULL, "");
+    DIR* dir = opendir("::dir");
+    ASSERT_NEQ(dir, NULL, "");
+    int count = 0;
+    struct dirent* de;
+    while ((de = readdir(dir)) != NULL) {
+        if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, "..")) {
+            continue;
+        }
+        int i = atoi(de->d_name);
+        ASSERT_GE(i, 0, "");
+        ASSERT_LT(i, num_entries, "");
+        ASSERT_FALSE(seen[i], "Direntry seen twice");
+        seen[i] = true;
+        count++;
+    }
+    ASSERT_EQ(count, num_entries, "");
+    ASSERT_EQ(closedir(dir), 0, "");
+    free(seen);
+
+    // Lookups by name must still succeed, and fail for absent names.
+    for (int i = 0; i < num_entries; i++) {
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "::dir/%05d", i);
+        struct stat st;
+        ASSERT_EQ(stat(path, &st), 0, "");
+        ASSERT_TRUE(S_ISDIR(st.st_mode), "");
+    }
+    struct stat st;
+    ASSERT_EQ(stat("::dir/99999", &st), -1, "");
+
+    for (int i = 0; i < num_entries; i++) {
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "::dir/%05d", i);
+        ASSERT_EQ(rmdir(path), 0, "");
+    }
+    ASSERT_EQ(rmdir("::dir"), 0, "");
+
+    END_TEST;
+}
+
+static bool check_churn_entry(int i, bool exists) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "::churn/file-%d", i);
+    struct stat st;
+    if (exists) {
+        ASSERT_EQ(stat(path, &st), 0, "");
+    } else {
+        ASSERT_EQ(stat(path, &st), -1, "");
+        ASSERT_EQ(errno, ENOENT, "");
+    }
+    return true;
+}
+
+bool test_directory_large_churn(void) {
+    BEGIN_TEST;
+
+    // Large enough that minfs indexes the directory and splits the index.
+    const int num_files = 2500;
+    ASSERT_EQ(mkdir("::churn", 0755), 0, "");
+    for (int i = 0; i < num_files; i++) {
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "::churn/file-%d", i);
+        int fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+        ASSERT_GT(fd, 0, "");
+        ASSERT_EQ(close(fd), 0, "");
+    }
+
+    // Remove every other file, and move half of the rest aside.
+    for (int i = 0; i < num_files; i += 2) {
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "::churn/file-%d", i);
+        ASSERT_EQ(unlink(path), 0, "");
+    }
+    for (int i = 1; i < num_files; i += 4) {
+        char src[PATH_MAX];
+        char dst[PATH_MAX];
+        snprintf(src, sizeof(src), "::churn/file-%d", i);
+        snprintf(dst, sizeof(dst), "::churn/moved-%d", i);
+        ASSERT_EQ(rename(src, dst), 0, "");
+    }
+    for (int i = 0; i < num_files; i++) {
+        ASSERT_TRUE(check_churn_entry(i, i % 4 == 3), "");
+    }
+
+    // Refill the holes, then make sure every name is still found.
+    for (int i = 0; i < num_files; i += 2) {
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "::churn/file-%d", i);
+        int fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+        ASSERT_GT(fd, 0, "");
+        ASSERT_EQ(close(fd), 0, "");
+    }
+    for (int i = 0; i < num_files; i++) {
+        ASSERT_TRUE(check_churn_entry(i, i % 4 != 1), "");
+    }
+
+    int count = 0;
+    DIR* dir = opendir("::churn");
+    ASSERT_NEQ(dir, NULL, "");
+    struct dirent* de;
+    while ((de = readdir(dir)) != NULL) {
+        if (strcmp(de->d_name, ".") && strcmp(de->d_name, "..")) {
+            char path[PATH_MAX];
+            snprintf(path, sizeof(path), "::churn/%s", de->d_name);
+            ASSERT_EQ(unlink(path), 0, "");
+            count++;
+        }
+    }
+    ASSERT_EQ(closedir(dir), 0, "");
+    ASSERT_EQ(count, num_files, "");
+    ASSERT_EQ(rmdir("::churn"), 0, "");
+
+    END_TEST;
+}
+
+bool test_directory_readdir_attr(void) {
+    BEGIN_TEST;
+
+    ASSERT_EQ(mkdir("::a", 0755), 0, "");
+    ASSERT_EQ(mkdir("::a/dir", 0755), 0, "");
+    int fd = open("::a/file", O_RDWR | O_CREAT | O_EXCL, 0644);
+    ASSERT_GT(fd, 0, "");
+    ASSERT_STREAM_ALL(write, fd, "hello", 5);
+    ASSERT_EQ(close(fd), 0, "");
+
+    // Attributes returned with the names must agree with stat().
+    DIR* dir = opendir("::a");
+    ASSERT_NEQ(dir, NULL, "");
+    int seen = 0;
+    struct dirent* de;
+    vnattr_t attr;
+    while ((de = mxio_readdir_attr(dir, &attr)) != NULL) {
+        if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, "..")) {
+            ASSERT_TRUE(S_ISDIR(attr.mode), "");
+            continue;
+        }
+        struct stat st;
+        ASSERT_EQ(fstatat(dirfd(dir), de->d_name, &st, 0), 0, "");
+        ASSERT_EQ(attr.mode, st.st_mode, "");
+        ASSERT_EQ(attr.inode, st.st_ino, "");
+        ASSERT_EQ((off_t)attr.size, st.st_size, "");
+        if (!strcmp(de->d_name, "file")) {
+            ASSERT_TRUE(S_ISREG(attr.mode), "");
+            ASSERT_EQ(attr.size, 5u, "");
+        } else {
+            ASSERT_EQ(strcmp(de->d_name, "dir"), 0, "");
+            ASSERT_TRUE(S_ISDIR(attr.mode), "");
+        }
+        seen++;
+    }
+    ASSERT_EQ(seen, 2, "");
+    ASSERT_EQ(closedir(dir), 0, "");
+
+    struct stat st;
+    ASSERT_EQ(stat("::a/dir/", &st), 0, "");
+    ASSERT_EQ(stat("::a/file/", &st), -1, "Trailing '/' requires a directory");
+    ASSERT_EQ(stat("::a/missing", &st), -1, "");
+    ASSERT_EQ(errno, ENOENT, "");
+
+    ASSERT_EQ(unlink("::a/file"), 0, "");
+    ASSERT_EQ(rmdir("::a/dir"), 0, "");
+    ASSERT_EQ(rmdir("::a"), 0, "");
+
+    END_TEST;
+}
+
 bool test_directory_rewind(void) {
     BEGIN_TEST;
 
@@ -344,6 +528,9 @@ RUN_FOR_ALL_FILESYSTEMS(directory_tests,
     RUN_TEST_LARGE(test_directory_large)
     RUN_TEST_MEDIUM(test_directory_trailing_slash)
     RUN_TEST_MEDIUM(test_directory_readdir)
+    RUN_TEST_LARGE(test_directory_readdir_large)
+    RUN_TEST_LARGE(test_directory_large_churn)
+    RUN_TEST_MEDIUM(test_directory_readdir_attr)
     RUN_TEST_MEDIUM(test_directory_rewind)
     RUN_TEST_MEDIUM(test_directory_after_rmdir)
 )
@@ -0,0 +1,108 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <mxio/limits.h>
+#include <mxio/remoteio.h>
+
+#include "filesystems.h"
+#include "misc.h"
+
+// Large enough to take several VMO transfers, plus a tail small enough to
+// go a chunk at a time.
+#define LARGE_SIZE (3 * MXIO_VMO_XFER_MAX + MXIO_CHUNK_SIZE + 123)
+
+static void fill(uint8_t* buf, size_t len, unsigned seed) {
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = (uint8_t)((i * 31 + seed) >> 3);
+    }
+}
+
+bool test_large_read_write(void) {
+    BEGIN_TEST;
+
+    uint8_t* data = malloc(LARGE_SIZE);
+    uint8_t* buf = malloc(LARGE_SIZE);
+    ASSERT_NONNULL(data, "");
+    ASSERT_NONNULL(buf, "");
+    fill(data, LARGE_SIZE, 1);
+
+    int fd = open("::large", O_RDWR | O_CREAT, 0644);
+    ASSERT_GT(fd, 0, "");
+    ASSERT_EQ(write(fd, data, LARGE_SIZE), LARGE_SIZE, "");
+    ASSERT_EQ(lseek(fd, 0, SEEK_CUR), LARGE_SIZE, "");
+
+    ASSERT_EQ(lseek(fd, 0, SEEK_SET), 0, "");
+    ASSERT_EQ(read(fd, buf, LARGE_SIZE), LARGE_SIZE, "");
+    ASSERT_EQ(memcmp(buf, data, LARGE_SIZE), 0, "");
+    ASSERT_EQ(lseek(fd, 0, SEEK_CUR), LARGE_SIZE, "");
+
+    // Short reads stop at the end of the file.
+    ASSERT_EQ(lseek(fd, LARGE_SIZE - 100, SEEK_SET), LARGE_SIZE - 100, "");
+    ASSERT_EQ(read(fd, buf, LARGE_SIZE), 100, "");
+    ASSERT_EQ(memcmp(buf, data + LARGE_SIZE - 100, 100), 0, "");
+    ASSERT_EQ(read(fd, buf, LARGE_SIZE), 0, "");
+
+    // Positioned io leaves the seek offset alone.
+    const size_t at = 5000;
+    const size_t len = MXIO_VMO_XFER_MAX + 4096;
+    fill(data + at, len, 2);
+    ASSERT_EQ(lseek(fd, 0, SEEK_SET), 0, "");
+    ASSERT_EQ(pwrite(fd, data + at, len, at), (ssize_t)len, "");
+    ASSERT_EQ(lseek(fd, 0, SEEK_CUR), 0, "");
+    memset(buf, 0, LARGE_SIZE);
+    ASSERT_EQ(pread(fd, buf, len, at), (ssize_t)len, "");
+    ASSERT_EQ(memcmp(buf, data + at, len), 0, "");
+    ASSERT_EQ(pread(fd, buf, LARGE_SIZE, 0), LARGE_SIZE, "");
+    ASSERT_EQ(memcmp(buf, data, LARGE_SIZE), 0, "");
+    ASSERT_EQ(lseek(fd, 0, SEEK_CUR), 0, "");
+
+    ASSERT_EQ(close(fd), 0, "");
+    ASSERT_EQ(unlink("::large"), 0, "");
+    free(data);
+    free(buf);
+    END_TEST;
+}
+
+bool test_large_append(void) {
+    BEGIN_TEST;
+
+    uint8_t* data = malloc(LARGE_SIZE);
+    uint8_t* buf = malloc(LARGE_SIZE);
+    ASSERT_NONNULL(data, "");
+    ASSERT_NONNULL(buf, "");
+    fill(data, LARGE_SIZE, 3);
+    const size_t first = 1000;
+
+    int fd = open("::large", O_RDWR | O_CREAT | O_APPEND, 0644);
+    ASSERT_GT(fd, 0, "");
+    ASSERT_EQ(write(fd, data, first), (ssize_t)first, "");
+    ASSERT_EQ(lseek(fd, 0, SEEK_SET), 0, "");
+    ASSERT_EQ(write(fd, data + first, LARGE_SIZE - first), (ssize_t)(LARGE_SIZE - first), "");
+    ASSERT_EQ(lseek(fd, 0, SEEK_CUR), LARGE_SIZE, "");
+
+    struct stat st;
+    ASSERT_EQ(fstat(fd, &st), 0, "");
+    ASSERT_EQ(st.st_size, LARGE_SIZE, "");
+    ASSERT_EQ(pread(fd, buf, LARGE_SIZE, 0), LARGE_SIZE, "");
+    ASSERT_EQ(memcmp(buf, data, LARGE_SIZE), 0, "");
+
+    ASSERT_EQ(close(fd), 0, "");
+    ASSERT_EQ(unlink("::large"), 0, "");
+    free(data);
+    free(buf);
+    END_TEST;
+}
+
+RUN_FOR_ALL_FILESYSTEMS(large_io_tests,
+    RUN_TEST_MEDIUM(test_large_read_write)
+    RUN_TEST_MEDIUM(test_large_append)
+)
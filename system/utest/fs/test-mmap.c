@@ -0,0 +1,89 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "filesystems.h"
+#include "misc.h"
+
+#define MMAP_FILE_SIZE (3 * PAGE_SIZE + 17)
+
+static bool mmap_make_file(const char* path, uint8_t* buf, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = (uint8_t)(i * 7 + 3);
+    }
+    int fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+    ASSERT_GT(fd, 0, "");
+    ASSERT_STREAM_ALL(write, fd, buf, len);
+    ASSERT_EQ(close(fd), 0, "");
+    return true;
+}
+
+bool test_mmap_readonly(void) {
+    BEGIN_TEST;
+
+    uint8_t* buf = malloc(MMAP_FILE_SIZE);
+    ASSERT_NEQ(buf, NULL, "");
+    ASSERT_TRUE(mmap_make_file("::alpha", buf, MMAP_FILE_SIZE), "");
+
+    int fd = open("::alpha", O_RDONLY);
+    ASSERT_GT(fd, 0, "");
+    uint8_t* addr = mmap(NULL, MMAP_FILE_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+    ASSERT_NEQ(addr, MAP_FAILED, "");
+    ASSERT_EQ(memcmp(addr, buf, MMAP_FILE_SIZE), 0, "");
+    ASSERT_EQ(munmap(addr, MMAP_FILE_SIZE), 0, "");
+
+    // The mapping may start anywhere page aligned within the file.
+    addr = mmap(NULL, MMAP_FILE_SIZE - PAGE_SIZE, PROT_READ, MAP_PRIVATE, fd, PAGE_SIZE);
+    ASSERT_NEQ(addr, MAP_FAILED, "");
+    ASSERT_EQ(memcmp(addr, buf + PAGE_SIZE, MMAP_FILE_SIZE - PAGE_SIZE), 0, "");
+    ASSERT_EQ(munmap(addr, MMAP_FILE_SIZE - PAGE_SIZE), 0, "");
+
+    // A file opened read-only cannot be mapped shared and writable.
+    ASSERT_EQ(mmap(NULL, PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0), MAP_FAILED, "");
+
+    ASSERT_EQ(close(fd), 0, "");
+    ASSERT_EQ(unlink("::alpha"), 0, "");
+    free(buf);
+
+    END_TEST;
+}
+
+bool test_mmap_private_write(void) {
+    BEGIN_TEST;
+
+    uint8_t* buf = malloc(MMAP_FILE_SIZE);
+    ASSERT_NEQ(buf, NULL, "");
+    ASSERT_TRUE(mmap_make_file("::alpha", buf, MMAP_FILE_SIZE), "");
+
+    int fd = open("::alpha", O_RDWR);
+    ASSERT_GT(fd, 0, "");
+    uint8_t* addr = mmap(NULL, MMAP_FILE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ASSERT_NEQ(addr, MAP_FAILED, "");
+    ASSERT_EQ(memcmp(addr, buf, MMAP_FILE_SIZE), 0, "");
+
+    // Stores into a private mapping stay out of the file.
+    memset(addr, 0xee, MMAP_FILE_SIZE);
+    ASSERT_TRUE(check_file_contents(fd, buf, MMAP_FILE_SIZE), "");
+    ASSERT_EQ(munmap(addr, MMAP_FILE_SIZE), 0, "");
+
+    ASSERT_EQ(close(fd), 0, "");
+    ASSERT_EQ(unlink("::alpha"), 0, "");
+    free(buf);
+
+    END_TEST;
+}
+
+RUN_FOR_ALL_FILESYSTEMS(mmap_tests,
+    RUN_TEST_MEDIUM(test_mmap_readonly)
+    RUN_TEST_MEDIUM(test_mmap_private_write)
+)
@@ -300,7 +300,82 @@ static bool test_work_concurrently(void) {
     END_TEST;
 }
 
+#define NUM_READ_FILES 4
+#define READERS_PER_FILE 2
+#define READ_FILE_SIZE (256 * 1024)
+#define READ_PASSES 8
+
+// Each reader opens its own descriptor, so readers of the same file and
+// of different files are served at once where the filesystem allows it.
+static int do_threaded_read(void* arg) {
+    int n = (int)(uintptr_t)arg;
+    char name[32];
+    snprintf(name, sizeof(name), "::read%d", n);
+    int fd = open(name, O_RDONLY);
+    if (fd < 0) {
+        return FAIL;
+    }
+    uint8_t buf[8192];
+    for (int pass = 0; pass < READ_PASSES; pass++) {
+        if (lseek(fd, 0, SEEK_SET) != 0) {
+            close(fd);
+            return FAIL;
+        }
+        for (size_t off = 0; off < READ_FILE_SIZE; off += sizeof(buf)) {
+            if (read(fd, buf, sizeof(buf)) != sizeof(buf)) {
+                close(fd);
+                return FAIL;
+            }
+            for (size_t i = 0; i < sizeof(buf); i++) {
+                if (buf[i] != (uint8_t)(n + (off + i) / 512)) {
+                    close(fd);
+                    return FAIL;
+                }
+            }
+        }
+    }
+    close(fd);
+    return DONE;
+}
+
+static bool test_read_concurrently(void) {
+    BEGIN_TEST;
+
+    uint8_t buf[512];
+    for (int n = 0; n < NUM_READ_FILES; n++) {
+        char name[32];
+        snprintf(name, sizeof(name), "::read%d", n);
+        int fd = open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+        ASSERT_GT(fd, 0, "");
+        for (size_t off = 0; off < READ_FILE_SIZE; off += sizeof(buf)) {
+            memset(buf, n + off / sizeof(buf), sizeof(buf));
+            ASSERT_EQ(write(fd, buf, sizeof(buf)), (ssize_t)sizeof(buf), "");
+        }
+        ASSERT_EQ(close(fd), 0, "");
+    }
+
+    thrd_t threads[NUM_READ_FILES * READERS_PER_FILE];
+    for (int i = 0; i < NUM_READ_FILES * READERS_PER_FILE; i++) {
+        ASSERT_EQ(thrd_create(&threads[i], do_threaded_read,
+                              (void*)(uintptr_t)(i % NUM_READ_FILES)), thrd_success, "");
+    }
+    for (int i = 0; i < NUM_READ_FILES * READERS_PER_FILE; i++) {
+        int rc;
+        ASSERT_EQ(thrd_join(threads[i], &rc), thrd_success, "");
+        ASSERT_EQ(rc, DONE, "Reader saw the wrong data");
+    }
+
+    for (int n = 0; n < NUM_READ_FILES; n++) {
+        char name[32];
+        snprintf(name, sizeof(name), "::read%d", n);
+        ASSERT_EQ(unlink(name), 0, "");
+    }
+
+    END_TEST;
+}
+
 RUN_FOR_ALL_FILESYSTEMS(rw_workers_test,
     RUN_TEST_MEDIUM(test_work_single_thread)
     RUN_TEST_LARGE(test_work_concurrently)
+    RUN_TEST_MEDIUM(test_read_concurrently)
 )
@@ -162,7 +162,57 @@ bool test_truncate_large(void) {
     END_TEST;
 }
 
+// Test that truncate releases the right parts of a file written out of
+// order, with holes between its pieces.
+bool test_truncate_sparse(void) {
+    BEGIN_TEST;
+
+    const char* filename = "::alpha";
+    const size_t piece = 8192;
+    const size_t stride = 3 * piece;
+    const int num_pieces = 40;
+    uint8_t* buf = malloc(piece);
+    ASSERT_NEQ(buf, NULL, "");
+
+    // Write the pieces back to front, so no two are ever appended in order
+    int fd = open(filename, O_RDWR | O_CREAT, 0644);
+    ASSERT_GT(fd, 0, "");
+    for (int i = num_pieces - 1; i >= 0; i--) {
+        memset(buf, i + 1, piece);
+        ASSERT_EQ(lseek(fd, i * stride, SEEK_SET), (off_t)(i * stride), "");
+        ASSERT_STREAM_ALL(write, fd, buf, piece);
+    }
+
+    // Cut the file in the middle of a piece, and check both pieces and holes
+    const size_t len = (num_pieces / 2) * stride + piece / 2;
+    ASSERT_EQ(ftruncate(fd, len), 0, "");
+    ASSERT_EQ(lseek(fd, 0, SEEK_SET), 0, "");
+    for (size_t off = 0; off < len; off += piece) {
+        size_t xfer = (len - off < piece) ? len - off : piece;
+        ASSERT_STREAM_ALL(read, fd, buf, xfer);
+        uint8_t expected = (off % stride == 0) ? (uint8_t)(off / stride + 1) : 0;
+        for (size_t n = 0; n < xfer; n++) {
+            ASSERT_EQ(buf[n], expected, "");
+        }
+    }
+
+    // Growing the file again must not resurrect the old contents
+    ASSERT_EQ(ftruncate(fd, num_pieces * stride), 0, "");
+    ASSERT_EQ(lseek(fd, len, SEEK_SET), (off_t)len, "");
+    ASSERT_STREAM_ALL(read, fd, buf, piece);
+    for (size_t n = 0; n < piece; n++) {
+        ASSERT_EQ(buf[n], 0, "");
+    }
+
+    free(buf);
+    ASSERT_EQ(close(fd), 0, "");
+    ASSERT_EQ(unlink(filename), 0, "");
+
+    END_TEST;
+}
+
 RUN_FOR_ALL_FILESYSTEMS(truncate_tests,
     RUN_TEST_MEDIUM(test_truncate_small)
     RUN_TEST_LARGE(test_truncate_large)
+    RUN_TEST_MEDIUM(test_truncate_sparse)
 )
@@ -0,0 +1,178 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gfx/gfx.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <unittest/unittest.h>
+
+// Odd sizes and offsets so every kernel runs its unaligned head and tail.
+#define WIDTH 67
+#define HEIGHT 9
+#define STRIDE 75
+
+static const char* kernels[] = { "sse2", "avx2", "neon" };
+
+static uint32_t next_pixel(uint32_t* seed) {
+    uint32_t x = *seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *seed = x;
+    // make sure the alpha fast paths are covered
+    switch (x % 8) {
+    case 0:
+        return x & 0x00ffffff;
+    case 1:
+        return x | 0xff000000;
+    default:
+        return x;
+    }
+}
+
+static gfx_surface* make_surface(unsigned format, uint32_t seed) {
+    gfx_surface* s = gfx_create_surface(NULL, WIDTH, HEIGHT, STRIDE, format, 0);
+    if (s == NULL) {
+        return NULL;
+    }
+    uint8_t* p = s->ptr;
+    for (size_t i = 0; i < s->len; i++) {
+        p[i] = (uint8_t)next_pixel(&seed);
+    }
+    return s;
+}
+
+// Run op with the generic kernels and with each optimized set, and check
+// that the target surface ends up identical.
+static bool check_kernels(unsigned target_format,
+                          void (*op)(gfx_surface* target, gfx_surface* src)) {
+    BEGIN_HELPER;
+
+    ASSERT_EQ(gfx_set_kernels("generic"), NO_ERROR, "");
+    gfx_surface* src = make_surface(MX_PIXEL_FORMAT_ARGB_8888, 1);
+    gfx_surface* expected = make_surface(target_format, 2);
+    ASSERT_NONNULL(src, "");
+    ASSERT_NONNULL(expected, "");
+    op(expected, src);
+
+    for (size_t k = 0; k < countof(kernels); k++) {
+        if (gfx_set_kernels(kernels[k]) != NO_ERROR) {
+            continue;
+        }
+        gfx_surface* actual = make_surface(target_format, 2);
+        ASSERT_NONNULL(actual, "");
+        op(actual, src);
+        EXPECT_EQ(memcmp(expected->ptr, actual->ptr, expected->len), 0, kernels[k]);
+        gfx_surface_destroy(actual);
+    }
+
+    gfx_surface_destroy(expected);
+    gfx_surface_destroy(src);
+    END_HELPER;
+}
+
+static void fill_op(gfx_surface* target, gfx_surface* src) {
+    gfx_fillrect(target, 3, 1, WIDTH - 4, HEIGHT - 2, 0x80a1b2c3);
+}
+
+static void blend_op(gfx_surface* target, gfx_surface* src) {
+    gfx_blend(target, src, 1, 0, WIDTH - 1, HEIGHT, 2, 1);
+}
+
+static bool fill32_test(void) {
+    BEGIN_TEST;
+    ASSERT_TRUE(check_kernels(MX_PIXEL_FORMAT_RGB_x888, fill_op), "");
+    END_TEST;
+}
+
+static bool fill16_test(void) {
+    BEGIN_TEST;
+    ASSERT_TRUE(check_kernels(MX_PIXEL_FORMAT_RGB_565, fill_op), "");
+    END_TEST;
+}
+
+static bool blend32_test(void) {
+    BEGIN_TEST;
+    ASSERT_TRUE(check_kernels(MX_PIXEL_FORMAT_ARGB_8888, blend_op), "");
+    END_TEST;
+}
+
+static bool convert565_test(void) {
+    BEGIN_TEST;
+    ASSERT_TRUE(check_kernels(MX_PIXEL_FORMAT_RGB_565, blend_op), "");
+    END_TEST;
+}
+
+static bool blend32_values_test(void) {
+    BEGIN_TEST;
+
+    ASSERT_EQ(gfx_set_kernels("generic"), NO_ERROR, "");
+    gfx_surface* src = gfx_create_surface(NULL, 3, 1, 3, MX_PIXEL_FORMAT_ARGB_8888, 0);
+    gfx_surface* dst = gfx_create_surface(NULL, 3, 1, 3, MX_PIXEL_FORMAT_ARGB_8888, 0);
+    ASSERT_NONNULL(src, "");
+    ASSERT_NONNULL(dst, "");
+
+    uint32_t* s = src->ptr;
+    uint32_t* d = dst->ptr;
+    s[0] = 0x00ffffff; // transparent: destination kept
+    s[1] = 0xff123456; // opaque: source copied
+    s[2] = 0x7fff0000; // red: (0xff * 128) / 256 + (0x80 * 127) / 256
+    d[0] = d[1] = d[2] = 0x40808080;
+    gfx_blend(dst, src, 0, 0, 3, 1, 0, 0);
+    EXPECT_EQ(d[0], 0x40808080u, "");
+    EXPECT_EQ(d[1], 0xff123456u, "");
+    EXPECT_EQ(d[2], 0x80be3f3fu, "");
+
+    gfx_surface_destroy(src);
+    gfx_surface_destroy(dst);
+    END_TEST;
+}
+
+static bool copyrect_overlap_test(void) {
+    BEGIN_TEST;
+
+    gfx_surface* s = gfx_create_surface(NULL, WIDTH, HEIGHT, STRIDE, MX_PIXEL_FORMAT_RGB_x888, 0);
+    ASSERT_NONNULL(s, "");
+    uint32_t* p = s->ptr;
+
+    // scroll up, as the console does
+    for (unsigned i = 0; i < STRIDE * HEIGHT; i++) {
+        p[i] = i;
+    }
+    gfx_copyrect(s, 0, 2, WIDTH, HEIGHT - 2, 0, 0);
+    for (unsigned y = 0; y < HEIGHT - 2; y++) {
+        for (unsigned x = 0; x < WIDTH; x++) {
+            ASSERT_EQ(p[y * STRIDE + x], (y + 2) * STRIDE + x, "");
+        }
+    }
+
+    // down and to the right, overlapping within each row
+    for (unsigned i = 0; i < STRIDE * HEIGHT; i++) {
+        p[i] = i;
+    }
+    gfx_copyrect(s, 0, 0, WIDTH - 3, HEIGHT - 1, 3, 1);
+    for (unsigned y = 0; y < HEIGHT - 1; y++) {
+        for (unsigned x = 0; x < WIDTH - 3; x++) {
+            ASSERT_EQ(p[(y + 1) * STRIDE + x + 3], y * STRIDE + x, "");
+        }
+    }
+
+    gfx_surface_destroy(s);
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(gfx_tests)
+RUN_TEST(fill32_test)
+RUN_TEST(fill16_test)
+RUN_TEST(blend32_test)
+RUN_TEST(convert565_test)
+RUN_TEST(blend32_values_test)
+RUN_TEST(copyrect_overlap_test)
+END_TEST_CASE(gfx_tests)
+
+int main(int argc, char** argv) {
+    return unittest_run_all_tests(argc, argv) ? 0 : -1;
+}
@@ -0,0 +1,99 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "harness.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+namespace bench {
+
+Options options;
+
+namespace {
+
+// Summary of one benchmark, in nanoseconds.
+struct Result {
+    const char* name;
+    uint32_t iterations;
+    uint64_t min;
+    uint64_t p50;
+    uint64_t p99;
+    uint64_t max;
+    uint64_t mean;
+};
+
+constexpr size_t kMaxResults = 64;
+Result results[kMaxResults];
+size_t num_results;
+
+int compare_ticks(const void* a, const void* b) {
+    uint64_t ta = *static_cast<const uint64_t*>(a);
+    uint64_t tb = *static_cast<const uint64_t*>(b);
+    return (ta > tb) - (ta < tb);
+}
+
+uint64_t ticks_to_ns(uint64_t ticks) {
+    return static_cast<uint64_t>(static_cast<double>(ticks) * 1e9 /
+                                 static_cast<double>(mx_ticks_per_second()));
+}
+
+} // namespace
+
+bool Record(const char* name, uint64_t* ticks, uint32_t count) {
+    if (count == 0 || num_results == kMaxResults)
+        return false;
+
+    qsort(ticks, count, sizeof(*ticks), compare_ticks);
+    uint64_t sum = 0;
+    for (uint32_t i = 0; i < count; i++)
+        sum += ticks[i];
+
+    Result* r = &results[num_results++];
+    r->name = name;
+    r->iterations = count;
+    r->min = ticks_to_ns(ticks[0]);
+    r->p50 = ticks_to_ns(ticks[count / 2]);
+    r->p99 = ticks_to_ns(ticks[(count * 99) / 100]);
+    r->max = ticks_to_ns(ticks[count - 1]);
+    r->mean = ticks_to_ns(sum / count);
+    return true;
+}
+
+void Report(FILE* out, Format format) {
+    switch (format) {
+    case Format::kText:
+        fprintf(out, "%-36s %8s %10s %10s %10s %10s %10s\n",
+                "benchmark (ns)", "iters", "min", "p50", "p99", "max", "mean");
+        for (size_t i = 0; i < num_results; i++) {
+            const Result& r = results[i];
+            fprintf(out, "%-36s %8u %10" PRIu64 " %10" PRIu64 " %10" PRIu64
+                    " %10" PRIu64 " %10" PRIu64 "\n",
+                    r.name, r.iterations, r.min, r.p50, r.p99, r.max, r.mean);
+        }
+        break;
+    case Format::kCsv:
+        fprintf(out, "name,iterations,min_ns,p50_ns,p99_ns,max_ns,mean_ns\n");
+        for (size_t i = 0; i < num_results; i++) {
+            const Result& r = results[i];
+            fprintf(out, "%s,%u,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n",
+                    r.name, r.iterations, r.min, r.p50, r.p99, r.max, r.mean);
+        }
+        break;
+    case Format::kJson:
+        fprintf(out, "[\n");
+        for (size_t i = 0; i < num_results; i++) {
+            const Result& r = results[i];
+            fprintf(out, "  {\"name\": \"%s\", \"iterations\": %u, \"min_ns\": %" PRIu64
+                    ", \"p50_ns\": %" PRIu64 ", \"p99_ns\": %" PRIu64 ", \"max_ns\": %" PRIu64
+                    ", \"mean_ns\": %" PRIu64 "}%s\n",
+                    r.name, r.iterations, r.min, r.p50, r.p99, r.max, r.mean,
+                    (i + 1 < num_results) ? "," : "");
+        }
+        fprintf(out, "]\n");
+        break;
+    }
+}
+
+} // namespace bench
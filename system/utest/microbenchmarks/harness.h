@@ -0,0 +1,75 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <magenta/new.h>
+#include <magenta/syscalls.h>
+#include <mxtl/unique_ptr.h>
+
+namespace bench {
+
+enum class Format {
+    kText,
+    kCsv,
+    kJson,
+};
+
+struct Options {
+    uint32_t warmup = 100;
+    uint32_t iterations = 1000;
+};
+
+// Set up by main() before any benchmark runs.
+extern Options options;
+
+// Records the samples, in ticks, of one benchmark. Returns false if they
+// could not be stored.
+bool Record(const char* name, uint64_t* ticks, uint32_t count);
+
+// Writes out everything recorded so far.
+void Report(FILE* out, Format format);
+
+// Runs |op| untimed options.warmup times, then times each of
+// options.iterations calls to it. |op| returns false if it failed, which
+// stops the benchmark.
+template <typename Op>
+bool Measure(const char* name, Op op) {
+    return MeasureTicks(name, [&op](uint64_t* ticks) {
+        uint64_t start = mx_ticks_get();
+        if (!op())
+            return false;
+        *ticks = mx_ticks_get() - start;
+        return true;
+    });
+}
+
+// Like Measure(), but |op| does its own timing and sets |*ticks|, for when
+// setting up or tearing down each iteration should not count.
+template <typename Op>
+bool MeasureTicks(const char* name, Op op);
+
+template <typename Op>
+bool MeasureTicks(const char* name, Op op) {
+    uint64_t ticks;
+    for (uint32_t i = 0; i < options.warmup; i++) {
+        if (!op(&ticks))
+            return false;
+    }
+
+    AllocChecker ac;
+    mxtl::unique_ptr<uint64_t[]> samples(new (&ac) uint64_t[options.iterations]);
+    if (!ac.check())
+        return false;
+    for (uint32_t i = 0; i < options.iterations; i++) {
+        if (!op(&samples[i]))
+            return false;
+    }
+    return Record(name, samples.get(), options.iterations);
+}
+
+} // namespace bench
@@ -0,0 +1,182 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <threads.h>
+
+#include <magenta/syscalls.h>
+#include <magenta/syscalls/port.h>
+#include <unittest/unittest.h>
+
+#include "harness.h"
+
+namespace {
+
+constexpr uint32_t kMessageSize = 64;
+
+int echo_thread(void* arg) {
+    mx_handle_t channel = *static_cast<mx_handle_t*>(arg);
+    uint8_t buf[kMessageSize];
+    while (true) {
+        mx_signals_t pending;
+        mx_status_t status = mx_object_wait_one(
+            channel, MX_CHANNEL_READABLE | MX_CHANNEL_PEER_CLOSED, MX_TIME_INFINITE, &pending);
+        if (status != NO_ERROR)
+            return status;
+        if (!(pending & MX_CHANNEL_READABLE))
+            return 0;
+        uint32_t actual;
+        status = mx_channel_read(channel, 0u, buf, sizeof(buf), &actual, nullptr, 0u, nullptr);
+        if (status == NO_ERROR)
+            status = mx_channel_write(channel, 0u, buf, actual, nullptr, 0u);
+        if (status != NO_ERROR)
+            return status;
+    }
+}
+
+bool channel_write_read() {
+    BEGIN_TEST;
+
+    mx_handle_t channel[2];
+    ASSERT_EQ(mx_channel_create(0u, &channel[0], &channel[1]), NO_ERROR, "");
+    uint8_t buf[kMessageSize] = {};
+
+    EXPECT_TRUE(bench::Measure("channel_write_read_64", [&]() {
+        uint32_t actual;
+        return mx_channel_write(channel[0], 0u, buf, sizeof(buf), nullptr, 0u) == NO_ERROR &&
+               mx_channel_read(channel[1], 0u, buf, sizeof(buf), &actual,
+                               nullptr, 0u, nullptr) == NO_ERROR;
+    }), "");
+
+    mx_handle_close(channel[0]);
+    mx_handle_close(channel[1]);
+    END_TEST;
+}
+
+bool channel_round_trip() {
+    BEGIN_TEST;
+
+    mx_handle_t channel[2];
+    ASSERT_EQ(mx_channel_create(0u, &channel[0], &channel[1]), NO_ERROR, "");
+    thrd_t thread;
+    ASSERT_EQ(thrd_create(&thread, echo_thread, &channel[1]), thrd_success, "");
+    uint8_t buf[kMessageSize] = {};
+
+    EXPECT_TRUE(bench::Measure("channel_round_trip_64", [&]() {
+        uint32_t actual;
+        return mx_channel_write(channel[0], 0u, buf, sizeof(buf), nullptr, 0u) == NO_ERROR &&
+               mx_object_wait_one(channel[0], MX_CHANNEL_READABLE, MX_TIME_INFINITE,
+                                  nullptr) == NO_ERROR &&
+               mx_channel_read(channel[0], 0u, buf, sizeof(buf), &actual,
+                               nullptr, 0u, nullptr) == NO_ERROR;
+    }), "");
+
+    mx_handle_close(channel[0]);
+    int result;
+    EXPECT_EQ(thrd_join(thread, &result), thrd_success, "");
+    EXPECT_EQ(result, 0, "");
+    mx_handle_close(channel[1]);
+    END_TEST;
+}
+
+bool port_queue_wait() {
+    BEGIN_TEST;
+
+    mx_handle_t port;
+    ASSERT_EQ(mx_port_create(MX_PORT_OPT_V2, &port), NO_ERROR, "");
+    mx_port_packet_t packet = {};
+    packet.type = MX_PKT_TYPE_USER;
+
+    EXPECT_TRUE(bench::Measure("port_queue_wait", [&]() {
+        return mx_port_queue(port, &packet, 0u) == NO_ERROR &&
+               mx_port_wait(port, 0u, &packet, 0u) == NO_ERROR;
+    }), "");
+
+    // A whole batch per wait, as a busy event loop would see it.
+    mx_port_packet_t packets[64];
+    EXPECT_TRUE(bench::Measure("port_queue_64_wait_many", [&]() {
+        for (size_t i = 0; i < countof(packets); i++) {
+            if (mx_port_queue(port, &packet, 0u) != NO_ERROR)
+                return false;
+        }
+        uint32_t count = countof(packets);
+        return mx_port_wait_many(port, 0u, packets, &count) == NO_ERROR &&
+               count == countof(packets);
+    }), "");
+
+    mx_handle_close(port);
+    END_TEST;
+}
+
+// Futex ping-pong: the main thread sets |state| to kPing and wakes the
+// partner, which sets it to kPong and wakes the main thread.
+constexpr int kPing = 1;
+constexpr int kPong = 2;
+constexpr int kQuit = 3;
+
+int futex_value;
+
+void futex_set(int value) {
+    __atomic_store_n(&futex_value, value, __ATOMIC_SEQ_CST);
+    mx_futex_wake(&futex_value, 1u);
+}
+
+bool futex_wait_for(int value) {
+    while (true) {
+        int current = __atomic_load_n(&futex_value, __ATOMIC_SEQ_CST);
+        if (current == value || current == kQuit)
+            return current == value;
+        mx_status_t status = mx_futex_wait(&futex_value, current, MX_TIME_INFINITE);
+        if (status != NO_ERROR && status != ERR_BAD_STATE)
+            return false;
+    }
+}
+
+int futex_partner(void*) {
+    while (futex_wait_for(kPing))
+        futex_set(kPong);
+    return 0;
+}
+
+bool futex_ping_pong() {
+    BEGIN_TEST;
+
+    futex_value = 0;
+    thrd_t thread;
+    ASSERT_EQ(thrd_create(&thread, futex_partner, nullptr), thrd_success, "");
+
+    EXPECT_TRUE(bench::Measure("futex_ping_pong", []() {
+        futex_set(kPing);
+        return futex_wait_for(kPong);
+    }), "");
+
+    futex_set(kQuit);
+    EXPECT_EQ(thrd_join(thread, nullptr), thrd_success, "");
+    END_TEST;
+}
+
+bool handle_duplicate_close() {
+    BEGIN_TEST;
+
+    mx_handle_t event;
+    ASSERT_EQ(mx_event_create(0u, &event), NO_ERROR, "");
+
+    EXPECT_TRUE(bench::Measure("handle_duplicate_close", [event]() {
+        mx_handle_t dup;
+        return mx_handle_duplicate(event, MX_RIGHT_SAME_RIGHTS, &dup) == NO_ERROR &&
+               mx_handle_close(dup) == NO_ERROR;
+    }), "");
+
+    mx_handle_close(event);
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(ipc_benchmarks)
+RUN_TEST_PERFORMANCE(channel_write_read)
+RUN_TEST_PERFORMANCE(channel_round_trip)
+RUN_TEST_PERFORMANCE(port_queue_wait)
+RUN_TEST_PERFORMANCE(futex_ping_pong)
+RUN_TEST_PERFORMANCE(handle_duplicate_close)
+END_TEST_CASE(ipc_benchmarks)
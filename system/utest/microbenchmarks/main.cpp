@@ -0,0 +1,86 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Microbenchmarks of the kernel paths IPC, VM and scheduling depend on.
+//
+// These are performance tests, so runtests only runs them when asked to
+// with "runtests -P microbenchmarks-test". Run directly, they always run:
+//
+//   microbenchmarks-test [-n iterations] [-w warmup] [-f text|csv|json] [-o file]
+//
+// Each benchmark reports the min, median, 99th percentile, max and mean
+// time of an iteration in nanoseconds.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unittest/unittest.h>
+
+#include "harness.h"
+
+namespace {
+
+bool parse_format(const char* arg, bench::Format* format) {
+    if (!strcmp(arg, "text")) {
+        *format = bench::Format::kText;
+    } else if (!strcmp(arg, "csv")) {
+        *format = bench::Format::kCsv;
+    } else if (!strcmp(arg, "json")) {
+        *format = bench::Format::kJson;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+int usage(const char* name) {
+    fprintf(stderr,
+            "usage: %s [-n iterations] [-w warmup] [-f text|csv|json] [-o file]\n",
+            name);
+    return -1;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bench::Format format = bench::Format::kText;
+    const char* out_path = nullptr;
+
+    // Anything we do not know about is left for the unittest library.
+    int unittest_argc = 1;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (!strcmp(arg, "-n") && has_value) {
+            bench::options.iterations = atoi(argv[++i]);
+        } else if (!strcmp(arg, "-w") && has_value) {
+            bench::options.warmup = atoi(argv[++i]);
+        } else if (!strcmp(arg, "-f") && has_value) {
+            if (!parse_format(argv[++i], &format))
+                return usage(argv[0]);
+        } else if (!strcmp(arg, "-o") && has_value) {
+            out_path = argv[++i];
+        } else if (arg[0] == '-') {
+            return usage(argv[0]);
+        } else {
+            argv[unittest_argc++] = argv[i];
+        }
+    }
+    if (bench::options.iterations == 0)
+        return usage(argv[0]);
+
+    bool success = unittest_run_all_tests(unittest_argc, argv);
+
+    FILE* out = stdout;
+    if (out_path != nullptr && (out = fopen(out_path, "w")) == nullptr) {
+        fprintf(stderr, "cannot open %s\n", out_path);
+        return -1;
+    }
+    bench::Report(out, format);
+    if (out != stdout)
+        fclose(out);
+
+    return success ? 0 : -1;
+}
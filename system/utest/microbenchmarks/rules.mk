@@ -0,0 +1,28 @@
+# Copyright 2017 The Fuchsia Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+LOCAL_DIR := $(GET_LOCAL_DIR)
+
+MODULE := $(LOCAL_DIR)
+
+MODULE_TYPE := usertest
+
+MODULE_NAME := microbenchmarks-test
+
+MODULE_SRCS := \
+    $(LOCAL_DIR)/main.cpp \
+    $(LOCAL_DIR)/harness.cpp \
+    $(LOCAL_DIR)/ipc.cpp \
+    $(LOCAL_DIR)/sched.cpp \
+    $(LOCAL_DIR)/vm.cpp \
+
+MODULE_LIBS := \
+    system/ulib/c \
+    system/ulib/mxcpp \
+    system/ulib/mxio \
+    system/ulib/mxtl \
+    system/ulib/magenta \
+    system/ulib/unittest \
+
+include make/module.mk
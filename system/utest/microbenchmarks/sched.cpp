@@ -0,0 +1,90 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <threads.h>
+
+#include <magenta/syscalls.h>
+#include <unittest/unittest.h>
+
+#include "harness.h"
+
+namespace {
+
+struct wakeup_context {
+    mx_handle_t wake;
+    mx_handle_t done;
+    // When the woken thread got to run, written before it signals |done|.
+    uint64_t woke_ticks;
+};
+
+int wakeup_thread(void* arg) {
+    auto ctx = static_cast<wakeup_context*>(arg);
+    while (true) {
+        mx_signals_t pending;
+        mx_status_t status = mx_object_wait_one(
+            ctx->wake, MX_EVENT_SIGNALED | MX_USER_SIGNAL_0, MX_TIME_INFINITE, &pending);
+        if (status != NO_ERROR)
+            return status;
+        if (pending & MX_USER_SIGNAL_0)
+            return 0;
+        ctx->woke_ticks = mx_ticks_get();
+        mx_object_signal(ctx->wake, MX_EVENT_SIGNALED, 0u);
+        mx_object_signal(ctx->done, 0u, MX_EVENT_SIGNALED);
+    }
+}
+
+// Time from signaling an event to a thread blocked on it running.
+bool thread_wakeup_latency() {
+    BEGIN_TEST;
+
+    wakeup_context ctx = {};
+    ASSERT_EQ(mx_event_create(0u, &ctx.wake), NO_ERROR, "");
+    ASSERT_EQ(mx_event_create(0u, &ctx.done), NO_ERROR, "");
+    thrd_t thread;
+    ASSERT_EQ(thrd_create(&thread, wakeup_thread, &ctx), thrd_success, "");
+
+    EXPECT_TRUE(bench::MeasureTicks("thread_wakeup_latency", [&ctx](uint64_t* ticks) {
+        // Give the thread time to block, so the wakeup is a real one.
+        mx_nanosleep(MX_USEC(50));
+        uint64_t start = mx_ticks_get();
+        if (mx_object_signal(ctx.wake, 0u, MX_EVENT_SIGNALED) != NO_ERROR ||
+            mx_object_wait_one(ctx.done, MX_EVENT_SIGNALED, MX_TIME_INFINITE,
+                               nullptr) != NO_ERROR ||
+            mx_object_signal(ctx.done, MX_EVENT_SIGNALED, 0u) != NO_ERROR)
+            return false;
+        *ticks = ctx.woke_ticks - start;
+        return true;
+    }), "");
+
+    mx_object_signal(ctx.wake, 0u, MX_USER_SIGNAL_0);
+    int result;
+    EXPECT_EQ(thrd_join(thread, &result), thrd_success, "");
+    EXPECT_EQ(result, 0, "");
+    mx_handle_close(ctx.wake);
+    mx_handle_close(ctx.done);
+    END_TEST;
+}
+
+int exit_thread(void*) {
+    return 0;
+}
+
+bool thread_create_join() {
+    BEGIN_TEST;
+
+    EXPECT_TRUE(bench::Measure("thread_create_join", []() {
+        thrd_t thread;
+        return thrd_create(&thread, exit_thread, nullptr) == thrd_success &&
+               thrd_join(thread, nullptr) == thrd_success;
+    }), "");
+
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(sched_benchmarks)
+RUN_TEST_PERFORMANCE(thread_wakeup_latency)
+RUN_TEST_PERFORMANCE(thread_create_join)
+END_TEST_CASE(sched_benchmarks)
@@ -0,0 +1,96 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <limits.h>
+
+#include <magenta/process.h>
+#include <magenta/syscalls.h>
+#include <unittest/unittest.h>
+
+#include "harness.h"
+
+namespace {
+
+constexpr uint32_t kMapFlags = MX_VM_FLAG_PERM_READ | MX_VM_FLAG_PERM_WRITE;
+
+// Time to fault in one page of a fresh VMO mapping. Each iteration touches
+// the next page of a mapping big enough for the whole run.
+bool page_fault() {
+    BEGIN_TEST;
+
+    size_t pages = bench::options.warmup + bench::options.iterations;
+    mx_handle_t vmo;
+    ASSERT_EQ(mx_vmo_create(pages * PAGE_SIZE, 0u, &vmo), NO_ERROR, "");
+    uintptr_t addr;
+    ASSERT_EQ(mx_vmar_map(mx_vmar_root_self(), 0u, vmo, 0u, pages * PAGE_SIZE, kMapFlags, &addr),
+              NO_ERROR, "");
+
+    volatile uint8_t* next = reinterpret_cast<volatile uint8_t*>(addr);
+    EXPECT_TRUE(bench::Measure("page_fault", [&next]() {
+        *next = 1;
+        next += PAGE_SIZE;
+        return true;
+    }), "");
+
+    mx_vmar_unmap(mx_vmar_root_self(), addr, pages * PAGE_SIZE);
+    mx_handle_close(vmo);
+    END_TEST;
+}
+
+bool vmar_map_unmap_size(const char* name, size_t size) {
+    BEGIN_HELPER;
+
+    mx_handle_t vmo;
+    ASSERT_EQ(mx_vmo_create(size, 0u, &vmo), NO_ERROR, "");
+
+    EXPECT_TRUE(bench::Measure(name, [vmo, size]() {
+        uintptr_t addr;
+        return mx_vmar_map(mx_vmar_root_self(), 0u, vmo, 0u, size, kMapFlags, &addr) ==
+                   NO_ERROR &&
+               mx_vmar_unmap(mx_vmar_root_self(), addr, size) == NO_ERROR;
+    }), "");
+
+    mx_handle_close(vmo);
+    END_HELPER;
+}
+
+bool vmar_map_unmap() {
+    BEGIN_TEST;
+    EXPECT_TRUE(vmar_map_unmap_size("vmar_map_unmap_4k", 4096), "");
+    EXPECT_TRUE(vmar_map_unmap_size("vmar_map_unmap_64k", 64 * 1024), "");
+    EXPECT_TRUE(vmar_map_unmap_size("vmar_map_unmap_1m", 1024 * 1024), "");
+    EXPECT_TRUE(vmar_map_unmap_size("vmar_map_unmap_16m", 16 * 1024 * 1024), "");
+    END_TEST;
+}
+
+// Maps committed pages and touches each of them, so the faults only have
+// to fill in page tables, not allocate.
+bool vmar_map_touch_unmap_committed() {
+    BEGIN_TEST;
+
+    constexpr size_t kSize = 1024 * 1024;
+    mx_handle_t vmo;
+    ASSERT_EQ(mx_vmo_create(kSize, 0u, &vmo), NO_ERROR, "");
+    ASSERT_EQ(mx_vmo_op_range(vmo, MX_VMO_OP_COMMIT, 0u, kSize, nullptr, 0u), NO_ERROR, "");
+
+    EXPECT_TRUE(bench::Measure("vmar_map_touch_unmap_1m_committed", [vmo]() {
+        uintptr_t addr;
+        if (mx_vmar_map(mx_vmar_root_self(), 0u, vmo, 0u, kSize, kMapFlags, &addr) != NO_ERROR)
+            return false;
+        for (size_t offset = 0; offset < kSize; offset += PAGE_SIZE)
+            *reinterpret_cast<volatile uint8_t*>(addr + offset) = 1;
+        return mx_vmar_unmap(mx_vmar_root_self(), addr, kSize) == NO_ERROR;
+    }), "");
+
+    mx_handle_close(vmo);
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(vm_benchmarks)
+RUN_TEST_PERFORMANCE(page_fault)
+RUN_TEST_PERFORMANCE(vmar_map_unmap)
+RUN_TEST_PERFORMANCE(vmar_map_touch_unmap_committed)
+END_TEST_CASE(vm_benchmarks)
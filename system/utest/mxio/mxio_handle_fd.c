@@ -60,6 +60,183 @@ bool epoll_test(void) {
     END_TEST;
 }
 
+bool epoll_edge_triggered_test(void) {
+    BEGIN_TEST;
+
+    mx_handle_t h = MX_HANDLE_INVALID;
+    ASSERT_EQ(NO_ERROR, mx_event_create(0u, &h), "mx_event_create() failed");
+
+    int fd = mxio_handle_fd(h, MX_USER_SIGNAL_0, MX_USER_SIGNAL_1, false);
+    ASSERT_GT(fd, 0, "mxio_handle_fd() failed");
+
+    int epollfd = epoll_create(0);
+    ASSERT_GT(epollfd, 0, "epoll_create() failed");
+
+    struct epoll_event ev, events[2];
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.u32 = 42;
+    ASSERT_EQ(0, epoll_ctl(epollfd, EPOLL_CTL_ADD, fd, &ev), "epoll_ctl() failed");
+
+    ASSERT_EQ(NO_ERROR, mx_object_signal(h, 0u, MX_USER_SIGNAL_0), "");
+
+    EXPECT_EQ(epoll_wait(epollfd, events, 1, 0), 1, "");
+    EXPECT_EQ(events[0].events, (uint32_t)EPOLLIN, "");
+    EXPECT_EQ(events[0].data.u32, 42u, "");
+
+    // Still readable, but nothing changed, so nothing to report.
+    EXPECT_EQ(epoll_wait(epollfd, events, 1, 0), 0, "");
+
+    // Another edge is reported again.
+    ASSERT_EQ(NO_ERROR, mx_object_signal(h, MX_USER_SIGNAL_0, 0u), "");
+    ASSERT_EQ(NO_ERROR, mx_object_signal(h, 0u, MX_USER_SIGNAL_0), "");
+    EXPECT_EQ(epoll_wait(epollfd, events, 1, 0), 1, "");
+
+    // Several edges between waits are reported as one event.
+    for (int i = 0; i < 2; i++) {
+        ASSERT_EQ(NO_ERROR, mx_object_signal(h, MX_USER_SIGNAL_0, 0u), "");
+        ASSERT_EQ(NO_ERROR, mx_object_signal(h, 0u, MX_USER_SIGNAL_0), "");
+    }
+    EXPECT_EQ(epoll_wait(epollfd, events, 2, 0), 1, "fd reported twice");
+    EXPECT_EQ(events[0].events, (uint32_t)EPOLLIN, "");
+
+    ASSERT_EQ(0, epoll_ctl(epollfd, EPOLL_CTL_DEL, fd, NULL), "");
+    ASSERT_EQ(NO_ERROR, mx_object_signal(h, MX_USER_SIGNAL_0, MX_USER_SIGNAL_0), "");
+    EXPECT_EQ(epoll_wait(epollfd, events, 1, 0), 0, "deleted fds report nothing");
+
+    close(epollfd);
+    close(fd);
+
+    END_TEST;
+}
+
+bool epoll_oneshot_test(void) {
+    BEGIN_TEST;
+
+    mx_handle_t h = MX_HANDLE_INVALID;
+    ASSERT_EQ(NO_ERROR, mx_event_create(0u, &h), "mx_event_create() failed");
+
+    int fd = mxio_handle_fd(h, MX_USER_SIGNAL_0, MX_USER_SIGNAL_1, false);
+    ASSERT_GT(fd, 0, "mxio_handle_fd() failed");
+
+    int epollfd = epoll_create(0);
+    ASSERT_GT(epollfd, 0, "epoll_create() failed");
+
+    struct epoll_event ev, events[1];
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ASSERT_EQ(0, epoll_ctl(epollfd, EPOLL_CTL_ADD, fd, &ev), "epoll_ctl() failed");
+
+    ASSERT_EQ(NO_ERROR, mx_object_signal(h, 0u, MX_USER_SIGNAL_0), "");
+    EXPECT_EQ(epoll_wait(epollfd, events, 1, 0), 1, "");
+
+    // Disabled until it is modified, even though it is still readable.
+    EXPECT_EQ(epoll_wait(epollfd, events, 1, 0), 0, "");
+
+    ASSERT_EQ(0, epoll_ctl(epollfd, EPOLL_CTL_MOD, fd, &ev), "epoll_ctl() failed");
+    EXPECT_EQ(epoll_wait(epollfd, events, 1, 0), 1, "");
+    EXPECT_EQ(events[0].events, (uint32_t)EPOLLIN, "");
+
+    close(epollfd);
+    close(fd);
+
+    END_TEST;
+}
+
+bool epoll_rearm_error_test(void) {
+    BEGIN_TEST;
+
+    mx_handle_t h = MX_HANDLE_INVALID;
+    ASSERT_EQ(NO_ERROR, mx_event_create(0u, &h), "mx_event_create() failed");
+
+    int fd = mxio_handle_fd(h, MX_USER_SIGNAL_0, MX_USER_SIGNAL_1, false);
+    ASSERT_GT(fd, 0, "mxio_handle_fd() failed");
+
+    int epollfd = epoll_create(0);
+    ASSERT_GT(epollfd, 0, "epoll_create() failed");
+
+    struct epoll_event ev, events[2];
+    ev.events = EPOLLIN;
+    ev.data.u32 = 7;
+    ASSERT_EQ(0, epoll_ctl(epollfd, EPOLL_CTL_ADD, fd, &ev), "epoll_ctl() failed");
+    ASSERT_EQ(NO_ERROR, mx_object_signal(h, 0u, MX_USER_SIGNAL_0), "");
+
+    // Pull the handle out from under the fd, so that once its packet
+    // has been handled it cannot be armed for the next one.
+    ASSERT_EQ(NO_ERROR, mx_handle_close(h), "");
+    EXPECT_EQ(epoll_wait(epollfd, events, 2, 0), 1, "");
+    EXPECT_EQ(events[0].data.u32, 7u, "");
+    EXPECT_TRUE(events[0].events & EPOLLERR, "");
+
+    // It is not silently forgotten afterwards either.
+    EXPECT_EQ(epoll_wait(epollfd, events, 2, 0), 1, "");
+    EXPECT_EQ(events[0].events, (uint32_t)EPOLLERR, "");
+
+    ASSERT_EQ(0, epoll_ctl(epollfd, EPOLL_CTL_DEL, fd, NULL), "");
+    EXPECT_EQ(epoll_wait(epollfd, events, 2, 0), 0, "deleted fds report nothing");
+
+    close(epollfd);
+    close(fd);
+
+    END_TEST;
+}
+
+bool epoll_many_test(void) {
+    BEGIN_TEST;
+
+    enum { kCount = 64 };
+    mx_handle_t h[kCount];
+    int fds[kCount];
+
+    int epollfd = epoll_create(0);
+    ASSERT_GT(epollfd, 0, "epoll_create() failed");
+
+    for (int i = 0; i < kCount; i++) {
+        ASSERT_EQ(NO_ERROR, mx_event_create(0u, &h[i]), "mx_event_create() failed");
+        fds[i] = mxio_handle_fd(h[i], MX_USER_SIGNAL_0, MX_USER_SIGNAL_1, false);
+        ASSERT_GT(fds[i], 0, "mxio_handle_fd() failed");
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u32 = i;
+        ASSERT_EQ(0, epoll_ctl(epollfd, EPOLL_CTL_ADD, fds[i], &ev), "epoll_ctl() failed");
+        EXPECT_EQ(-1, epoll_ctl(epollfd, EPOLL_CTL_ADD, fds[i], &ev), "added twice");
+    }
+
+    // Signal every other one; a single wait returns all of them.
+    for (int i = 0; i < kCount; i += 2) {
+        ASSERT_EQ(NO_ERROR, mx_object_signal(h[i], 0u, MX_USER_SIGNAL_0), "");
+    }
+    struct epoll_event events[kCount];
+    int nfds = epoll_wait(epollfd, events, kCount, 1000);
+    ASSERT_EQ(nfds, kCount / 2, "");
+    bool seen[kCount] = {};
+    for (int i = 0; i < nfds; i++) {
+        ASSERT_LT(events[i].data.u32, (uint32_t)kCount, "");
+        EXPECT_EQ(events[i].data.u32 % 2, 0u, "");
+        EXPECT_FALSE(seen[events[i].data.u32], "reported twice");
+        seen[events[i].data.u32] = true;
+    }
+
+    // They are level-triggered and still signaled, so the next wait
+    // reports each of them again, once.
+    nfds = epoll_wait(epollfd, events, kCount, 1000);
+    ASSERT_EQ(nfds, kCount / 2, "");
+    memset(seen, 0, sizeof(seen));
+    for (int i = 0; i < nfds; i++) {
+        ASSERT_LT(events[i].data.u32, (uint32_t)kCount, "");
+        EXPECT_FALSE(seen[events[i].data.u32], "reported twice");
+        seen[events[i].data.u32] = true;
+    }
+
+    for (int i = 0; i < kCount; i++) {
+        ASSERT_EQ(0, epoll_ctl(epollfd, EPOLL_CTL_DEL, fds[i], NULL), "epoll_ctl() failed");
+        close(fds[i]);
+    }
+    EXPECT_EQ(epoll_wait(epollfd, events, kCount, 0), 0, "");
+    close(epollfd);
+
+    END_TEST;
+}
+
 bool close_test(void) {
     BEGIN_TEST;
 
@@ -130,6 +307,10 @@ bool pipe_test(void) {
 
 BEGIN_TEST_CASE(mxio_handle_fd_test)
 RUN_TEST(epoll_test);
+RUN_TEST(epoll_edge_triggered_test);
+RUN_TEST(epoll_oneshot_test);
+RUN_TEST(epoll_rearm_error_test);
+RUN_TEST(epoll_many_test);
 RUN_TEST(close_test);
 RUN_TEST(pipe_test);
 END_TEST_CASE(mxio_handle_fd_test)
@@ -13,10 +13,13 @@
 #include <magenta/syscalls.h>
 #include <magenta/syscalls/object.h>
 #include <magenta/threads.h>
+#include <launchpad/launchpad.h>
 #include <mxio/util.h>
 #include <test-utils/test-utils.h>
 #include <unittest/unittest.h>
 
+static const char* program_path;
+
 static bool get_rights(mx_handle_t handle, mx_rights_t* rights)
 {
     mx_info_handle_basic_t info;
@@ -105,13 +108,288 @@ static bool thread_name_test(void)
     END_TEST;
 }
 
+static bool thread_timer_slack_test(void)
+{
+    BEGIN_TEST;
+
+    mx_handle_t main_thread = thrd_get_mx_handle(thrd_current());
+    mx_time_t slack = 1;
+    ASSERT_EQ(mx_object_get_property(main_thread, MX_PROP_TIMER_SLACK,
+                                     &slack, sizeof(slack)), NO_ERROR, "");
+    EXPECT_EQ(slack, 0u, "threads start with no slack");
+
+    slack = MX_MSEC(5);
+    ASSERT_EQ(mx_object_set_property(main_thread, MX_PROP_TIMER_SLACK,
+                                     &slack, sizeof(slack)), NO_ERROR, "");
+    slack = 0;
+    ASSERT_EQ(mx_object_get_property(main_thread, MX_PROP_TIMER_SLACK,
+                                     &slack, sizeof(slack)), NO_ERROR, "");
+    EXPECT_EQ(slack, MX_MSEC(5), "");
+
+    // Slack only ever makes a sleep longer, never shorter.
+    mx_time_t before = mx_time_get(MX_CLOCK_MONOTONIC);
+    ASSERT_EQ(mx_nanosleep(MX_MSEC(1)), NO_ERROR, "");
+    EXPECT_GE(mx_time_get(MX_CLOCK_MONOTONIC) - before, MX_MSEC(1), "");
+
+    slack = MX_TIMER_SLACK_MAX + 1;
+    EXPECT_EQ(mx_object_set_property(main_thread, MX_PROP_TIMER_SLACK,
+                                     &slack, sizeof(slack)), ERR_OUT_OF_RANGE, "");
+
+    // Only threads have timer slack.
+    EXPECT_EQ(mx_object_get_property(mx_process_self(), MX_PROP_TIMER_SLACK,
+                                     &slack, sizeof(slack)), ERR_WRONG_TYPE, "");
+
+    slack = 0;
+    ASSERT_EQ(mx_object_set_property(main_thread, MX_PROP_TIMER_SLACK,
+                                     &slack, sizeof(slack)), NO_ERROR, "");
+
+    END_TEST;
+}
+
+static bool thread_priority_test(void)
+{
+    BEGIN_TEST;
+
+    mx_handle_t main_thread = thrd_get_mx_handle(thrd_current());
+    int32_t priority = 0;
+    ASSERT_EQ(mx_object_get_property(main_thread, MX_PROP_THREAD_PRIORITY,
+                                     &priority, sizeof(priority)), NO_ERROR, "");
+    EXPECT_EQ(priority, MX_PRIORITY_DEFAULT, "");
+
+    // Threads may go as high as their job allows, and no higher.
+    int32_t max_priority = 0;
+    ASSERT_EQ(mx_object_get_property(mx_job_default(), MX_PROP_JOB_MAX_PRIORITY,
+                                     &max_priority, sizeof(max_priority)), NO_ERROR, "");
+    ASSERT_GE(max_priority, MX_PRIORITY_DEFAULT, "");
+    ASSERT_LE(max_priority, MX_PRIORITY_HIGHEST, "");
+
+    priority = max_priority;
+    ASSERT_EQ(mx_object_set_property(main_thread, MX_PROP_THREAD_PRIORITY,
+                                     &priority, sizeof(priority)), NO_ERROR, "");
+    priority = 0;
+    ASSERT_EQ(mx_object_get_property(main_thread, MX_PROP_THREAD_PRIORITY,
+                                     &priority, sizeof(priority)), NO_ERROR, "");
+    EXPECT_EQ(priority, max_priority, "");
+
+    if (max_priority < MX_PRIORITY_HIGHEST) {
+        priority = max_priority + 1;
+        EXPECT_EQ(mx_object_set_property(main_thread, MX_PROP_THREAD_PRIORITY,
+                                         &priority, sizeof(priority)), ERR_ACCESS_DENIED, "");
+    }
+
+    priority = MX_PRIORITY_HIGHEST + 1;
+    EXPECT_EQ(mx_object_set_property(main_thread, MX_PROP_THREAD_PRIORITY,
+                                     &priority, sizeof(priority)), ERR_OUT_OF_RANGE, "");
+    priority = MX_PRIORITY_LOWEST - 1;
+    EXPECT_EQ(mx_object_set_property(main_thread, MX_PROP_THREAD_PRIORITY,
+                                     &priority, sizeof(priority)), ERR_OUT_OF_RANGE, "");
+
+    priority = MX_PRIORITY_DEFAULT;
+    ASSERT_EQ(mx_object_set_property(main_thread, MX_PROP_THREAD_PRIORITY,
+                                     &priority, sizeof(priority)), NO_ERROR, "");
+
+    END_TEST;
+}
+
+static bool cpu_affinity_test(void)
+{
+    BEGIN_TEST;
+
+    mx_handle_t main_thread = thrd_get_mx_handle(thrd_current());
+    uint64_t saved = 0;
+    ASSERT_EQ(mx_object_get_property(main_thread, MX_PROP_CPU_AFFINITY,
+                                     &saved, sizeof(saved)), NO_ERROR, "");
+    ASSERT_NEQ(saved & 1u, 0u, "cpu 0 is allowed by default");
+
+    // Pin ourselves to cpu 0 and make sure we keep running.
+    uint64_t mask = 1u;
+    ASSERT_EQ(mx_object_set_property(main_thread, MX_PROP_CPU_AFFINITY,
+                                     &mask, sizeof(mask)), NO_ERROR, "");
+    ASSERT_EQ(mx_nanosleep(MX_MSEC(1)), NO_ERROR, "");
+    mask = 0;
+    ASSERT_EQ(mx_object_get_property(main_thread, MX_PROP_CPU_AFFINITY,
+                                     &mask, sizeof(mask)), NO_ERROR, "");
+    EXPECT_EQ(mask, 1u, "");
+
+    mask = 0;
+    EXPECT_EQ(mx_object_set_property(main_thread, MX_PROP_CPU_AFFINITY,
+                                     &mask, sizeof(mask)), ERR_INVALID_ARGS, "");
+
+    ASSERT_EQ(mx_object_set_property(main_thread, MX_PROP_CPU_AFFINITY,
+                                     &saved, sizeof(saved)), NO_ERROR, "");
+
+    // Jobs start with their parent's mask and can only narrow it.
+    mx_handle_t job_child, job_grandchild;
+    ASSERT_EQ(mx_job_create(mx_job_default(), 0u, &job_child), NO_ERROR, "");
+    mask = 0;
+    ASSERT_EQ(mx_object_get_property(job_child, MX_PROP_CPU_AFFINITY,
+                                     &mask, sizeof(mask)), NO_ERROR, "");
+    EXPECT_EQ(mask, saved, "");
+
+    mask = 1u;
+    ASSERT_EQ(mx_object_set_property(job_child, MX_PROP_CPU_AFFINITY,
+                                     &mask, sizeof(mask)), NO_ERROR, "");
+    ASSERT_EQ(mx_job_create(job_child, 0u, &job_grandchild), NO_ERROR, "");
+    mask = 0;
+    ASSERT_EQ(mx_object_get_property(job_grandchild, MX_PROP_CPU_AFFINITY,
+                                     &mask, sizeof(mask)), NO_ERROR, "");
+    EXPECT_EQ(mask, 1u, "");
+
+    mask = 3u;
+    EXPECT_EQ(mx_object_set_property(job_grandchild, MX_PROP_CPU_AFFINITY,
+                                     &mask, sizeof(mask)), ERR_ACCESS_DENIED, "");
+
+    // Only threads and jobs have an affinity.
+    EXPECT_EQ(mx_object_get_property(mx_process_self(), MX_PROP_CPU_AFFINITY,
+                                     &mask, sizeof(mask)), ERR_WRONG_TYPE, "");
+
+    ASSERT_EQ(mx_handle_close(job_grandchild), NO_ERROR, "");
+    ASSERT_EQ(mx_handle_close(job_child), NO_ERROR, "");
+
+    END_TEST;
+}
+
+static bool job_max_priority_test(void)
+{
+    BEGIN_TEST;
+
+    int32_t parent_max = 0;
+    ASSERT_EQ(mx_object_get_property(mx_job_default(), MX_PROP_JOB_MAX_PRIORITY,
+                                     &parent_max, sizeof(parent_max)), NO_ERROR, "");
+
+    // New jobs cannot raise their threads above the default on their own.
+    mx_handle_t job_child;
+    ASSERT_EQ(mx_job_create(mx_job_default(), 0u, &job_child), NO_ERROR, "");
+    int32_t max_priority = 0;
+    ASSERT_EQ(mx_object_get_property(job_child, MX_PROP_JOB_MAX_PRIORITY,
+                                     &max_priority, sizeof(max_priority)), NO_ERROR, "");
+    EXPECT_EQ(max_priority, parent_max < MX_PRIORITY_DEFAULT ? parent_max : MX_PRIORITY_DEFAULT, "");
+
+    // Nor above their parent.
+    if (parent_max < MX_PRIORITY_HIGHEST) {
+        max_priority = parent_max + 1;
+        EXPECT_EQ(mx_object_set_property(job_child, MX_PROP_JOB_MAX_PRIORITY,
+                                         &max_priority, sizeof(max_priority)),
+                  ERR_ACCESS_DENIED, "");
+    }
+    max_priority = MX_PRIORITY_LOWEST - 1;
+    EXPECT_EQ(mx_object_set_property(job_child, MX_PROP_JOB_MAX_PRIORITY,
+                                     &max_priority, sizeof(max_priority)), ERR_OUT_OF_RANGE, "");
+
+    // Only jobs have a maximum.
+    EXPECT_EQ(mx_object_get_property(mx_process_self(), MX_PROP_JOB_MAX_PRIORITY,
+                                     &max_priority, sizeof(max_priority)), ERR_WRONG_TYPE, "");
+
+    ASSERT_EQ(mx_handle_close(job_child), NO_ERROR, "");
+
+    END_TEST;
+}
+
+// Start a copy of this test that sleeps forever in |job| and return its
+// process and main thread.
+static bool start_sleeper(mx_handle_t job, mx_handle_t* process, mx_handle_t* thread)
+{
+    mx_handle_t job_copy;
+    ASSERT_EQ(mx_handle_duplicate(job, MX_RIGHT_SAME_RIGHTS, &job_copy), NO_ERROR, "");
+
+    launchpad_t* lp;
+    const char* args[] = { program_path, "sleep" };
+    ASSERT_EQ(launchpad_create(job_copy, "property-sleeper", &lp), NO_ERROR, "");
+    launchpad_load_from_file(lp, program_path);
+    launchpad_set_args(lp, countof(args), args);
+    ASSERT_EQ(launchpad_go(lp, process, NULL), NO_ERROR, "");
+
+    mx_koid_t tid;
+    size_t actual = 0;
+    ASSERT_EQ(mx_object_get_info(*process, MX_INFO_PROCESS_THREADS, &tid, sizeof(tid),
+                                 &actual, NULL), NO_ERROR, "");
+    ASSERT_EQ(actual, 1u, "");
+    *thread = tu_get_thread(*process, tid);
+    return true;
+}
+
+static bool job_limits_apply_to_running_threads_test(void)
+{
+    BEGIN_TEST;
+
+    mx_handle_t job, job_grandchild;
+    ASSERT_EQ(mx_job_create(mx_job_default(), 0u, &job), NO_ERROR, "");
+    ASSERT_EQ(mx_job_create(job, 0u, &job_grandchild), NO_ERROR, "");
+
+    mx_handle_t process, thread;
+    ASSERT_TRUE(start_sleeper(job, &process, &thread), "");
+
+    int32_t priority = MX_PRIORITY_DEFAULT;
+    ASSERT_EQ(mx_object_set_property(thread, MX_PROP_THREAD_PRIORITY,
+                                     &priority, sizeof(priority)), NO_ERROR, "");
+
+    // Lowering the job's maximum lowers threads and jobs already above it.
+    int32_t max_priority = MX_PRIORITY_LOWEST;
+    ASSERT_EQ(mx_object_set_property(job, MX_PROP_JOB_MAX_PRIORITY,
+                                     &max_priority, sizeof(max_priority)), NO_ERROR, "");
+    priority = 0;
+    ASSERT_EQ(mx_object_get_property(thread, MX_PROP_THREAD_PRIORITY,
+                                     &priority, sizeof(priority)), NO_ERROR, "");
+    EXPECT_EQ(priority, MX_PRIORITY_LOWEST, "");
+    max_priority = 0;
+    ASSERT_EQ(mx_object_get_property(job_grandchild, MX_PROP_JOB_MAX_PRIORITY,
+                                     &max_priority, sizeof(max_priority)), NO_ERROR, "");
+    EXPECT_EQ(max_priority, MX_PRIORITY_LOWEST, "");
+
+    priority = MX_PRIORITY_DEFAULT;
+    EXPECT_EQ(mx_object_set_property(thread, MX_PROP_THREAD_PRIORITY,
+                                     &priority, sizeof(priority)), ERR_ACCESS_DENIED, "");
+
+    // Likewise narrowing the job's cpus narrows theirs.
+    uint64_t mask = 1u;
+    ASSERT_EQ(mx_object_set_property(job, MX_PROP_CPU_AFFINITY,
+                                     &mask, sizeof(mask)), NO_ERROR, "");
+    mask = 0;
+    ASSERT_EQ(mx_object_get_property(thread, MX_PROP_CPU_AFFINITY,
+                                     &mask, sizeof(mask)), NO_ERROR, "");
+    EXPECT_EQ(mask, 1u, "");
+    mask = 0;
+    ASSERT_EQ(mx_object_get_property(job_grandchild, MX_PROP_CPU_AFFINITY,
+                                     &mask, sizeof(mask)), NO_ERROR, "");
+    EXPECT_EQ(mask, 1u, "");
+
+    // Masks wider than any cpu the kernel supports are rejected rather
+    // than truncated.
+    mask = 1ull << 63;
+    EXPECT_EQ(mx_object_set_property(job, MX_PROP_CPU_AFFINITY,
+                                     &mask, sizeof(mask)), ERR_INVALID_ARGS, "");
+    EXPECT_EQ(mx_object_set_property(thread, MX_PROP_CPU_AFFINITY,
+                                     &mask, sizeof(mask)), ERR_INVALID_ARGS, "");
+
+    ASSERT_EQ(mx_task_kill(process), NO_ERROR, "");
+    tu_process_wait_signaled(process);
+    ASSERT_EQ(mx_handle_close(thread), NO_ERROR, "");
+    ASSERT_EQ(mx_handle_close(process), NO_ERROR, "");
+    ASSERT_EQ(mx_handle_close(job_grandchild), NO_ERROR, "");
+    ASSERT_EQ(mx_handle_close(job), NO_ERROR, "");
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(property_tests)
 RUN_TEST(process_name_test);
 RUN_TEST(thread_name_test);
+RUN_TEST(thread_timer_slack_test);
+RUN_TEST(thread_priority_test);
+RUN_TEST(cpu_affinity_test);
+RUN_TEST(job_max_priority_test);
+RUN_TEST(job_limits_apply_to_running_threads_test);
 END_TEST_CASE(property_tests)
 
 int main(int argc, char **argv)
 {
+    program_path = argv[0];
+    if (argc == 2 && !strcmp(argv[1], "sleep")) {
+        // Child started by start_sleeper().
+        mx_nanosleep(MX_TIME_INFINITE);
+        return 0;
+    }
+
     bool success = unittest_run_all_tests(argc, argv);
     return success ? 0 : -1;
 }
@@ -0,0 +1,160 @@
+// Copyright 2017 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <limits.h>
+#include <string.h>
+#include <threads.h>
+
+#include <magenta/syscalls.h>
+#include <shm-ring/ring.h>
+#include <unittest/unittest.h>
+
+static bool create_rings(size_t size, shm_ring_t* w, shm_ring_t* r) {
+    mx_handle_t producer[2];
+    mx_handle_t consumer[2];
+    ASSERT_EQ(shm_ring_create(size, producer, consumer), NO_ERROR, "");
+    ASSERT_EQ(shm_ring_init(w, producer), NO_ERROR, "");
+    ASSERT_EQ(shm_ring_init(r, consumer), NO_ERROR, "");
+    return true;
+}
+
+static bool basic_test(void) {
+    BEGIN_TEST;
+
+    shm_ring_t w, r;
+    ASSERT_TRUE(create_rings(1, &w, &r), "");
+    EXPECT_EQ(w.size, (size_t)PAGE_SIZE, "size should round up to a page");
+
+    char buf[64];
+    size_t actual;
+    EXPECT_EQ(shm_ring_read(&r, buf, sizeof(buf), &actual), ERR_SHOULD_WAIT, "");
+
+    EXPECT_EQ(shm_ring_write(&w, "hello", 5), NO_ERROR, "");
+    EXPECT_EQ(shm_ring_write(&w, "", 0), NO_ERROR, "");
+    EXPECT_EQ(shm_ring_write(&w, "world!", 6), NO_ERROR, "");
+
+    EXPECT_EQ(shm_ring_read(&r, buf, 2, &actual), ERR_BUFFER_TOO_SMALL, "");
+    EXPECT_EQ(actual, 5u, "");
+    EXPECT_EQ(shm_ring_read(&r, buf, sizeof(buf), &actual), NO_ERROR, "");
+    EXPECT_EQ(actual, 5u, "");
+    EXPECT_EQ(memcmp(buf, "hello", 5), 0, "");
+    EXPECT_EQ(shm_ring_read(&r, buf, sizeof(buf), &actual), NO_ERROR, "");
+    EXPECT_EQ(actual, 0u, "");
+    EXPECT_EQ(shm_ring_read(&r, buf, sizeof(buf), &actual), NO_ERROR, "");
+    EXPECT_EQ(actual, 6u, "");
+    EXPECT_EQ(memcmp(buf, "world!", 6), 0, "");
+    EXPECT_EQ(shm_ring_read(&r, buf, sizeof(buf), &actual), ERR_SHOULD_WAIT, "");
+
+    shm_ring_close(&w);
+    EXPECT_EQ(shm_ring_read(&r, buf, sizeof(buf), &actual), ERR_REMOTE_CLOSED, "");
+    shm_ring_close(&r);
+
+    END_TEST;
+}
+
+static bool full_and_wrap_test(void) {
+    BEGIN_TEST;
+
+    shm_ring_t w, r;
+    ASSERT_TRUE(create_rings(PAGE_SIZE, &w, &r), "");
+
+    uint8_t big[PAGE_SIZE];
+    EXPECT_EQ(shm_ring_write(&w, big, shm_ring_max_message(&w) + 1), ERR_OUT_OF_RANGE, "");
+
+    // An odd size, so messages end up split around the end of the ring.
+    const size_t len = 100;
+    uint32_t written = 0;
+    uint32_t read = 0;
+    for (int round = 0; round < 50; round++) {
+        mx_status_t status;
+        while (true) {
+            memset(big, written & 0xff, len);
+            if ((status = shm_ring_write(&w, big, len)) != NO_ERROR)
+                break;
+            written++;
+        }
+        ASSERT_EQ(status, ERR_SHOULD_WAIT, "");
+
+        // Reading one message is enough to wake the producer up again.
+        size_t actual;
+        ASSERT_EQ(shm_ring_read(&r, big, sizeof(big), &actual), NO_ERROR, "");
+        ASSERT_EQ(actual, len, "");
+        ASSERT_EQ(big[0], read & 0xff, "");
+        read++;
+        ASSERT_EQ(shm_ring_wait(&w, 0), NO_ERROR, "");
+
+        // Drain some, but not all, of it.
+        for (int i = 0; i < round % 7; i++) {
+            ASSERT_EQ(shm_ring_read(&r, big, sizeof(big), &actual), NO_ERROR, "");
+            ASSERT_EQ(big[len - 1], read & 0xff, "");
+            read++;
+        }
+    }
+
+    shm_ring_close(&r);
+    shm_ring_close(&w);
+
+    END_TEST;
+}
+
+#define NUM_MESSAGES 100000u
+
+static int consumer_thread(void* arg) {
+    shm_ring_t* r = arg;
+    uint32_t next = 0;
+    while (true) {
+        uint32_t msg[16];
+        size_t actual;
+        mx_status_t status = shm_ring_read(r, msg, sizeof(msg), &actual);
+        if (status == ERR_SHOULD_WAIT) {
+            if (shm_ring_wait(r, MX_TIME_INFINITE) != NO_ERROR)
+                return -1;
+            continue;
+        }
+        if (status == ERR_REMOTE_CLOSED)
+            break;
+        if (status != NO_ERROR || actual != (msg[0] % 16 + 1) * sizeof(uint32_t) ||
+            msg[0] != next)
+            return -1;
+        next++;
+    }
+    return next == NUM_MESSAGES ? 0 : -1;
+}
+
+static bool threads_test(void) {
+    BEGIN_TEST;
+
+    shm_ring_t w, r;
+    ASSERT_TRUE(create_rings(PAGE_SIZE, &w, &r), "");
+
+    thrd_t thread;
+    ASSERT_EQ(thrd_create(&thread, consumer_thread, &r), thrd_success, "");
+
+    for (uint32_t i = 0; i < NUM_MESSAGES; i++) {
+        uint32_t msg[16] = { i };
+        mx_status_t status;
+        while ((status = shm_ring_write(&w, msg, (i % 16 + 1) * sizeof(uint32_t))) ==
+               ERR_SHOULD_WAIT)
+            ASSERT_EQ(shm_ring_wait(&w, MX_TIME_INFINITE), NO_ERROR, "");
+        ASSERT_EQ(status, NO_ERROR, "");
+    }
+    shm_ring_close(&w);
+
+    int result;
+    EXPECT_EQ(thrd_join(thread, &result), thrd_success, "");
+    EXPECT_EQ(result, 0, "");
+    shm_ring_close(&r);
+
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(shm_ring_tests)
+RUN_TEST(basic_test)
+RUN_TEST(full_and_wrap_test)
+RUN_TEST(threads_test)
+END_TEST_CASE(shm_ring_tests)
+
+int main(int argc, char** argv) {
+    return unittest_run_all_tests(argc, argv) ? 0 : -1;
+}
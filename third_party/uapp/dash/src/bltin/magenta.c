@@ -17,6 +17,8 @@
 
 #include <hexdump/hexdump.h>
 #include <magenta/syscalls.h>
+#include <mxio/io.h>
+#include <mxio/vfs.h>
 
 int mxc_dump(int argc, char** argv) {
     int fd;
@@ -74,8 +76,7 @@ static const char* modestr(uint32_t mode) {
 int mxc_ls(int argc, char** argv) {
     const char* dirn;
     struct stat s;
-    char tmp[2048];
-    size_t dirln;
+    vnattr_t attr;
     struct dirent* de;
     DIR* dir;
 
@@ -88,7 +89,6 @@ int mxc_ls(int argc, char** argv) {
     } else {
         dirn = argv[1];
     }
-    dirln = strlen(dirn);
 
     if (argc > 2) {
         fprintf(stderr, "usage: ls [ <file_or_directory> ]\n");
@@ -102,14 +102,9 @@ int mxc_ls(int argc, char** argv) {
         printf("%s %8jd %s\n", modestr(s.st_mode), (intmax_t)s.st_size, dirn);
         return 0;
     }
-    while((de = readdir(dir)) != NULL) {
-        memset(&s, 0, sizeof(struct stat));
-        if ((strlen(de->d_name) + dirln + 2) <= sizeof(tmp)) {
-            snprintf(tmp, sizeof(tmp), "%s/%s", dirn, de->d_name);
-            stat(tmp, &s);
-        }
-        printf("%s %2ju %8jd %s\n", modestr(s.st_mode), s.st_nlink,
-               (intmax_t)s.st_size, de->d_name);
+    while((de = mxio_readdir_attr(dir, &attr)) != NULL) {
+        printf("%s %2ju %8jd %s\n", modestr(attr.mode), (uintmax_t)attr.nlink,
+               (intmax_t)attr.size, de->d_name);
     }
     closedir(dir);
     return 0;
@@ -199,6 +199,7 @@ struct cpu_set_t;
 int pthread_getaffinity_np(pthread_t, size_t, struct cpu_set_t*);
 int pthread_setaffinity_np(pthread_t, size_t, const struct cpu_set_t*);
 int pthread_getattr_np(pthread_t, pthread_attr_t*);
+int pthread_setcachesize_np(size_t);
 #endif
 
 #ifdef __cplusplus
@@ -3,6 +3,8 @@
 
 #include <magenta/process.h>
 #include <magenta/syscalls.h>
+#include <pthread.h>
+#include <runtime/mutex.h>
 #include <stddef.h>
 #include <string.h>
 
@@ -76,6 +78,208 @@ __NO_SAFESTACK static bool map_block(mx_handle_t parent_vmar,
     return status != NO_ERROR;
 }
 
+// The blocks of threads that have finished are kept for reuse, which
+// saves creating and mapping a new VMO and faulting in fresh zero pages
+// for every thread.  The stacks and the TCB are cached separately.  An
+// exiting thread gives its stacks back itself once it has switched off
+// them, in pthread_exit.  Its TCB stays in use until it is gone, so only
+// the TCBs of joined threads (or of threads detached after they died)
+// can be cached; a detached thread's exit call unmaps its own.
+//
+// The list nodes live in the cached memory itself: at the top of the
+// safe stack, where a new thread's stack will start anyway, and at the
+// start of the TCB, which is cleared before it is used again.  All of
+// this runs on the exiting thread's temporary stack or before the unsafe
+// stack is set up, so none of it may use the unsafe stack.
+
+#define DEFAULT_THREAD_CACHE_SIZE (2u << 20)
+
+struct cached_stacks {
+    struct cached_stacks* next;
+    struct iovec safe_stack, safe_stack_region;
+    struct iovec unsafe_stack, unsafe_stack_region;
+};
+
+struct cached_tcb {
+    struct cached_tcb* next;
+    struct iovec tcb_region;
+};
+
+static mxr_mutex_t cache_lock = MXR_MUTEX_INIT;
+static struct cached_stacks* stacks_cache;
+static struct cached_tcb* tcb_cache;
+// Bytes of stack and TCB held in the lists, not counting guard pages.
+static size_t cache_size;
+static size_t cache_max = DEFAULT_THREAD_CACHE_SIZE;
+
+__NO_SAFESTACK static void unmap_region(const struct iovec* region) {
+    _mx_vmar_unmap(_mx_vmar_root_self(),
+                   (uintptr_t)region->iov_base, region->iov_len);
+}
+
+__NO_SAFESTACK static size_t stacks_size(const struct cached_stacks* s) {
+    return s->safe_stack.iov_len + s->unsafe_stack.iov_len;
+}
+
+__NO_SAFESTACK static struct cached_stacks* stacks_node(
+    const struct iovec* safe_stack) {
+    return (struct cached_stacks*)((uintptr_t)safe_stack->iov_base +
+                                   safe_stack->iov_len) - 1;
+}
+
+__NO_SAFESTACK static size_t cached_tcb_size(const struct iovec* tcb_region) {
+    return tcb_region->iov_len - 2 * PAGE_SIZE;
+}
+
+__NO_SAFESTACK static struct cached_tcb* tcb_node(
+    const struct iovec* tcb_region) {
+    return (struct cached_tcb*)((uintptr_t)tcb_region->iov_base + PAGE_SIZE);
+}
+
+// Unmaps everything on the lists starting at |stacks| and |tcbs|, which
+// must no longer be reachable from the cache.
+__NO_SAFESTACK static void unmap_lists(struct cached_stacks* stacks,
+                                       struct cached_tcb* tcbs) {
+    while (stacks != NULL) {
+        // The node is in the safe stack, so read it all first.
+        struct cached_stacks s = *stacks;
+        unmap_region(&s.unsafe_stack_region);
+        unmap_region(&s.safe_stack_region);
+        stacks = s.next;
+    }
+    while (tcbs != NULL) {
+        struct cached_tcb t = *tcbs;
+        unmap_region(&t.tcb_region);
+        tcbs = t.next;
+    }
+}
+
+// Takes stacks of the given size and guard size off the cache.
+__NO_SAFESTACK static bool take_stacks(size_t stack_size, size_t guard_size,
+                                       struct cached_stacks* out) {
+    bool found = false;
+    mxr_mutex_lock(&cache_lock);
+    for (struct cached_stacks** p = &stacks_cache; *p != NULL;
+         p = &(*p)->next) {
+        struct cached_stacks* s = *p;
+        if (s->safe_stack.iov_len == stack_size &&
+            s->safe_stack_region.iov_len == stack_size + guard_size) {
+            *p = s->next;
+            *out = *s;
+            cache_size -= stacks_size(out);
+            found = true;
+            break;
+        }
+    }
+    mxr_mutex_unlock(&cache_lock);
+    return found;
+}
+
+// Takes a TCB of the given size off the cache, and clears it.
+__NO_SAFESTACK static bool take_tcb(size_t size, struct iovec* tcb,
+                                    struct iovec* tcb_region) {
+    bool found = false;
+    mxr_mutex_lock(&cache_lock);
+    for (struct cached_tcb** p = &tcb_cache; *p != NULL; p = &(*p)->next) {
+        struct cached_tcb* t = *p;
+        if (cached_tcb_size(&t->tcb_region) == size) {
+            *p = t->next;
+            *tcb_region = t->tcb_region;
+            cache_size -= size;
+            found = true;
+            break;
+        }
+    }
+    mxr_mutex_unlock(&cache_lock);
+
+    if (found) {
+        tcb->iov_base = tcb_node(tcb_region);
+        tcb->iov_len = size;
+        memset(tcb->iov_base, 0, tcb->iov_len);
+    }
+    return found;
+}
+
+// Puts stacks on the cache, or unmaps them if that would make it too big.
+__NO_SAFESTACK static void put_stacks(const struct cached_stacks* s) {
+    mxr_mutex_lock(&cache_lock);
+    if (cache_size + stacks_size(s) <= cache_max) {
+        struct cached_stacks* node = stacks_node(&s->safe_stack);
+        *node = *s;
+        node->next = stacks_cache;
+        stacks_cache = node;
+        cache_size += stacks_size(s);
+        mxr_mutex_unlock(&cache_lock);
+        return;
+    }
+    mxr_mutex_unlock(&cache_lock);
+    unmap_region(&s->unsafe_stack_region);
+    unmap_region(&s->safe_stack_region);
+}
+
+// Puts a TCB on the cache, or unmaps it if that would make it too big.
+__NO_SAFESTACK static void put_tcb(const struct iovec* tcb_region) {
+    const size_t size = cached_tcb_size(tcb_region);
+    mxr_mutex_lock(&cache_lock);
+    if (cache_size + size <= cache_max) {
+        struct cached_tcb* node = tcb_node(tcb_region);
+        node->tcb_region = *tcb_region;
+        node->next = tcb_cache;
+        tcb_cache = node;
+        cache_size += size;
+        mxr_mutex_unlock(&cache_lock);
+        return;
+    }
+    mxr_mutex_unlock(&cache_lock);
+    unmap_region(tcb_region);
+}
+
+__NO_SAFESTACK void __thread_free_stacks(pthread_t td) {
+    struct cached_stacks s = {
+        .safe_stack = td->safe_stack,
+        .safe_stack_region = td->safe_stack_region,
+        .unsafe_stack = td->unsafe_stack,
+        .unsafe_stack_region = td->unsafe_stack_region,
+    };
+    put_stacks(&s);
+}
+
+__NO_SAFESTACK void __thread_free_tcb(pthread_t td) {
+    // The region descriptor is in the TCB, which put_tcb may overwrite.
+    struct iovec tcb_region = td->tcb_region;
+    put_tcb(&tcb_region);
+}
+
+// Bounds the memory the cache may hold to |size| bytes of stack and TCB.
+// Zero turns the cache off.
+int pthread_setcachesize_np(size_t size) {
+    struct cached_stacks* stacks = NULL;
+    struct cached_tcb* tcbs = NULL;
+
+    // Trim the most recently cached blocks first, so what is left is
+    // whatever has been sitting there longest.
+    mxr_mutex_lock(&cache_lock);
+    cache_max = size;
+    while (cache_size > cache_max && stacks_cache != NULL) {
+        struct cached_stacks* s = stacks_cache;
+        stacks_cache = s->next;
+        cache_size -= stacks_size(s);
+        s->next = stacks;
+        stacks = s;
+    }
+    while (cache_size > cache_max && tcb_cache != NULL) {
+        struct cached_tcb* t = tcb_cache;
+        tcb_cache = t->next;
+        cache_size -= cached_tcb_size(&t->tcb_region);
+        t->next = tcbs;
+        tcbs = t;
+    }
+    mxr_mutex_unlock(&cache_lock);
+
+    unmap_lists(stacks, tcbs);
+    return 0;
+}
+
 // This allocates all the per-thread memory for a new thread about
 // to be created, or for the initial thread at startup.  It's called
 // either at startup or under __acquire_ptc.  Hence, it's serialized
@@ -94,6 +298,10 @@ __NO_SAFESTACK static bool map_block(mx_handle_t parent_vmar,
 // This function also copies in the TLS initializer data.
 // It initializes the basic thread descriptor fields.
 // Everything else is zero-initialized.
+//
+// The stacks and the TCB block come from the cache when it has ones
+// of the right size.  A cached TCB block is cleared before use, but
+// cached stacks hold whatever the last thread left on them.
 
 __NO_SAFESTACK pthread_t __allocate_thread(const pthread_attr_t* attr) {
     const size_t guard_size =
@@ -102,43 +310,47 @@ __NO_SAFESTACK pthread_t __allocate_thread(const pthread_attr_t* attr) {
 
     const size_t tcb_size = round_up_to_page(libc.tls_size);
 
-    const size_t vmo_size = tcb_size + stack_size * 2;
-    mx_handle_t vmo;
-    mx_status_t status = _mx_vmo_create(vmo_size, 0, &vmo);
-    if (status != NO_ERROR)
-        return NULL;
-
+    struct cached_stacks stacks;
+    bool have_stacks = take_stacks(stack_size, guard_size, &stacks);
     struct iovec tcb, tcb_region;
-    if (map_block(_mx_vmar_root_self(), vmo, 0, tcb_size, PAGE_SIZE, PAGE_SIZE,
-                  &tcb, &tcb_region)) {
-        _mx_handle_close(vmo);
-        return NULL;
-    }
+    bool have_tcb = take_tcb(tcb_size, &tcb, &tcb_region);
 
-    pthread_t td = copy_tls(tcb.iov_base, tcb.iov_len);
+    mx_handle_t vmo = MX_HANDLE_INVALID;
+    const size_t vmo_size =
+        (have_tcb ? 0 : tcb_size) + (have_stacks ? 0 : stack_size * 2);
+    if (vmo_size != 0 && _mx_vmo_create(vmo_size, 0, &vmo) != NO_ERROR)
+        goto fail;
 
-    if (map_block(_mx_vmar_root_self(), vmo,
-                  tcb_size, stack_size, guard_size, 0,
-                  &td->safe_stack, &td->safe_stack_region)) {
-        _mx_vmar_unmap(_mx_vmar_root_self(),
-                       (uintptr_t)tcb_region.iov_base, tcb_region.iov_len);
-        _mx_handle_close(vmo);
-        return NULL;
+    size_t vmo_offset = 0;
+    if (!have_tcb) {
+        if (map_block(_mx_vmar_root_self(), vmo, 0, tcb_size,
+                      PAGE_SIZE, PAGE_SIZE, &tcb, &tcb_region))
+            goto fail;
+        have_tcb = true;
+        vmo_offset = tcb_size;
     }
 
-    if (map_block(_mx_vmar_root_self(), vmo,
-                  tcb_size + stack_size, stack_size, guard_size, 0,
-                  &td->unsafe_stack, &td->unsafe_stack_region)) {
-        _mx_vmar_unmap(_mx_vmar_root_self(),
-                       (uintptr_t)td->safe_stack_region.iov_base,
-                       td->safe_stack_region.iov_len);
-        _mx_vmar_unmap(_mx_vmar_root_self(),
-                       (uintptr_t)tcb_region.iov_base, tcb_region.iov_len);
-        _mx_handle_close(vmo);
-        return NULL;
+    if (!have_stacks) {
+        if (map_block(_mx_vmar_root_self(), vmo,
+                      vmo_offset, stack_size, guard_size, 0,
+                      &stacks.safe_stack, &stacks.safe_stack_region))
+            goto fail;
+        if (map_block(_mx_vmar_root_self(), vmo,
+                      vmo_offset + stack_size, stack_size, guard_size, 0,
+                      &stacks.unsafe_stack, &stacks.unsafe_stack_region)) {
+            unmap_region(&stacks.safe_stack_region);
+            goto fail;
+        }
     }
 
-    _mx_handle_close(vmo);
+    if (vmo != MX_HANDLE_INVALID)
+        _mx_handle_close(vmo);
+
+    pthread_t td = copy_tls(tcb.iov_base, tcb.iov_len);
+    td->safe_stack = stacks.safe_stack;
+    td->safe_stack_region = stacks.safe_stack_region;
+    td->unsafe_stack = stacks.unsafe_stack;
+    td->unsafe_stack_region = stacks.unsafe_stack_region;
     td->tcb_region = tcb_region;
     td->locale = &libc.global_locale;
     td->head.tp = (uintptr_t)pthread_to_tp(td);
@@ -146,4 +358,13 @@ __NO_SAFESTACK pthread_t __allocate_thread(const pthread_attr_t* attr) {
     td->abi.unsafe_sp =
         (uintptr_t)td->unsafe_stack.iov_base + td->unsafe_stack.iov_len;
     return td;
+
+fail:
+    if (vmo != MX_HANDLE_INVALID)
+        _mx_handle_close(vmo);
+    if (have_stacks)
+        put_stacks(&stacks);
+    if (have_tcb)
+        put_tcb(&tcb_region);
+    return NULL;
 }
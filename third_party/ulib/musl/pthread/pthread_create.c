@@ -37,11 +37,6 @@ static void start_c11(void* arg) {
     pthread_exit((void*)(intptr_t)start(self->start_arg));
 }
 
-static void deallocate_region(const struct iovec* region) {
-    _mx_vmar_unmap(_mx_vmar_root_self(),
-                   (uintptr_t)region->iov_base, region->iov_len);
-}
-
 int pthread_create(pthread_t* restrict res, const pthread_attr_t* restrict attrp, void* (*entry)(void*), void* restrict arg) {
     pthread_attr_t attr = attrp == NULL ? DEFAULT_PTHREAD_ATTR : *attrp;
 
@@ -105,9 +100,8 @@ int pthread_create(pthread_t* restrict res, const pthread_attr_t* restrict attrp
 
     atomic_fetch_sub(&libc.thread_count, 1);
 fail_after_alloc:
-    deallocate_region(&new->safe_stack_region);
-    deallocate_region(&new->unsafe_stack_region);
-    deallocate_region(&new->tcb_region);
+    __thread_free_stacks(new);
+    __thread_free_tcb(new);
     return status == ERR_ACCESS_DENIED ? EPERM : EAGAIN;
 }
 
@@ -115,11 +109,10 @@ static _Noreturn void final_exit(pthread_t self)
     __asm__("final_exit") __attribute__((used));
 
 static __NO_SAFESTACK void final_exit(pthread_t self) {
-    deallocate_region(&self->safe_stack_region);
-    deallocate_region(&self->unsafe_stack_region);
+    __thread_free_stacks(self);
 
     // This deallocates the TCB region too for the detached case.
-    // If not detached, pthread_join will deallocate it.
+    // If not detached, pthread_join will give it back to the cache.
     mxr_thread_exit_unmap_if_detached(&self->mxr_thread, _mx_vmar_root_self(),
                                       (uintptr_t)self->tcb_region.iov_base,
                                       self->tcb_region.iov_len);
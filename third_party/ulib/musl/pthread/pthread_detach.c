@@ -1,5 +1,4 @@
 #include "pthread_impl.h"
-#include <magenta/process.h>
 #include <threads.h>
 
 static int __pthread_detach(pthread_t t) {
@@ -8,9 +7,7 @@ static int __pthread_detach(pthread_t t) {
         return 0;
     case ERR_BAD_STATE:
         // It already died before it knew to deallocate itself.
-        _mx_vmar_unmap(_mx_vmar_root_self(),
-                       (uintptr_t)t->tcb_region.iov_base,
-                       t->tcb_region.iov_len);
+        __thread_free_tcb(t);
         return 0;
     default:
         return ESRCH;
@@ -201,4 +201,10 @@ static inline int __rt_sigqueueinfo(pid_t pid, int sig, siginfo_t* info) {
 pthread_t __allocate_thread(const pthread_attr_t* attr)
     __attribute__((nonnull(1))) ATTR_LIBC_VISIBILITY;
 
+// These give a thread's stacks, once it is no longer running on them,
+// and its TCB, once it is gone, back to the cache __allocate_thread
+// draws on.  They unmap them instead if the cache is full.
+void __thread_free_stacks(pthread_t td) ATTR_LIBC_VISIBILITY;
+void __thread_free_tcb(pthread_t td) ATTR_LIBC_VISIBILITY;
+
 pthread_t __init_main_thread(mx_handle_t thread_self) ATTR_LIBC_VISIBILITY;
@@ -9,6 +9,11 @@
 
 #include "pthread_impl.h"
 
+// Hook for the io library to map files: map len bytes of fd starting at
+// fd_off into the root VMAR at offset, as mmap() describes with flags.
+mx_status_t _mmap_file(size_t offset, size_t len, uint32_t mx_flags, int flags,
+                       int fd, off_t fd_off, uintptr_t* out) __attribute__((weak));
+
 void* __mmap(void* start, size_t len, int prot, int flags, int fd, off_t off) {
     if (off & (PAGE_SIZE - 1)) {
         errno = EINVAL;
@@ -35,65 +40,79 @@ void* __mmap(void* start, size_t len, int prot, int flags, int fd, off_t off) {
 
     //printf("__mmap start %p, len %zu prot %u flags %u fd %d off %llx\n", start, len, prot, flags, fd, off);
 
-    // look for a specific case that we can handle, from pthread_create
-    if ((flags & MAP_ANON) && (fd < 0)) {
-        // round up to page size
-        len = (len + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    if (!(flags & MAP_ANON) && (fd < 0)) {
+        errno = EBADF;
+        return MAP_FAILED;
+    }
+    if (!(flags & MAP_ANON) && (&_mmap_file == NULL)) {
+        // No companion library to map files with.
+        errno = ENODEV;
+        return MAP_FAILED;
+    }
+
+    // round up to page size
+    len = (len + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
 
-        // build magenta flags for this
-        uint32_t mx_flags = 0;
-        mx_flags |= (prot & PROT_READ) ? MX_VM_FLAG_PERM_READ : 0;
-        mx_flags |= (prot & PROT_WRITE) ? MX_VM_FLAG_PERM_WRITE : 0;
-        mx_flags |= (prot & PROT_EXEC) ? MX_VM_FLAG_PERM_EXECUTE : 0;
+    // build magenta flags for this
+    uint32_t mx_flags = 0;
+    mx_flags |= (prot & PROT_READ) ? MX_VM_FLAG_PERM_READ : 0;
+    mx_flags |= (prot & PROT_WRITE) ? MX_VM_FLAG_PERM_WRITE : 0;
+    mx_flags |= (prot & PROT_EXEC) ? MX_VM_FLAG_PERM_EXECUTE : 0;
 
-        size_t offset = 0;
-        if (flags & MAP_FIXED) {
-            mx_flags |= MX_VM_FLAG_SPECIFIC;
+    size_t offset = 0;
+    if (flags & MAP_FIXED) {
+        mx_flags |= MX_VM_FLAG_SPECIFIC;
 
-            mx_info_vmar_t info;
-            mx_status_t status = _mx_object_get_info(_mx_vmar_root_self(),
-                                                     MX_INFO_VMAR, &info,
-                                                     sizeof(info), NULL, NULL);
-            if (status < 0 || (uintptr_t)start < info.base) {
-                return MAP_FAILED;
-            }
-            offset = (uintptr_t)start - info.base;
+        mx_info_vmar_t info;
+        mx_status_t status = _mx_object_get_info(_mx_vmar_root_self(),
+                                                 MX_INFO_VMAR, &info,
+                                                 sizeof(info), NULL, NULL);
+        if (status < 0 || (uintptr_t)start < info.base) {
+            return MAP_FAILED;
         }
+        offset = (uintptr_t)start - info.base;
+    }
 
+    uintptr_t ptr = 0;
+    mx_status_t status;
+    if (flags & MAP_ANON) {
         mx_handle_t vmo;
         if (_mx_vmo_create(len, 0, &vmo) < 0) {
             errno = ENOMEM;
             return MAP_FAILED;
         }
 
-        uintptr_t ptr = 0;
-        mx_status_t status = _mx_vmar_map(_mx_vmar_root_self(), offset, vmo, 0,
-                                          len, mx_flags, &ptr);
+        status = _mx_vmar_map(_mx_vmar_root_self(), offset, vmo, 0,
+                              len, mx_flags, &ptr);
         _mx_handle_close(vmo);
         // TODO: map this as shared if we ever implement forking
-        if (status < 0) {
-            switch(status) {
-            case ERR_ACCESS_DENIED:
-                errno = EACCES;
-                break;
-            case ERR_NO_MEMORY:
-                errno = ENOMEM;
-                break;
-            case ERR_INVALID_ARGS:
-            case ERR_BAD_STATE:
-            default:
-                errno = EINVAL;
-                break;
-            }
-            return MAP_FAILED;
-        }
-
-        return (void*)ptr;
     } else {
-        // TODO(kulakowski) mxio file mapping
-        errno = ENODEV;
+        status = _mmap_file(offset, len, mx_flags, flags, fd, off, &ptr);
+    }
+    if (status < 0) {
+        switch(status) {
+        case ERR_ACCESS_DENIED:
+            errno = EACCES;
+            break;
+        case ERR_NO_MEMORY:
+            errno = ENOMEM;
+            break;
+        case ERR_BAD_HANDLE:
+            errno = EBADF;
+            break;
+        case ERR_NOT_SUPPORTED:
+            errno = ENODEV;
+            break;
+        case ERR_INVALID_ARGS:
+        case ERR_BAD_STATE:
+        default:
+            errno = EINVAL;
+            break;
+        }
         return MAP_FAILED;
     }
+
+    return (void*)ptr;
 }
 
 weak_alias(__mmap, mmap);